@@ -0,0 +1,95 @@
+// Counting malloc for the allocation check, compiled only with PLAYER_COUNT_ALLOCATIONS.
+// Linked into an executable, these definitions take the place of the C library's for the
+// whole process, FFmpeg and libstdc++ included; they count and hand over to glibc.
+
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static std::atomic<int64_t> player_counts[ALLOCATION_STAGE_COUNT];
+static std::atomic<int64_t> library_counts[ALLOCATION_STAGE_COUNT];
+
+// plain TLS in the executable, reading it must not allocate
+static __thread int thread_stage __attribute__((tls_model("initial-exec"))) = ALLOCATION_OTHER;
+static __thread int library_depth __attribute__((tls_model("initial-exec"))) = 0;
+
+static inline void count_allocation() {
+    std::atomic<int64_t> *counts = library_depth > 0 ? library_counts : player_counts;
+    counts[thread_stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+void allocation_set_stage(AllocationStage stage) {
+    thread_stage = stage;
+}
+
+void allocation_library_enter() {
+    library_depth++;
+}
+
+void allocation_library_leave() {
+    library_depth--;
+}
+
+bool allocation_in_library() {
+    return library_depth > 0;
+}
+
+AllocationCounts allocation_counts() {
+    AllocationCounts counts;
+    for (int i = 0; i < ALLOCATION_STAGE_COUNT; i++) {
+        counts.player[i] = player_counts[i].load(std::memory_order_relaxed);
+        counts.library[i] = library_counts[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    count_allocation();
+    return __libc_realloc(pointer, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    count_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    count_allocation();
+    void *memory = __libc_memalign(alignment, size);
+    if (memory == nullptr) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+}
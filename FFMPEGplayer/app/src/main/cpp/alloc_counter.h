@@ -0,0 +1,94 @@
+#ifndef FFMPEGPLAYER_ALLOC_COUNTER_H
+#define FFMPEGPLAYER_ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// the pipeline threads, which the allocation counter attributes heap allocations to
+enum AllocationStage {
+    ALLOCATION_OTHER = 0,
+    ALLOCATION_DEMUX,
+    ALLOCATION_DECODE,
+    ALLOCATION_CONVERT,
+    ALLOCATION_PRESENT,
+    ALLOCATION_AUDIO,
+    ALLOCATION_STAGE_COUNT
+};
+
+inline const char *allocation_stage_name(int stage) {
+    static const char *const NAMES[ALLOCATION_STAGE_COUNT] = {"other", "demux", "decode", "convert", "present", "audio"};
+    return stage >= 0 && stage < ALLOCATION_STAGE_COUNT ? NAMES[stage] : "unknown";
+}
+
+// heap allocations since the process started, per stage
+struct AllocationCounts {
+    // made by the player's own code
+    int64_t player[ALLOCATION_STAGE_COUNT] = {};
+    // made inside FFmpeg while a LibraryCall was open, less any PlayerCode scopes it calls back
+    // into: packet payloads, AVBufferRef bookkeeping
+    int64_t library[ALLOCATION_STAGE_COUNT] = {};
+};
+
+// Built with PLAYER_COUNT_ALLOCATIONS (a CMake option of the Linux build), alloc_counter.cpp
+// replaces malloc and friends with counting versions. Without it these compile to nothing.
+#ifdef PLAYER_COUNT_ALLOCATIONS
+
+// the stage the calling thread runs, for the allocations it makes from now on
+void allocation_set_stage(AllocationStage stage);
+
+void allocation_library_enter();
+void allocation_library_leave();
+// whether the calling thread is inside a LibraryCall
+bool allocation_in_library();
+
+AllocationCounts allocation_counts();
+
+#else
+
+inline void allocation_set_stage(AllocationStage) {}
+
+inline void allocation_library_enter() {}
+
+inline void allocation_library_leave() {}
+
+inline bool allocation_in_library() { return false; }
+
+inline AllocationCounts allocation_counts() { return AllocationCounts(); }
+
+#endif
+
+// brackets a call into FFmpeg, whose own allocations are counted apart from the player's
+class LibraryCall {
+public:
+    LibraryCall() { allocation_library_enter(); }
+
+    ~LibraryCall() { allocation_library_leave(); }
+
+    LibraryCall(const LibraryCall &) = delete;
+    LibraryCall &operator=(const LibraryCall &) = delete;
+};
+
+// brackets the player's own code when FFmpeg calls back into it from inside a LibraryCall
+// (get_buffer2 growing the frame pool), so those allocations still count as the player's.
+// FFmpeg's own threads are never inside one, there it leaves the count alone.
+class PlayerCode {
+public:
+    PlayerCode() : left_(allocation_in_library()) {
+        if (left_) {
+            allocation_library_leave();
+        }
+    }
+
+    ~PlayerCode() {
+        if (left_) {
+            allocation_library_enter();
+        }
+    }
+
+    PlayerCode(const PlayerCode &) = delete;
+    PlayerCode &operator=(const PlayerCode &) = delete;
+
+private:
+    bool left_;
+};
+
+#endif // FFMPEGPLAYER_ALLOC_COUNTER_H
@@ -0,0 +1,279 @@
+#include "audio_pipeline.h"
+
+#include "alloc_counter.h"
+#include "item_recycler.h"
+#include "log.h"
+#include "time_util.h"
+#include "trace.h"
+
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/samplefmt.h"
+}
+
+int64_t AudioClock::time_us() {
+    int64_t head = audio_->head_media_us_.load();
+    if (head == AV_NOPTS_VALUE || audio_->sink_->frames_played() == 0) {
+        return AV_NOPTS_VALUE;
+    }
+    int64_t drained = audio_->drained_wall_us_.load();
+    if (drained == AV_NOPTS_VALUE && audio_->finished_.load() && audio_->ring_->available() == 0) {
+        // nothing left to play, from here on the clock free-runs
+        int64_t unset = AV_NOPTS_VALUE;
+        audio_->drained_wall_us_.compare_exchange_strong(unset, now_us());
+        drained = audio_->drained_wall_us_.load();
+    }
+    // frames between the device's play position and the newest one written
+    int64_t pending = audio_->head_written_.load() - audio_->sink_->frames_played() - audio_->discarded_frames_.load();
+    int64_t position = head - av_rescale(pending, 1000000, audio_->format_.sample_rate);
+    if (drained != AV_NOPTS_VALUE) {
+        return position + now_us() - drained;
+    }
+    return position;
+}
+
+AudioPipeline::AudioPipeline(AVCodecContext *codec_context, int stream_index, AVRational time_base,
+                             AudioSink *sink, const AudioPipelineOptions &options)
+        : codec_context_(codec_context),
+          stream_index_(stream_index),
+          time_base_(time_base),
+          sink_(sink),
+          options_(options),
+          packet_queue_(options.packet_limits, time_base),
+          clock_(this) {
+}
+
+AudioPipeline::~AudioPipeline() {
+    abort();
+    join();
+    AVPacket *packet;
+    while (packet_queue_.try_pop(packet)) {
+        media_packet_put(&packet);
+    }
+    av_freep(&convert_buffer_);
+    swr_free(&swr_context_);
+    delete ring_;
+}
+
+int AudioPipeline::start() {
+    format_.sample_rate = options_.sample_rate > 0 ? options_.sample_rate : codec_context_->sample_rate;
+    format_.channels = FFMAX(1, FFMIN(codec_context_->ch_layout.nb_channels, FFMIN(options_.max_channels, 2)));
+    ring_ = new AudioRing((size_t) format_.sample_rate * options_.ring_ms / 1000, format_.channels);
+    int result = sink_->open(format_, ring_);
+    if (result < 0) {
+        return result;
+    }
+    // resample to the device format
+    AVChannelLayout out_layout;
+    av_channel_layout_default(&out_layout, format_.channels);
+    result = swr_alloc_set_opts2(&swr_context_,
+                                 &out_layout, AV_SAMPLE_FMT_S16, format_.sample_rate,
+                                 &codec_context_->ch_layout, codec_context_->sample_fmt, codec_context_->sample_rate,
+                                 0, nullptr);
+    av_channel_layout_uninit(&out_layout);
+    if (result < 0 || (result = swr_init(swr_context_)) < 0) {
+        LOGE("Player Error : Can not create audio resampler");
+        return result;
+    }
+    decode_thread_ = std::thread(&AudioPipeline::decode_loop, this);
+    return sink_->start();
+}
+
+void AudioPipeline::abort() {
+    aborted_.store(true);
+    packet_queue_.abort();
+}
+
+void AudioPipeline::join() {
+    if (decode_thread_.joinable()) {
+        decode_thread_.join();
+    }
+    // let the device play what is left unless we were told to stop
+    while (!aborted_.load() && ring_ != nullptr && ring_->available() > 0) {
+        precise_sleep_us(5000);
+    }
+    sink_->stop();
+}
+
+void AudioPipeline::pause() {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    paused_ = true;
+    sink_->pause();
+}
+
+void AudioPipeline::resume() {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    paused_ = false;
+    sink_->start();
+}
+
+void AudioPipeline::flush(int serial) {
+    serial_.store(serial);
+}
+
+AudioStats AudioPipeline::stats() const {
+    AudioStats stats;
+    stats.packets = packets_;
+    stats.frames_decoded = frames_decoded_;
+    stats.frames_played = sink_->frames_played();
+    stats.underruns = sink_->underruns();
+    return stats;
+}
+
+void AudioPipeline::decode_loop() {
+    allocation_set_stage(ALLOCATION_AUDIO);
+    trace_set_thread_name("audio decode");
+    AVPacket *packet = nullptr;
+    AVFrame *frame = media_frame_get();
+    while (!aborted_.load() && packet_queue_.pop(packet)) {
+        int serial = media_item_serial(packet);
+        if (serial != serial_.load()) {
+            // queued before a seek
+            media_packet_put(&packet);
+            continue;
+        }
+        if (serial != decoder_serial_) {
+            restart(serial);
+        }
+        if (media_item_is_eos(packet)) {
+            media_packet_put(&packet);
+            drain();
+            continue;
+        }
+        packets_++;
+        int result;
+        {
+            LibraryCall library;
+            TraceScope trace("avcodec_send_packet", packet->pts);
+            result = avcodec_send_packet(codec_context_, packet);
+        }
+        media_packet_put(&packet);
+        if (result < 0 && result != AVERROR(EAGAIN)) {
+            // a broken audio packet should not stop playback
+            continue;
+        }
+        for (;;) {
+            {
+                LibraryCall library;
+                TraceScope trace("avcodec_receive_frame");
+                result = avcodec_receive_frame(codec_context_, frame);
+                trace.set_pts(result >= 0 ? frame->pts : TRACE_NO_PTS);
+            }
+            if (result < 0) {
+                break;
+            }
+            write_frame(frame);
+            av_frame_unref(frame);
+        }
+    }
+    media_frame_put(&frame);
+    finished_.store(true);
+}
+
+// first packet after a seek: nothing decoded, resampled or buffered before it may be played
+void AudioPipeline::restart(int serial) {
+    decoder_serial_ = serial;
+    {
+        LibraryCall library;
+        TraceScope trace("avcodec_flush_buffers");
+        avcodec_flush_buffers(codec_context_);
+        // swr_init allocates the resampler's buffers anew
+        swr_close(swr_context_);
+        swr_init(swr_context_);
+    }
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    // the ring may only be reset while the device is not reading it; what the device had
+    // queued from before the seek is dropped with it
+    int64_t dropped = sink_->flush();
+    discarded_frames_.fetch_add(ring_->written() - ring_->read_total() + dropped);
+    ring_->reset();
+    head_media_us_.store(AV_NOPTS_VALUE);
+    drained_wall_us_.store(AV_NOPTS_VALUE);
+    finished_.store(false);
+    if (!paused_) {
+        sink_->start();
+    }
+}
+
+// end of stream: flush the frames the decoder and the resampler still hold
+void AudioPipeline::drain() {
+    AVFrame *frame = media_frame_get();
+    {
+        LibraryCall library;
+        TraceScope trace("avcodec_send_packet");
+        avcodec_send_packet(codec_context_, nullptr);
+    }
+    for (;;) {
+        int result;
+        {
+            LibraryCall library;
+            TraceScope trace("avcodec_receive_frame");
+            result = avcodec_receive_frame(codec_context_, frame);
+            trace.set_pts(result >= 0 ? frame->pts : TRACE_NO_PTS);
+        }
+        if (result < 0) {
+            break;
+        }
+        write_frame(frame);
+        av_frame_unref(frame);
+    }
+    write_frame(nullptr);
+    media_frame_put(&frame);
+    finished_.store(true);
+}
+
+int AudioPipeline::write_frame(const AVFrame *frame) {
+    int in_frames = frame ? frame->nb_samples : 0;
+    int out_frames = swr_get_out_samples(swr_context_, in_frames);
+    if (out_frames > convert_capacity_) {
+        av_freep(&convert_buffer_);
+        // with headroom, the resampler's delay varies a little from frame to frame and should
+        // not make it grow again mid-stream
+        int capacity = out_frames * 2;
+        if (av_samples_alloc(&convert_buffer_, nullptr, format_.channels, capacity, AV_SAMPLE_FMT_S16, 0) < 0) {
+            convert_capacity_ = 0;
+            return AVERROR(ENOMEM);
+        }
+        convert_capacity_ = capacity;
+    }
+    {
+        // with no frame this flushes what the resampler still holds
+        LibraryCall library;
+        TraceScope trace("swr_convert", frame ? frame->pts : TRACE_NO_PTS);
+        out_frames = swr_convert(swr_context_, &convert_buffer_, convert_capacity_,
+                                 frame ? (const uint8_t **) frame->extended_data : nullptr, in_frames);
+    }
+    if (out_frames <= 0) {
+        return out_frames;
+    }
+    int64_t written = ring_->written();
+    int64_t timestamp = frame ? frame->best_effort_timestamp : AV_NOPTS_VALUE;
+    if (timestamp != AV_NOPTS_VALUE) {
+        // the ring position now lines up with the end of this frame
+        head_written_.store(written + out_frames);
+        head_media_us_.store(av_rescale_q(timestamp, time_base_, AVRational{1, 1000000})
+                             + av_rescale(out_frames, 1000000, format_.sample_rate));
+    } else if (head_media_us_.load() != AV_NOPTS_VALUE) {
+        // no timestamp: continue from the previous frame
+        head_media_us_.store(head_media_us_.load() + av_rescale(written + out_frames - head_written_.load(),
+                                                                1000000, format_.sample_rate));
+        head_written_.store(written + out_frames);
+    }
+    frames_decoded_ += out_frames;
+    return write_samples(convert_buffer_, out_frames);
+}
+
+int AudioPipeline::write_samples(const uint8_t *samples, int frames) {
+    auto *pcm = (const int16_t *) samples;
+    while (frames > 0 && !aborted_.load() && serial_.load() == decoder_serial_) {
+        size_t written = ring_->write(pcm, frames);
+        pcm += written * format_.channels;
+        frames -= (int) written;
+        if (frames > 0) {
+            // the device drains the ring in periods of 10 ms
+            precise_sleep_us(5000);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#ifndef FFMPEGPLAYER_AUDIO_PIPELINE_H
+#define FFMPEGPLAYER_AUDIO_PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libswresample/swresample.h"
+}
+
+#include "audio_ring.h"
+#include "audio_sink.h"
+#include "master_clock.h"
+#include "media_queue.h"
+
+struct AudioPipelineOptions {
+    AudioPipelineOptions() {
+        packet_limits.max_items = 512;
+        packet_limits.max_duration_us = 4 * 1000000;
+    }
+
+    // 0 keeps the source rate
+    int sample_rate = 0;
+    // 1 or 2 output channels, more are downmixed
+    int max_channels = 2;
+    // decoded audio buffered ahead of the device
+    int ring_ms = 500;
+    MediaQueueLimits packet_limits;
+};
+
+struct AudioStats {
+    int64_t packets = 0;
+    int64_t frames_decoded = 0;
+    int64_t frames_played = 0;
+    int64_t underruns = 0;
+};
+
+class AudioPipeline;
+
+/**
+ * Playback position of the audio device: media time of the newest sample written, minus
+ * what is still buffered in the ring and the device. Once the audio is over it keeps
+ * running on the wall clock so a longer video track still finishes.
+ */
+class AudioClock : public MasterClock {
+public:
+    explicit AudioClock(AudioPipeline *audio) : audio_(audio) {}
+    int64_t time_us() override;
+
+private:
+    AudioPipeline *audio_;
+};
+
+/**
+ * Audio decode -> swresample -> ring -> sink. Packets come from the video pipeline's demuxer
+ * through packet_queue(); one thread decodes and converts to interleaved S16 at the device
+ * rate, the sink drains the ring on its own thread.
+ * Packets carry the serial of the seek they belong to and an end of stream item per serial
+ * (see media_item_serial()); after flush() the first packet of the new serial resets the
+ * decoder, the resampler and the ring before anything new is played.
+ */
+class AudioPipeline {
+public:
+    AudioPipeline(AVCodecContext *codec_context, int stream_index, AVRational time_base,
+                  AudioSink *sink, const AudioPipelineOptions &options = AudioPipelineOptions());
+    ~AudioPipeline();
+
+    // set up the resampler and the device and start decoding, returns 0 or a negative AVERROR
+    int start();
+
+    // stop decoding and the device right away
+    void abort();
+
+    // wait for the decoder to finish and the device to play out what is buffered
+    void join();
+
+    void pause();
+    void resume();
+
+    // a seek started serial; everything older still queued or buffered is thrown away
+    void flush(int serial);
+
+    int stream_index() const { return stream_index_; }
+    MediaQueue<AVPacket *> &packet_queue() { return packet_queue_; }
+    MasterClock *clock() { return &clock_; }
+    AudioStats stats() const;
+
+private:
+    friend class AudioClock;
+
+    void decode_loop();
+    void restart(int serial);
+    void drain();
+    int write_frame(const AVFrame *frame);
+    int write_samples(const uint8_t *samples, int frames);
+
+    AVCodecContext *codec_context_;
+    int stream_index_;
+    AVRational time_base_;
+    AudioSink *sink_;
+    AudioPipelineOptions options_;
+    AudioFormat format_;
+    SwrContext *swr_context_ = nullptr;
+    AudioRing *ring_ = nullptr;
+    uint8_t *convert_buffer_ = nullptr;
+    int convert_capacity_ = 0;
+
+    MediaQueue<AVPacket *> packet_queue_;
+    std::thread decode_thread_;
+    std::atomic<bool> aborted_{false};
+    std::atomic<bool> finished_{false};
+    // serial playing now, and the one the decoder has been reset for
+    std::atomic<int> serial_{0};
+    int decoder_serial_ = 0;
+    // serialises pause/resume from the control side with the decode thread's restart
+    std::mutex sink_mutex_;
+    bool paused_ = false;
+    // frames thrown out of the ring by seeks, they count as played for the clock
+    std::atomic<int64_t> discarded_frames_{0};
+    // media time just past the newest sample in the ring, and the ring's write count at that point
+    std::atomic<int64_t> head_media_us_{AV_NOPTS_VALUE};
+    std::atomic<int64_t> head_written_{0};
+    // wall time the last sample was played, for the clock after the audio ended
+    std::atomic<int64_t> drained_wall_us_{AV_NOPTS_VALUE};
+    int64_t frames_decoded_ = 0;
+    int64_t packets_ = 0;
+    AudioClock clock_;
+};
+
+#endif // FFMPEGPLAYER_AUDIO_PIPELINE_H
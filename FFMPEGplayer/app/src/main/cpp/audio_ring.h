@@ -0,0 +1,92 @@
+#ifndef FFMPEGPLAYER_AUDIO_RING_H
+#define FFMPEGPLAYER_AUDIO_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "spsc_queue.h"
+
+/**
+ * Lock-free single-producer/single-consumer ring of interleaved S16 audio frames.
+ * The decode thread writes, the device callback reads; neither side ever blocks, so it is
+ * safe to use from a real-time audio callback. Positions count frames since creation.
+ */
+class AudioRing {
+public:
+    AudioRing(size_t frames, int channels) : channels_(channels) {
+        size_t size = 1;
+        while (size < frames) {
+            size <<= 1;
+        }
+        capacity_ = size;
+        samples_.resize(size * channels);
+    }
+
+    // producer side, returns how many frames fit
+    size_t write(const int16_t *samples, size_t frames) {
+        size_t write_position = write_position_.load(std::memory_order_relaxed);
+        size_t space = capacity_ - (write_position - read_position_.load(std::memory_order_acquire));
+        if (frames > space) {
+            frames = space;
+        }
+        copy_in(samples, write_position, frames);
+        write_position_.store(write_position + frames, std::memory_order_release);
+        return frames;
+    }
+
+    // consumer side, returns how many frames were available
+    size_t read(int16_t *samples, size_t frames) {
+        size_t read_position = read_position_.load(std::memory_order_relaxed);
+        size_t available = write_position_.load(std::memory_order_acquire) - read_position;
+        if (frames > available) {
+            frames = available;
+        }
+        copy_out(samples, read_position, frames);
+        read_position_.store(read_position + frames, std::memory_order_release);
+        return frames;
+    }
+
+    size_t available() const {
+        return write_position_.load(std::memory_order_acquire) - read_position_.load(std::memory_order_acquire);
+    }
+
+    size_t space() const { return capacity_ - available(); }
+    size_t capacity() const { return capacity_; }
+    int channels() const { return channels_; }
+
+    // frames ever written / read
+    int64_t written() const { return (int64_t) write_position_.load(std::memory_order_acquire); }
+    int64_t read_total() const { return (int64_t) read_position_.load(std::memory_order_acquire); }
+
+    // drop everything buffered; only while the consumer is stopped, see AudioSink::flush()
+    void reset() { read_position_.store(write_position_.load()); }
+
+private:
+    void copy_in(const int16_t *samples, size_t position, size_t frames) {
+        size_t offset = position & (capacity_ - 1);
+        size_t first = frames < capacity_ - offset ? frames : capacity_ - offset;
+        memcpy(samples_.data() + offset * channels_, samples, first * channels_ * sizeof(int16_t));
+        memcpy(samples_.data(), samples + first * channels_, (frames - first) * channels_ * sizeof(int16_t));
+    }
+
+    void copy_out(int16_t *samples, size_t position, size_t frames) const {
+        size_t offset = position & (capacity_ - 1);
+        size_t first = frames < capacity_ - offset ? frames : capacity_ - offset;
+        memcpy(samples, samples_.data() + offset * channels_, first * channels_ * sizeof(int16_t));
+        memcpy(samples + first * channels_, samples_.data(), (frames - first) * channels_ * sizeof(int16_t));
+    }
+
+    std::vector<int16_t> samples_;
+    size_t capacity_;
+    int channels_;
+    // the device callback and the decode thread each get their own cache line
+    char read_padding_[CACHE_LINE_SIZE];
+    std::atomic<size_t> read_position_{0};
+    char write_padding_[CACHE_LINE_SIZE];
+    std::atomic<size_t> write_position_{0};
+};
+
+#endif // FFMPEGPLAYER_AUDIO_RING_H
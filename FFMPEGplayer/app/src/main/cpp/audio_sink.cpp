@@ -0,0 +1,118 @@
+#include "audio_sink.h"
+
+#include <vector>
+
+#include "log.h"
+#include "time_util.h"
+
+// 10 ms periods, like a low latency device would ask for
+static const int PERIODS_PER_SECOND = 100;
+
+NullAudioSink::~NullAudioSink() {
+    stop();
+}
+
+int NullAudioSink::open(const AudioFormat &format, AudioRing *ring) {
+    format_ = format;
+    ring_ = ring;
+    return 0;
+}
+
+int NullAudioSink::start() {
+    if (running_.exchange(true)) {
+        return 0;
+    }
+    thread_ = std::thread(&NullAudioSink::run, this);
+    return 0;
+}
+
+void NullAudioSink::pause() {
+    running_.store(false);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void NullAudioSink::stop() {
+    pause();
+}
+
+// every period is played out as it is read, nothing is left queued
+int64_t NullAudioSink::flush() {
+    pause();
+    return 0;
+}
+
+void NullAudioSink::run() {
+    int period = format_.sample_rate / PERIODS_PER_SECOND;
+    std::vector<int16_t> samples((size_t) period * format_.channels);
+    int64_t period_us = 1000000 / PERIODS_PER_SECOND;
+    int64_t next = now_us();
+    while (running_.load()) {
+        size_t frames = ring_->read(samples.data(), period);
+        if ((int) frames < period) {
+            // pad with silence, the clock does not advance over it
+            std::fill(samples.begin() + frames * format_.channels, samples.end(), 0);
+            underruns_.fetch_add(1);
+        }
+        write_period(samples.data(), period);
+        frames_played_.fetch_add(frames);
+        next += period_us;
+        precise_sleep_us(next - now_us());
+    }
+}
+
+WavAudioSink::~WavAudioSink() {
+    stop();
+}
+
+int WavAudioSink::open(const AudioFormat &format, AudioRing *ring) {
+    file_ = fopen(path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        LOGE("Player Error : Can not open %s", path_.c_str());
+        return -1;
+    }
+    int result = NullAudioSink::open(format, ring);
+    write_header();
+    return result;
+}
+
+void WavAudioSink::stop() {
+    NullAudioSink::stop();
+    if (file_ != nullptr) {
+        // sizes are only known now
+        fseek(file_, 0, SEEK_SET);
+        write_header();
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void WavAudioSink::write_period(const int16_t *samples, int frames) {
+    size_t bytes = (size_t) frames * format_.channels * sizeof(int16_t);
+    fwrite(samples, 1, bytes, file_);
+    data_bytes_ += bytes;
+}
+
+static void put_le(FILE *file, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((value >> (8 * i)) & 0xff, file);
+    }
+}
+
+void WavAudioSink::write_header() {
+    int block_align = format_.channels * 2;
+    fwrite("RIFF", 1, 4, file_);
+    put_le(file_, (uint32_t) (36 + data_bytes_), 4);
+    fwrite("WAVEfmt ", 1, 8, file_);
+    put_le(file_, 16, 4);
+    // PCM
+    put_le(file_, 1, 2);
+    put_le(file_, format_.channels, 2);
+    put_le(file_, format_.sample_rate, 4);
+    put_le(file_, format_.sample_rate * block_align, 4);
+    put_le(file_, block_align, 2);
+    put_le(file_, 16, 2);
+    fwrite("data", 1, 4, file_);
+    put_le(file_, (uint32_t) data_bytes_, 4);
+}
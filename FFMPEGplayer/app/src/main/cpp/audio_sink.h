@@ -0,0 +1,91 @@
+#ifndef FFMPEGPLAYER_AUDIO_SINK_H
+#define FFMPEGPLAYER_AUDIO_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "audio_ring.h"
+
+// interleaved signed 16 bit PCM
+struct AudioFormat {
+    int sample_rate = 48000;
+    int channels = 2;
+};
+
+/**
+ * Audio output device. The sink pulls from the ring on its own (callback) thread and pads
+ * with silence when the ring runs dry; frames_played() is the clock the player syncs to.
+ */
+class AudioSink {
+public:
+    virtual ~AudioSink() {}
+
+    // mono or stereo S16 at any common rate, returns < 0 on failure
+    virtual int open(const AudioFormat &format, AudioRing *ring) = 0;
+    virtual int start() = 0;
+    virtual void pause() = 0;
+    virtual void stop() = 0;
+    // pauses and drops what the device already took from the ring; once it returns the ring
+    // is not read until start(). Returns the frames dropped, which will never be played.
+    virtual int64_t flush() = 0;
+
+    // frames the device has finished playing, silence padding excluded
+    virtual int64_t frames_played() const = 0;
+    virtual int64_t underruns() const = 0;
+};
+
+/**
+ * Software device for Linux: a thread drains the ring one period at a time at the real
+ * sample rate. Subclasses get every period to write out; the base class drops it.
+ */
+class NullAudioSink : public AudioSink {
+public:
+    ~NullAudioSink() override;
+
+    int open(const AudioFormat &format, AudioRing *ring) override;
+    int start() override;
+    void pause() override;
+    void stop() override;
+    int64_t flush() override;
+    int64_t frames_played() const override { return frames_played_.load(); }
+    int64_t underruns() const override { return underruns_.load(); }
+
+protected:
+    virtual void write_period(const int16_t * /*samples*/, int /*frames*/) {}
+
+    AudioFormat format_;
+
+private:
+    void run();
+
+    AudioRing *ring_ = nullptr;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<int64_t> frames_played_{0};
+    std::atomic<int64_t> underruns_{0};
+};
+
+// writes what is played into a WAV file
+class WavAudioSink : public NullAudioSink {
+public:
+    explicit WavAudioSink(const std::string &path) : path_(path) {}
+    ~WavAudioSink() override;
+
+    int open(const AudioFormat &format, AudioRing *ring) override;
+    void stop() override;
+
+protected:
+    void write_period(const int16_t *samples, int frames) override;
+
+private:
+    void write_header();
+
+    std::string path_;
+    FILE *file_ = nullptr;
+    int64_t data_bytes_ = 0;
+};
+
+#endif // FFMPEGPLAYER_AUDIO_SINK_H
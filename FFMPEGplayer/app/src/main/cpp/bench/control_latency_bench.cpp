@@ -0,0 +1,130 @@
+// Measures how quickly the player reacts to its controls, on Linux without a display.
+//   control_latency_bench [-n rounds] [--audio] <file or url>
+// The player plays in real time into a NullSink (and a NullAudioSink with --audio). Every round
+// pauses, resumes and seeks to a pseudo-random position while playing, then seeks once more
+// while paused. Reported per command: the time from the call returning until the control thread
+// applied it, and for the paused seeks the time until the first frame of the new position was posted.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "audio_sink.h"
+#include "media_player.h"
+#include "time_util.h"
+#include "video_sink.h"
+
+// how long to wait for a frame before counting the seek as failed
+static const int64_t FIRST_FRAME_TIMEOUT_US = 5 * 1000000;
+
+static int64_t percentile(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (p * (values.size() - 1))];
+}
+
+static bool wait_for_state(const MediaPlayer &player, PlayerState state, int64_t timeout_us) {
+    int64_t deadline = now_us() + timeout_us;
+    while (player.state() != state) {
+        if (now_us() > deadline || player.state() == PLAYER_ERROR) {
+            return false;
+        }
+        precise_sleep_us(1000);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    int rounds = 20;
+    bool with_audio = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio") == 0) {
+            with_audio = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "usage: %s [-n rounds] [--audio] <file or url>\n", argv[0]);
+        return 2;
+    }
+    NullSink sink;
+    NullAudioSink audio_sink;
+    MediaPlayerOptions options;
+    options.source.enable_audio = with_audio;
+    MediaPlayer player(&sink, with_audio ? &audio_sink : nullptr, options);
+
+    int64_t prepare_start = now_us();
+    player.prepare(path);
+    player.sync();
+    if (player.state() != PLAYER_PREPARED) {
+        fprintf(stderr, "prepare failed\n");
+        return 1;
+    }
+    printf("prepared in %.1f ms, duration %lld ms\n", (now_us() - prepare_start) / 1000.0,
+           (long long) player.duration_ms());
+    player.start();
+    precise_sleep_us(500 * 1000);
+
+    // seek targets stay clear of the end so there is always a frame to show
+    int64_t seek_range_ms = std::max<int64_t>(1, (player.duration_ms() > 0 ? player.duration_ms() : 10000) * 8 / 10);
+    // fixed seed, runs are comparable
+    srand(1);
+    std::vector<int64_t> first_frame_us;
+    int failed = 0;
+    for (int round = 0; round < rounds; round++) {
+        player.pause();
+        precise_sleep_us(50 * 1000);
+        player.start();
+        precise_sleep_us(100 * 1000);
+        player.seek(rand() % seek_range_ms);
+        precise_sleep_us(200 * 1000);
+
+        player.pause();
+        player.sync();
+        // let the frame that may have been in flight go out
+        precise_sleep_us(50 * 1000);
+        int64_t frames = sink.frames();
+        int64_t seek_start = now_us();
+        player.seek(rand() % seek_range_ms);
+        while (sink.frames() == frames && now_us() - seek_start < FIRST_FRAME_TIMEOUT_US) {
+            precise_sleep_us(200);
+        }
+        if (sink.frames() == frames) {
+            failed++;
+        } else {
+            first_frame_us.push_back(now_us() - seek_start);
+        }
+        player.start();
+        if (!wait_for_state(player, PLAYER_STARTED, FIRST_FRAME_TIMEOUT_US)) {
+            fprintf(stderr, "player stuck in %s\n", player_state_name(player.state()));
+            return 1;
+        }
+    }
+    player.release();
+    wait_for_state(player, PLAYER_RELEASED, FIRST_FRAME_TIMEOUT_US);
+
+    ControlStats stats = player.control_stats();
+    printf("%-8s %6s %10s %10s\n", "command", "count", "mean us", "max us");
+    for (int i = 0; i < PLAYER_COMMAND_COUNT; i++) {
+        const CommandLatency &latency = stats.commands[i];
+        if (latency.count == 0) {
+            continue;
+        }
+        printf("%-8s %6lld %10lld %10lld\n", player_command_name((PlayerCommand) i),
+               (long long) latency.count, (long long) latency.mean_us(), (long long) latency.max_us);
+    }
+    printf("paused seek -> first frame: p50 %.1f ms p99 %.1f ms max %.1f ms, %d without a frame\n",
+           percentile(first_frame_us, 0.5) / 1000.0, percentile(first_frame_us, 0.99) / 1000.0,
+           percentile(first_frame_us, 1.0) / 1000.0, failed);
+    printf("%lld frames presented\n", (long long) sink.frames());
+    return failed > 0 ? 1 : 0;
+}
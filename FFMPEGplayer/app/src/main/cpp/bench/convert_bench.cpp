@@ -0,0 +1,212 @@
+// YUV -> RGBA kernels: bit-exactness against the C reference, then throughput against swscale,
+// then what converting to a smaller surface saves against the best kernel at full size.
+//   convert_bench [frames]
+// Exits non-zero if any SIMD kernel disagrees with the reference on any byte.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "libavutil/cpu.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+}
+
+#include "frame_converter.h"
+#include "time_util.h"
+#include "yuv2rgba.h"
+
+// the SIMD kernel sets this build has and this CPU can run
+static std::vector<const Yuv2RgbaKernels *> simd_kernels() {
+    std::vector<const Yuv2RgbaKernels *> kernels;
+    int flags = av_get_cpu_flags();
+    if (yuv2rgba_kernels_sse4() && (flags & AV_CPU_FLAG_SSE4)) {
+        kernels.push_back(yuv2rgba_kernels_sse4());
+    }
+    if (yuv2rgba_kernels_avx2() && (flags & AV_CPU_FLAG_AVX2)) {
+        kernels.push_back(yuv2rgba_kernels_avx2());
+    }
+    if (yuv2rgba_kernels_neon() && (flags & AV_CPU_FLAG_NEON)) {
+        kernels.push_back(yuv2rgba_kernels_neon());
+    }
+    return kernels;
+}
+
+static void fill(std::vector<uint8_t> &plane, bool extremes) {
+    for (auto &value : plane) {
+        // extremes push every term into saturation
+        value = extremes ? (rand() & 1 ? 0 : 255) : (uint8_t) rand();
+    }
+}
+
+// every row width around the SIMD block sizes, every matrix/range, planar and both semi-planar orders
+static int verify() {
+    static const int widths[] = {1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100, 1279, 1920, 3840};
+    const Yuv2RgbaKernels *reference = yuv2rgba_kernels_c();
+    std::vector<const Yuv2RgbaKernels *> kernels = simd_kernels();
+    int failures = 0;
+    int checks = 0;
+    srand(1);
+    for (int matrix = YUV_MATRIX_BT601; matrix <= YUV_MATRIX_BT709; matrix++) {
+        for (int full_range = 0; full_range <= 1; full_range++) {
+            YuvToRgbaCoefficients coefficients;
+            yuv2rgba_coefficients(&coefficients, (YuvMatrix) matrix, full_range != 0);
+            for (int width : widths) {
+                for (int round = 0; round < 16; round++) {
+                    std::vector<uint8_t> y(width + 64), u(width + 64), v(width + 64), uv(2 * width + 64);
+                    std::vector<uint8_t> expected(4 * width), actual(4 * width);
+                    bool extremes = round % 4 == 0;
+                    fill(y, extremes);
+                    fill(u, extremes);
+                    fill(v, extremes);
+                    fill(uv, extremes);
+                    for (const Yuv2RgbaKernels *kernels : kernels) {
+                        reference->planar(y.data(), u.data(), v.data(), expected.data(), width, &coefficients);
+                        kernels->planar(y.data(), u.data(), v.data(), actual.data(), width, &coefficients);
+                        checks++;
+                        if (memcmp(expected.data(), actual.data(), expected.size()) != 0) {
+                            failures++;
+                            printf("MISMATCH %s planar matrix %d full %d width %d\n", kernels->name, matrix, full_range, width);
+                        }
+                        for (int swap = 0; swap <= 1; swap++) {
+                            reference->semi_planar(y.data(), uv.data(), expected.data(), width, &coefficients, swap != 0);
+                            kernels->semi_planar(y.data(), uv.data(), actual.data(), width, &coefficients, swap != 0);
+                            checks++;
+                            if (memcmp(expected.data(), actual.data(), expected.size()) != 0) {
+                                failures++;
+                                printf("MISMATCH %s %s matrix %d full %d width %d\n", kernels->name,
+                                       swap ? "nv21" : "nv12", matrix, full_range, width);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("bit-exactness: %d checks, %d mismatches\n", checks, failures);
+    return failures;
+}
+
+static AVFrame *random_frame(AVPixelFormat format, int width, int height) {
+    AVFrame *frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    frame->colorspace = AVCOL_SPC_BT709;
+    av_frame_get_buffer(frame, 0);
+    for (int plane = 0; plane < 4 && frame->buf[plane]; plane++) {
+        for (size_t i = 0; i < frame->buf[plane]->size; i++) {
+            frame->buf[plane]->data[i] = (uint8_t) rand();
+        }
+    }
+    return frame;
+}
+
+static void throughput(AVPixelFormat format, int width, int height, int frames) {
+    AVFrame *frame = random_frame(format, width, height);
+    AVFrame *rgba = av_frame_alloc();
+    rgba->format = AV_PIX_FMT_RGBA;
+    rgba->width = width;
+    rgba->height = height;
+    av_frame_get_buffer(rgba, 0);
+
+    SwsContext *sws_context = sws_getContext(width, height, format, width, height, AV_PIX_FMT_RGBA,
+                                             SWS_BICUBIC, nullptr, nullptr, nullptr);
+    int64_t start = now_us();
+    for (int i = 0; i < frames; i++) {
+        sws_scale(sws_context, (const uint8_t *const *) frame->data, frame->linesize, 0, height,
+                  rgba->data, rgba->linesize);
+    }
+    double sws_fps = frames * 1e6 / (now_us() - start);
+    sws_freeContext(sws_context);
+
+    printf("%-8s %4dx%-4d  swscale %7.1f fps", av_get_pix_fmt_name(format), width, height, sws_fps);
+    std::vector<const Yuv2RgbaKernels *> kernels = simd_kernels();
+    kernels.insert(kernels.begin(), yuv2rgba_kernels_c());
+    for (const Yuv2RgbaKernels *set : kernels) {
+        start = now_us();
+        for (int i = 0; i < frames; i++) {
+            yuv2rgba_convert(set, frame, rgba->data[0], rgba->linesize[0]);
+        }
+        double fps = frames * 1e6 / (now_us() - start);
+        printf("  %s %7.1f fps (x%.1f)", set->name, fps, fps / sws_fps);
+    }
+    printf("\n");
+    av_frame_free(&rgba);
+    av_frame_free(&frame);
+}
+
+// ms per frame of a swscale conversion to dst_width x dst_height with these flags
+static double scaled_ms(const AVFrame *frame, int dst_width, int dst_height, int flags, int frames) {
+    AVFrame *rgba = av_frame_alloc();
+    rgba->format = AV_PIX_FMT_RGBA;
+    rgba->width = dst_width;
+    rgba->height = dst_height;
+    av_frame_get_buffer(rgba, 0);
+    SwsContext *sws_context = sws_getContext(frame->width, frame->height, (AVPixelFormat) frame->format,
+                                             dst_width, dst_height, AV_PIX_FMT_RGBA, flags,
+                                             nullptr, nullptr, nullptr);
+    int64_t start = now_us();
+    for (int i = 0; i < frames; i++) {
+        sws_scale(sws_context, (const uint8_t *const *) frame->data, frame->linesize, 0, frame->height,
+                  rgba->data, rgba->linesize);
+    }
+    double ms = (now_us() - start) / 1000.0 / frames;
+    sws_freeContext(sws_context);
+    av_frame_free(&rgba);
+    return ms;
+}
+
+// a 4K frame shown on smaller surfaces: the filter FrameConverter picks against the full size
+// conversion it replaces, with bicubic alongside for what the old fixed filter cost
+static void scaling(AVPixelFormat format, int frames) {
+    static const int surfaces[][2] = {{1920, 1080}, {1280, 720}, {640, 360}, {320, 180}};
+    const int width = 3840;
+    const int height = 2160;
+    AVFrame *frame = random_frame(format, width, height);
+    AVFrame *rgba = av_frame_alloc();
+    rgba->format = AV_PIX_FMT_RGBA;
+    rgba->width = width;
+    rgba->height = height;
+    av_frame_get_buffer(rgba, 0);
+    const Yuv2RgbaKernels *kernels = yuv2rgba_kernels_best();
+    int64_t start = now_us();
+    for (int i = 0; i < frames; i++) {
+        yuv2rgba_convert(kernels, frame, rgba->data[0], rgba->linesize[0]);
+    }
+    double full_ms = (now_us() - start) / 1000.0 / frames;
+    av_frame_free(&rgba);
+
+    printf("%-8s %4dx%-4d full size with %s: %6.2f ms, %6.1f MB per frame\n", av_get_pix_fmt_name(format),
+           width, height, kernels->name, full_ms, width * height * 4 / (1024.0 * 1024));
+    for (const auto &surface : surfaces) {
+        int output_width;
+        int output_height;
+        fit_output_size(width, height, av_make_q(1, 1), surface[0], surface[1], &output_width, &output_height);
+        int flags = scale_filter(width, height, output_width, output_height);
+        double ms = scaled_ms(frame, output_width, output_height, flags, frames);
+        double bicubic_ms = scaled_ms(frame, output_width, output_height, SWS_BICUBIC, frames);
+        double saved_mb = (width * height - output_width * output_height) * 4 / (1024.0 * 1024);
+        printf("  -> %4dx%-4d %-8s %6.2f ms (bicubic %6.2f ms), saves %6.2f ms and %6.1f MB per frame\n",
+               output_width, output_height, scale_filter_name(flags), ms, bicubic_ms, full_ms - ms, saved_mb);
+    }
+    av_frame_free(&frame);
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 60;
+    int failures = verify();
+    static const AVPixelFormat formats[] = {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12};
+    for (AVPixelFormat format : formats) {
+        throughput(format, 1920, 1080, frames);
+        throughput(format, 3840, 2160, frames);
+    }
+    for (AVPixelFormat format : formats) {
+        scaling(format, frames);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Decode-only throughput of the video stream from 1 to N decoder threads.
+//   decode_threads_bench [-n max_threads] <clip> [clip...]
+// Feed it a 1080p and a 4K clip to see how frame/slice threading scales on this machine.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "media_source.h"
+#include "time_util.h"
+
+// decode every video frame once, returns frames per second or < 0 on failure
+static double decode_fps(const char *path, int threads, DecoderThreading *threading) {
+    MediaSourceOptions options;
+    options.threading_mode = threads == 1 ? DECODER_THREADING_OFF : DECODER_THREADING_AUTO;
+    options.decoder_threads = threads;
+    MediaSource source;
+    if (media_source_open(&source, path, options) < 0) {
+        media_source_close(&source);
+        return -1;
+    }
+    *threading = source.video_threading;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int64_t frames = 0;
+    int64_t start = now_us();
+    bool eof = false;
+    while (!eof) {
+        if (av_read_frame(source.format_context, packet) < 0) {
+            // flush the frames still inside the decoder threads
+            eof = true;
+            avcodec_send_packet(source.video_codec_context, nullptr);
+        } else if (packet->stream_index == source.video_stream_index) {
+            avcodec_send_packet(source.video_codec_context, packet);
+        }
+        av_packet_unref(packet);
+        while (avcodec_receive_frame(source.video_codec_context, frame) >= 0) {
+            frames++;
+            av_frame_unref(frame);
+        }
+    }
+    int64_t elapsed = now_us() - start;
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    media_source_close(&source);
+    return elapsed > 0 ? frames * 1e6 / elapsed : 0;
+}
+
+int main(int argc, char **argv) {
+    int max_threads = (int) std::thread::hardware_concurrency();
+    std::vector<const char *> clips;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else {
+            clips.push_back(argv[i]);
+        }
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (clips.empty()) {
+        fprintf(stderr, "usage: %s [-n max_threads] <clip> [clip...]\n", argv[0]);
+        return 2;
+    }
+    for (const char *clip : clips) {
+        printf("%s\n", clip);
+        double single = 0;
+        // powers of two, always finishing on the full core count
+        std::vector<int> counts;
+        for (int threads = 1; threads < max_threads; threads *= 2) {
+            counts.push_back(threads);
+        }
+        counts.push_back(max_threads);
+        for (int threads : counts) {
+            DecoderThreading threading;
+            double fps = decode_fps(clip, threads, &threading);
+            if (fps < 0) {
+                return 1;
+            }
+            if (threads == 1) {
+                single = fps;
+            }
+            char description[32];
+            printf("  %2d threads  %-14s %8.1f fps  x%.2f\n", threads,
+                   decoder_threading_describe(threading, description, sizeof(description)),
+                   fps, single > 0 ? fps / single : 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Drives the DegradationController over a synthetic load, so its steps down and back up are
+// reproducible on any machine.
+//   degradation_sim [fps] [slowdown] [seconds]
+// Decode costs 40 % of the frame duration and convert 20 %, times slowdown in the middle third
+// of the run (2.5 by default), so the ladder has to be walked down there and back up after.
+// Each rung cuts the modelled cost about as much as it does on a phone. Exits 1 when the load
+// stayed above real time at the bottom of the ladder, or the level did not return to none.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "degradation_controller.h"
+
+// share of the full cost left at each level, decode and convert
+static const double DECODE_COST[DEGRADE_LEVEL_COUNT] = {1.0, 0.8, 0.8, 0.8, 0.8, 0.7};
+static const double CONVERT_COST[DEGRADE_LEVEL_COUNT] = {1.0, 1.0, 0.8, 0.25, 0.25, 0.25};
+
+int main(int argc, char **argv) {
+    int fps = argc > 1 ? atoi(argv[1]) : 30;
+    double slowdown = argc > 2 ? atof(argv[2]) : 2.5;
+    int seconds = argc > 3 ? atoi(argv[3]) : 60;
+    if (fps < 1 || seconds < 3) {
+        fprintf(stderr, "usage: %s [fps] [slowdown] [seconds]\n", argv[0]);
+        return 2;
+    }
+
+    int64_t frame_us = 1000000 / fps;
+    int frames = fps * seconds;
+    DegradationController controller;
+    int64_t decode_busy = 0;
+    int64_t convert_busy = 0;
+    // the load in the slow third at the level it ended up on
+    double slow_load = 0;
+    for (int i = 0; i < frames; i++) {
+        int64_t media_us = i * frame_us;
+        bool slow = i >= frames / 3 && i < 2 * frames / 3;
+        int level = controller.level();
+        // skipped non-reference frames: every other frame is neither decoded nor converted
+        bool skipped = level >= DEGRADE_SKIP_NONREF && i % 2 == 1;
+        if (!skipped) {
+            double factor = slow ? slowdown : 1.0;
+            decode_busy += (int64_t) (0.4 * frame_us * factor * DECODE_COST[level]);
+            convert_busy += (int64_t) (0.2 * frame_us * CONVERT_COST[level]);
+        }
+        if (controller.update(media_us, decode_busy, convert_busy)) {
+            const DegradationStats &stats = controller.stats();
+            const DegradationTransition &transition = stats.transitions[stats.transition_count - 1];
+            printf("%7.2f s  load %3d%%  %-26s -> %s\n", media_us / 1e6, transition.load_percent,
+                   degradation_level_name(transition.from), degradation_level_name(transition.to));
+        }
+        if (slow && i == 2 * frames / 3 - 1) {
+            int l = controller.level();
+            double full = 0.4 * slowdown * DECODE_COST[l] + 0.2 * CONVERT_COST[l];
+            slow_load = l >= DEGRADE_SKIP_NONREF ? full / 2 : full;
+        }
+    }
+
+    const DegradationStats &stats = controller.stats();
+    printf("%d frames @%d fps, slowdown x%.1f: %lld steps down %lld up, final level %s\n", frames, fps, slowdown,
+           (long long) stats.step_downs, (long long) stats.step_ups, degradation_level_name(stats.level));
+    for (int level = 0; level < DEGRADE_LEVEL_COUNT; level++) {
+        printf("  %-26s %7.2f s\n", degradation_level_name(level), stats.level_us[level] / 1e6);
+    }
+    printf("load at the end of the slow part %.0f%%\n", slow_load * 100);
+    return slow_load < 1.0 && stats.level == DEGRADE_NONE ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// Drives the FrameRateCap and the FrameDecimator over synthetic streams with a modelled decode
+// and convert cost, so what the cap leaves out and the CPU time it reports saving can be
+// checked on any machine.
+//   frame_rate_cap_sim [cap]
+// Every stream plays 50 seconds: uncapped for the first 10, capped at cap (30 by default) up to
+// 40, uncapped again after, the way a battery saver comes and goes. Streams:
+//   60 fps IBP     every B nothing refers to, NONREF alone halves the rate
+//   60 fps IBBP    NONREF would leave 20 fps, it is taken back and frames dropped before conversion
+//   50 fps IPPP    all reference frames, everything above the cap is dropped before conversion
+//   60 fps intra   intra-only (MJPEG), packets above the cap are never decoded
+//   30 fps IBP     at a cap of 30 nothing may be left out
+// Exits 1 when the rate shown while capped is off the cap, the uncapped phases lost frames,
+// NONREF was not tried where it could help, or the CPU time reported saved is more than 15 %
+// off what the model saved over the capped phase.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "frame_rate_cap.h"
+
+// modelled CPU time per frame, in microseconds
+static const int64_t REF_DECODE_US = 6000;
+static const int64_t NONREF_DECODE_US = 3000;
+// parsing a frame the decoder discards
+static const int64_t DISCARD_US = 100;
+static const int64_t INTRA_DECODE_US = 5000;
+static const int64_t CONVERT_US = 2000;
+
+static const int SECONDS = 50;
+static const int CAP_FROM = 10;
+static const int CAP_UNTIL = 40;
+// left out of the rates at the start of a phase, the cap needs a window to see the stream
+static const int SETTLE_SECONDS = 2;
+
+struct Stream {
+    const char *name;
+    int fps;
+    // frame types in decode order, repeating; 'b' is a frame nothing refers to
+    const char *pattern;
+    bool intra_only;
+};
+
+struct Phase {
+    // over the settled part, for the rate
+    int64_t frames = 0;
+    int64_t settled_us = 0;
+    // over all of it, for the CPU time
+    int64_t cpu_us = 0;
+    int64_t us = 0;
+};
+
+static bool simulate(const Stream &stream, double cap_rate) {
+    FrameRateCap cap(stream.intra_only);
+    FrameDecimator decimator;
+    int64_t frame_us = 1000000 / stream.fps;
+    int pattern_length = 0;
+    while (stream.pattern[pattern_length] != '\0') {
+        pattern_length++;
+    }
+    int64_t cpu_us = 0;
+    // uncapped before, capped, uncapped after; settled part of each
+    Phase phases[3];
+    bool nonref_seen = false;
+    int64_t dropped_frames = 0;
+    for (int64_t i = 0; i < (int64_t) stream.fps * SECONDS; i++) {
+        int64_t media_us = i * frame_us;
+        int second = (int) (media_us / 1000000);
+        int phase = second < CAP_FROM ? 0 : second < CAP_UNTIL ? 1 : 2;
+        double max_rate = phase == 1 ? cap_rate : 0;
+        if (max_rate != cap.max_rate()) {
+            cap.set_max_rate(max_rate);
+        }
+        int64_t before_us = cpu_us;
+        bool shown = false;
+        if (cap.packet(media_us, cpu_us)) {
+            nonref_seen = nonref_seen || cap.nonref();
+            char type = stream.pattern[i % pattern_length];
+            if (type == 'b' && cap.nonref()) {
+                cpu_us += DISCARD_US;
+            } else {
+                cpu_us += stream.intra_only ? INTRA_DECODE_US : type == 'b' ? NONREF_DECODE_US : REF_DECODE_US;
+                cap.frame();
+                if (decimator.admit(media_us, cap.active_rate())) {
+                    cpu_us += CONVERT_US;
+                    shown = true;
+                } else {
+                    dropped_frames++;
+                }
+            }
+        }
+        int phase_start = phase == 0 ? 0 : phase == 1 ? CAP_FROM : CAP_UNTIL;
+        if (second >= phase_start + SETTLE_SECONDS) {
+            phases[phase].frames += shown ? 1 : 0;
+            phases[phase].settled_us += frame_us;
+        }
+        phases[phase].cpu_us += cpu_us - before_us;
+        phases[phase].us += frame_us;
+    }
+
+    const FrameRateCapStats &stats = cap.stats();
+    double rates[3];
+    for (int p = 0; p < 3; p++) {
+        rates[p] = phases[p].frames * 1e6 / phases[p].settled_us;
+    }
+    double uncapped_load = phases[0].cpu_us / (double) phases[0].us;
+    double capped_load = phases[1].cpu_us / (double) phases[1].us;
+    double model_saved_ms = (uncapped_load - capped_load) * 60000;
+    double reported_saved_ms = stats.saved_us_per_minute() / 1000.0;
+    bool capped = stream.fps > cap_rate * 1.1;
+    double expected_rate = capped ? cap_rate : stream.fps;
+    bool rate_ok = fabs(rates[1] - expected_rate) <= expected_rate * 0.05
+                   && fabs(rates[0] - stream.fps) < 0.5 && fabs(rates[2] - stream.fps) < 0.5;
+    bool saved_ok = capped ? fabs(reported_saved_ms - model_saved_ms) <= model_saved_ms * 0.15
+                           : stats.saved_us == 0 && stats.capped_us == 0;
+    // tried on everything above the cap that can decode without some frames, kept or not
+    bool nonref_ok = nonref_seen == (capped && !stream.intra_only);
+    printf("%-14s %5.1f -> %5.1f -> %5.1f fps  nonref %-3s  %5lld discarded %5lld packets %5lld frames dropped  "
+           "saved %6.0f ms/min (model %6.0f)  %s\n",
+           stream.name, rates[0], rates[1], rates[2], nonref_seen ? "on" : "off",
+           (long long) stats.discarded_frames, (long long) stats.dropped_packets, (long long) dropped_frames,
+           reported_saved_ms, model_saved_ms, rate_ok && saved_ok && nonref_ok ? "ok" : "FAIL");
+    return rate_ok && saved_ok && nonref_ok;
+}
+
+int main(int argc, char **argv) {
+    double cap_rate = argc > 1 ? atof(argv[1]) : 30;
+    if (cap_rate <= 0) {
+        fprintf(stderr, "usage: %s [cap]\n", argv[0]);
+        return 2;
+    }
+    const Stream streams[] = {
+            {"60 fps IBP", 60, "Pb", false},
+            {"60 fps IBBP", 60, "Pbb", false},
+            {"50 fps IPPP", 50, "P", false},
+            {"60 fps intra", 60, "I", true},
+            {"30 fps IBP", 30, "Pb", false},
+    };
+    printf("cap %.1f fps from %d s to %d s, rates before, during and after\n", cap_rate, CAP_FROM, CAP_UNTIL);
+    bool passed = true;
+    for (const Stream &stream : streams) {
+        passed = simulate(stream, cap_rate) && passed;
+    }
+    return passed ? 0 : 1;
+}
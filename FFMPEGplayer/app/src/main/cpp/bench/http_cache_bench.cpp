@@ -0,0 +1,197 @@
+// Reads a URL straight from the network, then through the HTTP cache cold and again warm with a
+// new cache instance on the same directory (as after a restart), then at random offsets twice.
+//   http_cache_bench [--cache <dir>] [--seeks 50] <http url>
+// Serve a file with tools/throttled_http_server.py so the network side is slow and its log
+// shows the range requests. Every byte read through the cache is checked against the network.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+#include "http_cache.h"
+#include "time_util.h"
+
+static const int BLOCK_SIZE = 256 * 1024;
+
+struct PassReport {
+    int64_t bytes = 0;
+    int64_t wall_us = 0;
+    uint64_t hash = 14695981039346656037ULL;
+    bool mismatch = false;
+};
+
+static void hash_bytes(uint64_t *hash, const uint8_t *data, int size) {
+    for (int i = 0; i < size; i++) {
+        *hash = (*hash ^ data[i]) * 1099511628211ULL;
+    }
+}
+
+// size bytes from position, fewer only at the end of the file; negative AVERROR on failure
+static int read_at(ByteSource *source, int64_t position, uint8_t *buffer, int size) {
+    int64_t result = source->seek(position);
+    if (result < 0) {
+        return (int) result;
+    }
+    int done = 0;
+    while (done < size) {
+        int read = source->read(buffer + done, size - done);
+        if (read == AVERROR_EOF) {
+            break;
+        }
+        if (read < 0) {
+            return read;
+        }
+        done += read;
+    }
+    return done;
+}
+
+static int read_all(ByteSource *source, PassReport *report) {
+    std::vector<uint8_t> buffer(BLOCK_SIZE);
+    int64_t start = now_us();
+    for (int64_t position = 0;; position += BLOCK_SIZE) {
+        int read = read_at(source, position, buffer.data(), BLOCK_SIZE);
+        if (read < 0) {
+            return read;
+        }
+        hash_bytes(&report->hash, buffer.data(), read);
+        report->bytes += read;
+        if (read < BLOCK_SIZE) {
+            break;
+        }
+    }
+    report->wall_us = now_us() - start;
+    return 0;
+}
+
+static void print_pass(const char *name, const PassReport &report, const HttpCacheStats *before,
+                       const HttpCacheStats *after) {
+    printf("%-10s %8.1f MB %8.1f ms %8.2f MB/s", name, report.bytes / (1024.0 * 1024), report.wall_us / 1000.0,
+           report.wall_us > 0 ? report.bytes / (1024.0 * 1024) * 1e6 / report.wall_us : 0);
+    if (after != nullptr) {
+        printf(" %8.1f %8.1f %8lld", (after->network_bytes - before->network_bytes) / (1024.0 * 1024),
+               (after->disk_bytes - before->disk_bytes) / (1024.0 * 1024),
+               (long long) (after->requests - before->requests));
+    }
+    printf("%s\n", report.mismatch ? "  MISMATCH" : "");
+}
+
+// the whole file through a cache on directory, returns the cache's counters
+static int cached_pass(const char *url, const std::string &directory, PassReport *report, HttpCacheStats *stats) {
+    HttpCacheOptions options;
+    options.directory = directory;
+    HttpCache cache(options);
+    int result = cache.open();
+    if (result < 0) {
+        return result;
+    }
+    {
+        CachedHttpSource source(&cache);
+        result = source.open(url);
+        if (result < 0) {
+            return result;
+        }
+        result = read_all(&source, report);
+    }
+    *stats = cache.stats();
+    return result;
+}
+
+int main(int argc, char **argv) {
+    const char *url = nullptr;
+    std::string directory;
+    int seeks = 50;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "--seeks") == 0 && i + 1 < argc) {
+            seeks = atoi(argv[++i]);
+        } else {
+            url = argv[i];
+        }
+    }
+    if (url == nullptr) {
+        fprintf(stderr, "usage: %s [--cache <dir>] [--seeks 50] <http url>\n", argv[0]);
+        return 2;
+    }
+    if (directory.empty()) {
+        char temporary[] = "/tmp/http_cache_bench.XXXXXX";
+        if (mkdtemp(temporary) == nullptr) {
+            return 1;
+        }
+        directory = temporary;
+    }
+    printf("%-10s %11s %11s %13s %8s %8s %8s\n", "pass", "read", "wall", "speed", "net MB", "disk MB", "requests");
+
+    ProtocolSource network;
+    if (network.open(url) < 0 || network.size() <= 0) {
+        fprintf(stderr, "can not open %s with a known size\n", url);
+        return 1;
+    }
+    PassReport reference;
+    if (read_all(&network, &reference) < 0) {
+        fprintf(stderr, "can not read %s\n", url);
+        return 1;
+    }
+    print_pass("network", reference, nullptr, nullptr);
+
+    HttpCacheStats none;
+    PassReport cold;
+    HttpCacheStats cold_stats;
+    PassReport warm;
+    HttpCacheStats warm_stats;
+    if (cached_pass(url, directory + "/sequential", &cold, &cold_stats) < 0 ||
+        cached_pass(url, directory + "/sequential", &warm, &warm_stats) < 0) {
+        fprintf(stderr, "can not read %s through the cache\n", url);
+        return 1;
+    }
+    cold.mismatch = cold.hash != reference.hash || cold.bytes != reference.bytes;
+    warm.mismatch = warm.hash != reference.hash || warm.bytes != reference.bytes;
+    print_pass("cold", cold, &none, &cold_stats);
+    print_pass("warm", warm, &none, &warm_stats);
+
+    // the same random blocks twice: the second round finds all of them on disk
+    HttpCacheOptions options;
+    options.directory = directory + "/seeks";
+    HttpCache cache(options);
+    if (cache.open() < 0) {
+        return 1;
+    }
+    std::mt19937_64 random(1);
+    std::vector<int64_t> positions;
+    for (int i = 0; i < seeks; i++) {
+        positions.push_back((int64_t) (random() % (uint64_t) network.size()));
+    }
+    std::vector<uint8_t> expected(BLOCK_SIZE);
+    std::vector<uint8_t> actual(BLOCK_SIZE);
+    CachedHttpSource source(&cache);
+    if (source.open(url) < 0) {
+        return 1;
+    }
+    const char *names[] = {"seek cold", "seek warm"};
+    for (const char *name : names) {
+        PassReport report;
+        HttpCacheStats before = cache.stats();
+        for (int64_t position : positions) {
+            int64_t start = now_us();
+            int read = read_at(&source, position, actual.data(), BLOCK_SIZE);
+            report.wall_us += now_us() - start;
+            if (read < 0 || read_at(&network, position, expected.data(), BLOCK_SIZE) != read ||
+                memcmp(expected.data(), actual.data(), (size_t) read) != 0) {
+                report.mismatch = true;
+            }
+            report.bytes += FFMAX(read, 0);
+        }
+        HttpCacheStats after = cache.stats();
+        print_pass(name, report, &before, &after);
+    }
+    printf("cache in %s\n", directory.c_str());
+    return 0;
+}
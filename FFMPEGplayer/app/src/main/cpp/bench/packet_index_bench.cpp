@@ -0,0 +1,193 @@
+// Compares seeking through the demuxer with seeking through the sidecar packet index.
+//   packet_index_bench [-n seeks] [--index <dir>] <file>
+// The first run scans the whole input once to build the index (timed, and skipped on later
+// runs with the same --index directory). Then the input is opened twice, with and without the
+// index, and both seek to the same pseudo-random positions. A seek counts until the first video
+// frame is decoded. Meant for long MPEG-TS recordings, e.g. a multi-GB file made with
+//   ffmpeg -f lavfi -i testsrc2=size=1920x1080:rate=30 -t 3600 -c:v libx264 -b:v 8M -g 120 long.ts
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "media_source.h"
+#include "packet_index.h"
+#include "time_util.h"
+
+static int64_t percentile(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (p * (values.size() - 1))];
+}
+
+// read the whole input once, every video packet goes into the index
+static int build_index(const char *path, PacketIndexStore *store, int64_t *wall_us) {
+    MediaSource source;
+    MediaSourceOptions options;
+    options.packet_index_store = store;
+    int result = media_source_open(&source, path, options);
+    if (result >= 0 && source.packet_index == nullptr) {
+        result = AVERROR(ENOSYS);
+    }
+    if (result >= 0 && !source.packet_index->complete()) {
+        int64_t start = now_us();
+        AVPacket *packet = av_packet_alloc();
+        source.packet_index->begin_run(true);
+        while ((result = av_read_frame(source.format_context, packet)) >= 0) {
+            if (packet->stream_index == source.video_stream_index) {
+                source.packet_index->add(packet);
+            }
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+        if (result == AVERROR_EOF) {
+            source.packet_index->end_of_stream();
+            result = 0;
+        }
+        *wall_us = now_us() - start;
+    }
+    // saves the index
+    media_source_close(&source);
+    return result;
+}
+
+// reposition and decode until the first video frame; returns 0 or a negative AVERROR
+static int seek_to_frame(MediaSource *source, int64_t media_us, AVPacket *packet, AVFrame *frame) {
+    int result = -1;
+    AVStream *stream = source->format_context->streams[source->video_stream_index];
+    PacketIndexEntry keyframe;
+    if (source->packet_index != nullptr
+        && source->packet_index->keyframe_before(av_rescale_q(media_us, AV_TIME_BASE_Q, stream->time_base), &keyframe)) {
+        result = packet_index_seek(source->format_context, *source->packet_index, keyframe);
+    }
+    if (result < 0) {
+        result = avformat_seek_file(source->format_context, -1, INT64_MIN, media_us, media_us, 0);
+    }
+    if (result < 0) {
+        return result;
+    }
+    avcodec_flush_buffers(source->video_codec_context);
+    while ((result = av_read_frame(source->format_context, packet)) >= 0) {
+        if (packet->stream_index != source->video_stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        result = avcodec_send_packet(source->video_codec_context, packet);
+        av_packet_unref(packet);
+        if (result < 0 && result != AVERROR(EAGAIN)) {
+            return result;
+        }
+        if (avcodec_receive_frame(source->video_codec_context, frame) == 0) {
+            av_frame_unref(frame);
+            return 0;
+        }
+    }
+    return result;
+}
+
+static bool run_seeks(const char *path, PacketIndexStore *store, const std::vector<double> &fractions,
+                      std::vector<int64_t> *latency, int64_t *duration_us, int64_t *open_us) {
+    MediaSource source;
+    MediaSourceOptions options;
+    options.packet_index_store = store;
+    int64_t start = now_us();
+    if (media_source_open(&source, path, options) < 0) {
+        media_source_close(&source);
+        return false;
+    }
+    *open_us = now_us() - start;
+    AVFormatContext *format_context = source.format_context;
+    *duration_us = format_context->duration;
+    int64_t start_time = format_context->start_time != AV_NOPTS_VALUE ? format_context->start_time : 0;
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    bool ok = true;
+    for (double fraction : fractions) {
+        int64_t target = start_time + (int64_t) (fraction * (double) FFMAX(format_context->duration, 0));
+        int64_t seek_start = now_us();
+        if (seek_to_frame(&source, target, packet, frame) < 0) {
+            ok = false;
+            break;
+        }
+        latency->push_back(now_us() - seek_start);
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    media_source_close(&source);
+    return ok;
+}
+
+static void print_row(const char *name, const std::vector<int64_t> &latency, int64_t duration_us, int64_t open_us) {
+    printf("%-8s %8.1f %8.2f %8.2f %8.2f %12.3f\n", name, open_us / 1000.0, percentile(latency, 0.5) / 1000.0,
+           percentile(latency, 0.9) / 1000.0, percentile(latency, 1.0) / 1000.0, duration_us / 1e6);
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    int seeks = 50;
+    std::string directory;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            seeks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr || seeks <= 0) {
+        fprintf(stderr, "usage: %s [-n seeks] [--index <dir>] <file>\n", argv[0]);
+        return 2;
+    }
+    if (directory.empty()) {
+        char temporary[] = "/tmp/packet_index_bench.XXXXXX";
+        if (mkdtemp(temporary) == nullptr) {
+            return 1;
+        }
+        directory = temporary;
+    }
+    PacketIndexStore store(directory);
+    if (store.open() < 0) {
+        return 1;
+    }
+    int64_t build_us = 0;
+    if (build_index(path, &store, &build_us) < 0) {
+        fprintf(stderr, "can not index %s\n", path);
+        return 1;
+    }
+    if (build_us > 0) {
+        printf("index built in %.1f s\n", build_us / 1e6);
+    }
+    // fixed seed, both runs seek to the same positions
+    srand(1);
+    std::vector<double> fractions;
+    for (int i = 0; i < seeks; i++) {
+        fractions.push_back((rand() % 950) / 1000.0);
+    }
+    printf("%-8s %8s %8s %8s %8s %12s\n", "seek", "open ms", "p50 ms", "p90 ms", "max ms", "duration s");
+    std::vector<int64_t> demuxer;
+    std::vector<int64_t> indexed;
+    int64_t demuxer_duration = 0;
+    int64_t indexed_duration = 0;
+    int64_t demuxer_open = 0;
+    int64_t indexed_open = 0;
+    if (!run_seeks(path, nullptr, fractions, &demuxer, &demuxer_duration, &demuxer_open)
+        || !run_seeks(path, &store, fractions, &indexed, &indexed_duration, &indexed_open)) {
+        fprintf(stderr, "seek failed in %s\n", path);
+        return 1;
+    }
+    print_row("demuxer", demuxer, demuxer_duration, demuxer_open);
+    print_row("index", indexed, indexed_duration, indexed_open);
+    printf("index in %s\n", directory.c_str());
+    return 0;
+}
@@ -0,0 +1,329 @@
+// End-to-end playback benchmark over a corpus of clips, on Linux without a display.
+//   playback_bench [--runs n] [--output <results.json>] [--baseline <results.json>] [--threshold <percent>] <file>...
+// Every clip plays through the whole pipeline flat out into a NullSink, in a child process of
+// its own so the peak RSS is that clip's alone. Reported per clip: decode and conversion fps
+// (frames over the busy time of the stage), playback fps over the wall time, the time to the
+// first frame from opening the input to the first present, and the peak RSS. With --runs the
+// run with the best playback fps counts.
+// The results are written as JSON, one clip per line, to stdout or --output. With --baseline the
+// output of an earlier run is compared against: an fps that dropped, or a first frame time or
+// peak RSS that grew, by more than --threshold percent (10 by default) is flagged and the exit
+// status is 1. Keep a baseline from before an FFmpeg or NDK bump and compare after it.
+// The corpus comes from tools/make_bench_corpus.sh.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "media_source.h"
+#include "pipeline.h"
+#include "video_sink.h"
+
+struct PlaybackResult {
+    std::string file;
+    std::string codec;
+    int width = 0;
+    int height = 0;
+    double frame_rate = 0;
+    int64_t frames = 0;
+    double decode_fps = 0;
+    double convert_fps = 0;
+    double playback_fps = 0;
+    double first_frame_ms = 0;
+    int64_t peak_rss_kb = 0;
+};
+
+// how a metric is compared against the baseline
+struct Metric {
+    const char *name;
+    // a drop is the regression, otherwise a rise is
+    bool higher_is_better;
+};
+
+static const Metric METRICS[] = {
+        {"decode_fps", true},
+        {"convert_fps", true},
+        {"playback_fps", true},
+        {"first_frame_ms", false},
+        {"peak_rss_kb", false},
+};
+
+static double metric_value(const PlaybackResult &result, const char *name) {
+    if (strcmp(name, "decode_fps") == 0) {
+        return result.decode_fps;
+    }
+    if (strcmp(name, "convert_fps") == 0) {
+        return result.convert_fps;
+    }
+    if (strcmp(name, "playback_fps") == 0) {
+        return result.playback_fps;
+    }
+    if (strcmp(name, "first_frame_ms") == 0) {
+        return result.first_frame_ms;
+    }
+    return (double) result.peak_rss_kb;
+}
+
+static double stage_fps(const StageStats &stats) {
+    return stats.busy_us > 0 ? stats.items * 1e6 / stats.busy_us : 0;
+}
+
+static std::string base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash != nullptr ? slash + 1 : path;
+}
+
+static std::string format_result(const PlaybackResult &result) {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\"file\": \"%s\", \"codec\": \"%s\", \"width\": %d, \"height\": %d, \"frame_rate\": %.3f, "
+             "\"frames\": %lld, \"decode_fps\": %.1f, \"convert_fps\": %.1f, \"playback_fps\": %.1f, "
+             "\"first_frame_ms\": %.2f, \"peak_rss_kb\": %lld}",
+             result.file.c_str(), result.codec.c_str(), result.width, result.height, result.frame_rate,
+             (long long) result.frames, result.decode_fps, result.convert_fps, result.playback_fps,
+             result.first_frame_ms, (long long) result.peak_rss_kb);
+    return line;
+}
+
+static bool find_string(const std::string &line, const char *key, std::string *value) {
+    std::string pattern = std::string("\"") + key + "\": \"";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos) {
+        return false;
+    }
+    start += pattern.size();
+    size_t end = line.find('"', start);
+    if (end == std::string::npos) {
+        return false;
+    }
+    *value = line.substr(start, end - start);
+    return true;
+}
+
+static double find_number(const std::string &line, const char *key) {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t start = line.find(pattern);
+    return start == std::string::npos ? 0 : strtod(line.c_str() + start + pattern.size(), nullptr);
+}
+
+// reads back one line of format_result(); only what this program writes, not JSON at large
+static bool parse_result(const std::string &line, PlaybackResult *result) {
+    if (!find_string(line, "file", &result->file)) {
+        return false;
+    }
+    find_string(line, "codec", &result->codec);
+    result->width = (int) find_number(line, "width");
+    result->height = (int) find_number(line, "height");
+    result->frame_rate = find_number(line, "frame_rate");
+    result->frames = (int64_t) find_number(line, "frames");
+    result->decode_fps = find_number(line, "decode_fps");
+    result->convert_fps = find_number(line, "convert_fps");
+    result->playback_fps = find_number(line, "playback_fps");
+    result->first_frame_ms = find_number(line, "first_frame_ms");
+    result->peak_rss_kb = (int64_t) find_number(line, "peak_rss_kb");
+    return true;
+}
+
+static bool load_results(const char *path, std::vector<PlaybackResult> *results) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        PlaybackResult result;
+        if (parse_result(line, &result)) {
+            results->push_back(result);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// one playback of the clip in this process, the result written to fd as a line
+static int play_clip(const char *path, int fd) {
+    MediaSource source;
+    MediaSourceOptions source_options;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        return 1;
+    }
+    AVStream *stream = source.format_context->streams[source.video_stream_index];
+    PlaybackResult result;
+    result.file = base_name(path);
+    result.codec = avcodec_get_name(source.video_codec_context->codec_id);
+    result.width = source.video_codec_context->width;
+    result.height = source.video_codec_context->height;
+    result.frame_rate = av_q2d(av_guess_frame_rate(source.format_context, stream, nullptr));
+    NullSink sink;
+    PipelineOptions options;
+    StartupTimings startup = source.startup;
+    PipelineStats stats;
+    int status;
+    {
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, &sink, options);
+        status = pipeline.run();
+        stats = pipeline.stats();
+        startup.first_present_us = pipeline.first_present_us();
+    }
+    media_source_close(&source);
+    if (status < 0 || startup.total_us() < 0) {
+        return 1;
+    }
+    result.frames = stats.present.items;
+    result.decode_fps = stage_fps(stats.decode);
+    result.convert_fps = stage_fps(stats.convert);
+    result.playback_fps = stats.wall_us > 0 ? stats.present.items * 1e6 / stats.wall_us : 0;
+    result.first_frame_ms = startup.total_us() / 1000.0;
+    std::string line = format_result(result) + "\n";
+    return write(fd, line.data(), line.size()) == (ssize_t) line.size() ? 0 : 1;
+}
+
+// plays the clip in a child process; false when it failed
+static bool run_clip(const char *path, PlaybackResult *result) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return false;
+    }
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        _exit(play_clip(path, fds[1]));
+    }
+    close(fds[1]);
+    std::string line;
+    char buffer[512];
+    ssize_t size;
+    while ((size = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        line.append(buffer, (size_t) size);
+    }
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return false;
+    }
+    if (!parse_result(line, result)) {
+        return false;
+    }
+    // the child's own peak, it started from this small process
+    result->peak_rss_kb = usage.ru_maxrss;
+    return true;
+}
+
+// prints the changes against the baseline; returns the number of regressions
+static int compare(const std::vector<PlaybackResult> &results, const std::vector<PlaybackResult> &baseline,
+                   double threshold) {
+    int regressions = 0;
+    fprintf(stderr, "%-28s %-15s %12s %12s %8s\n", "clip", "metric", "baseline", "now", "change");
+    for (const PlaybackResult &result : results) {
+        const PlaybackResult *before = nullptr;
+        for (const PlaybackResult &candidate : baseline) {
+            if (candidate.file == result.file) {
+                before = &candidate;
+            }
+        }
+        if (before == nullptr) {
+            fprintf(stderr, "%-28s not in the baseline\n", result.file.c_str());
+            continue;
+        }
+        for (const Metric &metric : METRICS) {
+            double old_value = metric_value(*before, metric.name);
+            double new_value = metric_value(result, metric.name);
+            if (old_value <= 0) {
+                continue;
+            }
+            double change = (new_value - old_value) * 100 / old_value;
+            bool regressed = metric.higher_is_better ? change < -threshold : change > threshold;
+            regressions += regressed ? 1 : 0;
+            fprintf(stderr, "%-28s %-15s %12.1f %12.1f %+7.1f%%%s\n", result.file.c_str(), metric.name,
+                    old_value, new_value, change, regressed ? "  REGRESSION" : "");
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    int runs = 1;
+    const char *output_path = nullptr;
+    const char *baseline_path = nullptr;
+    double threshold = 10;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || runs < 1) {
+        fprintf(stderr, "usage: %s [--runs n] [--output <results.json>] [--baseline <results.json>] [--threshold <percent>] <file>...\n",
+                argv[0]);
+        return 2;
+    }
+    std::vector<PlaybackResult> baseline;
+    if (baseline_path != nullptr && !load_results(baseline_path, &baseline)) {
+        fprintf(stderr, "can not read the baseline %s\n", baseline_path);
+        return 2;
+    }
+
+    std::vector<PlaybackResult> results;
+    int failures = 0;
+    for (const char *path : paths) {
+        PlaybackResult best;
+        bool played = false;
+        for (int run = 0; run < runs; run++) {
+            PlaybackResult result;
+            if (run_clip(path, &result) && (!played || result.playback_fps > best.playback_fps)) {
+                best = result;
+                played = true;
+            }
+        }
+        if (!played) {
+            fprintf(stderr, "%s: playback failed\n", path);
+            failures++;
+            continue;
+        }
+        fprintf(stderr, "%-28s %5s %4dx%-4d %6.1f fps: decode %8.1f convert %8.1f playback %8.1f fps, first frame %7.1f ms, peak %6.1f MB\n",
+                best.file.c_str(), best.codec.c_str(), best.width, best.height, best.frame_rate, best.decode_fps,
+                best.convert_fps, best.playback_fps, best.first_frame_ms, best.peak_rss_kb / 1024.0);
+        results.push_back(best);
+    }
+
+    FILE *output = output_path != nullptr ? fopen(output_path, "w") : stdout;
+    if (output == nullptr) {
+        fprintf(stderr, "can not write %s\n", output_path);
+        return 2;
+    }
+    fprintf(output, "{\"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(output, "%s%s\n", format_result(results[i]).c_str(), i + 1 < results.size() ? "," : "");
+    }
+    fprintf(output, "]}\n");
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    int regressions = baseline_path != nullptr ? compare(results, baseline, threshold) : 0;
+    if (regressions > 0) {
+        fprintf(stderr, "%d regressions beyond %.1f%%\n", regressions, threshold);
+    }
+    return failures > 0 || regressions > 0 ? 1 : 0;
+}
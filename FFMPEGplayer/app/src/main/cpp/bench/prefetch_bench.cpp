@@ -0,0 +1,137 @@
+// Compares how long av_read_frame blocks the demux thread with FFmpeg's own I/O and with the
+// prefetching AVIOContext, when packets are consumed at playback speed.
+//   prefetch_bench [--seconds 20] [--prefetch <MB>] <url>
+// Serve the clip with tools/throttled_http_server.py and a --rate not far above its bitrate to
+// get a link that stalls now and then. After playing, both modes seek back two seconds: with
+// prefetching that seek is served from the ring and costs no round trip.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+#include "media_source.h"
+#include "time_util.h"
+
+// a read blocking this long would have cost a frame at 50 fps
+static const int64_t STALL_US = 20000;
+
+struct ReadReport {
+    int64_t reads = 0;
+    int64_t blocked_us = 0;
+    int64_t max_us = 0;
+    int64_t p99_us = 0;
+    int64_t stalls = 0;
+    int64_t seek_us = 0;
+};
+
+static int run(const char *url, int64_t prefetch_bytes, int64_t seconds, ReadReport *report, PrefetchStats *prefetch) {
+    MediaSource source;
+    MediaSourceOptions options;
+    options.prefetch_bytes = prefetch_bytes;
+    int result = media_source_open(&source, url, options);
+    if (result < 0) {
+        media_source_close(&source);
+        return result;
+    }
+    AVStream *stream = source.format_context->streams[source.video_stream_index];
+    AVPacket *packet = av_packet_alloc();
+    std::vector<int64_t> latencies;
+    int64_t first_us = AV_NOPTS_VALUE;
+    int64_t media_us = 0;
+    int64_t anchor = now_us();
+    for (;;) {
+        int64_t start = now_us();
+        result = av_read_frame(source.format_context, packet);
+        int64_t elapsed = now_us() - start;
+        if (result < 0) {
+            break;
+        }
+        latencies.push_back(elapsed);
+        report->blocked_us += elapsed;
+        if (packet->stream_index == source.video_stream_index && packet->pts != AV_NOPTS_VALUE) {
+            media_us = av_rescale_q(packet->pts, stream->time_base, AVRational{1, 1000000});
+            if (first_us == AV_NOPTS_VALUE) {
+                first_us = media_us;
+            }
+            // consume at playback speed like the player would
+            int64_t due = anchor + media_us - first_us;
+            if (due > now_us()) {
+                precise_sleep_us(due - now_us());
+            }
+        }
+        av_packet_unref(packet);
+        if (first_us != AV_NOPTS_VALUE && media_us - first_us >= seconds * 1000000) {
+            break;
+        }
+    }
+    // back two seconds and the first packet from there
+    int64_t target = FFMAX(media_us - 2000000, 0);
+    int64_t start = now_us();
+    if (avformat_seek_file(source.format_context, -1, INT64_MIN, target, target, 0) >= 0) {
+        av_read_frame(source.format_context, packet);
+        av_packet_unref(packet);
+    }
+    report->seek_us = now_us() - start;
+    av_packet_free(&packet);
+
+    std::sort(latencies.begin(), latencies.end());
+    report->reads = (int64_t) latencies.size();
+    if (!latencies.empty()) {
+        report->max_us = latencies.back();
+        report->p99_us = latencies[(size_t) (0.99 * (latencies.size() - 1))];
+    }
+    for (int64_t latency : latencies) {
+        if (latency >= STALL_US) {
+            report->stalls++;
+        }
+    }
+    if (source.prefetch != nullptr) {
+        *prefetch = source.prefetch->stats();
+    }
+    media_source_close(&source);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *url = nullptr;
+    int64_t seconds = 20;
+    int64_t prefetch_bytes = 8 * 1024 * 1024;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            prefetch_bytes = atoll(argv[++i]) * 1024 * 1024;
+        } else {
+            url = argv[i];
+        }
+    }
+    if (url == nullptr || prefetch_bytes <= 0) {
+        fprintf(stderr, "usage: %s [--seconds 20] [--prefetch <MB>] <url>\n", argv[0]);
+        return 2;
+    }
+    printf("%-10s %8s %10s %8s %8s %8s %10s\n", "io", "reads", "blocked ms", "p99 ms", "max ms", "stalls", "seek ms");
+    int64_t modes[] = {0, prefetch_bytes};
+    for (int64_t mode : modes) {
+        ReadReport report;
+        PrefetchStats prefetch;
+        if (run(url, mode, seconds, &report, &prefetch) < 0) {
+            fprintf(stderr, "can not open %s\n", url);
+            return 1;
+        }
+        printf("%-10s %8lld %10.1f %8.1f %8.1f %8lld %10.1f\n", mode > 0 ? "prefetch" : "ffmpeg",
+               (long long) report.reads, report.blocked_us / 1000.0, report.p99_us / 1000.0,
+               report.max_us / 1000.0, (long long) report.stalls, report.seek_us / 1000.0);
+        if (mode > 0) {
+            printf("           ring %d%% full, %.2f MB/s from the network, %lld buffered %lld protocol seeks\n",
+                   prefetch.fill_percent(), prefetch.throughput_bps() / (1024.0 * 1024),
+                   (long long) prefetch.buffered_seeks, (long long) prefetch.protocol_seeks);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Measures open-to-first-frame of an input without the probe cache, then with it warm.
+//   probe_cache_bench [-n runs] [--cache <dir>] <file or url>
+// Every run opens the input, demuxes and decodes until the first video frame comes out and
+// closes it again. The first run with the cache stores the entry, the ones after read it back.
+// Reported are the medians of the probe phase and of the wall time to the first frame.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "media_source.h"
+#include "probe_cache.h"
+#include "time_util.h"
+
+static int64_t median(std::vector<int64_t> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+struct OpenRuns {
+    std::vector<int64_t> probe;
+    std::vector<int64_t> wall;
+    int cached = 0;
+};
+
+// decode until the first video frame; returns 0 or a negative AVERROR
+static int first_frame(MediaSource *source) {
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int result = 0;
+    bool found = false;
+    while (!found && result >= 0) {
+        result = av_read_frame(source->format_context, packet);
+        if (result < 0) {
+            break;
+        }
+        if (packet->stream_index == source->video_stream_index) {
+            if (packet->flags & AV_PKT_FLAG_KEY) {
+                media_source_remember_keyframe(source, packet->pos);
+            }
+            result = avcodec_send_packet(source->video_codec_context, packet);
+            if (result == AVERROR(EAGAIN)) {
+                result = 0;
+            }
+            found = result >= 0 && avcodec_receive_frame(source->video_codec_context, frame) == 0;
+        }
+        av_packet_unref(packet);
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return found ? 0 : result < 0 ? result : AVERROR_EOF;
+}
+
+static bool run_once(const char *path, ProbeCache *cache, OpenRuns *runs) {
+    MediaSource source;
+    MediaSourceOptions options;
+    options.probe_cache = cache;
+    int64_t start = now_us();
+    int result = media_source_open(&source, path, options);
+    if (result >= 0) {
+        result = first_frame(&source);
+    }
+    int64_t wall = now_us() - start;
+    StartupTimings timings = source.startup;
+    media_source_close(&source);
+    if (result < 0) {
+        return false;
+    }
+    runs->probe.push_back(timings.probe_us);
+    runs->wall.push_back(wall);
+    runs->cached += timings.probe_cached ? 1 : 0;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    int count = 5;
+    std::string directory;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr || count <= 0) {
+        fprintf(stderr, "usage: %s [-n runs] [--cache <dir>] <file or url>\n", argv[0]);
+        return 2;
+    }
+    if (directory.empty()) {
+        char temporary[] = "/tmp/probe_cache_bench.XXXXXX";
+        if (mkdtemp(temporary) == nullptr) {
+            return 1;
+        }
+        directory = temporary;
+    }
+    ProbeCache cache(directory);
+    if (cache.open() < 0) {
+        return 1;
+    }
+    printf("%-6s %10s %10s  (median ms of %d runs)\n", "open", "probe", "wall", count);
+    OpenRuns cold;
+    OpenRuns warm;
+    for (int i = 0; i < count; i++) {
+        if (!run_once(path, nullptr, &cold)) {
+            fprintf(stderr, "no frame from %s\n", path);
+            return 1;
+        }
+    }
+    // fills the entry, the keyframe offset included
+    OpenRuns fill;
+    if (!run_once(path, &cache, &fill)) {
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!run_once(path, &cache, &warm)) {
+            fprintf(stderr, "no frame from %s\n", path);
+            return 1;
+        }
+    }
+    printf("%-6s %10.1f %10.1f\n", "cold", median(cold.probe) / 1000.0, median(cold.wall) / 1000.0);
+    printf("%-6s %10.1f %10.1f  %d of %d from the cache\n", "warm", median(warm.probe) / 1000.0,
+           median(warm.wall) / 1000.0, warm.cached, count);
+    ProbeCacheStats stats = cache.stats();
+    printf("cache  %lld hits %lld misses %lld stored in %s\n", (long long) stats.hits, (long long) stats.misses,
+           (long long) stats.stores, directory.c_str());
+    return 0;
+}
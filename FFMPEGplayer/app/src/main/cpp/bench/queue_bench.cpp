@@ -0,0 +1,125 @@
+// Compares the lock-free MediaQueue with a mutex+condvar queue and libavutil's AVThreadMessageQueue.
+//   queue_bench [items] [rate items/s]
+// Each queue is run twice: flat out for throughput, then paced at the given rate for hand-off latency.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/packet.h"
+#include "libavutil/threadmessage.h"
+}
+
+#include "bounded_queue.h"
+#include "media_queue.h"
+#include "time_util.h"
+
+static const int QUEUE_SIZE = 64;
+
+// adapters so every queue is driven by the same loop
+struct LockFreeAdapter {
+    MediaQueue<AVPacket *> queue;
+    LockFreeAdapter() : queue(limits()) {}
+    static MediaQueueLimits limits() {
+        MediaQueueLimits limits;
+        limits.max_items = QUEUE_SIZE;
+        limits.max_bytes = 4 * 1024 * 1024;
+        return limits;
+    }
+    bool push(AVPacket *packet) { return queue.push(packet); }
+    bool pop(AVPacket *&packet) { return queue.pop(packet); }
+    void close() { queue.close(); }
+};
+
+struct MutexAdapter {
+    BoundedQueue<AVPacket *> queue;
+    MutexAdapter() : queue(QUEUE_SIZE) {}
+    bool push(AVPacket *packet) { return queue.push(packet); }
+    bool pop(AVPacket *&packet) { return queue.pop(packet); }
+    void close() { queue.close(); }
+};
+
+struct ThreadMessageAdapter {
+    AVThreadMessageQueue *queue = nullptr;
+    ThreadMessageAdapter() { av_thread_message_queue_alloc(&queue, QUEUE_SIZE, sizeof(AVPacket *)); }
+    ~ThreadMessageAdapter() { av_thread_message_queue_free(&queue); }
+    bool push(AVPacket *packet) { return av_thread_message_queue_send(queue, &packet, 0) >= 0; }
+    bool pop(AVPacket *&packet) { return av_thread_message_queue_recv(queue, &packet, 0) >= 0; }
+    void close() { av_thread_message_queue_set_err_recv(queue, AVERROR_EOF); }
+};
+
+struct Result {
+    double items_per_second;
+    int64_t p50_us;
+    int64_t p99_us;
+    int64_t max_us;
+};
+
+// the packet's pts carries the send time, so latency needs no side channel
+template <typename Adapter>
+static Result run(std::vector<AVPacket *> &packets, int rate) {
+    Adapter adapter;
+    std::vector<int64_t> latencies;
+    latencies.reserve(packets.size());
+    int64_t start = now_us();
+    std::thread consumer([&] {
+        AVPacket *packet;
+        while (adapter.pop(packet)) {
+            if (rate > 0) {
+                latencies.push_back(now_us() - packet->pts);
+            }
+        }
+    });
+    for (size_t i = 0; i < packets.size(); i++) {
+        if (rate > 0) {
+            int64_t due = start + (int64_t) (i * 1000000.0 / rate);
+            while (now_us() < due) {
+            }
+        }
+        packets[i]->pts = now_us();
+        adapter.push(packets[i]);
+    }
+    adapter.close();
+    consumer.join();
+    int64_t elapsed = now_us() - start;
+
+    Result result = {};
+    result.items_per_second = packets.size() * 1e6 / std::max<int64_t>(elapsed, 1);
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        result.p50_us = latencies[latencies.size() / 2];
+        result.p99_us = latencies[latencies.size() * 99 / 100];
+        result.max_us = latencies.back();
+    }
+    return result;
+}
+
+template <typename Adapter>
+static void bench(const char *name, std::vector<AVPacket *> &packets, int rate) {
+    Result throughput = run<Adapter>(packets, 0);
+    Result paced = run<Adapter>(packets, rate);
+    printf("%-16s %12.0f items/s   @%d/s latency p50 %5lld us  p99 %5lld us  max %6lld us\n",
+           name, throughput.items_per_second, rate,
+           (long long) paced.p50_us, (long long) paced.p99_us, (long long) paced.max_us);
+}
+
+int main(int argc, char **argv) {
+    int items = argc > 1 ? atoi(argv[1]) : 200000;
+    int rate = argc > 2 ? atoi(argv[2]) : 20000;
+    std::vector<AVPacket *> packets(items);
+    for (int i = 0; i < items; i++) {
+        packets[i] = av_packet_alloc();
+        // sizes of a typical 1080p H.264 GOP, only the budget accounting looks at them
+        packets[i]->size = i % 60 == 0 ? 200000 : 12000;
+    }
+    bench<LockFreeAdapter>("spsc lock-free", packets, rate);
+    bench<MutexAdapter>("mutex+condvar", packets, rate);
+    bench<ThreadMessageAdapter>("AVThreadMessage", packets, rate);
+    for (int i = 0; i < items; i++) {
+        av_packet_free(&packets[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Measures what reduced-cost decoding saves for video shown in a small tile, on Linux without a
+// display.
+//   reduced_decode_bench [--tile <w>x<h>] [--runs n] [--threads n] <file>...
+// Every file plays flat out into a NullSink with a surface the size of the tile (320x180 by
+// default), so frames are scaled down to it either way, once per mode:
+//   full     the decoder produces the whole picture and sws_scale shrinks it
+//   reduced  lowres where the codec has it, no loop filter while the picture is still twice
+//            the tile or more
+//   gray     reduced, and no chroma where the decoder can leave it out; only FFmpeg builds
+//            configured with --enable-gray do, elsewhere it matches reduced
+//   nonref   reduced, and the reference frames alone
+// Each run is a child process of its own and its CPU time, every thread included, comes from
+// wait4. Reported per mode: the size the decoder output, CPU ms per second of video, the
+// frames presented and how many times less CPU than full it took. With --runs the cheapest run
+// counts. The grid clips come from tools/make_grid_clips.sh.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "media_source.h"
+#include "pipeline.h"
+#include "video_sink.h"
+
+enum Mode {
+    MODE_FULL,
+    MODE_REDUCED,
+    MODE_GRAY,
+    MODE_NONREF,
+    MODE_COUNT,
+};
+
+static const char *MODE_NAMES[MODE_COUNT] = {"full", "reduced", "gray", "nonref"};
+
+struct ModeResult {
+    int width = 0;
+    int height = 0;
+    int64_t frames = 0;
+    double seconds = 0;
+    char reduced[64] = "";
+    // filled in by the parent from the child's rusage
+    double cpu_ms = 0;
+};
+
+static int64_t timeval_us(const struct timeval &time) {
+    return time.tv_sec * 1000000LL + time.tv_usec;
+}
+
+// one playback of the file in this process, the result written to fd
+static int play(const char *path, Mode mode, int tile_width, int tile_height, int threads, int fd) {
+    MediaSourceOptions source_options;
+    source_options.decoder_threads = threads;
+    if (mode != MODE_FULL) {
+        source_options.reduced_decode.display_width = tile_width;
+        source_options.reduced_decode.display_height = tile_height;
+        source_options.reduced_decode.allow_gray = mode == MODE_GRAY;
+        source_options.reduced_decode.skip_nonref = mode == MODE_NONREF;
+    }
+    MediaSource source;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        return 1;
+    }
+    ModeResult result;
+    result.width = source.video_codec_context->width;
+    result.height = source.video_codec_context->height;
+    reduced_decode_describe(source.video_reduced, result.reduced, sizeof(result.reduced));
+    if (source.format_context->duration != AV_NOPTS_VALUE) {
+        result.seconds = source.format_context->duration / (double) AV_TIME_BASE;
+    }
+    NullSink sink(tile_width, tile_height);
+    PipelineOptions options;
+    int status;
+    {
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, &sink, options);
+        status = pipeline.run();
+        result.frames = pipeline.stats().present.items;
+    }
+    media_source_close(&source);
+    if (status < 0) {
+        return 1;
+    }
+    return write(fd, &result, sizeof(result)) == (ssize_t) sizeof(result) ? 0 : 1;
+}
+
+// plays the file in a child process; false when it failed
+static bool run(const char *path, Mode mode, int tile_width, int tile_height, int threads, ModeResult *result) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return false;
+    }
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        _exit(play(path, mode, tile_width, tile_height, threads, fds[1]));
+    }
+    close(fds[1]);
+    // far below PIPE_BUF, it arrives in one piece
+    ssize_t size = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+        || size != (ssize_t) sizeof(*result)) {
+        return false;
+    }
+    result->cpu_ms = (timeval_us(usage.ru_utime) + timeval_us(usage.ru_stime)) / 1000.0;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int tile_width = 320;
+    int tile_height = 180;
+    int runs = 1;
+    int threads = 0;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &tile_width, &tile_height) != 2) {
+                tile_width = tile_height = 0;
+            }
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || runs < 1 || tile_width <= 0 || tile_height <= 0) {
+        fprintf(stderr, "usage: %s [--tile <w>x<h>] [--runs n] [--threads n] <file>...\n", argv[0]);
+        return 2;
+    }
+
+    printf("%dx%d tile\n", tile_width, tile_height);
+    printf("%-24s %-8s %10s %12s %8s %8s  %s\n", "file", "mode", "decoded", "cpu ms/s", "frames", "less", "decoder");
+    int failures = 0;
+    for (const char *path : paths) {
+        const char *slash = strrchr(path, '/');
+        const char *name = slash != nullptr ? slash + 1 : path;
+        double full_cpu = 0;
+        for (int mode = 0; mode < MODE_COUNT; mode++) {
+            ModeResult best;
+            bool played = false;
+            for (int i = 0; i < runs; i++) {
+                ModeResult result;
+                if (run(path, (Mode) mode, tile_width, tile_height, threads, &result)
+                    && (!played || result.cpu_ms < best.cpu_ms)) {
+                    best = result;
+                    played = true;
+                }
+            }
+            if (!played) {
+                fprintf(stderr, "%s: %s playback failed\n", path, MODE_NAMES[mode]);
+                failures++;
+                continue;
+            }
+            // per second of video rather than per frame, nonref presents fewer of them
+            double cpu_per_second = best.seconds > 0 ? best.cpu_ms / best.seconds : best.cpu_ms;
+            if (mode == MODE_FULL) {
+                full_cpu = cpu_per_second;
+            }
+            char decoded[24];
+            snprintf(decoded, sizeof(decoded), "%dx%d", best.width, best.height);
+            printf("%-24s %-8s %10s %12.1f %8lld %7.2fx  %s\n", name, MODE_NAMES[mode], decoded, cpu_per_second,
+                   (long long) best.frames, full_cpu > 0 && cpu_per_second > 0 ? full_cpu / cpu_per_second : 0,
+                   best.reduced);
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
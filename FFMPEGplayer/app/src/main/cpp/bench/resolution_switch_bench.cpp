@@ -0,0 +1,121 @@
+// Plays a clip that changes resolution mid-stream in real time and measures the glitch at every
+// switch, on Linux without a display.
+//   resolution_switch_bench [--staging] <file>
+// The glitch is the gap between the last frame posted at the old size and the first one at the
+// new size, beyond the frame interval: what the decoder's reinit, a new conversion context, new
+// RGBA buffers and reconfiguring the sink add up to on screen. Frames are converted at the
+// stream's own size so every switch reaches the sink. The clip comes from
+// tools/make_switch_clip.sh.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "master_clock.h"
+#include "media_source.h"
+#include "pipeline.h"
+#include "time_util.h"
+#include "video_sink.h"
+
+// when each frame was posted and at what size
+struct Post {
+    int64_t time_us;
+    int width;
+    int height;
+};
+
+class RecordingSink : public NullSink {
+public:
+    RecordingSink() {
+        // a few minutes at 60 fps, recording does not allocate while playing
+        posts_.reserve(16384);
+    }
+
+    int configure(int width, int height) override {
+        width_ = width;
+        height_ = height;
+        return NullSink::configure(width, height);
+    }
+
+    int post() override {
+        Post post = {now_us(), width_, height_};
+        posts_.push_back(post);
+        return NullSink::post();
+    }
+
+    // read once the pipeline has stopped
+    const std::vector<Post> &posts() const { return posts_; }
+
+private:
+    std::vector<Post> posts_;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    PipelineOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--staging") == 0) {
+            options.direct_present = false;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "usage: %s [--staging] <file>\n", argv[0]);
+        return 2;
+    }
+    MediaSource source;
+    MediaSourceOptions source_options;
+    source_options.enable_audio = false;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        return 1;
+    }
+    AVStream *stream = source.format_context->streams[source.video_stream_index];
+    AVRational frame_rate = av_guess_frame_rate(source.format_context, stream, nullptr);
+    int64_t interval_us = frame_rate.num > 0 ? (int64_t) (1e6 / av_q2d(frame_rate)) : 40000;
+    SystemClock clock;
+    options.clock = &clock;
+    options.scale_to_surface = false;
+    options.packet_index = source.packet_index;
+    RecordingSink sink;
+    int result;
+    PipelineStats stats;
+    {
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, &sink, options);
+        result = pipeline.run();
+        stats = pipeline.stats();
+    }
+    media_source_close(&source);
+    if (result < 0) {
+        fprintf(stderr, "playback failed\n");
+        return 1;
+    }
+
+    const std::vector<Post> &posts = sink.posts();
+    int switches = 0;
+    int64_t total_glitch_us = 0;
+    int64_t max_glitch_us = 0;
+    for (size_t i = 1; i < posts.size(); i++) {
+        const Post &before = posts[i - 1];
+        const Post &after = posts[i];
+        if (before.width == after.width && before.height == after.height) {
+            continue;
+        }
+        int64_t gap = after.time_us - before.time_us;
+        int64_t glitch = gap > interval_us ? gap - interval_us : 0;
+        printf("frame %6zu %4dx%-4d -> %4dx%-4d gap %7.2f ms, glitch %7.2f ms\n", i, before.width, before.height,
+               after.width, after.height, gap / 1000.0, glitch / 1000.0);
+        switches++;
+        total_glitch_us += glitch;
+        max_glitch_us = glitch > max_glitch_us ? glitch : max_glitch_us;
+    }
+    printf("%zu frames, %d switches at %.2f ms per frame: glitch mean %.2f ms max %.2f ms\n", posts.size(), switches,
+           interval_us / 1000.0, switches > 0 ? total_glitch_us / 1000.0 / switches : 0, max_glitch_us / 1000.0);
+    printf("%lld format changes, first frame converted in %.2f ms max, %lld sink resizes %.2f ms max, %lld dropped\n",
+           (long long) stats.format_changes, stats.format_change_max_us / 1000.0, (long long) stats.sink_resizes,
+           stats.sink_resize_max_us / 1000.0, (long long) stats.schedule.dropped);
+    return 0;
+}
@@ -0,0 +1,55 @@
+// Drives the PresentScheduler with a FakeClock over a synthetic timeline, so drop and jitter
+// behaviour is reproducible to the microsecond on any machine.
+//   scheduler_sim [fps] [frames] [spike_every] [spike_us]
+// Every frame costs a third of its duration to convert; every spike_every-th one stalls
+// for spike_us, which is where drops are expected.
+
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" {
+#include "libavutil/frame.h"
+}
+
+#include "master_clock.h"
+#include "present_scheduler.h"
+
+int main(int argc, char **argv) {
+    int fps = argc > 1 ? atoi(argv[1]) : 60;
+    int frames = argc > 2 ? atoi(argv[2]) : 600;
+    int spike_every = argc > 3 ? atoi(argv[3]) : 120;
+    int64_t spike_us = argc > 4 ? atoll(argv[4]) : 80000;
+
+    // a 1/fps time base means pts is just the frame number
+    AVRational time_base = {1, fps};
+    int64_t frame_us = 1000000 / fps;
+    FakeClock clock;
+    PresentScheduler scheduler(&clock, time_base);
+    AVFrame *frame = av_frame_alloc();
+    int64_t converted = 0;
+    for (int i = 0; i < frames; i++) {
+        frame->pts = i;
+        frame->best_effort_timestamp = i;
+        frame->duration = 1;
+        if (spike_every > 0 && i > 0 && i % spike_every == 0) {
+            // decoder stall before this frame arrives
+            clock.advance(spike_us);
+        }
+        int64_t media_us = scheduler.frame_time_us(frame);
+        if (!scheduler.admit(media_us)) {
+            continue;
+        }
+        clock.advance(frame_us / 3);
+        converted++;
+        scheduler.wait(media_us);
+        scheduler.presented(media_us);
+    }
+    av_frame_free(&frame);
+
+    const SchedulerStats &stats = scheduler.stats();
+    printf("%d frames @%d fps: converted %lld presented %lld dropped %lld late %lld\n",
+           frames, fps, (long long) converted, (long long) stats.presented,
+           (long long) stats.dropped, (long long) stats.late);
+    printf("jitter mean %lld us max %lld us\n", (long long) stats.jitter_mean_us(), (long long) stats.jitter_max_us);
+    return 0;
+}
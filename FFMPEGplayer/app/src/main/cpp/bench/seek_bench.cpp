@@ -0,0 +1,113 @@
+// Measures seek-to-frame latency and landing accuracy of both seek modes, on Linux without a display.
+//   seek_bench [-n seeks] <file>...
+// Each file is prepared, started and paused, then seeked to the same pseudo-random positions
+// in fast and in accurate mode. A seek made while paused posts the frame where it landed, which
+// ends the measurement. Clips with short to long GOPs come from tools/make_gop_clips.sh.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "media_player.h"
+#include "time_util.h"
+#include "video_sink.h"
+
+// how long to wait for the frame of a seek before counting it as failed
+static const int64_t SEEK_TIMEOUT_US = 5 * 1000000;
+
+static int64_t percentile(std::vector<int64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (p * (values.size() - 1))];
+}
+
+static bool wait_for_state(const MediaPlayer &player, PlayerState state) {
+    int64_t deadline = now_us() + SEEK_TIMEOUT_US;
+    while (player.state() != state) {
+        if (now_us() > deadline || player.state() == PLAYER_ERROR) {
+            return false;
+        }
+        precise_sleep_us(1000);
+    }
+    return true;
+}
+
+// returns the number of seeks that showed no frame, -1 when the file does not play
+static int run_mode(const char *path, SeekMode mode, int seeks) {
+    NullSink sink;
+    MediaPlayerOptions options;
+    options.source.enable_audio = false;
+    MediaPlayer player(&sink, nullptr, options);
+    player.prepare(path);
+    player.start();
+    player.pause();
+    player.sync();
+    if (!wait_for_state(player, PLAYER_PAUSED)) {
+        return -1;
+    }
+    // targets stay clear of the end so there is always a frame to land on
+    int64_t range_ms = std::max<int64_t>(1, (player.duration_ms() > 0 ? player.duration_ms() : 10000) * 9 / 10);
+    // fixed seed, both modes seek to the same positions
+    srand(1);
+    std::vector<int64_t> latency;
+    std::vector<int64_t> error;
+    int failed = 0;
+    for (int i = 0; i < seeks; i++) {
+        int64_t count = player.seek_stats().count;
+        player.seek(rand() % range_ms, mode);
+        int64_t start = now_us();
+        SeekStats stats;
+        do {
+            precise_sleep_us(200);
+            stats = player.seek_stats();
+        } while (stats.count == count && now_us() - start < SEEK_TIMEOUT_US);
+        if (stats.count == count) {
+            failed++;
+            continue;
+        }
+        latency.push_back(stats.last_us);
+        error.push_back(llabs(stats.last_error_us));
+    }
+    SeekStats stats = player.seek_stats();
+    printf("%-9s %8.1f %8.1f %8.1f %10.1f %10.1f %9.1f %6d\n", mode == SEEK_FAST ? "fast" : "accurate",
+           percentile(latency, 0.5) / 1000.0, percentile(latency, 0.9) / 1000.0, percentile(latency, 1.0) / 1000.0,
+           percentile(error, 0.5) / 1000.0, percentile(error, 1.0) / 1000.0,
+           stats.count > 0 ? stats.discarded_frames / (double) stats.count : 0, failed);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int seeks = 30;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            seeks = atoi(argv[++i]);
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || seeks <= 0) {
+        fprintf(stderr, "usage: %s [-n seeks] <file>...\n", argv[0]);
+        return 2;
+    }
+    int failed = 0;
+    for (const char *path : paths) {
+        printf("%s\n", path);
+        printf("%-9s %8s %8s %8s %10s %10s %9s %6s\n", "mode", "p50 ms", "p90 ms", "max ms", "off p50 ms",
+               "off max ms", "skipped", "failed");
+        SeekMode modes[] = {SEEK_FAST, SEEK_ACCURATE};
+        for (SeekMode mode : modes) {
+            int result = run_mode(path, mode, seeks);
+            if (result < 0) {
+                fprintf(stderr, "can not play %s\n", path);
+                return 1;
+            }
+            failed += result;
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+// Measures the time to the first frame with and without fast start, on Linux without a display.
+//   startup_bench [-n runs] [--prefetch <MB>] <file or url>
+// Every run prepares a new player and starts it right away into a NullSink. Reported are the
+// medians of each startup phase and of the wall time from prepare() to the first posted frame.
+// Over the network, serve the clip with tools/throttled_http_server.py and some --latency.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "audio_sink.h"
+#include "media_player.h"
+#include "time_util.h"
+#include "video_sink.h"
+
+static const int64_t FIRST_FRAME_TIMEOUT_US = 30 * 1000000;
+
+static int64_t median(std::vector<int64_t> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+struct StartupRuns {
+    std::vector<int64_t> connect;
+    std::vector<int64_t> open;
+    std::vector<int64_t> probe;
+    std::vector<int64_t> codec_open;
+    std::vector<int64_t> first_decode;
+    std::vector<int64_t> first_present;
+    std::vector<int64_t> wall;
+    int skipped_probes = 0;
+};
+
+static bool run_once(const char *path, const MediaPlayerOptions &options, StartupRuns *runs) {
+    NullSink sink;
+    NullAudioSink audio_sink;
+    MediaPlayer player(&sink, &audio_sink, options);
+    int64_t start = now_us();
+    player.prepare(path);
+    player.start();
+    StartupTimings timings;
+    for (;;) {
+        timings = player.startup_timings();
+        if (timings.first_present_us >= 0) {
+            break;
+        }
+        if (player.state() == PLAYER_ERROR || now_us() - start > FIRST_FRAME_TIMEOUT_US) {
+            return false;
+        }
+        precise_sleep_us(500);
+    }
+    runs->wall.push_back(now_us() - start);
+    runs->connect.push_back(timings.connect_us);
+    runs->open.push_back(timings.open_us);
+    runs->probe.push_back(timings.probe_us);
+    runs->codec_open.push_back(timings.codec_open_us);
+    runs->first_decode.push_back(timings.first_decode_us);
+    runs->first_present.push_back(timings.first_present_us);
+    runs->skipped_probes += timings.probe_skipped ? 1 : 0;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    int count = 5;
+    int64_t prefetch_bytes = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            prefetch_bytes = atoll(argv[++i]) * 1024 * 1024;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr || count <= 0) {
+        fprintf(stderr, "usage: %s [-n runs] [--prefetch <MB>] <file or url>\n", argv[0]);
+        return 2;
+    }
+    printf("%-10s %8s %8s %8s %8s %8s %8s %8s  (median ms of %d runs)\n", "mode", "connect", "open", "probe",
+           "codecs", "decode", "present", "wall", count);
+    bool modes[] = {false, true};
+    for (bool fast_start : modes) {
+        MediaPlayerOptions options;
+        options.source.fast_start = fast_start;
+        options.pipeline.fast_start = fast_start;
+        if (prefetch_bytes >= 0) {
+            options.source.prefetch_bytes = prefetch_bytes;
+        }
+        StartupRuns runs;
+        for (int i = 0; i < count; i++) {
+            if (!run_once(path, options, &runs)) {
+                fprintf(stderr, "no frame from %s\n", path);
+                return 1;
+            }
+        }
+        printf("%-10s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f", fast_start ? "fast" : "default",
+               median(runs.connect) / 1000.0, median(runs.open) / 1000.0, median(runs.probe) / 1000.0,
+               median(runs.codec_open) / 1000.0, median(runs.first_decode) / 1000.0,
+               median(runs.first_present) / 1000.0, median(runs.wall) / 1000.0);
+        printf("%s\n", runs.skipped_probes > 0 ? "  probe skipped" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef FFMPEGPLAYER_BOUNDED_QUEUE_H
+#define FFMPEGPLAYER_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * Blocking queue with a fixed capacity, used to hand work from one pipeline stage to the next.
+ * push blocks while the queue is full, which is what gives the pipeline its backpressure.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    // blocks while full, returns false if the queue was aborted
+    bool push(const T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return aborted_ || items_.size() < capacity_; });
+        if (aborted_) {
+            return false;
+        }
+        items_.push_back(item);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // blocks while empty, returns false once the producer closed the queue and it is drained, or on abort
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return aborted_ || closed_ || !items_.empty(); });
+        if (aborted_ || items_.empty()) {
+            return false;
+        }
+        item = items_.front();
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // producer side end of stream, the consumer still drains what is queued
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+    // wake everyone up and refuse further work
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    // take whatever is left without blocking, used to free items on teardown
+    bool try_pop(T &item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) {
+            return false;
+        }
+        item = items_.front();
+        items_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+    bool aborted_ = false;
+};
+
+#endif // FFMPEGPLAYER_BOUNDED_QUEUE_H
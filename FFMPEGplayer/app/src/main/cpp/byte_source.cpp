@@ -0,0 +1,38 @@
+#include "byte_source.h"
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+ProtocolSource::~ProtocolSource() {
+    avio_closep(&context_);
+}
+
+int ProtocolSource::open(const char *url, AVDictionary **options) {
+    AVIOInterruptCB interrupt = {&ProtocolSource::interrupt_callback, this};
+    int result = avio_open2(&context_, url, AVIO_FLAG_READ, &interrupt, options);
+    if (result < 0) {
+        return result;
+    }
+    size_ = avio_size(context_);
+    return 0;
+}
+
+int ProtocolSource::read(uint8_t *buffer, int size) {
+    // returns as soon as the protocol has anything, callers are fed in small steps
+    int result = avio_read_partial(context_, buffer, size);
+    return result == 0 ? AVERROR_EOF : result;
+}
+
+int64_t ProtocolSource::seek(int64_t position) {
+    return avio_seek(context_, position, SEEK_SET);
+}
+
+bool ProtocolSource::seekable() const {
+    return context_ != nullptr && context_->seekable != 0;
+}
+
+int ProtocolSource::interrupt_callback(void *opaque) {
+    auto *source = static_cast<ProtocolSource *>(opaque);
+    return source->aborted_.load() || (source->interrupt_ != nullptr && source->interrupt_->load()) ? 1 : 0;
+}
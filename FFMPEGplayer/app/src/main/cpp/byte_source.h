@@ -0,0 +1,59 @@
+#ifndef FFMPEGPLAYER_BYTE_SOURCE_H
+#define FFMPEGPLAYER_BYTE_SOURCE_H
+
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include "libavformat/avio.h"
+}
+
+/**
+ * Random-access input the prefetcher reads from: FFmpeg's protocols directly, or the HTTP
+ * cache in front of them. Reads and seeks come from one thread, abort() from any.
+ */
+class ByteSource {
+public:
+    virtual ~ByteSource() {}
+
+    // some bytes from the current position: > 0, AVERROR_EOF or another negative AVERROR
+    virtual int read(uint8_t *buffer, int size) = 0;
+
+    // returns position or a negative AVERROR
+    virtual int64_t seek(int64_t position) = 0;
+
+    // total size, -1 when unknown
+    virtual int64_t size() const = 0;
+
+    virtual bool seekable() const = 0;
+
+    // make a blocking read return AVERROR_EXIT
+    virtual void abort() = 0;
+};
+
+// one of FFmpeg's protocols (file, http, ...) opened through avio
+class ProtocolSource : public ByteSource {
+public:
+    // interrupt, when given, aborts this source too; it has to outlive it
+    explicit ProtocolSource(const std::atomic<bool> *interrupt = nullptr) : interrupt_(interrupt) {}
+    ~ProtocolSource() override;
+
+    // returns 0 or a negative AVERROR
+    int open(const char *url, AVDictionary **options = nullptr);
+
+    int read(uint8_t *buffer, int size) override;
+    int64_t seek(int64_t position) override;
+    int64_t size() const override { return size_; }
+    bool seekable() const override;
+    void abort() override { aborted_.store(true); }
+
+private:
+    static int interrupt_callback(void *opaque);
+
+    const std::atomic<bool> *interrupt_;
+    AVIOContext *context_ = nullptr;
+    int64_t size_ = -1;
+    std::atomic<bool> aborted_{false};
+};
+
+#endif // FFMPEGPLAYER_BYTE_SOURCE_H
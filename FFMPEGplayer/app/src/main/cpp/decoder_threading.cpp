@@ -0,0 +1,94 @@
+#include "decoder_threading.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// more threads than this stop paying off at the given picture size
+static int max_useful_threads(int64_t pixels) {
+    if (pixels >= 3840 * 2160) {
+        return 8;
+    }
+    if (pixels >= 1920 * 1080) {
+        return 6;
+    }
+    if (pixels >= 1280 * 720) {
+        return 4;
+    }
+    return 2;
+}
+
+DecoderThreading decoder_threading_choose(const AVCodec *codec, const AVCodecParameters *codecpar,
+                                          DecoderThreadingMode mode, int thread_count, int cores) {
+    DecoderThreading threading;
+    threading.mode = mode;
+    bool frame_capable = (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) != 0;
+    bool slice_capable = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) != 0;
+    int64_t pixels = (int64_t) codecpar->width * codecpar->height;
+
+    switch (mode) {
+        case DECODER_THREADING_OFF:
+            threading.thread_count = 1;
+            threading.thread_type = 0;
+            return threading;
+        case DECODER_THREADING_FRAME:
+            threading.thread_type = FF_THREAD_FRAME;
+            break;
+        case DECODER_THREADING_SLICE:
+            threading.thread_type = FF_THREAD_SLICE;
+            break;
+        case DECODER_THREADING_FRAME_SLICE:
+            threading.thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            break;
+        case DECODER_THREADING_AUTO:
+            if (frame_capable && pixels >= 1280 * 720) {
+                threading.thread_type = FF_THREAD_FRAME;
+                // 4K HEVC/H.264 with many slices also gains from slice threads once frames are spread out
+                if (slice_capable && pixels >= 3840 * 2160) {
+                    threading.thread_type |= FF_THREAD_SLICE;
+                }
+            } else if (slice_capable) {
+                threading.thread_type = FF_THREAD_SLICE;
+            } else if (frame_capable) {
+                threading.thread_type = FF_THREAD_FRAME;
+            }
+            break;
+    }
+
+    if (threading.thread_type == 0) {
+        threading.thread_count = 1;
+    } else if (thread_count > 0) {
+        threading.thread_count = thread_count;
+    } else {
+        int available = cores > 2 ? cores - 1 : std::max(cores, 1);
+        threading.thread_count = std::max(1, std::min(available, max_useful_threads(pixels)));
+    }
+    if (threading.thread_count == 1) {
+        threading.thread_type = 0;
+    }
+    return threading;
+}
+
+void decoder_threading_apply(AVCodecContext *codec_context, DecoderThreading *threading) {
+    codec_context->thread_count = threading->thread_count;
+    if (threading->thread_type != 0) {
+        codec_context->thread_type = threading->thread_type;
+    }
+}
+
+void decoder_threading_update(const AVCodecContext *codec_context, DecoderThreading *threading) {
+    threading->thread_count = codec_context->thread_count;
+    threading->active_thread_type = codec_context->active_thread_type;
+}
+
+const char *decoder_threading_describe(const DecoderThreading &threading, char *buffer, int size) {
+    int type = threading.active_thread_type;
+    const char *name = type == (FF_THREAD_FRAME | FF_THREAD_SLICE) ? "frame+slice"
+                       : type == FF_THREAD_FRAME ? "frame"
+                       : type == FF_THREAD_SLICE ? "slice" : nullptr;
+    if (name == nullptr || threading.thread_count <= 1) {
+        snprintf(buffer, size, "off");
+    } else {
+        snprintf(buffer, size, "%s x%d", name, threading.thread_count);
+    }
+    return buffer;
+}
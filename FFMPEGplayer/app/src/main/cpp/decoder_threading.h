@@ -0,0 +1,46 @@
+#ifndef FFMPEGPLAYER_DECODER_THREADING_H
+#define FFMPEGPLAYER_DECODER_THREADING_H
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+enum DecoderThreadingMode {
+    // pick from codec capabilities, resolution and core count
+    DECODER_THREADING_AUTO,
+    // single threaded, the behaviour before threading was enabled
+    DECODER_THREADING_OFF,
+    DECODER_THREADING_FRAME,
+    DECODER_THREADING_SLICE,
+    // let the codec use whichever it supports, frame first
+    DECODER_THREADING_FRAME_SLICE,
+};
+
+struct DecoderThreading {
+    DecoderThreadingMode mode = DECODER_THREADING_AUTO;
+    // 0 lets the policy decide
+    int thread_count = 0;
+    // FF_THREAD_FRAME / FF_THREAD_SLICE bits requested, and what the codec actually activated
+    int thread_type = 0;
+    int active_thread_type = 0;
+};
+
+/**
+ * Resolve the threading configuration for a decoder that is about to be opened.
+ * Frame threading scales best but adds (thread_count - 1) frames of latency, so it is used
+ * from 720p up; smaller pictures get slice threading or stay single threaded.
+ * One core is left for demux/convert/present unless the device only has two.
+ */
+DecoderThreading decoder_threading_choose(const AVCodec *codec, const AVCodecParameters *codecpar,
+                                          DecoderThreadingMode mode, int thread_count, int cores);
+
+// copy the choice into the context, must be called before avcodec_open2
+void decoder_threading_apply(AVCodecContext *codec_context, DecoderThreading *threading);
+
+// read back what the opened codec activated
+void decoder_threading_update(const AVCodecContext *codec_context, DecoderThreading *threading);
+
+// "frame x6", "slice x4", "off"
+const char *decoder_threading_describe(const DecoderThreading &threading, char *buffer, int size);
+
+#endif // FFMPEGPLAYER_DECODER_THREADING_H
@@ -0,0 +1,118 @@
+#include "degradation_controller.h"
+
+// how far step_up_windows may grow when steps up keep being taken back
+static const int MAX_STEP_UP_WINDOWS = 64;
+// no rung is trusted to save more than this, a noisy measurement would make stepping up look safe
+// far too early
+static const double MIN_COST_RATIO = 0.3;
+
+const char *degradation_level_name(int level) {
+    switch (level) {
+        case DEGRADE_NONE:
+            return "none";
+        case DEGRADE_SKIP_LOOP_FILTER:
+            return "skip loop filter";
+        case DEGRADE_FAST_SCALER:
+            return "fast scaler";
+        case DEGRADE_DOWNSCALE:
+            return "downscale";
+        case DEGRADE_SKIP_NONREF:
+            return "skip non-reference frames";
+        case DEGRADE_SKIP_IDCT:
+            return "skip idct";
+        default:
+            return "unknown";
+    }
+}
+
+DegradationController::DegradationController(const DegradationOptions &options)
+        : options_(options),
+          step_up_windows_(options.step_up_windows) {
+    for (double &ratio : cost_ratio_) {
+        ratio = 1;
+    }
+}
+
+bool DegradationController::update(int64_t media_us, int64_t decode_busy_us, int64_t convert_busy_us) {
+    int64_t busy_us = decode_busy_us + convert_busy_us;
+    if (!window_open_ || media_us < last_media_us_) {
+        window_open_ = true;
+        window_start_us_ = media_us;
+        window_busy_us_ = busy_us;
+        last_media_us_ = media_us;
+        return false;
+    }
+    stats_.level_us[stats_.level] += media_us - last_media_us_;
+    last_media_us_ = media_us;
+    int64_t span_us = media_us - window_start_us_;
+    if (span_us < options_.window_us) {
+        return false;
+    }
+    double load = (busy_us - window_busy_us_) / (double) span_us;
+    window_start_us_ = media_us;
+    window_busy_us_ = busy_us;
+    windows_since_change_++;
+    if (settle_windows_ > 0) {
+        settle_windows_--;
+        return false;
+    }
+    if (measure_ratio_) {
+        // a rung that seems to cost more was measured on heavier content, count it as no saving
+        measure_ratio_ = false;
+        double ratio = step_load_ > 0 ? load / step_load_ : 1;
+        cost_ratio_[stats_.level] = ratio < MIN_COST_RATIO ? MIN_COST_RATIO : ratio > 1 ? 1 : ratio;
+    }
+    if (load > options_.step_down_load && stats_.level < options_.max_level) {
+        if (stepped_up_ && windows_since_change_ <= 2) {
+            // the step up did not hold, wait longer before the next one
+            step_up_windows_ = step_up_windows_ * 2 < MAX_STEP_UP_WINDOWS ? step_up_windows_ * 2 : MAX_STEP_UP_WINDOWS;
+        }
+        step(stats_.level + 1, media_us, load);
+        return true;
+    }
+    if (stats_.level > DEGRADE_NONE && load / cost_ratio_[stats_.level] < options_.step_up_load) {
+        if (++headroom_windows_ >= step_up_windows_) {
+            step(stats_.level - 1, media_us, load);
+            return true;
+        }
+    } else {
+        headroom_windows_ = 0;
+    }
+    return false;
+}
+
+void DegradationController::reset() {
+    window_open_ = false;
+    headroom_windows_ = 0;
+}
+
+void DegradationController::step(int level, int64_t media_us, double load) {
+    stepped_up_ = level < stats_.level;
+    if (stepped_up_) {
+        stats_.step_ups++;
+    } else {
+        stats_.step_downs++;
+    }
+    DegradationTransition transition;
+    transition.media_us = media_us;
+    transition.from = stats_.level;
+    transition.to = level;
+    transition.load_percent = (int) (load * 100 + 0.5);
+    if (stats_.transition_count == DegradationStats::HISTORY) {
+        for (int i = 1; i < DegradationStats::HISTORY; i++) {
+            stats_.transitions[i - 1] = stats_.transitions[i];
+        }
+        stats_.transition_count--;
+    }
+    stats_.transitions[stats_.transition_count++] = transition;
+    if (!stepped_up_) {
+        step_load_ = load;
+        measure_ratio_ = true;
+    } else {
+        measure_ratio_ = false;
+    }
+    stats_.level = level;
+    headroom_windows_ = 0;
+    settle_windows_ = 1;
+    windows_since_change_ = 0;
+}
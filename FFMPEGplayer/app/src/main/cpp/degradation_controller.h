@@ -0,0 +1,109 @@
+#ifndef FFMPEGPLAYER_DEGRADATION_CONTROLLER_H
+#define FFMPEGPLAYER_DEGRADATION_CONTROLLER_H
+
+#include <cstdint>
+
+// rungs of the ladder, least visible first; every rung keeps the ones above it.
+// Values are shared with PlayerStats.java
+enum DegradationLevel {
+    DEGRADE_NONE = 0,
+    // no deblocking, blocks show on flat areas at low bitrates
+    DEGRADE_SKIP_LOOP_FILTER,
+    // fast bilinear swscale filter, only where swscale converts
+    DEGRADE_FAST_SCALER,
+    // convert at half the output size each way, the compositor scales it back up
+    DEGRADE_DOWNSCALE,
+    // non-reference frames are not decoded at all, the frame rate drops
+    DEGRADE_SKIP_NONREF,
+    // no inverse transform on anything but keyframes, for the decoders that honour it
+    DEGRADE_SKIP_IDCT,
+    DEGRADE_LEVEL_COUNT
+};
+
+const char *degradation_level_name(int level);
+
+struct DegradationOptions {
+    // only acts when the pipeline presents against a clock
+    bool enabled = true;
+    // decode plus convert time over the media time of a window; above this a rung is taken
+    double step_down_load = 0.9;
+    // a window counts as headroom towards stepping back up when the load the rung above is
+    // expected to run at stays below this; the expectation comes from what stepping down saved
+    double step_up_load = 0.75;
+    // media time one measurement covers
+    int64_t window_us = 500000;
+    // windows of headroom in a row before a step up; doubles each time a step up has to be
+    // taken back right away, so the level does not flap
+    int step_up_windows = 4;
+    // the lowest rung taken
+    int max_level = DEGRADE_SKIP_IDCT;
+};
+
+struct DegradationTransition {
+    // media time of the frame that ended the window
+    int64_t media_us = 0;
+    int from = DEGRADE_NONE;
+    int to = DEGRADE_NONE;
+    // load of that window in percent
+    int load_percent = 0;
+};
+
+struct DegradationStats {
+    static const int HISTORY = 16;
+
+    int level = DEGRADE_NONE;
+    int64_t step_downs = 0;
+    int64_t step_ups = 0;
+    // media time played at each level
+    int64_t level_us[DEGRADE_LEVEL_COUNT] = {};
+    // the latest transitions, oldest first
+    DegradationTransition transitions[HISTORY];
+    int transition_count = 0;
+};
+
+/**
+ * Decides how far playback steps down the degradation ladder. The stage that converts feeds
+ * it every frame with the busy time the decode and convert stages have spent so far; over
+ * windows of media time that gives the load, the share of real time the two stages need.
+ * A window above step_down_load takes the next rung. The first window measured on a new rung
+ * tells how much it saved, so the load of the rung above can be told from the current one;
+ * windows where that stays below step_up_load give the rung back. The window right after a
+ * change is left out, frames made at the old level are still coming out of the decoder's
+ * threads. Applying the levels is up to the pipeline.
+ */
+class DegradationController {
+public:
+    explicit DegradationController(const DegradationOptions &options = DegradationOptions());
+
+    // a frame reached the converting stage; true when the level changed
+    bool update(int64_t media_us, int64_t decode_busy_us, int64_t convert_busy_us);
+
+    // the timeline jumped (seek): the next frame opens a new window, the level stays
+    void reset();
+
+    int level() const { return stats_.level; }
+    const DegradationStats &stats() const { return stats_; }
+
+private:
+    void step(int level, int64_t media_us, double load);
+
+    DegradationOptions options_;
+    DegradationStats stats_;
+    bool window_open_ = false;
+    int64_t window_start_us_ = 0;
+    int64_t window_busy_us_ = 0;
+    int64_t last_media_us_ = 0;
+    int step_up_windows_;
+    int headroom_windows_ = 0;
+    int settle_windows_ = 0;
+    // load at each rung relative to the one above it, measured when it was last stepped down to
+    double cost_ratio_[DEGRADE_LEVEL_COUNT];
+    // the load that made the last step down, until the new rung has been measured
+    double step_load_ = 0;
+    bool measure_ratio_ = false;
+    // windows measured since the last change, and whether it was a step up
+    int windows_since_change_ = 0;
+    bool stepped_up_ = false;
+};
+
+#endif // FFMPEGPLAYER_DEGRADATION_CONTROLLER_H
@@ -0,0 +1,120 @@
+#include "file_sink.h"
+
+#include <cerrno>
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libavutil/pixfmt.h"
+}
+
+#include "log.h"
+
+// rows and the buffer start on cache lines, as in a window buffer
+static const int ROW_ALIGNMENT = 64;
+
+FileSink::~FileSink() {
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+int FileSink::configure(int width, int height) {
+    width_ = width;
+    height_ = height;
+    linesize_ = (width * 4 + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+    pixels_.assign((size_t) linesize_ * height + ROW_ALIGNMENT, 0);
+    if (file_ != nullptr) {
+        // the stream changed size, it goes on in the same file
+        return 0;
+    }
+    file_ = fopen(path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        LOGE("Player Error : Can not open %s", path_.c_str());
+        return AVERROR(errno);
+    }
+    return write_header();
+}
+
+uint8_t *FileSink::pixels() {
+    uintptr_t address = (uintptr_t) pixels_.data();
+    return (uint8_t *) ((address + ROW_ALIGNMENT - 1) & ~(uintptr_t) (ROW_ALIGNMENT - 1));
+}
+
+int FileSink::lock(VideoSinkBuffer *buffer) {
+    buffer->bits = pixels();
+    buffer->linesize = linesize_;
+    buffer->width = width_;
+    buffer->height = height_;
+    return 0;
+}
+
+int FileSink::post() {
+    int result = write_frame(pixels(), linesize_);
+    if (result < 0) {
+        return result;
+    }
+    frames_++;
+    return 0;
+}
+
+int FileSink::write(const void *data, size_t size) {
+    if (fwrite(data, 1, size, file_) != size) {
+        LOGE("Player Error : Can not write %s", path_.c_str());
+        return AVERROR(EIO);
+    }
+    written_bytes_ += (int64_t) size;
+    return 0;
+}
+
+int RawFileSink::write_frame(const uint8_t *rgba, int linesize) {
+    for (int y = 0; y < height_; y++) {
+        int result = write(rgba + (size_t) y * linesize, (size_t) width_ * 4);
+        if (result < 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+Y4mFileSink::~Y4mFileSink() {
+    sws_freeContext(sws_context_);
+}
+
+int Y4mFileSink::write_header() {
+    file_width_ = width_;
+    file_height_ = height_;
+    // the chroma planes round up on odd sizes
+    size_t luma = (size_t) file_width_ * file_height_;
+    size_t chroma = (size_t) ((file_width_ + 1) / 2) * ((file_height_ + 1) / 2);
+    planes_.assign(luma + 2 * chroma, 0);
+    AVRational rate = frame_rate_.num > 0 && frame_rate_.den > 0 ? frame_rate_ : AVRational{25, 1};
+    char header[128];
+    int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:%d Ip A0:0 C420jpeg\n",
+                          file_width_, file_height_, rate.num, rate.den);
+    return write(header, (size_t) length);
+}
+
+int Y4mFileSink::write_frame(const uint8_t *rgba, int linesize) {
+    // the same context until the stream changes size
+    sws_context_ = sws_getCachedContext(sws_context_, width_, height_, AV_PIX_FMT_RGBA,
+                                        file_width_, file_height_, AV_PIX_FMT_YUV420P,
+                                        SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (sws_context_ == nullptr) {
+        LOGE("Player Error : Can not create convert context");
+        return AVERROR(EINVAL);
+    }
+    int chroma_width = (file_width_ + 1) / 2;
+    size_t luma_size = (size_t) file_width_ * file_height_;
+    uint8_t *luma = planes_.data();
+    uint8_t *planes[4] = {luma, luma + luma_size,
+                          luma + luma_size + (size_t) chroma_width * ((file_height_ + 1) / 2), nullptr};
+    int linesizes[4] = {file_width_, chroma_width, chroma_width, 0};
+    const uint8_t *source[4] = {rgba, nullptr, nullptr, nullptr};
+    int source_linesizes[4] = {linesize, 0, 0, 0};
+    if (sws_scale(sws_context_, source, source_linesizes, 0, height_, planes, linesizes) <= 0) {
+        LOGE("Player Error : data convert fail");
+        return AVERROR(EINVAL);
+    }
+    int result = write("FRAME\n", 6);
+    return result < 0 ? result : write(planes_.data(), planes_.size());
+}
@@ -0,0 +1,86 @@
+#ifndef FFMPEGPLAYER_FILE_SINK_H
+#define FFMPEGPLAYER_FILE_SINK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavutil/rational.h"
+#include "libswscale/swscale.h"
+}
+
+#include "video_sink.h"
+
+/**
+ * Writes every posted frame into a file, for looking at what the pipeline produced off-device.
+ * Frames are drawn into one aligned scratch buffer like a window buffer, so the direct path
+ * still converts in place, and written out on post(). configure() again mid-stream resizes the
+ * scratch buffer and keeps writing to the same file.
+ */
+class FileSink : public VideoSink {
+public:
+    explicit FileSink(const std::string &path) : path_(path) {}
+    ~FileSink() override;
+
+    int configure(int width, int height) override;
+    int lock(VideoSinkBuffer *buffer) override;
+    int post() override;
+
+    int64_t frames() const { return frames_; }
+    int64_t written_bytes() const { return written_bytes_; }
+
+protected:
+    // the file is open; called before the first frame. Returns 0 or a negative AVERROR.
+    virtual int write_header() { return 0; }
+    // the RGBA picture of the frame just posted, linesize bytes between rows
+    virtual int write_frame(const uint8_t *rgba, int linesize) = 0;
+    int write(const void *data, size_t size);
+
+    int width_ = 0;
+    int height_ = 0;
+
+private:
+    uint8_t *pixels();
+
+    std::string path_;
+    FILE *file_ = nullptr;
+    std::vector<uint8_t> pixels_;
+    int linesize_ = 0;
+    int64_t frames_ = 0;
+    int64_t written_bytes_ = 0;
+};
+
+// bare RGBA rows, back to back: ffplay -f rawvideo -pixel_format rgba -video_size WxH <file>
+// A stream that changes size goes on with rows of the new size.
+class RawFileSink : public FileSink {
+public:
+    explicit RawFileSink(const std::string &path) : FileSink(path) {}
+
+protected:
+    int write_frame(const uint8_t *rgba, int linesize) override;
+};
+
+// YUV4MPEG2 in 4:2:0, which most players and comparison tools read as is. The header holds one
+// size for the whole file, frames of any other size are scaled to it.
+class Y4mFileSink : public FileSink {
+public:
+    // frame_rate goes into the header only, frames are written as they are posted
+    Y4mFileSink(const std::string &path, AVRational frame_rate) : FileSink(path), frame_rate_(frame_rate) {}
+    ~Y4mFileSink() override;
+
+protected:
+    int write_header() override;
+    int write_frame(const uint8_t *rgba, int linesize) override;
+
+private:
+    AVRational frame_rate_;
+    // the size in the header
+    int file_width_ = 0;
+    int file_height_ = 0;
+    SwsContext *sws_context_ = nullptr;
+    std::vector<uint8_t> planes_;
+};
+
+#endif // FFMPEGPLAYER_FILE_SINK_H
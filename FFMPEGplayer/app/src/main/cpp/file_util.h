@@ -0,0 +1,60 @@
+#ifndef FFMPEGPLAYER_FILE_UTIL_H
+#define FFMPEGPLAYER_FILE_UTIL_H
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/error.h"
+}
+
+// FNV-1a of a URL in hex, short and safe to use as a file name
+inline std::string url_file_key(const std::string &url) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : url) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016" PRIx64, hash);
+    return key;
+}
+
+// mkdir -p; returns 0 or a negative AVERROR
+inline int make_directories(const std::string &path) {
+    for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+        std::string part = path.substr(0, slash);
+        if (mkdir(part.c_str(), 0700) < 0 && errno != EEXIST) {
+            return AVERROR(errno);
+        }
+        if (slash == std::string::npos) {
+            return 0;
+        }
+    }
+}
+
+// what tells one version of an input from the next: size, and the mtime of local files.
+// False for live input, which has neither.
+inline bool input_identity(const std::string &url, const AVFormatContext *format_context,
+                           int64_t *size, int64_t *mtime) {
+    bool local = url.find("://") == std::string::npos || url.compare(0, 5, "file:") == 0;
+    if (local) {
+        std::string path = url.compare(0, 5, "file:") == 0 ? url.substr(5) : url;
+        struct stat status;
+        if (stat(path.c_str(), &status) < 0) {
+            return false;
+        }
+        *size = status.st_size;
+        *mtime = status.st_mtime;
+        return true;
+    }
+    // through our own I/O as well as FFmpeg's, the size the server reported
+    *size = format_context->pb != nullptr ? avio_size(format_context->pb) : -1;
+    *mtime = 0;
+    return *size > 0;
+}
+
+#endif // FFMPEGPLAYER_FILE_UTIL_H
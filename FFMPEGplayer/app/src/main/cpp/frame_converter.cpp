@@ -0,0 +1,163 @@
+#include "frame_converter.h"
+
+#include <cmath>
+
+#include "log.h"
+#include "trace.h"
+
+extern "C" {
+#include "libavutil/pixdesc.h"
+}
+
+// a scaling pass has to cut at least this share of the pixels to beat the SIMD kernels at full size
+static const double MIN_SCALE_SAVING = 0.25;
+// at or below this ratio per side a downscale is large: several source pixels fold into each one
+static const double LARGE_DOWNSCALE = 0.5;
+
+void fit_output_size(int width, int height, AVRational sample_aspect_ratio,
+                     int surface_width, int surface_height, int *output_width, int *output_height) {
+    double display_width = width;
+    double display_height = height;
+    if (sample_aspect_ratio.num > 0 && sample_aspect_ratio.den > 0) {
+        // stretch the short side rather than squeeze the long one, no detail is thrown away
+        double ratio = av_q2d(sample_aspect_ratio);
+        if (ratio > 1) {
+            display_width *= ratio;
+        } else {
+            display_height /= ratio;
+        }
+    }
+    if (surface_width > 0 && surface_height > 0) {
+        double scale = FFMIN(surface_width / display_width, surface_height / display_height);
+        if (scale < 1) {
+            display_width *= scale;
+            display_height *= scale;
+        }
+    }
+    *output_width = FFMAX(1, (int) lrint(display_width));
+    *output_height = FFMAX(1, (int) lrint(display_height));
+    if (*output_width <= width && *output_height <= height
+        && (double) *output_width * *output_height > (1 - MIN_SCALE_SAVING) * width * height) {
+        *output_width = width;
+        *output_height = height;
+    }
+}
+
+int scale_filter(int src_width, int src_height, int dst_width, int dst_height) {
+    if (dst_width > src_width || dst_height > src_height) {
+        return SWS_BICUBIC;
+    }
+    double ratio = FFMAX((double) dst_width / src_width, (double) dst_height / src_height);
+    return ratio <= LARGE_DOWNSCALE ? SWS_AREA : SWS_BILINEAR;
+}
+
+const char *scale_filter_name(int flags) {
+    switch (flags) {
+        case SWS_FAST_BILINEAR:
+            return "fast bilinear";
+        case SWS_BILINEAR:
+            return "bilinear";
+        case SWS_BICUBIC:
+            return "bicubic";
+        case SWS_AREA:
+            return "area";
+        default:
+            return "other";
+    }
+}
+
+FrameConverter::FrameConverter(bool allow_simd)
+        : kernels_(allow_simd ? yuv2rgba_kernels_best() : yuv2rgba_kernels_c()),
+          allow_simd_(allow_simd) {
+}
+
+FrameConverter::~FrameConverter() {
+    for (ScaleContext &entry : contexts_) {
+        sws_freeContext(entry.context);
+    }
+}
+
+void FrameConverter::set_output_size(int width, int height) {
+    output_width_ = width;
+    output_height_ = height;
+}
+
+int FrameConverter::convert(const AVFrame *frame, uint8_t *rgba, int linesize) {
+    int width = output_width_ > 0 ? output_width_ : frame->width;
+    int height = output_height_ > 0 ? output_height_ : frame->height;
+    bool scaled = width != frame->width || height != frame->height;
+    if (!scaled && allow_simd_ && yuv2rgba_supported((AVPixelFormat) frame->format)) {
+        simd_frames_++;
+        TraceScope trace("yuv2rgba", frame->pts);
+        return yuv2rgba_convert(kernels_, frame, rgba, linesize);
+    }
+    SwsContext *sws_context = scale_context(frame, width, height);
+    if (sws_context == nullptr) {
+        return AVERROR(EINVAL);
+    }
+    uint8_t *data[4] = {rgba, nullptr, nullptr, nullptr};
+    int linesizes[4] = {linesize, 0, 0, 0};
+    // data format transform
+    int result;
+    {
+        TraceScope trace("sws_scale", frame->pts);
+        result = sws_scale(
+                sws_context,
+                (const uint8_t *const *) frame->data, frame->linesize,
+                0, frame->height,
+                data, linesizes);
+    }
+    if (result <= 0) {
+        LOGE("Player Error : data convert fail");
+        return AVERROR(EINVAL);
+    }
+    sws_frames_++;
+    return 0;
+}
+
+SwsContext *FrameConverter::scale_context(const AVFrame *frame, int width, int height) {
+    use_count_++;
+    int flags = fast_filter_ ? SWS_FAST_BILINEAR : scale_filter(frame->width, frame->height, width, height);
+    YuvMatrix matrix = yuv2rgba_frame_matrix(frame);
+    bool full_range = yuv2rgba_full_range(frame);
+    ScaleContext *oldest = &contexts_[0];
+    for (ScaleContext &entry : contexts_) {
+        if (entry.context != nullptr && entry.src_width == frame->width && entry.src_height == frame->height
+            && entry.src_format == frame->format && entry.dst_width == width && entry.dst_height == height
+            && entry.flags == flags && entry.matrix == matrix && entry.full_range == full_range) {
+            entry.last_use = use_count_;
+            return entry.context;
+        }
+        if (entry.last_use < oldest->last_use) {
+            oldest = &entry;
+        }
+    }
+    // Data format context transform
+    SwsContext *context = sws_getContext(
+            frame->width, frame->height, (AVPixelFormat) frame->format,
+            width, height, AV_PIX_FMT_RGBA,
+            flags, nullptr, nullptr, nullptr);
+    if (context == nullptr) {
+        LOGE("Player Error : Can not create convert context");
+        return nullptr;
+    }
+    // swscale's own default is BT.601 whatever the size; follow the SIMD kernels instead
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    if (descriptor != nullptr && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB)) {
+        const int *coefficients = sws_getCoefficients(matrix == YUV_MATRIX_BT709 ? SWS_CS_ITU709 : SWS_CS_ITU601);
+        sws_setColorspaceDetails(context, coefficients, full_range ? 1 : 0, sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+    }
+    sws_freeContext(oldest->context);
+    oldest->context = context;
+    oldest->src_width = frame->width;
+    oldest->src_height = frame->height;
+    oldest->src_format = frame->format;
+    oldest->dst_width = width;
+    oldest->dst_height = height;
+    oldest->flags = flags;
+    oldest->matrix = matrix;
+    oldest->full_range = full_range;
+    oldest->last_use = use_count_;
+    contexts_created_++;
+    return context;
+}
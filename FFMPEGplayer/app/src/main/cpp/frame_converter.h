@@ -0,0 +1,85 @@
+#ifndef FFMPEGPLAYER_FRAME_CONVERTER_H
+#define FFMPEGPLAYER_FRAME_CONVERTER_H
+
+#include <cstdint>
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+
+#include "yuv2rgba.h"
+
+// the size to convert a width x height picture to for a surface_width x surface_height surface:
+// stretched to square pixels by the sample aspect ratio, then shrunk to fit the surface with the
+// aspect ratio kept. It is never upscaled to fill the surface, the compositor does that for free.
+// A surface size of 0 only corrects the aspect ratio.
+void fit_output_size(int width, int height, AVRational sample_aspect_ratio,
+                     int surface_width, int surface_height, int *output_width, int *output_height);
+
+// swscale filter for a src -> dst conversion, chosen by the scale ratio: area averaging for large
+// downscales, bilinear for mild ones, bicubic only when upscaling
+int scale_filter(int src_width, int src_height, int dst_width, int dst_height);
+const char *scale_filter_name(int flags);
+
+/**
+ * Decoded frame -> RGBA, at the frame's size or scaled to an output size in the same pass.
+ * Unscaled 4:2:0 sources go through the SIMD kernels picked for this CPU, everything else
+ * through swscale. The swscale contexts are kept per source size and format, a few of them,
+ * so a stream that switches resolution or pixel format mid-way costs one lookup per frame and
+ * a new context only the first time a format shows up.
+ */
+class FrameConverter {
+public:
+    explicit FrameConverter(bool allow_simd = true);
+    ~FrameConverter();
+
+    // convert to this size instead of the frame's; 0 keeps the frame's size
+    void set_output_size(int width, int height);
+
+    // swscale with its fast bilinear filter whatever the scale ratio, cheaper and blurrier
+    void set_fast_filter(bool fast) { fast_filter_ = fast; }
+
+    // convert into an RGBA buffer of the output size, returns 0 or a negative AVERROR
+    int convert(const AVFrame *frame, uint8_t *rgba, int linesize);
+
+    // kernel set used for SIMD conversion, "c" when SIMD is disabled
+    const char *kernels_name() const { return kernels_->name; }
+
+    int64_t simd_frames() const { return simd_frames_; }
+    int64_t sws_frames() const { return sws_frames_; }
+    // swscale contexts created, the first one included
+    int64_t contexts_created() const { return contexts_created_; }
+
+private:
+    // one swscale context and the conversion it was made for
+    struct ScaleContext {
+        SwsContext *context = nullptr;
+        int src_width = 0;
+        int src_height = 0;
+        int src_format = AV_PIX_FMT_NONE;
+        int dst_width = 0;
+        int dst_height = 0;
+        int flags = 0;
+        int matrix = YUV_MATRIX_BT601;
+        bool full_range = false;
+        // use_count_ when it was last used, the oldest goes first
+        int64_t last_use = 0;
+    };
+    static const int CONTEXT_COUNT = 4;
+
+    SwsContext *scale_context(const AVFrame *frame, int width, int height);
+
+    const Yuv2RgbaKernels *kernels_;
+    bool allow_simd_;
+    int output_width_ = 0;
+    int output_height_ = 0;
+    bool fast_filter_ = false;
+    ScaleContext contexts_[CONTEXT_COUNT];
+    int64_t use_count_ = 0;
+    int64_t contexts_created_ = 0;
+    int64_t simd_frames_ = 0;
+    int64_t sws_frames_ = 0;
+};
+
+#endif // FFMPEGPLAYER_FRAME_CONVERTER_H
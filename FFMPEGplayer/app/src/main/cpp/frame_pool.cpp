@@ -0,0 +1,163 @@
+#include "frame_pool.h"
+
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+}
+
+#include "alloc_counter.h"
+#include "log.h"
+
+// buffers start on a page, rows on a cache line
+static const size_t PAGE_SIZE_BYTES = 4096;
+static const int ROW_ALIGNMENT = 64;
+// codecs may read a little past the end of a plane with their SIMD loads
+static const size_t PLANE_PADDING = 64;
+
+FramePool::~FramePool() {
+    reset();
+}
+
+void FramePool::attach(AVCodecContext *codec_context) {
+    codec_context->opaque = this;
+    codec_context->get_buffer2 = &FramePool::get_buffer2;
+}
+
+FramePoolStats FramePool::stats() const {
+    FramePoolStats stats;
+    stats.misses = misses_.load();
+    stats.hits = requests_.load() - stats.misses;
+    stats.fallbacks = fallbacks_.load();
+    stats.bytes = bytes_.load();
+    stats.peak_bytes = peak_bytes_.load();
+    return stats;
+}
+
+int FramePool::get_buffer2(AVCodecContext *codec_context, AVFrame *frame, int flags) {
+    return static_cast<FramePool *>(codec_context->opaque)->get_buffer(codec_context, frame, flags);
+}
+
+// what release() needs to account for a buffer; only made when the pool grows
+struct PoolAllocation {
+    FramePool *pool;
+    size_t size;
+};
+
+AVBufferRef *FramePool::allocate(void *opaque, size_t size) {
+    FramePool *pool = static_cast<FramePool *>(opaque);
+    void *data = nullptr;
+    PoolAllocation *allocation = nullptr;
+    {
+        // a miss is the pool's allocation, not FFmpeg's, even though it runs under get_buffer2
+        PlayerCode player_code;
+        if (posix_memalign(&data, PAGE_SIZE_BYTES, size) != 0) {
+            return nullptr;
+        }
+        // fault every page in now rather than in the middle of decoding a frame
+        memset(data, 0, size);
+        allocation = new PoolAllocation{pool, size};
+    }
+    AVBufferRef *buffer = av_buffer_create(static_cast<uint8_t *>(data), size, &FramePool::release, allocation, 0);
+    if (buffer == nullptr) {
+        delete allocation;
+        free(data);
+        return nullptr;
+    }
+    pool->misses_++;
+    int64_t bytes = pool->bytes_ += (int64_t) size;
+    int64_t peak = pool->peak_bytes_.load();
+    while (bytes > peak && !pool->peak_bytes_.compare_exchange_weak(peak, bytes)) {
+    }
+    return buffer;
+}
+
+// called when a pool itself lets go of a buffer, once the pool is uninitialized
+void FramePool::release(void *opaque, uint8_t *data) {
+    PoolAllocation *allocation = static_cast<PoolAllocation *>(opaque);
+    allocation->pool->bytes_ -= (int64_t) allocation->size;
+    delete allocation;
+    free(data);
+}
+
+void FramePool::reset() {
+    for (AVBufferPool *&pool : pools_) {
+        // frees the pool once its last buffer is back
+        av_buffer_pool_uninit(&pool);
+    }
+    memset(linesizes_, 0, sizeof(linesizes_));
+    format_ = AV_PIX_FMT_NONE;
+    width_ = 0;
+    height_ = 0;
+}
+
+int FramePool::configure(AVCodecContext *codec_context, const AVFrame *frame) {
+    reset();
+    AVPixelFormat format = (AVPixelFormat) frame->format;
+    int width = frame->width;
+    int height = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    // the codec's own padding: macroblock multiples and edge emulation
+    avcodec_align_dimensions2(codec_context, &width, &height, linesize_align);
+    int result = av_image_fill_linesizes(linesizes_, format, width);
+    if (result < 0) {
+        return result;
+    }
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; i++) {
+        linesizes_[i] = FFALIGN(linesizes_[i], ROW_ALIGNMENT);
+        linesizes[i] = linesizes_[i];
+    }
+    size_t sizes[4];
+    result = av_image_fill_plane_sizes(sizes, format, height, linesizes);
+    if (result < 0) {
+        return result;
+    }
+    for (int i = 0; i < 4 && sizes[i] > 0; i++) {
+        pools_[i] = av_buffer_pool_init2(sizes[i] + PLANE_PADDING, this, &FramePool::allocate, nullptr);
+        if (pools_[i] == nullptr) {
+            reset();
+            return AVERROR(ENOMEM);
+        }
+    }
+    format_ = format;
+    width_ = frame->width;
+    height_ = frame->height;
+    char name[32];
+    LOGI("Player : frame pool %dx%d %s, %d bytes per row", width_, height_,
+         av_get_pix_fmt_string(name, sizeof(name), format_), linesizes_[0]);
+    return 0;
+}
+
+int FramePool::get_buffer(AVCodecContext *codec_context, AVFrame *frame, int flags) {
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    if (codec_context->codec_type != AVMEDIA_TYPE_VIDEO || !(codec_context->codec->capabilities & AV_CODEC_CAP_DR1)
+        || descriptor == nullptr || (descriptor->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+        fallbacks_++;
+        return avcodec_default_get_buffer2(codec_context, frame, flags);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frame->format != format_ || frame->width != width_ || frame->height != height_) {
+        int result = configure(codec_context, frame);
+        if (result < 0) {
+            fallbacks_++;
+            return avcodec_default_get_buffer2(codec_context, frame, flags);
+        }
+    }
+    for (int i = 0; i < 4 && pools_[i] != nullptr; i++) {
+        requests_++;
+        frame->buf[i] = av_buffer_pool_get(pools_[i]);
+        if (frame->buf[i] == nullptr) {
+            for (int j = 0; j < i; j++) {
+                av_buffer_unref(&frame->buf[j]);
+            }
+            return AVERROR(ENOMEM);
+        }
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = linesizes_[i];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef FFMPEGPLAYER_FRAME_POOL_H
+#define FFMPEGPLAYER_FRAME_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/buffer.h"
+}
+
+struct FramePoolStats {
+    // buffers handed out from the pool, and ones it had to allocate first
+    int64_t hits = 0;
+    int64_t misses = 0;
+    // frames the codec could not take from the pool (no DR1, hardware formats)
+    int64_t fallbacks = 0;
+    // allocated by the pool right now and at most
+    int64_t bytes = 0;
+    int64_t peak_bytes = 0;
+};
+
+/**
+ * Decoded frame memory for one video decoder, plugged in as its get_buffer2. Each plane comes
+ * from an AVBufferPool sized to the stream: page aligned, every row on a cache line, and
+ * written once when allocated so the pages are mapped before the decoder first touches them.
+ * A buffer goes back to its pool when the last frame referencing it is freed, so once the
+ * decoder and the queues behind it hold their fill, playback allocates nothing. A change of
+ * size or format mid-stream starts new pools; the old ones go away with their last buffer.
+ * Must outlive the codec context and every frame it decoded.
+ */
+class FramePool {
+public:
+    FramePool() = default;
+    ~FramePool();
+
+    // install on a codec context before avcodec_open2
+    void attach(AVCodecContext *codec_context);
+
+    FramePoolStats stats() const;
+
+private:
+    static int get_buffer2(AVCodecContext *codec_context, AVFrame *frame, int flags);
+    static AVBufferRef *allocate(void *opaque, size_t size);
+    static void release(void *opaque, uint8_t *data);
+    int get_buffer(AVCodecContext *codec_context, AVFrame *frame, int flags);
+    int configure(AVCodecContext *codec_context, const AVFrame *frame);
+    void reset();
+
+    // decoder threads ask for buffers concurrently
+    std::mutex mutex_;
+    AVPixelFormat format_ = AV_PIX_FMT_NONE;
+    int width_ = 0;
+    int height_ = 0;
+    int linesizes_[4] = {0};
+    AVBufferPool *pools_[4] = {nullptr};
+
+    std::atomic<int64_t> requests_{0};
+    std::atomic<int64_t> misses_{0};
+    std::atomic<int64_t> fallbacks_{0};
+    std::atomic<int64_t> bytes_{0};
+    std::atomic<int64_t> peak_bytes_{0};
+};
+
+#endif // FFMPEGPLAYER_FRAME_POOL_H
@@ -0,0 +1,98 @@
+#include "frame_rate_cap.h"
+
+// media time one measurement covers
+static const int64_t WINDOW_US = 1000000;
+// the stream has to be this much faster than the cap before anything is dropped, so timestamp
+// jitter on a stream right at the cap does not thin it
+static const double ACTIVE_MARGIN = 1.1;
+// NONREF is taken back when it leaves fewer frames than this share of the cap
+static const double NONREF_MIN_SHARE = 0.9;
+// weight of the latest uncapped window in the uncapped load
+static const double LOAD_WEIGHT = 0.25;
+
+bool FrameDecimator::admit(int64_t media_us, double rate) {
+    if (rate <= 0 || media_us == AV_NOPTS_VALUE) {
+        return true;
+    }
+    int64_t interval_us = (int64_t) (1e6 / rate);
+    // timestamps rounded to the time base land a little before their slot
+    int64_t tolerance_us = interval_us / 8;
+    if (next_us_ != AV_NOPTS_VALUE && media_us < next_us_ - tolerance_us) {
+        if (media_us >= next_us_ - 2 * interval_us) {
+            return false;
+        }
+        // went back further than a frame could: a new timeline
+        next_us_ = AV_NOPTS_VALUE;
+    }
+    // far behind the grid (a gap in the stream) it starts over from this frame
+    if (next_us_ == AV_NOPTS_VALUE || media_us - next_us_ > interval_us) {
+        next_us_ = media_us;
+    }
+    next_us_ += interval_us;
+    return true;
+}
+
+void FrameRateCap::set_max_rate(double rate) {
+    max_rate_ = rate > 0 ? rate : 0;
+    stats_.max_rate = max_rate_;
+    nonref_blocked_ = false;
+    activate();
+}
+
+bool FrameRateCap::packet(int64_t media_us, int64_t cpu_us) {
+    if (media_us == AV_NOPTS_VALUE) {
+        return true;
+    }
+    if (window_open_ && media_us >= window_start_us_ && media_us - window_start_us_ >= WINDOW_US) {
+        end_window(media_us - window_start_us_, cpu_us);
+        window_open_ = false;
+    }
+    if (!window_open_ || media_us < window_start_us_) {
+        window_open_ = true;
+        window_nonref_ = nonref_;
+        window_start_us_ = media_us;
+        window_cpu_us_ = cpu_us;
+        window_packets_ = 0;
+        window_frames_ = 0;
+    }
+    window_packets_++;
+    if (intra_only_ && !decimator_.admit(media_us, active_rate_)) {
+        stats_.dropped_packets++;
+        return false;
+    }
+    return true;
+}
+
+void FrameRateCap::reset() {
+    window_open_ = false;
+    decimator_.reset();
+}
+
+void FrameRateCap::end_window(int64_t span_us, int64_t cpu_us) {
+    double load = (cpu_us - window_cpu_us_) / (double) span_us;
+    double output_rate = window_frames_ * 1e6 / span_us;
+    stats_.source_rate = window_packets_ * 1e6 / span_us;
+    if (active_rate_ > 0) {
+        stats_.capped_us += span_us;
+        if (uncapped_load_ >= 0 && load < uncapped_load_) {
+            stats_.saved_us += (int64_t) ((uncapped_load_ - load) * span_us);
+        }
+    } else {
+        uncapped_load_ = uncapped_load_ < 0 ? load : uncapped_load_ + LOAD_WEIGHT * (load - uncapped_load_);
+    }
+    if (window_nonref_ && nonref_) {
+        // frames still in the decoder's threads even out over the windows
+        stats_.discarded_frames += window_packets_ > window_frames_ ? window_packets_ - window_frames_ : 0;
+        if (output_rate < max_rate_ * NONREF_MIN_SHARE) {
+            nonref_blocked_ = true;
+        }
+    }
+    activate();
+}
+
+void FrameRateCap::activate() {
+    bool above = max_rate_ > 0 && stats_.source_rate > max_rate_ * ACTIVE_MARGIN;
+    active_rate_ = above ? max_rate_ : 0;
+    nonref_ = above && !intra_only_ && !nonref_blocked_;
+    stats_.nonref = nonref_;
+}
@@ -0,0 +1,109 @@
+#ifndef FFMPEGPLAYER_FRAME_RATE_CAP_H
+#define FFMPEGPLAYER_FRAME_RATE_CAP_H
+
+#include <cstdint>
+
+extern "C" {
+#include "libavutil/avutil.h"
+}
+
+/**
+ * Thins a stream of timestamps out to a rate: a frame is kept when it reaches the next slot
+ * of a grid spaced 1 / rate apart, so 60 fps goes to 30 by keeping every other frame and
+ * 50 fps to 30 by keeping three frames out of five, evenly spread.
+ */
+class FrameDecimator {
+public:
+    // true when the frame at media_us is shown at no more than rate frames a second;
+    // a rate of 0 keeps everything
+    bool admit(int64_t media_us, double rate);
+    // the timeline jumped: the next frame is kept and starts the grid over
+    void reset() { next_us_ = AV_NOPTS_VALUE; }
+
+private:
+    int64_t next_us_ = AV_NOPTS_VALUE;
+};
+
+struct FrameRateCapStats {
+    // the cap last set, 0 for none
+    double max_rate = 0;
+    // the stream's own frame rate, from the packets of the last window
+    double source_rate = 0;
+    // the decoder leaves out non-reference frames right now
+    bool nonref = false;
+    // frames the decoder left out with AVDISCARD_NONREF, packets of intra-only streams that
+    // were never decoded, and decoded frames dropped before conversion
+    int64_t discarded_frames = 0;
+    int64_t dropped_packets = 0;
+    int64_t dropped_frames = 0;
+    // media time played with the cap below the stream's rate, and the process CPU time it saved
+    // against the CPU time per second of media measured while it was not
+    int64_t capped_us = 0;
+    int64_t saved_us = 0;
+
+    int64_t saved_us_per_minute() const {
+        return capped_us > 0 ? (int64_t) (saved_us * 60e6 / capped_us) : 0;
+    }
+};
+
+/**
+ * Caps the frame rate shown, to save CPU rather than to keep up: 60 fps content shown at 30
+ * on battery. Lives on the decode thread and sees every packet before it is decoded, which
+ * gives the stream's rate over windows of media time. Once that is above the cap the cap
+ * becomes active:
+ *  - intra-only streams (MJPEG, ProRes and the like) lose the excess packets before decoding,
+ *    any packet decodes on its own;
+ *  - other decoders are set to AVDISCARD_NONREF, which skips B-frames nothing refers to at
+ *    no cost beyond parsing. When that leaves fewer frames than the cap (IBBP thins 60 fps to
+ *    20) it is taken back until the cap changes;
+ *  - whatever is still above the cap the stage that converts drops before sws_scale, through
+ *    a FrameDecimator at active_rate().
+ * The process CPU time per second of media is tracked in windows where the cap is inactive;
+ * capped windows are measured against it for the CPU saved.
+ */
+class FrameRateCap {
+public:
+    explicit FrameRateCap(bool intra_only) : intra_only_(intra_only) {}
+
+    // 0 lifts the cap; takes effect right away when the stream's rate is known
+    void set_max_rate(double rate);
+    double max_rate() const { return max_rate_; }
+
+    // a packet at media_us is about to be sent to the decoder, cpu_us is the process CPU time
+    // now; false when the packet is to be dropped instead
+    bool packet(int64_t media_us, int64_t cpu_us);
+    // a frame came out of the decoder
+    void frame() { window_frames_++; }
+    // the timeline jumped (seek): the next packet opens a new window, what was learned stays
+    void reset();
+
+    // the rate frames are to be thinned out to before conversion, 0 for all of them
+    double active_rate() const { return active_rate_; }
+    // the decoder is to discard non-reference frames
+    bool nonref() const { return nonref_; }
+    const FrameRateCapStats &stats() const { return stats_; }
+
+private:
+    void end_window(int64_t span_us, int64_t cpu_us);
+    void activate();
+
+    bool intra_only_;
+    double max_rate_ = 0;
+    double active_rate_ = 0;
+    bool nonref_ = false;
+    // NONREF thinned the stream below the cap, not tried again until the cap changes
+    bool nonref_blocked_ = false;
+    FrameDecimator decimator_;
+    bool window_open_ = false;
+    // the whole window was decoded with NONREF
+    bool window_nonref_ = false;
+    int64_t window_start_us_ = 0;
+    int64_t window_cpu_us_ = 0;
+    int64_t window_packets_ = 0;
+    int64_t window_frames_ = 0;
+    // process CPU time per media time while uncapped, -1 until measured
+    double uncapped_load_ = -1;
+    FrameRateCapStats stats_;
+};
+
+#endif // FFMPEGPLAYER_FRAME_RATE_CAP_H
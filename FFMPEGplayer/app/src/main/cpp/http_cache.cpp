@@ -0,0 +1,436 @@
+#include "http_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+}
+
+#include "file_util.h"
+#include "log.h"
+
+// the index is rewritten after this many new bytes, so a crash loses little
+static const int64_t SAVE_INTERVAL_BYTES = 4 * 1024 * 1024;
+// and the size limit checked after this many
+static const int64_t TRIM_INTERVAL_BYTES = 8 * 1024 * 1024;
+
+void IntervalSet::add(int64_t start, int64_t end) {
+    if (start >= end) {
+        return;
+    }
+    auto it = ranges_.upper_bound(start);
+    if (it != ranges_.begin()) {
+        auto previous = std::prev(it);
+        if (previous->second >= start) {
+            start = previous->first;
+            end = FFMAX(end, previous->second);
+            total_ -= previous->second - previous->first;
+            ranges_.erase(previous);
+        }
+    }
+    // swallow every range the new one overlaps or touches
+    while (it != ranges_.end() && it->first <= end) {
+        end = FFMAX(end, it->second);
+        total_ -= it->second - it->first;
+        it = ranges_.erase(it);
+    }
+    ranges_[start] = end;
+    total_ += end - start;
+}
+
+int64_t IntervalSet::covered_until(int64_t position) const {
+    auto it = ranges_.upper_bound(position);
+    if (it == ranges_.begin()) {
+        return position;
+    }
+    --it;
+    return it->second > position ? it->second : position;
+}
+
+int64_t IntervalSet::next_start(int64_t position) const {
+    auto it = ranges_.upper_bound(position);
+    return it == ranges_.end() ? INT64_MAX : it->first;
+}
+
+void IntervalSet::clear() {
+    ranges_.clear();
+    total_ = 0;
+}
+
+HttpCache::HttpCache(const HttpCacheOptions &options) : options_(options) {}
+
+HttpCache::~HttpCache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &item : entries_) {
+        HttpCacheEntry *entry = item.second.get();
+        std::lock_guard<std::mutex> entry_lock(entry->mutex);
+        if (entry->unsaved_bytes > 0) {
+            save_index(entry);
+        }
+        if (entry->fd >= 0) {
+            close(entry->fd);
+            entry->fd = -1;
+        }
+    }
+}
+
+int HttpCache::open() {
+    int result = make_directories(options_.directory);
+    if (result < 0) {
+        LOGE("Player Error : Can not create cache directory %s", options_.directory.c_str());
+        return result;
+    }
+    DIR *directory = opendir(options_.directory.c_str());
+    if (directory == nullptr) {
+        return AVERROR(errno);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (dirent *file = readdir(directory)) {
+        std::string name = file->d_name;
+        if (name.size() > 6 && name.compare(name.size() - 6, 6, ".index") == 0) {
+            load_entry(options_.directory + "/" + name);
+        }
+    }
+    closedir(directory);
+    trim();
+    LOGI("Player : http cache %s, %d entries", options_.directory.c_str(), (int) entries_.size());
+    return 0;
+}
+
+void HttpCache::load_entry(const std::string &index_path) {
+    FILE *index = fopen(index_path.c_str(), "r");
+    if (index == nullptr) {
+        return;
+    }
+    std::shared_ptr<HttpCacheEntry> entry(new HttpCacheEntry());
+    entry->index_path = index_path;
+    entry->data_path = index_path.substr(0, index_path.size() - 6) + ".data";
+    char line[4096];
+    long long size = -1;
+    long long last_used = 0;
+    bool valid = fgets(line, sizeof(line), index) != nullptr;
+    if (valid) {
+        line[strcspn(line, "\n")] = 0;
+        entry->url = line;
+        valid = fscanf(index, "%lld %lld", &size, &last_used) == 2;
+    }
+    // ranges past the end of the data file did not make it to disk
+    struct stat data;
+    valid = valid && stat(entry->data_path.c_str(), &data) == 0;
+    long long start;
+    long long end;
+    while (valid && fscanf(index, "%lld %lld", &start, &end) == 2) {
+        entry->ranges.add(start, FFMIN(end, (long long) data.st_size));
+    }
+    fclose(index);
+    std::string key = url_file_key(entry->url);
+    if (!valid || entry->data_path != options_.directory + "/" + key + ".data") {
+        unlink(index_path.c_str());
+        unlink(entry->data_path.c_str());
+        return;
+    }
+    entry->size = size;
+    entry->last_used = last_used;
+    entries_[key] = entry;
+}
+
+void HttpCache::save_index(HttpCacheEntry *entry) {
+    // written aside and renamed over, the index on disk is always a complete one
+    std::string temporary = entry->index_path + ".tmp";
+    FILE *index = fopen(temporary.c_str(), "w");
+    if (index == nullptr) {
+        return;
+    }
+    fprintf(index, "%s\n%lld %lld\n", entry->url.c_str(), (long long) entry->size, (long long) entry->last_used);
+    for (const auto &range : entry->ranges.ranges()) {
+        fprintf(index, "%lld %lld\n", (long long) range.first, (long long) range.second);
+    }
+    if (fclose(index) == 0) {
+        rename(temporary.c_str(), entry->index_path.c_str());
+    }
+    entry->unsaved_bytes = 0;
+}
+
+std::shared_ptr<HttpCacheEntry> HttpCache::acquire(const std::string &url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = url_file_key(url);
+    std::shared_ptr<HttpCacheEntry> &entry = entries_[key];
+    if (entry && entry->url != url) {
+        // hash collision: the older URL loses its entry, unless it is being played
+        if (entry.use_count() > 1) {
+            return nullptr;
+        }
+        if (entry->fd >= 0) {
+            close(entry->fd);
+        }
+        unlink(entry->data_path.c_str());
+        entry.reset();
+    }
+    if (!entry) {
+        entry.reset(new HttpCacheEntry());
+        entry->url = url;
+        entry->data_path = options_.directory + "/" + key + ".data";
+        entry->index_path = options_.directory + "/" + key + ".index";
+    }
+    if (entry->fd < 0) {
+        entry->fd = ::open(entry->data_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (entry->fd < 0) {
+            LOGE("Player Error : Can not open cache file %s", entry->data_path.c_str());
+            entries_.erase(key);
+            return nullptr;
+        }
+    }
+    entry->last_used = time(nullptr);
+    std::shared_ptr<HttpCacheEntry> acquired = entry;
+    trim();
+    return acquired;
+}
+
+void HttpCache::release(const std::shared_ptr<HttpCacheEntry> &entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry->last_used = time(nullptr);
+    std::lock_guard<std::mutex> entry_lock(entry->mutex);
+    save_index(entry.get());
+}
+
+void HttpCache::validate(HttpCacheEntry *entry, int64_t size) {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->size == size) {
+        return;
+    }
+    if (entry->ranges.total() > 0) {
+        LOGI("Player : %s changed size on the server, dropping its cached bytes", entry->url.c_str());
+        entry->ranges.clear();
+        if (ftruncate(entry->fd, 0) < 0) {
+            LOGE("Player Error : Can not truncate cache file %s", entry->data_path.c_str());
+        }
+    }
+    entry->size = size;
+    save_index(entry);
+}
+
+void HttpCache::stored(HttpCacheEntry *entry, int64_t position, int64_t bytes) {
+    network_bytes_ += bytes;
+    {
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        entry->ranges.add(position, position + bytes);
+        entry->unsaved_bytes += bytes;
+        if (entry->unsaved_bytes >= SAVE_INTERVAL_BYTES) {
+            save_index(entry);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_since_trim_ += bytes;
+    if (written_since_trim_ >= TRIM_INTERVAL_BYTES) {
+        written_since_trim_ = 0;
+        trim();
+    }
+}
+
+void HttpCache::trim() {
+    int64_t total = 0;
+    for (auto &item : entries_) {
+        std::lock_guard<std::mutex> lock(item.second->mutex);
+        total += item.second->ranges.total();
+    }
+    while (total > options_.max_bytes) {
+        // the least recently used entry nobody is reading
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.use_count() == 1 && (victim == entries_.end() || it->second->last_used < victim->second->last_used)) {
+                victim = it;
+            }
+        }
+        if (victim == entries_.end()) {
+            break;
+        }
+        HttpCacheEntry *entry = victim->second.get();
+        if (entry->fd >= 0) {
+            close(entry->fd);
+        }
+        unlink(entry->data_path.c_str());
+        unlink(entry->index_path.c_str());
+        total -= entry->ranges.total();
+        entries_.erase(victim);
+        evictions_++;
+    }
+}
+
+HttpCacheStats HttpCache::stats() const {
+    HttpCacheStats stats;
+    stats.disk_bytes = disk_bytes_.load();
+    stats.network_bytes = network_bytes_.load();
+    stats.requests = requests_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.evictions = evictions_;
+    stats.entries = (int) entries_.size();
+    for (const auto &item : entries_) {
+        std::lock_guard<std::mutex> entry_lock(item.second->mutex);
+        stats.cached_bytes += item.second->ranges.total();
+    }
+    return stats;
+}
+
+CachedHttpSource::~CachedHttpSource() {
+    close_request();
+    if (entry_) {
+        cache_->release(entry_);
+    }
+    av_dict_free(&options_);
+}
+
+int CachedHttpSource::open(const char *url, AVDictionary **options) {
+    if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
+        return AVERROR(ENOSYS);
+    }
+    url_ = url;
+    if (options != nullptr) {
+        av_dict_copy(&options_, *options, 0);
+    }
+    entry_ = cache_->acquire(url_);
+    if (!entry_) {
+        return AVERROR(ENOSYS);
+    }
+    // the first request asks for the whole file: its Content-Range gives the size to check
+    // the entry against, and its body is what a cold start reads next anyway
+    int result = open_request(0, -1);
+    if (result >= 0) {
+        size_ = request_->size();
+        if (size_ <= 0 || !request_->seekable()) {
+            // live or chunked, nothing to key ranges on
+            close_request();
+            cache_->release(entry_);
+            entry_.reset();
+            return AVERROR(ENOSYS);
+        }
+        cache_->validate(entry_.get(), size_);
+        return 0;
+    }
+    if (result == AVERROR_EXIT) {
+        return result;
+    }
+    // offline, still fine when every byte is on disk
+    std::lock_guard<std::mutex> lock(entry_->mutex);
+    if (entry_->size > 0 && entry_->ranges.covered_until(0) >= entry_->size) {
+        LOGI("Player : %s unreachable, playing it from the cache", url);
+        size_ = entry_->size;
+        return 0;
+    }
+    return result;
+}
+
+int CachedHttpSource::read(uint8_t *buffer, int size) {
+    if (aborted_.load() || (interrupt_ != nullptr && interrupt_->load())) {
+        return AVERROR_EXIT;
+    }
+    if (position_ >= size_) {
+        return AVERROR_EOF;
+    }
+    int64_t covered_end;
+    int64_t next_start;
+    {
+        std::lock_guard<std::mutex> lock(entry_->mutex);
+        covered_end = entry_->ranges.covered_until(position_);
+        next_start = entry_->ranges.next_start(position_);
+    }
+    if (covered_end > position_) {
+        // a request that is not waiting at the end of this range would only fetch bytes on disk
+        if (request_ && request_position_ != covered_end) {
+            close_request();
+        }
+        int length = (int) FFMIN((int64_t) size, covered_end - position_);
+        ssize_t result = pread(entry_->fd, buffer, (size_t) length, position_);
+        if (result <= 0) {
+            return result < 0 ? AVERROR(errno) : AVERROR(EIO);
+        }
+        position_ += result;
+        cache_->served(result);
+        return (int) result;
+    }
+    // a gap, up to the next cached range or the end of the file
+    int64_t gap_end = FFMIN(next_start, size_);
+    if (!request_ || request_position_ != position_) {
+        close_request();
+        int result = open_request(position_, gap_end < size_ ? gap_end : -1);
+        if (result < 0) {
+            return result;
+        }
+    }
+    int length = (int) FFMIN((int64_t) size, gap_end - position_);
+    int result = request_->read(buffer, length);
+    if (result < 0) {
+        close_request();
+        return result;
+    }
+    // a failed write only means these bytes are fetched again next time
+    if (pwrite(entry_->fd, buffer, (size_t) result, position_) == result) {
+        cache_->stored(entry_.get(), position_, result);
+    }
+    position_ += result;
+    request_position_ += result;
+    return result;
+}
+
+int64_t CachedHttpSource::seek(int64_t position) {
+    if (position < 0 || position > size_) {
+        return AVERROR(EINVAL);
+    }
+    // the next read decides between disk and a new request
+    position_ = position;
+    return position;
+}
+
+void CachedHttpSource::abort() {
+    std::lock_guard<std::mutex> lock(request_mutex_);
+    aborted_.store(true);
+    if (request_) {
+        request_->abort();
+    }
+}
+
+int CachedHttpSource::open_request(int64_t position, int64_t end) {
+    std::unique_ptr<ProtocolSource> request(new ProtocolSource(interrupt_));
+    ProtocolSource *opening = request.get();
+    {
+        // published before connecting, so abort() reaches a connect that hangs
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        if (aborted_.load()) {
+            return AVERROR_EXIT;
+        }
+        request_ = std::move(request);
+    }
+    AVDictionary *options = nullptr;
+    av_dict_copy(&options, options_, 0);
+    // options of FFmpeg's http protocol, sent as Range: bytes=position-(end - 1)
+    av_dict_set_int(&options, "offset", position, 0);
+    if (end >= 0) {
+        av_dict_set_int(&options, "end_offset", end, 0);
+    }
+    cache_->requested();
+    int result = opening->open(url_.c_str(), &options);
+    av_dict_free(&options);
+    if (result < 0) {
+        close_request();
+        return result;
+    }
+    request_position_ = position;
+    return 0;
+}
+
+void CachedHttpSource::close_request() {
+    std::unique_ptr<ProtocolSource> request;
+    {
+        std::lock_guard<std::mutex> lock(request_mutex_);
+        request = std::move(request_);
+    }
+    // closing the connection happens outside the lock abort() takes
+}
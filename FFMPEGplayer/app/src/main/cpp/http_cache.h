@@ -0,0 +1,155 @@
+#ifndef FFMPEGPLAYER_HTTP_CACHE_H
+#define FFMPEGPLAYER_HTTP_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "byte_source.h"
+
+struct HttpCacheOptions {
+    // where entries are kept, created when missing
+    std::string directory;
+    // least recently used entries are deleted once the cached bytes pass this
+    int64_t max_bytes = 512LL * 1024 * 1024;
+};
+
+struct HttpCacheStats {
+    // bytes served from disk, and bytes fetched from the network and stored
+    int64_t disk_bytes = 0;
+    int64_t network_bytes = 0;
+    // range requests sent, probes included
+    int64_t requests = 0;
+    int64_t evictions = 0;
+    int64_t cached_bytes = 0;
+    int entries = 0;
+};
+
+// disjoint, non adjacent [start, end) byte ranges
+class IntervalSet {
+public:
+    void add(int64_t start, int64_t end);
+
+    // end of the range holding position, position itself when it is not covered
+    int64_t covered_until(int64_t position) const;
+
+    // start of the first range after position, INT64_MAX when there is none
+    int64_t next_start(int64_t position) const;
+
+    int64_t total() const { return total_; }
+
+    void clear();
+
+    const std::map<int64_t, int64_t> &ranges() const { return ranges_; }
+
+private:
+    std::map<int64_t, int64_t> ranges_;
+    int64_t total_ = 0;
+};
+
+// one URL on disk: a sparse data file at the URL's offsets and the ranges of it that are valid
+struct HttpCacheEntry {
+    std::string url;
+    std::string data_path;
+    std::string index_path;
+    int fd = -1;
+    // from Content-Range, a different size on the server means the file changed
+    int64_t size = -1;
+    // wall clock seconds, so the LRU order survives restarts; guarded by the cache's mutex
+    int64_t last_used = 0;
+    // guarded by mutex
+    IntervalSet ranges;
+    int64_t unsaved_bytes = 0;
+    std::mutex mutex;
+};
+
+/**
+ * Byte range cache for HTTP inputs that lives across sessions. What was downloaded once, even
+ * in pieces around seeks, is read back from disk; only the gaps go to the network, each as its
+ * own range request. Entries can be used by several sources at once; eviction skips them.
+ */
+class HttpCache {
+public:
+    explicit HttpCache(const HttpCacheOptions &options);
+    ~HttpCache();
+
+    // create the directory and pick up the entries of earlier sessions; returns 0 or a negative AVERROR
+    int open();
+
+    HttpCacheStats stats() const;
+
+private:
+    friend class CachedHttpSource;
+
+    std::shared_ptr<HttpCacheEntry> acquire(const std::string &url);
+    void release(const std::shared_ptr<HttpCacheEntry> &entry);
+    // the server reported size: an entry of another size is emptied
+    void validate(HttpCacheEntry *entry, int64_t size);
+    // bytes at position were written into the entry's data file
+    void stored(HttpCacheEntry *entry, int64_t position, int64_t bytes);
+    void served(int64_t bytes) { disk_bytes_ += bytes; }
+    void requested() { requests_++; }
+
+    void load_entry(const std::string &index_path);
+    // caller holds the entry's mutex
+    void save_index(HttpCacheEntry *entry);
+    // caller holds mutex_
+    void trim();
+
+    HttpCacheOptions options_;
+    mutable std::mutex mutex_;
+    // by hash of the URL, also the file names
+    std::map<std::string, std::shared_ptr<HttpCacheEntry>> entries_;
+    int64_t written_since_trim_ = 0;
+    std::atomic<int64_t> disk_bytes_{0};
+    std::atomic<int64_t> network_bytes_{0};
+    std::atomic<int64_t> requests_{0};
+    int64_t evictions_ = 0;
+};
+
+/**
+ * An http(s) URL read through the cache. Covered ranges come from disk, a gap is fetched with
+ * a range request that ends where the next cached range starts, and stored on the way through.
+ */
+class CachedHttpSource : public ByteSource {
+public:
+    // interrupt, when given, aborts this source too; it has to outlive it
+    explicit CachedHttpSource(HttpCache *cache, const std::atomic<bool> *interrupt = nullptr)
+            : cache_(cache), interrupt_(interrupt) {}
+    ~CachedHttpSource() override;
+
+    // AVERROR(ENOSYS) when the URL can not be cached: not http(s), no size or no range support.
+    // A fully cached URL also opens while the server is unreachable.
+    int open(const char *url, AVDictionary **options = nullptr);
+
+    int read(uint8_t *buffer, int size) override;
+    int64_t seek(int64_t position) override;
+    int64_t size() const override { return size_; }
+    bool seekable() const override { return true; }
+    void abort() override;
+
+private:
+    // a request for [position, end), end < 0 for up to the end of the file
+    int open_request(int64_t position, int64_t end);
+    void close_request();
+
+    HttpCache *cache_;
+    const std::atomic<bool> *interrupt_;
+    std::string url_;
+    AVDictionary *options_ = nullptr;
+    std::shared_ptr<HttpCacheEntry> entry_;
+    int64_t size_ = -1;
+    int64_t position_ = 0;
+
+    // request_ is replaced on the reading thread and aborted from any, under request_mutex_
+    std::mutex request_mutex_;
+    std::unique_ptr<ProtocolSource> request_;
+    std::atomic<bool> aborted_{false};
+    // where the open request will deliver its next byte
+    int64_t request_position_ = 0;
+};
+
+#endif // FFMPEGPLAYER_HTTP_CACHE_H
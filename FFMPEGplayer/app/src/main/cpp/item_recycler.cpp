@@ -0,0 +1,101 @@
+#include "item_recycler.h"
+
+#include <mutex>
+#include <vector>
+
+// enough for the packet queues of a few players at their default budgets
+static const size_t PACKET_SHELF_CAPACITY = 1024;
+// frames are held by the frame queue, the decoder's reorder delay and the staging frames
+static const size_t FRAME_SHELF_CAPACITY = 128;
+
+static void free_item(AVPacket **packet) {
+    av_packet_free(packet);
+}
+
+static void free_item(AVFrame **frame) {
+    av_frame_free(frame);
+}
+
+// blank items waiting to be reused; its storage is reserved up front so taking and giving
+// back never allocate
+template <typename T>
+class Shelf {
+public:
+    explicit Shelf(size_t capacity) : capacity_(capacity) {
+        items_.reserve(capacity);
+    }
+
+    ~Shelf() {
+        for (T *item : items_) {
+            free_item(&item);
+        }
+    }
+
+    T *take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) {
+            return nullptr;
+        }
+        T *item = items_.back();
+        items_.pop_back();
+        return item;
+    }
+
+    bool give(T *item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_) {
+            return false;
+        }
+        items_.push_back(item);
+        return true;
+    }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::vector<T *> items_;
+};
+
+static Shelf<AVPacket> &packet_shelf() {
+    static Shelf<AVPacket> shelf(PACKET_SHELF_CAPACITY);
+    return shelf;
+}
+
+static Shelf<AVFrame> &frame_shelf() {
+    static Shelf<AVFrame> shelf(FRAME_SHELF_CAPACITY);
+    return shelf;
+}
+
+AVPacket *media_packet_get() {
+    AVPacket *packet = packet_shelf().take();
+    return packet != nullptr ? packet : av_packet_alloc();
+}
+
+void media_packet_put(AVPacket **packet) {
+    if (*packet == nullptr) {
+        return;
+    }
+    // back to the defaults of a fresh packet, serial included
+    av_packet_unref(*packet);
+    if (!packet_shelf().give(*packet)) {
+        av_packet_free(packet);
+    }
+    *packet = nullptr;
+}
+
+AVFrame *media_frame_get() {
+    AVFrame *frame = frame_shelf().take();
+    return frame != nullptr ? frame : av_frame_alloc();
+}
+
+void media_frame_put(AVFrame **frame) {
+    if (*frame == nullptr) {
+        return;
+    }
+    // back to the defaults of a fresh frame: format -1, no serial; pooled buffers return to their pool
+    av_frame_unref(*frame);
+    if (!frame_shelf().give(*frame)) {
+        av_frame_free(frame);
+    }
+    *frame = nullptr;
+}
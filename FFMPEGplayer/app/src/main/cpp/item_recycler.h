@@ -0,0 +1,26 @@
+#ifndef FFMPEGPLAYER_ITEM_RECYCLER_H
+#define FFMPEGPLAYER_ITEM_RECYCLER_H
+
+extern "C" {
+#include "libavcodec/packet.h"
+#include "libavutil/frame.h"
+}
+
+// The AVPacket and AVFrame structs that travel through the queues are recycled instead of
+// being allocated for every packet and freed after every frame. Their payloads are not kept:
+// put() drops the references like av_packet_free/av_frame_free would, and the shell goes back
+// on a process-wide shelf for the next get(). Safe to call from any thread.
+
+// a blank packet, as from av_packet_alloc(); nullptr when out of memory
+AVPacket *media_packet_get();
+
+// unreferences the packet and keeps it for reuse, frees it once the shelf is full; sets *packet to nullptr
+void media_packet_put(AVPacket **packet);
+
+// a blank frame, as from av_frame_alloc(); nullptr when out of memory
+AVFrame *media_frame_get();
+
+// unreferences the frame and keeps it for reuse, frees it once the shelf is full; sets *frame to nullptr
+void media_frame_put(AVFrame **frame);
+
+#endif // FFMPEGPLAYER_ITEM_RECYCLER_H
@@ -0,0 +1,64 @@
+#include "keyframe_index.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// an hour at a keyframe a second before appending has to reallocate during playback
+static const size_t RESERVED_KEYFRAMES = 4096;
+
+static bool before(const KeyframeEntry &entry, int64_t timestamp) {
+    return entry.timestamp < timestamp;
+}
+
+// keeps the candidate closer to target
+static void consider(int64_t target, int64_t timestamp, int64_t position, bool *found, KeyframeEntry *best) {
+    if (timestamp == AV_NOPTS_VALUE) {
+        return;
+    }
+    if (!*found || llabs(timestamp - target) < llabs(best->timestamp - target)) {
+        best->timestamp = timestamp;
+        best->position = position;
+        *found = true;
+    }
+}
+
+KeyframeIndex::KeyframeIndex(AVStream *stream) : stream_(stream) {
+    entries_.reserve(RESERVED_KEYFRAMES);
+}
+
+void KeyframeIndex::add(int64_t timestamp, int64_t position) {
+    if (timestamp == AV_NOPTS_VALUE) {
+        return;
+    }
+    // packets mostly come in order, the append is the common case
+    if (entries_.empty() || entries_.back().timestamp < timestamp) {
+        entries_.push_back({timestamp, position});
+        return;
+    }
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), timestamp, before);
+    if (it == entries_.end() || it->timestamp != timestamp) {
+        entries_.insert(it, {timestamp, position});
+    }
+}
+
+bool KeyframeIndex::nearest(int64_t timestamp, KeyframeEntry *keyframe) const {
+    bool found = false;
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), timestamp, before);
+    if (it != entries_.end()) {
+        consider(timestamp, it->timestamp, it->position, &found, keyframe);
+    }
+    if (it != entries_.begin()) {
+        --it;
+        consider(timestamp, it->timestamp, it->position, &found, keyframe);
+    }
+    // the demuxer's index, when the container has one, also covers what was not played yet
+    int flags[] = {AVSEEK_FLAG_BACKWARD, 0};
+    for (int flag : flags) {
+        int index = av_index_search_timestamp(stream_, timestamp, flag);
+        const AVIndexEntry *entry = index >= 0 ? avformat_index_get_entry(stream_, index) : nullptr;
+        if (entry != nullptr && (entry->flags & AVINDEX_KEYFRAME)) {
+            consider(timestamp, entry->timestamp, entry->pos, &found, keyframe);
+        }
+    }
+    return found;
+}
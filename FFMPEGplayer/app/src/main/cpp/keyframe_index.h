@@ -0,0 +1,41 @@
+#ifndef FFMPEGPLAYER_KEYFRAME_INDEX_H
+#define FFMPEGPLAYER_KEYFRAME_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+struct KeyframeEntry {
+    // in the stream time base
+    int64_t timestamp;
+    int64_t position;
+};
+
+/**
+ * Keyframes of one stream, collected from the demuxer's own index and from the packets read
+ * so far, so a fast seek can land on the keyframe closest to the target, after it as well as
+ * before. Containers without an index (raw streams, MPEG-TS) fill in as playback goes.
+ * Used by the demux thread only.
+ */
+class KeyframeIndex {
+public:
+    explicit KeyframeIndex(AVStream *stream);
+
+    // a keyframe packet was demuxed; kept sorted, duplicates are ignored
+    void add(int64_t timestamp, int64_t position);
+
+    // the keyframe nearest to timestamp, from both this index and the demuxer's;
+    // false when neither knows one
+    bool nearest(int64_t timestamp, KeyframeEntry *keyframe) const;
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    AVStream *stream_;
+    std::vector<KeyframeEntry> entries_;
+};
+
+#endif // FFMPEGPLAYER_KEYFRAME_INDEX_H
@@ -0,0 +1,15 @@
+#ifndef FFMPEGPLAYER_LOG_H
+#define FFMPEGPLAYER_LOG_H
+
+// Android 打印 Log, falls back to stderr so the player core also runs headless on Linux
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(FORMAT,...) __android_log_print(ANDROID_LOG_ERROR, "player", FORMAT, ##__VA_ARGS__);
+#define LOGI(FORMAT,...) __android_log_print(ANDROID_LOG_INFO, "player", FORMAT, ##__VA_ARGS__);
+#else
+#include <cstdio>
+#define LOGE(FORMAT,...) fprintf(stderr, "player E: " FORMAT "\n", ##__VA_ARGS__);
+#define LOGI(FORMAT,...) fprintf(stderr, "player I: " FORMAT "\n", ##__VA_ARGS__);
+#endif
+
+#endif // FFMPEGPLAYER_LOG_H
@@ -0,0 +1,139 @@
+#ifndef FFMPEGPLAYER_MASTER_CLOCK_H
+#define FFMPEGPLAYER_MASTER_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+extern "C" {
+#include "libavutil/avutil.h"
+}
+
+#include "time_util.h"
+
+/**
+ * The timeline video frames are scheduled against, in media microseconds.
+ * Whoever owns playback position (wall clock, audio output, an external source) implements it.
+ */
+class MasterClock {
+public:
+    virtual ~MasterClock() {}
+
+    // current media time, AV_NOPTS_VALUE while the clock has not started
+    virtual int64_t time_us() = 0;
+
+    // offered the first frame's media time; clocks that free-run anchor themselves to it
+    virtual void start_at(int64_t /*media_us*/) {}
+
+    // wait for the clock to advance by about duration_us
+    virtual void sleep_us(int64_t duration_us) { precise_sleep_us(duration_us); }
+
+    // hold the clock at its current time; clocks driven by a device stop with the device instead
+    virtual void set_paused(bool /*paused*/) {}
+
+    // forget the anchor after a seek, the next start_at() picks the new position up
+    virtual void reset() {}
+};
+
+// media time follows the monotonic wall clock from the first frame on
+class SystemClock : public MasterClock {
+public:
+    int64_t time_us() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!started_) {
+            return AV_NOPTS_VALUE;
+        }
+        return paused_ ? paused_media_us_ : now_us() - anchor_wall_us_ + anchor_media_us_;
+    }
+
+    void start_at(int64_t media_us) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        anchor_media_us_ = media_us;
+        anchor_wall_us_ = now_us();
+        paused_media_us_ = media_us;
+    }
+
+    void set_paused(bool paused) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (paused == paused_) {
+            return;
+        }
+        paused_ = paused;
+        if (!started_) {
+            return;
+        }
+        if (paused) {
+            paused_media_us_ = now_us() - anchor_wall_us_ + anchor_media_us_;
+        } else {
+            // carry on from where the clock stopped
+            anchor_media_us_ = paused_media_us_;
+            anchor_wall_us_ = now_us();
+        }
+    }
+
+    void reset() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        started_ = false;
+    }
+
+private:
+    // taken by the present thread a few times per frame and by the control thread on pause/seek
+    std::mutex mutex_;
+    bool started_ = false;
+    bool paused_ = false;
+    int64_t anchor_wall_us_ = 0;
+    int64_t anchor_media_us_ = 0;
+    int64_t paused_media_us_ = 0;
+};
+
+// set from outside (a network time source, another player); runs at wall speed in between updates
+class ExternalClock : public MasterClock {
+public:
+    void set(int64_t media_us) {
+        media_us_.store(media_us);
+        wall_us_.store(now_us());
+    }
+
+    int64_t time_us() override {
+        int64_t wall = wall_us_.load();
+        return wall == AV_NOPTS_VALUE ? AV_NOPTS_VALUE : media_us_.load() + now_us() - wall;
+    }
+
+private:
+    std::atomic<int64_t> media_us_{0};
+    std::atomic<int64_t> wall_us_{AV_NOPTS_VALUE};
+};
+
+// deterministic clock: time only moves when something sleeps on it or advance() is called
+class FakeClock : public MasterClock {
+public:
+    int64_t time_us() override { return started_ ? time_us_ : AV_NOPTS_VALUE; }
+
+    void start_at(int64_t media_us) override {
+        if (!started_) {
+            time_us_ = media_us;
+            started_ = true;
+        }
+    }
+
+    void sleep_us(int64_t duration_us) override {
+        if (duration_us > 0) {
+            time_us_ += duration_us;
+        }
+    }
+
+    void reset() override { started_ = false; }
+
+    // simulate work taking this long
+    void advance(int64_t duration_us) { time_us_ += duration_us; }
+
+private:
+    int64_t time_us_ = 0;
+    bool started_ = false;
+};
+
+#endif // FFMPEGPLAYER_MASTER_CLOCK_H
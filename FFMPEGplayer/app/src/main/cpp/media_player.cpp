@@ -0,0 +1,384 @@
+#include "media_player.h"
+
+#include <chrono>
+
+#include "log.h"
+#include "time_util.h"
+
+// how often an idle control thread looks at the pipeline for the end of the stream and errors
+static const int POLL_INTERVAL_MS = 20;
+
+const char *player_state_name(PlayerState state) {
+    switch (state) {
+        case PLAYER_IDLE:
+            return "idle";
+        case PLAYER_PREPARED:
+            return "prepared";
+        case PLAYER_STARTED:
+            return "started";
+        case PLAYER_PAUSED:
+            return "paused";
+        case PLAYER_STOPPED:
+            return "stopped";
+        case PLAYER_COMPLETED:
+            return "completed";
+        case PLAYER_ERROR:
+            return "error";
+        case PLAYER_RELEASED:
+            return "released";
+    }
+    return "unknown";
+}
+
+const char *player_command_name(PlayerCommand command) {
+    switch (command) {
+        case PLAYER_COMMAND_PREPARE:
+            return "prepare";
+        case PLAYER_COMMAND_START:
+            return "start";
+        case PLAYER_COMMAND_PAUSE:
+            return "pause";
+        case PLAYER_COMMAND_SEEK:
+            return "seek";
+        case PLAYER_COMMAND_STOP:
+            return "stop";
+        case PLAYER_COMMAND_RELEASE:
+            return "release";
+        case PLAYER_COMMAND_SYNC:
+            return "sync";
+        case PLAYER_COMMAND_COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+MediaPlayer::MediaPlayer(VideoSink *video_sink, AudioSink *audio_sink, const MediaPlayerOptions &options)
+        : video_sink_(video_sink),
+          audio_sink_(audio_sink),
+          options_(options),
+          max_frame_rate_(options.pipeline.max_frame_rate) {
+    control_thread_ = std::thread(&MediaPlayer::control_loop, this);
+}
+
+MediaPlayer::~MediaPlayer() {
+    release();
+    if (control_thread_.joinable()) {
+        control_thread_.join();
+    }
+}
+
+void MediaPlayer::prepare(const std::string &path) {
+    Command command;
+    command.type = PLAYER_COMMAND_PREPARE;
+    command.path = path;
+    post(command);
+}
+
+void MediaPlayer::start() {
+    Command command;
+    command.type = PLAYER_COMMAND_START;
+    post(command);
+}
+
+void MediaPlayer::pause() {
+    Command command;
+    command.type = PLAYER_COMMAND_PAUSE;
+    post(command);
+}
+
+void MediaPlayer::seek(int64_t position_ms, SeekMode mode) {
+    Command command;
+    command.type = PLAYER_COMMAND_SEEK;
+    command.value = position_ms;
+    command.mode = mode;
+    post(command);
+}
+
+void MediaPlayer::stop() {
+    Command command;
+    command.type = PLAYER_COMMAND_STOP;
+    post(command);
+}
+
+void MediaPlayer::release() {
+    if (released_.exchange(true)) {
+        return;
+    }
+    Command command;
+    command.type = PLAYER_COMMAND_RELEASE;
+    command.issued_us = now_us();
+    commands_.push(command);
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_condition_.notify_one();
+}
+
+void MediaPlayer::set_max_frame_rate(double rate) {
+    max_frame_rate_.store(rate);
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    if (pipeline_) {
+        pipeline_->set_max_frame_rate(rate);
+    }
+}
+
+void MediaPlayer::sync() {
+    Command command;
+    command.type = PLAYER_COMMAND_SYNC;
+    command.done = std::make_shared<std::promise<void>>();
+    std::future<void> done = command.done->get_future();
+    post(command);
+    done.wait();
+}
+
+int64_t MediaPlayer::position_ms() const {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    if (!pipeline_) {
+        return -1;
+    }
+    int64_t position = pipeline_->position_us();
+    return position == AV_NOPTS_VALUE ? 0 : (position - start_time_us_) / 1000;
+}
+
+StartupTimings MediaPlayer::startup_timings() const {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    StartupTimings timings = source_.startup;
+    if (pipeline_) {
+        timings.first_decode_us = pipeline_->first_decode_us();
+        timings.first_present_us = pipeline_->first_present_us();
+    }
+    return timings;
+}
+
+SeekStats MediaPlayer::seek_stats() const {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    return pipeline_ ? pipeline_->seek_stats() : SeekStats();
+}
+
+MetricsSnapshot MediaPlayer::metrics() const {
+    std::lock_guard<std::mutex> lock(pipeline_mutex_);
+    return pipeline_ ? pipeline_->metrics() : MetricsSnapshot();
+}
+
+ControlStats MediaPlayer::control_stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return control_stats_;
+}
+
+void MediaPlayer::post(Command command) {
+    if (released_.load()) {
+        // nothing will run it; do not leave sync() hanging
+        if (command.done) {
+            command.done->set_value();
+        }
+        return;
+    }
+    command.issued_us = now_us();
+    commands_.push(command);
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_condition_.notify_one();
+}
+
+void MediaPlayer::control_loop() {
+    Command command;
+    for (;;) {
+        if (!commands_.try_pop(command)) {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_condition_.wait_for(lock, std::chrono::milliseconds(POLL_INTERVAL_MS),
+                                     [this] { return !commands_.empty(); });
+            lock.unlock();
+            poll();
+            continue;
+        }
+        handle(command);
+        int64_t latency = now_us() - command.issued_us;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            CommandLatency &stats = control_stats_.commands[command.type];
+            stats.count++;
+            stats.total_us += latency;
+            if (latency > stats.max_us) {
+                stats.max_us = latency;
+            }
+        }
+        if (command.done) {
+            command.done->set_value();
+        }
+        if (command.type == PLAYER_COMMAND_RELEASE) {
+            break;
+        }
+    }
+    // commands that raced with release are dropped, but nobody may be left waiting on them
+    while (commands_.try_pop(command)) {
+        if (command.done) {
+            command.done->set_value();
+        }
+    }
+}
+
+void MediaPlayer::handle(const Command &command) {
+    PlayerState state = this->state();
+    switch (command.type) {
+        case PLAYER_COMMAND_PREPARE:
+            do_prepare(command.path);
+            break;
+        case PLAYER_COMMAND_START:
+            do_start();
+            break;
+        case PLAYER_COMMAND_PAUSE:
+            if (state == PLAYER_STARTED) {
+                pipeline_->pause();
+                state_.store(PLAYER_PAUSED);
+            }
+            break;
+        case PLAYER_COMMAND_SEEK:
+            if (pipeline_ && state != PLAYER_ERROR) {
+                pipeline_->seek(start_time_us_ + command.value * 1000, command.mode);
+                if (state == PLAYER_COMPLETED) {
+                    // the stages are still running, they pick up from the new position
+                    state_.store(PLAYER_STARTED);
+                }
+            }
+            break;
+        case PLAYER_COMMAND_STOP:
+            if (pipeline_ && state != PLAYER_ERROR && state != PLAYER_IDLE) {
+                // rewind and hold; nothing is torn down so start() is cheap
+                pipeline_->pause();
+                pipeline_->seek(start_time_us_, SEEK_FAST);
+                state_.store(PLAYER_STOPPED);
+            }
+            break;
+        case PLAYER_COMMAND_RELEASE:
+            teardown();
+            state_.store(PLAYER_RELEASED);
+            break;
+        case PLAYER_COMMAND_SYNC:
+        case PLAYER_COMMAND_COUNT:
+            break;
+    }
+}
+
+void MediaPlayer::do_prepare(const std::string &path) {
+    teardown();
+    MediaSource source;
+    int result = media_source_open(&source, path.c_str(), options_.source);
+    if (result < 0) {
+        media_source_close(&source);
+        set_error(result);
+        return;
+    }
+    PipelineOptions pipeline_options = options_.pipeline;
+    pipeline_options.hold_at_end = true;
+    pipeline_options.packet_index = source.packet_index;
+    pipeline_options.clock = nullptr;
+    pipeline_options.audio = nullptr;
+    std::unique_ptr<AudioPipeline> audio;
+    if (options_.realtime) {
+        // a clock left paused or anchored by the previous source
+        clock_.reset();
+        clock_.set_paused(false);
+        pipeline_options.clock = &clock_;
+        // with an audio stream the audio device becomes the clock video follows
+        if (audio_sink_ != nullptr && source.audio_codec_context != nullptr) {
+            audio.reset(new AudioPipeline(source.audio_codec_context, source.audio_stream_index,
+                                          source.format_context->streams[source.audio_stream_index]->time_base,
+                                          audio_sink_, options_.audio));
+            pipeline_options.audio = audio.get();
+            pipeline_options.clock = audio->clock();
+        }
+    }
+    AVFormatContext *format_context = source.format_context;
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex_);
+        source_ = source;
+        audio_ = std::move(audio);
+        // read under the lock, a set_max_frame_rate() racing with this lands in one or the other
+        pipeline_options.max_frame_rate = max_frame_rate_.load();
+        pipeline_.reset(new Pipeline(source.format_context, source.video_stream_index, source.video_codec_context,
+                                     video_sink_, pipeline_options));
+        start_time_us_ = format_context->start_time != AV_NOPTS_VALUE ? format_context->start_time : 0;
+    }
+    duration_ms_.store(format_context->duration != AV_NOPTS_VALUE ? format_context->duration / 1000 : -1);
+    started_ = false;
+    startup_logged_ = false;
+    logged_seeks_ = 0;
+    error_.store(0);
+    state_.store(PLAYER_PREPARED);
+}
+
+void MediaPlayer::do_start() {
+    PlayerState state = this->state();
+    if (!pipeline_ || state == PLAYER_ERROR) {
+        return;
+    }
+    if (!started_) {
+        int result = pipeline_->start();
+        if (result < 0) {
+            set_error(result);
+            return;
+        }
+        started_ = true;
+    } else if (state == PLAYER_COMPLETED) {
+        pipeline_->seek(start_time_us_, SEEK_FAST);
+    }
+    pipeline_->resume();
+    state_.store(PLAYER_STARTED);
+}
+
+// the stages report the end of the stream and failures on their own, pick them up between commands
+void MediaPlayer::poll() {
+    if (!pipeline_) {
+        return;
+    }
+    int error = pipeline_->error();
+    PlayerState state = this->state();
+    if (error < 0 && state != PLAYER_ERROR) {
+        set_error(error);
+    } else if (state == PLAYER_STARTED && pipeline_->ended()) {
+        state_.store(PLAYER_COMPLETED);
+    }
+    if (!startup_logged_ && pipeline_->first_present_us() >= 0) {
+        startup_logged_ = true;
+        char timings[160];
+        LOGI("Player : %s", startup_timings_describe(startup_timings(), timings, sizeof(timings)));
+        std::lock_guard<std::mutex> lock(pipeline_mutex_);
+        media_source_remember_keyframe(&source_, pipeline_->first_keyframe_position());
+    }
+    SeekStats seeks = pipeline_->seek_stats();
+    if (seeks.count != logged_seeks_) {
+        logged_seeks_ = seeks.count;
+        LOGI("Player : seek showed a frame after %lld ms, %lld ms off the target; %lld frames skipped so far",
+             (long long) seeks.last_us / 1000, (long long) seeks.last_error_us / 1000,
+             (long long) seeks.discarded_frames);
+    }
+}
+
+void MediaPlayer::teardown() {
+    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<AudioPipeline> audio;
+    MediaSource source;
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex_);
+        pipeline.swap(pipeline_);
+        audio.swap(audio_);
+        source = source_;
+        source_ = MediaSource();
+    }
+    // a demuxer waiting on the network lets go right away
+    media_source_interrupt(&source);
+    // the pipeline goes first, it feeds the audio pipeline and reads the source
+    if (pipeline) {
+        pipeline->abort();
+        pipeline.reset();
+    }
+    audio.reset();
+    media_source_close(&source);
+    started_ = false;
+    duration_ms_.store(-1);
+}
+
+void MediaPlayer::set_error(int error) {
+    char message[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(error, message, sizeof(message));
+    LOGE("Player Error : %s", message);
+    error_.store(error);
+    state_.store(PLAYER_ERROR);
+}
@@ -0,0 +1,172 @@
+#ifndef FFMPEGPLAYER_MEDIA_PLAYER_H
+#define FFMPEGPLAYER_MEDIA_PLAYER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "audio_pipeline.h"
+#include "audio_sink.h"
+#include "master_clock.h"
+#include "media_source.h"
+#include "mpsc_queue.h"
+#include "pipeline.h"
+#include "video_sink.h"
+
+// values are shared with FFMpegPlayer.java
+enum PlayerState {
+    PLAYER_IDLE = 0,
+    PLAYER_PREPARED = 1,
+    PLAYER_STARTED = 2,
+    PLAYER_PAUSED = 3,
+    PLAYER_STOPPED = 4,
+    PLAYER_COMPLETED = 5,
+    PLAYER_ERROR = 6,
+    PLAYER_RELEASED = 7,
+};
+
+enum PlayerCommand {
+    PLAYER_COMMAND_PREPARE,
+    PLAYER_COMMAND_START,
+    PLAYER_COMMAND_PAUSE,
+    PLAYER_COMMAND_SEEK,
+    PLAYER_COMMAND_STOP,
+    PLAYER_COMMAND_RELEASE,
+    PLAYER_COMMAND_SYNC,
+    PLAYER_COMMAND_COUNT,
+};
+
+const char *player_state_name(PlayerState state);
+const char *player_command_name(PlayerCommand command);
+
+// time from a call returning to the control thread having applied it
+struct CommandLatency {
+    int64_t count = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+
+    int64_t mean_us() const { return count > 0 ? total_us / count : 0; }
+};
+
+struct ControlStats {
+    CommandLatency commands[PLAYER_COMMAND_COUNT];
+};
+
+struct MediaPlayerOptions {
+    MediaPlayerOptions() {
+        source.enable_audio = true;
+        source.prefetch_bytes = 8 * 1024 * 1024;
+        source.fast_start = true;
+        pipeline.fast_start = true;
+    }
+
+    MediaSourceOptions source;
+    // clock, audio and hold_at_end are filled in by the player
+    PipelineOptions pipeline;
+    AudioPipelineOptions audio;
+    // present at the timestamps; false runs as fast as the stages go, for measurements
+    bool realtime = true;
+};
+
+/**
+ * Long-lived player handle. Every call only queues a command and returns; one control
+ * thread owned by the player applies them in order, so callers (the UI thread, JNI, a test
+ * harness) never block on I/O or on the stages. The input, the decoders, the converter and
+ * the stage threads live from prepare() to release() and are reused by start, pause, seek
+ * and stop instead of being rebuilt per call.
+ * States follow android.media.MediaPlayer loosely: stop() rewinds and holds, start() after
+ * stop or the end of the stream plays again from the start.
+ */
+class MediaPlayer {
+public:
+    // the sinks are not owned and must outlive the player; audio_sink may be nullptr
+    MediaPlayer(VideoSink *video_sink, AudioSink *audio_sink,
+                const MediaPlayerOptions &options = MediaPlayerOptions());
+    ~MediaPlayer();
+
+    void prepare(const std::string &path);
+    void start();
+    void pause();
+    void seek(int64_t position_ms, SeekMode mode = SEEK_ACCURATE);
+    void stop();
+    // tears everything down; further commands are ignored
+    void release();
+
+    // show no more than this many frames a second, 0 for all; applies to the prepared source
+    // right away and to the ones prepared after it. Safe from any thread, not queued.
+    void set_max_frame_rate(double rate);
+
+    // block until every command queued before this call has been applied
+    void sync();
+
+    PlayerState state() const { return (PlayerState) state_.load(); }
+    // 0 or the negative AVERROR that put the player in PLAYER_ERROR
+    int error() const { return error_.load(); }
+    // from the start of the stream, -1 before prepare
+    int64_t position_ms() const;
+    int64_t duration_ms() const { return duration_ms_.load(); }
+    ControlStats control_stats() const;
+    // of the prepared source; the pipeline part counts from the first start()
+    StartupTimings startup_timings() const;
+    // of the prepared source, seek-to-frame latency of every seek since prepare
+    SeekStats seek_stats() const;
+    // of the prepared source, stage latencies and counters since prepare; not enabled before it
+    MetricsSnapshot metrics() const;
+
+private:
+    struct Command {
+        PlayerCommand type = PLAYER_COMMAND_SYNC;
+        int64_t value = 0;
+        SeekMode mode = SEEK_ACCURATE;
+        std::string path;
+        int64_t issued_us = 0;
+        std::shared_ptr<std::promise<void>> done;
+    };
+
+    void post(Command command);
+    void control_loop();
+    void handle(const Command &command);
+    void do_prepare(const std::string &path);
+    void do_start();
+    void poll();
+    void teardown();
+    void set_error(int error);
+
+    VideoSink *video_sink_;
+    AudioSink *audio_sink_;
+    MediaPlayerOptions options_;
+
+    MpscQueue<Command> commands_;
+    // the control thread parks here when there are no commands
+    std::mutex wake_mutex_;
+    std::condition_variable wake_condition_;
+    std::thread control_thread_;
+    std::atomic<bool> released_{false};
+    // options_.pipeline.max_frame_rate, as set_max_frame_rate() last changed it
+    std::atomic<double> max_frame_rate_;
+
+    // owned by the control thread; pipeline_mutex_ covers replacing them against readers
+    mutable std::mutex pipeline_mutex_;
+    MediaSource source_;
+    SystemClock clock_;
+    std::unique_ptr<AudioPipeline> audio_;
+    std::unique_ptr<Pipeline> pipeline_;
+    bool started_ = false;
+    int64_t start_time_us_ = 0;
+    bool startup_logged_ = false;
+    int64_t logged_seeks_ = 0;
+
+    std::atomic<int> state_{PLAYER_IDLE};
+    std::atomic<int> error_{0};
+    std::atomic<int64_t> duration_ms_{-1};
+
+    mutable std::mutex stats_mutex_;
+    ControlStats control_stats_;
+};
+
+#endif // FFMPEGPLAYER_MEDIA_PLAYER_H
@@ -0,0 +1,228 @@
+#ifndef FFMPEGPLAYER_MEDIA_QUEUE_H
+#define FFMPEGPLAYER_MEDIA_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "libavcodec/packet.h"
+#include "libavutil/frame.h"
+#include "libavutil/mathematics.h"
+}
+
+#include "spsc_queue.h"
+
+// size and duration of the items the queues carry, used for the byte and duration budgets
+inline int64_t media_item_bytes(const AVPacket *packet) {
+    return packet->size;
+}
+
+inline int64_t media_item_bytes(const AVFrame *frame) {
+    int64_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+        bytes += frame->buf[i]->size;
+    }
+    return bytes;
+}
+
+inline int64_t media_item_duration(const AVPacket *packet) {
+    return packet->duration;
+}
+
+inline int64_t media_item_duration(const AVFrame *frame) {
+    return frame->duration;
+}
+
+// playback generation an item belongs to; every seek starts a new one and stages drop items
+// of an older generation unprocessed. It travels in the opaque field, which nothing else uses.
+inline int media_item_serial(const AVPacket *packet) {
+    return (int) (intptr_t) packet->opaque;
+}
+
+inline int media_item_serial(const AVFrame *frame) {
+    return (int) (intptr_t) frame->opaque;
+}
+
+inline void media_item_set_serial(AVPacket *packet, int serial) {
+    packet->opaque = (void *) (intptr_t) serial;
+}
+
+inline void media_item_set_serial(AVFrame *frame, int serial) {
+    frame->opaque = (void *) (intptr_t) serial;
+}
+
+// end of stream travels through the queues as an item too, so the stages can drain and still
+// be around for a seek; demuxed packets always carry a stream and decoded frames a format
+inline bool media_item_is_eos(const AVPacket *packet) {
+    return packet->stream_index < 0;
+}
+
+inline bool media_item_is_eos(const AVFrame *frame) {
+    return frame->format < 0;
+}
+
+struct MediaQueueLimits {
+    // hard cap on the number of items, rounded up to a power of two
+    int max_items = 64;
+    // 0 disables the byte budget
+    int64_t max_bytes = 0;
+    // 0 disables the duration budget, in microseconds
+    int64_t max_duration_us = 0;
+};
+
+/**
+ * Single-producer/single-consumer queue of AVPacket* or AVFrame* that moves references
+ * between pipeline stages. Besides the item count it is bounded by the bytes and by the
+ * presentation duration in flight, so a handful of 4K keyframes cannot pile up the same way
+ * a handful of tiny audio packets would.
+ *
+ * The fast path only touches atomics. A side that has to wait spins briefly and then parks
+ * on a condition variable; the other side only takes the mutex when somebody is parked.
+ * An item is always accepted into an empty queue so an oversized one cannot deadlock it.
+ */
+template <typename T>
+class MediaQueue {
+public:
+    explicit MediaQueue(const MediaQueueLimits &limits, AVRational time_base = AVRational{1, 1000000})
+            : ring_(limits.max_items), limits_(limits), time_base_(time_base) {}
+
+    // blocks while over budget, returns false if the queue was aborted
+    bool push(T item) {
+        int64_t bytes = limits_.max_bytes > 0 ? media_item_bytes(item) : 0;
+        int64_t duration = limits_.max_duration_us > 0 ? duration_us(item) : 0;
+        for (int spins = 0;; spins++) {
+            if (aborted_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (!over_budget() && ring_.try_push(item)) {
+                break;
+            }
+            if (!backoff(spins)) {
+                continue;
+            }
+            park(producer_waiting_, [this] { return aborted_.load() || (!over_budget() && ring_.size() < ring_.capacity()); });
+        }
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        duration_us_.fetch_add(duration, std::memory_order_relaxed);
+        wake(consumer_waiting_);
+        return true;
+    }
+
+    // blocks while empty, returns false once closed and drained, or on abort
+    bool pop(T &item) {
+        for (int spins = 0;; spins++) {
+            if (aborted_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (ring_.try_pop(item)) {
+                break;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // the producer may have pushed right before closing
+                if (ring_.try_pop(item)) {
+                    break;
+                }
+                return false;
+            }
+            if (!backoff(spins)) {
+                continue;
+            }
+            park(consumer_waiting_, [this] { return aborted_.load() || closed_.load() || ring_.size() > 0; });
+        }
+        if (limits_.max_bytes > 0) {
+            bytes_.fetch_sub(media_item_bytes(item), std::memory_order_relaxed);
+        }
+        if (limits_.max_duration_us > 0) {
+            duration_us_.fetch_sub(duration_us(item), std::memory_order_relaxed);
+        }
+        wake(producer_waiting_);
+        return true;
+    }
+
+    // consumer side, never blocks; used to free what is left on teardown
+    bool try_pop(T &item) {
+        return ring_.try_pop(item);
+    }
+
+    // producer side end of stream, the consumer still drains what is queued
+    void close() {
+        closed_.store(true);
+        wake(consumer_waiting_);
+    }
+
+    // wake everyone up and refuse further work
+    void abort() {
+        aborted_.store(true);
+        wake(consumer_waiting_);
+        wake(producer_waiting_);
+    }
+
+    size_t size() const { return ring_.size(); }
+    int64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    int64_t duration_us() const { return duration_us_.load(std::memory_order_relaxed); }
+
+private:
+    int64_t duration_us(const T &item) const {
+        int64_t duration = media_item_duration(item);
+        return duration > 0 ? av_rescale_q(duration, time_base_, AVRational{1, 1000000}) : 0;
+    }
+
+    bool over_budget() const {
+        // an empty queue takes anything
+        if (ring_.size() == 0) {
+            return false;
+        }
+        return (limits_.max_bytes > 0 && bytes_.load(std::memory_order_relaxed) >= limits_.max_bytes)
+               || (limits_.max_duration_us > 0 && duration_us_.load(std::memory_order_relaxed) >= limits_.max_duration_us);
+    }
+
+    // returns true once spinning stopped paying off and the caller should park
+    static bool backoff(int spins) {
+        if (spins < 64) {
+            return false;
+        }
+        if (spins < 128) {
+            std::this_thread::yield();
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Ready>
+    void park(std::atomic<bool> &waiting, Ready ready) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting.store(true);
+        // the timeout only guards against a missed wake-up, it is not part of the protocol
+        while (!ready()) {
+            condition_.wait_for(lock, std::chrono::milliseconds(5));
+        }
+        waiting.store(false);
+    }
+
+    void wake(std::atomic<bool> &waiting) {
+        // orders the ring update before reading the flag, pairs with the store in park()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            condition_.notify_all();
+        }
+    }
+
+    SpscQueue<T> ring_;
+    MediaQueueLimits limits_;
+    AVRational time_base_;
+    std::atomic<int64_t> bytes_{0};
+    std::atomic<int64_t> duration_us_{0};
+    std::atomic<bool> closed_{false};
+    std::atomic<bool> aborted_{false};
+    std::atomic<bool> producer_waiting_{false};
+    std::atomic<bool> consumer_waiting_{false};
+    std::mutex mutex_;
+    std::condition_variable condition_;
+};
+
+#endif // FFMPEGPLAYER_MEDIA_QUEUE_H
@@ -0,0 +1,290 @@
+#include "media_source.h"
+
+#include <cstring>
+#include <thread>
+
+#include "log.h"
+#include "time_util.h"
+
+// how much avformat_find_stream_info may read in fast start mode, per container. The
+// defaults (5 MB, 5 s) are sized for odd files; these are enough for every stream of a
+// regular one to show up with its parameters.
+struct ProbeLimits {
+    const char *format;
+    int64_t probe_bytes;
+    int64_t analyze_us;
+};
+
+static const ProbeLimits FAST_PROBE_LIMITS[] = {
+        // streams are only announced by their packets, audio may trail video a little
+        {"mpegts", 512 * 1024, 700 * 1000},
+        // the header flags say which streams exist, their first packets carry the rest
+        {"flv", 256 * 1024, 500 * 1000},
+        // every variant stream is opened and probed in turn, keep each one short
+        {"hls", 256 * 1024, 500 * 1000},
+};
+static const ProbeLimits DEFAULT_FAST_PROBE_LIMITS = {nullptr, 1024 * 1024, 1000 * 1000};
+
+static const ProbeLimits &fast_probe_limits(const AVInputFormat *format) {
+    for (const ProbeLimits &limits : FAST_PROBE_LIMITS) {
+        if (format != nullptr && strcmp(format->name, limits.format) == 0) {
+            return limits;
+        }
+    }
+    return DEFAULT_FAST_PROBE_LIMITS;
+}
+
+// enough to open a decoder and size the output without looking at any packet
+static bool stream_parameters_known(const AVCodecParameters *parameters) {
+    switch (parameters->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            return parameters->codec_id != AV_CODEC_ID_NONE && parameters->width > 0 && parameters->height > 0;
+        case AVMEDIA_TYPE_AUDIO:
+            return parameters->codec_id != AV_CODEC_ID_NONE && parameters->sample_rate > 0
+                   && parameters->ch_layout.nb_channels > 0;
+        default:
+            // not played
+            return true;
+    }
+}
+
+static bool all_stream_parameters_known(const AVFormatContext *format_context) {
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        if (!stream_parameters_known(format_context->streams[i]->codecpar)) {
+            return false;
+        }
+    }
+    return format_context->nb_streams > 0;
+}
+
+// what avformat_find_stream_info would have derived from the streams, when it did not run
+static void fill_stream_timings(AVFormatContext *format_context) {
+    static const AVRational microseconds = {1, 1000000};
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        AVStream *stream = format_context->streams[i];
+        if (stream->start_time != AV_NOPTS_VALUE) {
+            int64_t start_time = av_rescale_q(stream->start_time, stream->time_base, microseconds);
+            if (format_context->start_time == AV_NOPTS_VALUE || start_time < format_context->start_time) {
+                format_context->start_time = start_time;
+            }
+        }
+    }
+    if (format_context->duration != AV_NOPTS_VALUE) {
+        return;
+    }
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        AVStream *stream = format_context->streams[i];
+        if (stream->duration != AV_NOPTS_VALUE) {
+            int64_t duration = av_rescale_q(stream->duration, stream->time_base, microseconds);
+            format_context->duration = FFMAX(format_context->duration, duration);
+        }
+    }
+}
+
+const char *startup_timings_describe(const StartupTimings &timings, char *buffer, int size) {
+    snprintf(buffer, size, "connect %lld open %lld probe %lld%s codecs %lld decode %lld present %lld, %lld ms to the first frame",
+             (long long) timings.connect_us / 1000, (long long) timings.open_us / 1000,
+             (long long) timings.probe_us / 1000,
+             timings.probe_skipped ? " (skipped)" : timings.probe_cached ? " (cached)" : "",
+             (long long) timings.codec_open_us / 1000, (long long) timings.first_decode_us / 1000,
+             (long long) timings.first_present_us / 1000, (long long) timings.total_us() / 1000);
+    return buffer;
+}
+
+// audio is optional, a stream that cannot be decoded just plays silent
+static void open_audio(MediaSource *source) {
+    const AVCodec *audio_codec = nullptr;
+    int index = av_find_best_stream(source->format_context, AVMEDIA_TYPE_AUDIO, -1,
+                                    source->video_stream_index, &audio_codec, 0);
+    if (index < 0) {
+        return;
+    }
+    AVCodecContext *audio_codec_context = avcodec_alloc_context3(audio_codec);
+    avcodec_parameters_to_context(audio_codec_context, source->format_context->streams[index]->codecpar);
+    audio_codec_context->pkt_timebase = source->format_context->streams[index]->time_base;
+    if (avcodec_open2(audio_codec_context, audio_codec, nullptr) < 0) {
+        LOGE("Player Error : Can not open audio codec");
+        avcodec_free_context(&audio_codec_context);
+        return;
+    }
+    source->audio_stream_index = index;
+    source->audio_codec_context = audio_codec_context;
+}
+
+int media_source_open(MediaSource *source, const char *path, const MediaSourceOptions &options) {
+    // save the result
+    int result;
+    // regiister FFmpeg component
+    // av_register_all();  // not necessary after version 4.0
+    avformat_network_init();
+    // initialize AVFormatContext
+    source->format_context = avformat_alloc_context();
+    StartupTimings &startup = source->startup;
+    int64_t start = now_us();
+    if (options.prefetch_bytes > 0) {
+        PrefetchOptions prefetch_options;
+        prefetch_options.capacity_bytes = options.prefetch_bytes;
+        source->prefetch = new PrefetchReader(prefetch_options);
+        result = source->prefetch->open(path, nullptr, options.http_cache);
+        if (result < 0) {
+            LOGE("Player Error : Can not open video file");
+            return result;
+        }
+        // a preset pb makes avformat_open_input treat the I/O as custom and leave it to us
+        source->format_context->pb = source->prefetch->io_context();
+        startup.connect_us = now_us() - start;
+        start = now_us();
+    }
+    // open video file
+    result = avformat_open_input(&source->format_context, path, nullptr, nullptr);
+    if (result < 0) {
+        LOGE("Player Error : Can not open video file");
+        return result;
+    }
+    startup.open_us = now_us() - start;
+    start = now_us();
+    int64_t keyframe_position = -1;
+    if (options.probe_cache != nullptr && options.probe_cache->apply(path, source->format_context, &keyframe_position)) {
+        // opened before: the stream info is on disk, and where the first picture starts
+        startup.probe_cached = true;
+        source->probe_cache = options.probe_cache;
+        source->url = path;
+        source->first_keyframe_position = keyframe_position;
+        if (keyframe_position > 0 && packet_index_byte_seekable(source->format_context->iformat)) {
+            av_seek_frame(source->format_context, -1, keyframe_position, AVSEEK_FLAG_BYTE);
+        }
+        startup.probe_us = now_us() - start;
+    } else if (options.fast_start && all_stream_parameters_known(source->format_context)) {
+        // mp4, mkv and the like: reading packets would only confirm what the header said
+        startup.probe_skipped = true;
+        fill_stream_timings(source->format_context);
+    } else {
+        if (options.fast_start) {
+            const ProbeLimits &limits = fast_probe_limits(source->format_context->iformat);
+            source->format_context->probesize = limits.probe_bytes;
+            source->format_context->max_analyze_duration = limits.analyze_us;
+        }
+        // look up video file information
+        result = avformat_find_stream_info(source->format_context, nullptr);
+        if (result < 0) {
+            LOGE("Player Error : Can not find video file stream info");
+            return result;
+        }
+        startup.probe_us = now_us() - start;
+        if (options.probe_cache != nullptr) {
+            options.probe_cache->store(path, source->format_context, -1);
+            source->probe_cache = options.probe_cache;
+            source->url = path;
+        }
+    }
+    start = now_us();
+    // look up video codec
+    for (unsigned int i = 0; i < source->format_context->nb_streams; i++) {
+        // match video stream
+        if (source->format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            source->video_stream_index = i;
+        }
+    }
+    // video stream  is not found
+    if (source->video_stream_index == -1) {
+        LOGE("Player Error : Can not find video stream");
+        return AVERROR_STREAM_NOT_FOUND;
+    }
+    if (options.packet_index_store != nullptr) {
+        source->url = path;
+        source->packet_index_store = options.packet_index_store;
+        source->packet_index = options.packet_index_store->load(path, source->format_context, source->video_stream_index);
+        int64_t duration = source->packet_index != nullptr ? source->packet_index->duration_us() : AV_NOPTS_VALUE;
+        if (duration != AV_NOPTS_VALUE) {
+            // measured over every packet rather than estimated from the bit rate or the first minutes
+            AVStream *stream = source->format_context->streams[source->video_stream_index];
+            source->format_context->duration = duration;
+            stream->duration = av_rescale_q(duration, AV_TIME_BASE_Q, stream->time_base);
+        }
+        if (source->packet_index != nullptr && source->packet_index->size() > 0) {
+            LOGI("Player : packet index %lld packets %lld keyframes%s", (long long) source->packet_index->size(),
+                 (long long) source->packet_index->keyframe_count(), source->packet_index->complete() ? ", complete" : "");
+        }
+    }
+    // initialize video codec context
+    source->video_codec_context = avcodec_alloc_context3(nullptr);
+    avcodec_parameters_to_context(source->video_codec_context,
+                                  source->format_context->streams[source->video_stream_index]->codecpar);
+    source->video_codec_context->pkt_timebase = source->format_context->streams[source->video_stream_index]->time_base;
+    // initialize video codec
+    const AVCodec *video_codec = avcodec_find_decoder(source->video_codec_context->codec_id);
+    if (video_codec == nullptr) {
+        LOGE("Player Error : Can not find video codec");
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+    // spread decoding over the cores, frame and/or slice threads depending on codec and size
+    source->video_threading = decoder_threading_choose(
+            video_codec, source->format_context->streams[source->video_stream_index]->codecpar,
+            options.threading_mode, options.decoder_threads, (int) std::thread::hardware_concurrency());
+    decoder_threading_apply(source->video_codec_context, &source->video_threading);
+    // shown small, the decoder does not need to produce the whole picture
+    source->video_reduced = reduced_decode_choose(
+            video_codec, source->format_context->streams[source->video_stream_index]->codecpar, options.reduced_decode);
+    reduced_decode_apply(source->video_codec_context, source->video_reduced);
+    if (options.pooled_frames) {
+        source->frame_pool = new FramePool();
+        source->frame_pool->attach(source->video_codec_context);
+    }
+    // open video codec
+    result = avcodec_open2(source->video_codec_context, video_codec, nullptr);
+    if (result < 0) {
+        LOGE("Player Error : Can not open video codec");
+        return result;
+    }
+    decoder_threading_update(source->video_codec_context, &source->video_threading);
+    char threading[32];
+    LOGI("Player : %s decoder threading %s", video_codec->name,
+         decoder_threading_describe(source->video_threading, threading, sizeof(threading)));
+    if (source->video_reduced.reduced()) {
+        // the decoder clamps a lowres it can not do
+        source->video_reduced.lowres = source->video_codec_context->lowres;
+        char reduced[64];
+        LOGI("Player : %s decoding reduced, %s, to %dx%d", video_codec->name,
+             reduced_decode_describe(source->video_reduced, reduced, sizeof(reduced)),
+             source->video_codec_context->width, source->video_codec_context->height);
+    }
+    if (options.enable_audio) {
+        open_audio(source);
+    }
+    startup.codec_open_us = now_us() - start;
+    return 0;
+}
+
+void media_source_close(MediaSource *source) {
+    if (source->packet_index_store != nullptr) {
+        source->packet_index_store->save(source->url, source->packet_index);
+    }
+    delete source->packet_index;
+    source->packet_index = nullptr;
+    source->packet_index_store = nullptr;
+    avcodec_free_context(&source->audio_codec_context);
+    source->audio_stream_index = -1;
+    avcodec_free_context(&source->video_codec_context);
+    // after the decoder, which holds frames from it
+    delete source->frame_pool;
+    source->frame_pool = nullptr;
+    avformat_close_input(&source->format_context);
+    source->video_stream_index = -1;
+    // after the demuxer, which reads through it
+    delete source->prefetch;
+    source->prefetch = nullptr;
+}
+
+void media_source_remember_keyframe(MediaSource *source, int64_t position) {
+    if (source->probe_cache == nullptr || source->first_keyframe_position >= 0 || position < 0) {
+        return;
+    }
+    source->first_keyframe_position = position;
+    source->probe_cache->store_keyframe(source->url, position);
+}
+
+void media_source_interrupt(MediaSource *source) {
+    if (source->prefetch != nullptr) {
+        source->prefetch->abort();
+    }
+}
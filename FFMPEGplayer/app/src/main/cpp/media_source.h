@@ -0,0 +1,113 @@
+#ifndef FFMPEGPLAYER_MEDIA_SOURCE_H
+#define FFMPEGPLAYER_MEDIA_SOURCE_H
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+}
+
+#include <string>
+
+#include "decoder_threading.h"
+#include "frame_pool.h"
+#include "packet_index.h"
+#include "prefetch_io.h"
+#include "probe_cache.h"
+#include "reduced_decode.h"
+
+struct MediaSourceOptions {
+    DecoderThreadingMode threading_mode = DECODER_THREADING_AUTO;
+    // 0 lets the threading policy decide
+    int decoder_threads = 0;
+    // also open the best audio stream's decoder
+    bool enable_audio = false;
+    // read ahead of the demuxer on a background thread into a ring this large;
+    // 0 leaves I/O to FFmpeg on the demux thread
+    int64_t prefetch_bytes = 0;
+    // when prefetching, http(s) inputs go through this cache; not owned
+    HttpCache *http_cache = nullptr;
+    // start playing sooner: probe with per-container caps, or not at all when the container
+    // header already gave every stream's codec parameters
+    bool fast_start = false;
+    // stream info of inputs opened before comes from here instead of a probe; not owned
+    ProbeCache *probe_cache = nullptr;
+    // sidecar packet indexes of seekable inputs are loaded from and saved to here; not owned
+    PacketIndexStore *packet_index_store = nullptr;
+    // decode video into recycled, aligned and pre-faulted buffers instead of FFmpeg's own
+    bool pooled_frames = true;
+    // decode video at no more than the size it is shown at, for tiles and picture-in-picture
+    ReducedDecodeOptions reduced_decode;
+};
+
+// where the time to the first frame went, in microseconds
+struct StartupTimings {
+    // opening the protocol; 0 without prefetching, avformat_open_input connects itself then
+    int64_t connect_us = 0;
+    // reading the container header
+    int64_t open_us = 0;
+    // avformat_find_stream_info, 0 when it was skipped
+    int64_t probe_us = 0;
+    bool probe_skipped = false;
+    // the probe cache had the stream info
+    bool probe_cached = false;
+    int64_t codec_open_us = 0;
+    // from the pipeline start to the first decoded and the first presented frame, -1 until then;
+    // filled in by whoever runs the pipeline
+    int64_t first_decode_us = -1;
+    int64_t first_present_us = -1;
+
+    // open to first present, -1 until a frame was presented
+    int64_t total_us() const {
+        return first_present_us < 0 ? -1 : connect_us + open_us + probe_us + codec_open_us + first_present_us;
+    }
+};
+
+// "connect 120 open 85 probe 0 (skipped) codecs 6 decode 41 present 44, 255 ms to the first frame"
+const char *startup_timings_describe(const StartupTimings &timings, char *buffer, int size);
+
+/**
+ * Opened input plus the decoder of its video stream.
+ * Shared by the JNI entry points and the headless runner.
+ */
+struct MediaSource {
+    AVFormatContext *format_context = nullptr;
+    int video_stream_index = -1;
+    AVCodecContext *video_codec_context = nullptr;
+    // threading the video decoder was opened with
+    DecoderThreading video_threading;
+    // the work the video decoder was told to leave out
+    ReducedDecode video_reduced;
+    // where the video decoder gets its frame buffers, nullptr for FFmpeg's default
+    FramePool *frame_pool = nullptr;
+    // -1 / nullptr when there is no audio or it was not asked for
+    int audio_stream_index = -1;
+    AVCodecContext *audio_codec_context = nullptr;
+    // the custom I/O under format_context when prefetching, nullptr otherwise
+    PrefetchReader *prefetch = nullptr;
+    StartupTimings startup;
+    // set when the stream info was probed or taken from the cache, for remembering the keyframe
+    ProbeCache *probe_cache = nullptr;
+    std::string url;
+    // byte offset of the first video keyframe, -1 while unknown
+    int64_t first_keyframe_position = -1;
+    // of the video stream, when there is a store; pass it to the pipeline to extend and seek
+    // with. Saved and freed by media_source_close.
+    PacketIndex *packet_index = nullptr;
+    PacketIndexStore *packet_index_store = nullptr;
+};
+
+// open the file or URL and the video decoder, returns 0 or a negative AVERROR
+int media_source_open(MediaSource *source, const char *path,
+                      const MediaSourceOptions &options = MediaSourceOptions());
+
+// the pipeline found the first video keyframe at this byte offset; the probe cache keeps it
+// so the next open can start reading there
+void media_source_remember_keyframe(MediaSource *source, int64_t position);
+
+// make I/O the demuxer is blocked in fail right away, ahead of tearing the source down
+void media_source_interrupt(MediaSource *source);
+
+// release everything media_source_open acquired, safe on a partially opened source
+void media_source_close(MediaSource *source);
+
+#endif // FFMPEGPLAYER_MEDIA_SOURCE_H
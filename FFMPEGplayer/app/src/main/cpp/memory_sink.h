@@ -0,0 +1,78 @@
+#ifndef FFMPEGPLAYER_MEMORY_SINK_H
+#define FFMPEGPLAYER_MEMORY_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "video_sink.h"
+
+/**
+ * In-memory stand-in for an ANativeWindow: a small swap chain of buffers with a padded
+ * stride, so the present path can be exercised and measured on Linux.
+ * byte_offset shifts the buffers off their natural alignment to force the staging fallback.
+ * set_surface_size() makes it report a surface the frames are scaled to fit.
+ */
+class MemorySink : public VideoSink {
+public:
+    explicit MemorySink(int buffer_count = 3, int stride_alignment = 64, int byte_offset = 0)
+            : buffers_(buffer_count), stride_alignment_(stride_alignment), byte_offset_(byte_offset) {}
+
+    void set_surface_size(int width, int height) {
+        surface_width_ = width;
+        surface_height_ = height;
+    }
+
+    bool surface_size(int *width, int *height) const override {
+        *width = surface_width_;
+        *height = surface_height_;
+        return surface_width_ > 0 && surface_height_ > 0;
+    }
+
+    int configure(int width, int height) override {
+        width_ = width;
+        height_ = height;
+        // windows round the stride up, rows are wider than the picture
+        linesize_ = (width * 4 + stride_alignment_ - 1) / stride_alignment_ * stride_alignment_;
+        for (auto &buffer : buffers_) {
+            buffer.assign((size_t) linesize_ * height + 64 + byte_offset_, 0);
+        }
+        return 0;
+    }
+
+    int lock(VideoSinkBuffer *buffer) override {
+        uintptr_t address = (uintptr_t) buffers_[current_].data();
+        buffer->bits = (uint8_t *) ((address + 63) & ~(uintptr_t) 63) + byte_offset_;
+        buffer->linesize = linesize_;
+        buffer->width = width_;
+        buffer->height = height_;
+        locks_++;
+        return 0;
+    }
+
+    int post() override {
+        current_ = (current_ + 1) % buffers_.size();
+        frames_++;
+        return 0;
+    }
+
+    int64_t frames() const { return frames_; }
+    int64_t locks() const { return locks_; }
+    // bytes of picture data that land in the window per frame
+    int64_t frame_bytes() const { return (int64_t) width_ * height_ * 4; }
+
+private:
+    std::vector<std::vector<uint8_t>> buffers_;
+    size_t current_ = 0;
+    int stride_alignment_;
+    int byte_offset_;
+    int surface_width_ = 0;
+    int surface_height_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    int linesize_ = 0;
+    int64_t frames_ = 0;
+    int64_t locks_ = 0;
+};
+
+#endif // FFMPEGPLAYER_MEMORY_SINK_H
@@ -0,0 +1,74 @@
+#ifndef FFMPEGPLAYER_MPSC_QUEUE_H
+#define FFMPEGPLAYER_MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * Unbounded lock-free multi-producer/single-consumer queue (Vyukov's linked list with a
+ * stub node). Any thread may call push, only one thread may call try_pop and empty.
+ * Every push allocates a node, so it is meant for control messages rather than media.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(new Node()) {
+        tail_ = head_.load();
+    }
+
+    ~MpscQueue() {
+        T item;
+        while (try_pop(item)) {
+        }
+        delete tail_;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // producer side, never blocks
+    void push(T item) {
+        Node *node = new Node(std::move(item));
+        Node *previous = head_.exchange(node, std::memory_order_acq_rel);
+        // until this store the consumer sees the queue end at previous, the item shows up right after
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // consumer side, returns false when the queue is empty
+    bool try_pop(T &item) {
+        Node *next = tail_->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        // next becomes the stub, its item has been taken
+        item = std::move(next->item);
+        delete tail_;
+        tail_ = next;
+        return true;
+    }
+
+    // consumer side
+    bool empty() const {
+        return tail_->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        Node() {}
+        explicit Node(T value) : item(std::move(value)) {}
+
+        std::atomic<Node *> next{nullptr};
+        T item;
+    };
+
+    // producers swap themselves in at the head, the consumer walks from the tail
+    std::atomic<Node *> head_;
+    char padding_[CACHE_LINE_SIZE];
+    Node *tail_;
+};
+
+#endif // FFMPEGPLAYER_MPSC_QUEUE_H
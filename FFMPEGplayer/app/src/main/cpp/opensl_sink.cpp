@@ -0,0 +1,138 @@
+#include "opensl_sink.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "log.h"
+
+// 10 ms per buffer keeps the clock fine grained without waking up too often
+static const int PERIODS_PER_SECOND = 100;
+
+OpenSLSink::~OpenSLSink() {
+    stop();
+}
+
+int OpenSLSink::open(const AudioFormat &format, AudioRing *ring) {
+    ring_ = ring;
+    // the mixer takes mono or stereo at any common rate and resamples itself
+    format_ = format;
+    period_frames_ = format.sample_rate / PERIODS_PER_SECOND;
+    for (auto &buffer : buffers_) {
+        buffer.assign((size_t) period_frames_ * format.channels, 0);
+    }
+
+    SLresult result = slCreateEngine(&engine_object_, 0, nullptr, 0, nullptr, nullptr);
+    if (result != SL_RESULT_SUCCESS
+        || (*engine_object_)->Realize(engine_object_, SL_BOOLEAN_FALSE) != SL_RESULT_SUCCESS
+        || (*engine_object_)->GetInterface(engine_object_, SL_IID_ENGINE, &engine_) != SL_RESULT_SUCCESS
+        || (*engine_)->CreateOutputMix(engine_, &output_mix_, 0, nullptr, nullptr) != SL_RESULT_SUCCESS
+        || (*output_mix_)->Realize(output_mix_, SL_BOOLEAN_FALSE) != SL_RESULT_SUCCESS) {
+        LOGE("Player Error : Can not create OpenSL engine");
+        return -1;
+    }
+
+    SLDataLocator_AndroidSimpleBufferQueue queue_locator = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, BUFFER_COUNT};
+    SLDataFormat_PCM pcm = {
+            SL_DATAFORMAT_PCM, (SLuint32) format.channels, (SLuint32) format.sample_rate * 1000,
+            SL_PCMSAMPLEFORMAT_FIXED_16, SL_PCMSAMPLEFORMAT_FIXED_16,
+            (SLuint32) (format.channels == 2 ? (SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT) : SL_SPEAKER_FRONT_CENTER),
+            SL_BYTEORDER_LITTLEENDIAN};
+    SLDataSource source = {&queue_locator, &pcm};
+    SLDataLocator_OutputMix mix_locator = {SL_DATALOCATOR_OUTPUTMIX, output_mix_};
+    SLDataSink sink = {&mix_locator, nullptr};
+    const SLInterfaceID ids[] = {SL_IID_ANDROIDSIMPLEBUFFERQUEUE};
+    const SLboolean required[] = {SL_BOOLEAN_TRUE};
+    if ((*engine_)->CreateAudioPlayer(engine_, &player_object_, &source, &sink, 1, ids, required) != SL_RESULT_SUCCESS
+        || (*player_object_)->Realize(player_object_, SL_BOOLEAN_FALSE) != SL_RESULT_SUCCESS
+        || (*player_object_)->GetInterface(player_object_, SL_IID_PLAY, &play_) != SL_RESULT_SUCCESS
+        || (*player_object_)->GetInterface(player_object_, SL_IID_ANDROIDSIMPLEBUFFERQUEUE, &queue_) != SL_RESULT_SUCCESS
+        || (*queue_)->RegisterCallback(queue_, &OpenSLSink::on_buffer_done, this) != SL_RESULT_SUCCESS) {
+        LOGE("Player Error : Can not create OpenSL player");
+        return -1;
+    }
+    return 0;
+}
+
+int OpenSLSink::start() {
+    if (play_ == nullptr) {
+        return -1;
+    }
+    // prime the queue, from then on every finished buffer refills itself
+    while (queued_ < BUFFER_COUNT) {
+        enqueue_next();
+    }
+    return (*play_)->SetPlayState(play_, SL_PLAYSTATE_PLAYING) == SL_RESULT_SUCCESS ? 0 : -1;
+}
+
+void OpenSLSink::pause() {
+    if (play_ != nullptr) {
+        (*play_)->SetPlayState(play_, SL_PLAYSTATE_PAUSED);
+    }
+}
+
+void OpenSLSink::stop() {
+    flush();
+    if (player_object_ != nullptr) {
+        (*player_object_)->Destroy(player_object_);
+        player_object_ = nullptr;
+        play_ = nullptr;
+        queue_ = nullptr;
+    }
+    if (output_mix_ != nullptr) {
+        (*output_mix_)->Destroy(output_mix_);
+        output_mix_ = nullptr;
+    }
+    if (engine_object_ != nullptr) {
+        (*engine_object_)->Destroy(engine_object_);
+        engine_object_ = nullptr;
+        engine_ = nullptr;
+    }
+}
+
+int64_t OpenSLSink::flush() {
+    if (play_ == nullptr) {
+        return 0;
+    }
+    flushing_.store(true);
+    (*play_)->SetPlayState(play_, SL_PLAYSTATE_STOPPED);
+    // a callback already past the flushing_ check may still read the ring and enqueue
+    while (in_callback_.load()) {
+        std::this_thread::yield();
+    }
+    (*queue_)->Clear(queue_);
+    // the queued buffers are the last queued_ ones filled, ending just before next_buffer_
+    int64_t dropped = 0;
+    for (int i = 1; i <= queued_; i++) {
+        dropped += (int64_t) buffer_frames_[(next_buffer_ - i + BUFFER_COUNT) % BUFFER_COUNT];
+    }
+    queued_ = 0;
+    flushing_.store(false);
+    return dropped;
+}
+
+void OpenSLSink::enqueue_next() {
+    std::vector<int16_t> &buffer = buffers_[next_buffer_];
+    size_t frames = ring_->read(buffer.data(), period_frames_);
+    if ((int) frames < period_frames_) {
+        std::fill(buffer.begin() + frames * format_.channels, buffer.end(), 0);
+        underruns_.fetch_add(1);
+    }
+    buffer_frames_[next_buffer_] = frames;
+    (*queue_)->Enqueue(queue_, buffer.data(), (SLuint32) (buffer.size() * sizeof(int16_t)));
+    next_buffer_ = (next_buffer_ + 1) % BUFFER_COUNT;
+    queued_++;
+}
+
+// runs on the OpenSL callback thread, must not block
+void OpenSLSink::on_buffer_done(SLAndroidSimpleBufferQueueItf queue, void *context) {
+    auto *sink = (OpenSLSink *) context;
+    sink->in_callback_.store(true);
+    // while flushing the buffer counts as dropped, flush() sums up every one still queued
+    if (!sink->flushing_.load()) {
+        // buffers complete in the order they were queued, the oldest one is next_buffer_
+        sink->frames_played_.fetch_add((int64_t) sink->buffer_frames_[sink->next_buffer_]);
+        sink->queued_--;
+        sink->enqueue_next();
+    }
+    sink->in_callback_.store(false);
+}
@@ -0,0 +1,60 @@
+#ifndef FFMPEGPLAYER_OPENSL_SINK_H
+#define FFMPEGPLAYER_OPENSL_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+
+#include "audio_sink.h"
+
+/**
+ * OpenSL ES buffer queue player. AAudio would need API 26 and the app still supports 24,
+ * so this is the low latency path available everywhere.
+ */
+class OpenSLSink : public AudioSink {
+public:
+    ~OpenSLSink() override;
+
+    int open(const AudioFormat &format, AudioRing *ring) override;
+    int start() override;
+    void pause() override;
+    void stop() override;
+    int64_t flush() override;
+    int64_t frames_played() const override { return frames_played_.load(); }
+    int64_t underruns() const override { return underruns_.load(); }
+
+private:
+    static const int BUFFER_COUNT = 2;
+
+    static void on_buffer_done(SLAndroidSimpleBufferQueueItf queue, void *context);
+    void enqueue_next();
+
+    AudioRing *ring_ = nullptr;
+    AudioFormat format_;
+    int period_frames_ = 0;
+    std::vector<int16_t> buffers_[BUFFER_COUNT];
+    int next_buffer_ = 0;
+    // real (not padded) frames in each buffer, credited to the clock once the device is done with it
+    size_t buffer_frames_[BUFFER_COUNT] = {};
+    int queued_ = 0;
+    // flush() and the callback keep out of each other's way without a lock: the callback
+    // marks itself busy before it looks at flushing_, flush() sets flushing_ before it
+    // waits for the callback to be idle
+    std::atomic<bool> flushing_{false};
+    std::atomic<bool> in_callback_{false};
+
+    SLObjectItf engine_object_ = nullptr;
+    SLEngineItf engine_ = nullptr;
+    SLObjectItf output_mix_ = nullptr;
+    SLObjectItf player_object_ = nullptr;
+    SLPlayItf play_ = nullptr;
+    SLAndroidSimpleBufferQueueItf queue_ = nullptr;
+
+    std::atomic<int64_t> frames_played_{0};
+    std::atomic<int64_t> underruns_{0};
+};
+
+#endif // FFMPEGPLAYER_OPENSL_SINK_H
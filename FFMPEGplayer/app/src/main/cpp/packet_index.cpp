@@ -0,0 +1,337 @@
+#include "packet_index.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_util.h"
+#include "log.h"
+
+static const uint32_t INDEX_MAGIC = 0x58444950; // "PIDX"
+// bump when the layout changes, older sidecars are then rebuilt
+static const uint32_t INDEX_VERSION = 1;
+
+// the start of a sidecar; the entries follow it, then the keyframe table as entry numbers.
+// Native endian and fixed width, the files never leave the device.
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t input_size;
+    int64_t input_mtime;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    int64_t entry_count;
+    int64_t keyframe_count;
+    int64_t start_pts;
+    int64_t end_pts;
+    int32_t complete;
+    int32_t stream_index;
+};
+
+static const char *const BYTE_SEEK_FORMATS[] = {"mpegts", "mpeg", "flv"};
+
+bool packet_index_byte_seekable(const AVInputFormat *format) {
+    if (format->flags & AVFMT_NO_BYTE_SEEK) {
+        return false;
+    }
+    for (const char *name : BYTE_SEEK_FORMATS) {
+        if (strcmp(format->name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int packet_index_seek(AVFormatContext *format_context, const PacketIndex &index, const PacketIndexEntry &keyframe) {
+    if (keyframe.position >= 0 && packet_index_byte_seekable(format_context->iformat)) {
+        int result = av_seek_frame(format_context, -1, keyframe.position, AVSEEK_FLAG_BYTE);
+        if (result >= 0) {
+            return result;
+        }
+    }
+    return avformat_seek_file(format_context, index.stream_index(), keyframe.pts, keyframe.pts, keyframe.pts, 0);
+}
+
+PacketIndex::PacketIndex(int stream_index, AVRational time_base, int64_t input_size, int64_t input_mtime)
+        : stream_index_(stream_index),
+          time_base_(time_base),
+          input_size_(input_size),
+          input_mtime_(input_mtime) {}
+
+PacketIndex::~PacketIndex() {
+    unmap();
+}
+
+void PacketIndex::unmap() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+    }
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    mapped_ = nullptr;
+    mapped_count_ = 0;
+    mapped_keyframes_ = nullptr;
+    mapped_keyframe_count_ = 0;
+}
+
+bool PacketIndex::load(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size >= (off_t) sizeof(IndexHeader)) {
+        mapping = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping keeps the file alive
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    unmap();
+    mapping_ = mapping;
+    mapping_size_ = (size_t) status.st_size;
+    const IndexHeader *header = static_cast<const IndexHeader *>(mapping);
+    uint64_t entries_size = (uint64_t) header->entry_count * sizeof(PacketIndexEntry);
+    uint64_t keyframes_size = (uint64_t) header->keyframe_count * sizeof(int64_t);
+    if (header->magic != INDEX_MAGIC || header->version != INDEX_VERSION
+        || header->input_size != input_size_ || header->input_mtime != input_mtime_
+        || header->stream_index != stream_index_
+        || header->time_base_num != time_base_.num || header->time_base_den != time_base_.den
+        || header->entry_count < 0 || header->keyframe_count < 0 || header->keyframe_count > header->entry_count
+        || sizeof(IndexHeader) + entries_size + keyframes_size != mapping_size_) {
+        unmap();
+        return false;
+    }
+    const uint8_t *base = static_cast<const uint8_t *>(mapping);
+    mapped_ = reinterpret_cast<const PacketIndexEntry *>(base + sizeof(IndexHeader));
+    mapped_count_ = header->entry_count;
+    mapped_keyframes_ = reinterpret_cast<const int64_t *>(base + sizeof(IndexHeader) + entries_size);
+    mapped_keyframe_count_ = header->keyframe_count;
+    for (int64_t k = 0; k < mapped_keyframe_count_; k++) {
+        if (mapped_keyframes_[k] < 0 || mapped_keyframes_[k] >= mapped_count_) {
+            unmap();
+            return false;
+        }
+    }
+    appended_.clear();
+    appended_keyframes_.clear();
+    start_pts_ = header->start_pts;
+    end_pts_ = header->end_pts;
+    end_dts_ = mapped_count_ > 0 ? mapped_[mapped_count_ - 1].dts : AV_NOPTS_VALUE;
+    complete_ = header->complete != 0;
+    dirty_ = false;
+    return true;
+}
+
+int PacketIndex::save(const std::string &path) const {
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.input_size = input_size_;
+    header.input_mtime = input_mtime_;
+    header.time_base_num = time_base_.num;
+    header.time_base_den = time_base_.den;
+    header.entry_count = size();
+    header.keyframe_count = keyframe_count();
+    header.start_pts = start_pts_;
+    header.end_pts = end_pts_;
+    header.complete = complete_ ? 1 : 0;
+    header.stream_index = stream_index_;
+    // written aside and renamed over, the mapping of a player still reading the old file stays valid
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return AVERROR(errno);
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (mapped_count_ > 0) {
+        written = written && fwrite(mapped_, sizeof(PacketIndexEntry), (size_t) mapped_count_, file) == (size_t) mapped_count_;
+    }
+    if (!appended_.empty()) {
+        written = written && fwrite(appended_.data(), sizeof(PacketIndexEntry), appended_.size(), file) == appended_.size();
+    }
+    if (mapped_keyframe_count_ > 0) {
+        written = written && fwrite(mapped_keyframes_, sizeof(int64_t), (size_t) mapped_keyframe_count_, file)
+                             == (size_t) mapped_keyframe_count_;
+    }
+    if (!appended_keyframes_.empty()) {
+        written = written && fwrite(appended_keyframes_.data(), sizeof(int64_t), appended_keyframes_.size(), file)
+                             == appended_keyframes_.size();
+    }
+    if (fclose(file) != 0 || !written || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return AVERROR(EIO);
+    }
+    return 0;
+}
+
+void PacketIndex::reserve(int64_t packets) {
+    int64_t missing = packets - mapped_count_;
+    if (missing > (int64_t) appended_.capacity()) {
+        appended_.reserve((size_t) missing);
+        // every packet may be a keyframe in an intra-only stream
+        appended_keyframes_.reserve((size_t) missing);
+    }
+}
+
+void PacketIndex::begin_run(bool from_start) {
+    recording_ = false;
+    run_started_ = false;
+    run_from_start_ = from_start;
+}
+
+void PacketIndex::add(const AVPacket *packet) {
+    int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : dts;
+    if (dts == AV_NOPTS_VALUE) {
+        // nothing to order it by, the run can not extend the index
+        recording_ = false;
+        run_started_ = true;
+        return;
+    }
+    if (!run_started_) {
+        run_started_ = true;
+        // a run continues the index when it starts inside what is indexed already
+        recording_ = size() == 0 ? run_from_start_ : dts <= end_dts_;
+    }
+    if (!recording_ || (end_dts_ != AV_NOPTS_VALUE && dts <= end_dts_)) {
+        return;
+    }
+    PacketIndexEntry entry;
+    entry.pts = pts;
+    entry.dts = dts;
+    entry.position = packet->pos;
+    entry.size = packet->size;
+    entry.flags = packet->flags;
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        appended_keyframes_.push_back(size());
+    }
+    appended_.push_back(entry);
+    end_dts_ = dts;
+    if (start_pts_ == AV_NOPTS_VALUE || pts < start_pts_) {
+        start_pts_ = pts;
+    }
+    int64_t end = pts + packet->duration;
+    if (end_pts_ == AV_NOPTS_VALUE || end > end_pts_) {
+        end_pts_ = end;
+    }
+    dirty_ = true;
+}
+
+void PacketIndex::end_of_stream() {
+    if (recording_ && !complete_) {
+        complete_ = true;
+        dirty_ = true;
+    }
+}
+
+const PacketIndexEntry &PacketIndex::entry(int64_t i) const {
+    return i < mapped_count_ ? mapped_[i] : appended_[(size_t) (i - mapped_count_)];
+}
+
+const PacketIndexEntry &PacketIndex::keyframe(int64_t k) const {
+    return entry(k < mapped_keyframe_count_ ? mapped_keyframes_[k] : appended_keyframes_[(size_t) (k - mapped_keyframe_count_)]);
+}
+
+// a keyframe past pts is indexed, or the index reaches the end
+bool PacketIndex::covers(int64_t pts) const {
+    int64_t count = keyframe_count();
+    return count > 0 && (complete_ || keyframe(count - 1).pts > pts);
+}
+
+// the first keyframe with a pts after the target; keyframes come in pts order
+int64_t PacketIndex::keyframe_after(int64_t pts) const {
+    int64_t low = 0;
+    int64_t high = keyframe_count();
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (keyframe(middle).pts <= pts) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+bool PacketIndex::keyframe_before(int64_t pts, PacketIndexEntry *keyframe_entry) const {
+    if (!covers(pts)) {
+        return false;
+    }
+    int64_t after = keyframe_after(pts);
+    *keyframe_entry = keyframe(after > 0 ? after - 1 : 0);
+    return true;
+}
+
+bool PacketIndex::keyframe_nearest(int64_t pts, PacketIndexEntry *keyframe_entry) const {
+    if (!covers(pts)) {
+        return false;
+    }
+    int64_t after = keyframe_after(pts);
+    *keyframe_entry = keyframe(after > 0 ? after - 1 : 0);
+    if (after < keyframe_count() && llabs(keyframe(after).pts - pts) < llabs(keyframe_entry->pts - pts)) {
+        *keyframe_entry = keyframe(after);
+    }
+    return true;
+}
+
+int64_t PacketIndex::duration_us() const {
+    if (!complete_ || start_pts_ == AV_NOPTS_VALUE || end_pts_ == AV_NOPTS_VALUE) {
+        return AV_NOPTS_VALUE;
+    }
+    return av_rescale_q(end_pts_ - start_pts_, time_base_, AV_TIME_BASE_Q);
+}
+
+int PacketIndexStore::open() {
+    int result = make_directories(directory_);
+    if (result < 0) {
+        LOGE("Player Error : Can not create packet index directory %s", directory_.c_str());
+    }
+    return result;
+}
+
+std::string PacketIndexStore::path(const std::string &url) const {
+    return directory_ + "/" + url_file_key(url) + ".pidx";
+}
+
+// the packet count the container announces, or its duration at the frame rate; 0 when unknown
+static int64_t expected_packets(const AVFormatContext *format_context, const AVStream *stream) {
+    if (stream->nb_frames > 0) {
+        return stream->nb_frames;
+    }
+    if (format_context->duration == AV_NOPTS_VALUE || stream->avg_frame_rate.num <= 0 || stream->avg_frame_rate.den <= 0) {
+        return 0;
+    }
+    // a little over, timestamps and rates are rarely exact
+    return av_rescale_q(format_context->duration, AV_TIME_BASE_Q, av_inv_q(stream->avg_frame_rate)) * 11 / 10;
+}
+
+PacketIndex *PacketIndexStore::load(const std::string &url, const AVFormatContext *format_context, int stream_index) {
+    int64_t size;
+    int64_t mtime;
+    if (stream_index < 0 || !input_identity(url, format_context, &size, &mtime)) {
+        return nullptr;
+    }
+    const AVStream *stream = format_context->streams[stream_index];
+    PacketIndex *index = new PacketIndex(stream_index, stream->time_base, size, mtime);
+    if (!index->load(path(url)) || !index->complete()) {
+        index->reserve(expected_packets(format_context, stream));
+    }
+    return index;
+}
+
+void PacketIndexStore::save(const std::string &url, const PacketIndex *index) {
+    if (index == nullptr || !index->dirty()) {
+        return;
+    }
+    if (index->save(path(url)) < 0) {
+        LOGE("Player Error : Can not save packet index of %s", url.c_str());
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef FFMPEGPLAYER_PACKET_INDEX_H
+#define FFMPEGPLAYER_PACKET_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+// one video packet as the sidecar file stores it; timestamps in the stream time base
+struct PacketIndexEntry {
+    int64_t pts;
+    int64_t dts;
+    int64_t position;
+    int32_t size;
+    int32_t flags;
+};
+
+/**
+ * Every video packet of an input, in decode order, with its timestamps, byte position, size
+ * and keyframe flag, plus a table of the keyframes for O(log n) lookups. It is built by the
+ * demuxer as it reads and kept as a binary sidecar file that the next open maps into memory,
+ * so containers with a poor index or none (MPEG-TS, raw streams, broken MP4) seek straight to
+ * a keyframe instead of bisecting or scanning, and report their exact duration.
+ *
+ * The index covers the input from its start up to the last packet recorded. Reading on from
+ * anywhere inside that range extends it, reading elsewhere leaves it alone, so it grows over
+ * sessions until one of them reaches the end and marks it complete.
+ * Built and looked up on the demux thread; loaded and saved while it is not running.
+ */
+class PacketIndex {
+public:
+    PacketIndex(int stream_index, AVRational time_base, int64_t input_size, int64_t input_mtime);
+    ~PacketIndex();
+
+    // map a sidecar file written by save(); false when it is missing, damaged or belongs to
+    // another version of the input
+    bool load(const std::string &path);
+    // returns 0 or a negative AVERROR
+    int save(const std::string &path) const;
+
+    // room for this many packets in all, so recording does not reallocate while playing
+    void reserve(int64_t packets);
+
+    // the demuxer repositioned; from_start is true for the run that begins at the input start
+    void begin_run(bool from_start);
+    // a packet of the indexed stream was demuxed
+    void add(const AVPacket *packet);
+    // the demuxer reached the end of the input
+    void end_of_stream();
+
+    // the keyframe at or before pts, and the one nearest to it; false when pts is outside
+    // the indexed range
+    bool keyframe_before(int64_t pts, PacketIndexEntry *keyframe) const;
+    bool keyframe_nearest(int64_t pts, PacketIndexEntry *keyframe) const;
+
+    int stream_index() const { return stream_index_; }
+    int64_t size() const { return mapped_count_ + (int64_t) appended_.size(); }
+    int64_t keyframe_count() const { return mapped_keyframe_count_ + (int64_t) appended_keyframes_.size(); }
+    // from the first packet to the end of the last one, AV_NOPTS_VALUE until the index is complete
+    int64_t duration_us() const;
+    bool complete() const { return complete_; }
+    // changed since load()
+    bool dirty() const { return dirty_; }
+
+private:
+    const PacketIndexEntry &entry(int64_t i) const;
+    const PacketIndexEntry &keyframe(int64_t k) const;
+    int64_t keyframe_after(int64_t pts) const;
+    bool covers(int64_t pts) const;
+    void unmap();
+
+    int stream_index_;
+    AVRational time_base_;
+    int64_t input_size_;
+    int64_t input_mtime_;
+
+    // the sidecar file, mapped read only
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    const PacketIndexEntry *mapped_ = nullptr;
+    int64_t mapped_count_ = 0;
+    const int64_t *mapped_keyframes_ = nullptr;
+    int64_t mapped_keyframe_count_ = 0;
+    // recorded this session, after the mapped ones
+    std::vector<PacketIndexEntry> appended_;
+    std::vector<int64_t> appended_keyframes_;
+
+    // decode timestamp of the last packet indexed
+    int64_t end_dts_ = AV_NOPTS_VALUE;
+    int64_t start_pts_ = AV_NOPTS_VALUE;
+    // presentation end of the latest packet, for the duration
+    int64_t end_pts_ = AV_NOPTS_VALUE;
+    bool complete_ = false;
+    bool dirty_ = false;
+    // the current run continues the indexed range
+    bool recording_ = false;
+    bool run_started_ = false;
+    bool run_from_start_ = false;
+};
+
+// demuxers that resync on any byte offset, so reading can start right at an indexed keyframe
+bool packet_index_byte_seekable(const AVInputFormat *format);
+
+// position the demuxer on an indexed keyframe: by byte offset where the demuxer allows it,
+// by timestamp otherwise. Returns 0 or a negative AVERROR.
+int packet_index_seek(AVFormatContext *format_context, const PacketIndex &index, const PacketIndexEntry &keyframe);
+
+/**
+ * Where the sidecar files live, one per input keyed by URL like the probe cache.
+ * Safe to share between players.
+ */
+class PacketIndexStore {
+public:
+    explicit PacketIndexStore(const std::string &directory) : directory_(directory) {}
+
+    // create the directory; returns 0 or a negative AVERROR
+    int open();
+
+    // the index of url's video stream, loaded from its sidecar when there is a valid one and
+    // empty otherwise; nullptr for live input. Owned by the caller.
+    PacketIndex *load(const std::string &url, const AVFormatContext *format_context, int stream_index);
+
+    // write the index back when it learned something
+    void save(const std::string &url, const PacketIndex *index);
+
+private:
+    std::string path(const std::string &url) const;
+
+    std::string directory_;
+};
+
+#endif // FFMPEGPLAYER_PACKET_INDEX_H
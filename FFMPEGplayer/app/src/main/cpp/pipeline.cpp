@@ -0,0 +1,1180 @@
+#include "pipeline.h"
+
+#include <cstring>
+#include <thread>
+
+#include "alloc_counter.h"
+#include "item_recycler.h"
+#include "log.h"
+#include "time_util.h"
+#include "trace.h"
+
+extern "C" {
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+}
+
+// swscale needs 16 byte aligned rows to use its SIMD output paths on the destination,
+// the YUV kernels store unaligned but still lose a lot on rows that straddle cache lines
+static const int DIRECT_ALIGNMENT = 16;
+
+static MediaQueueLimits count_limits(int max_items) {
+    MediaQueueLimits limits;
+    limits.max_items = max_items;
+    return limits;
+}
+
+// every packet decodes on its own, so any of them can be left out
+static bool intra_only(AVCodecID codec_id) {
+    const AVCodecDescriptor *descriptor = avcodec_descriptor_get(codec_id);
+    return descriptor != nullptr && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY) != 0;
+}
+
+static AVFrame *alloc_rgba_frame(int width, int height) {
+    AVFrame *rgba_frame = av_frame_alloc();
+    rgba_frame->format = AV_PIX_FMT_RGBA;
+    rgba_frame->width = width;
+    rgba_frame->height = height;
+    if (av_frame_get_buffer(rgba_frame, 0) < 0) {
+        av_frame_free(&rgba_frame);
+    }
+    return rgba_frame;
+}
+
+Pipeline::Pipeline(AVFormatContext *format_context, int video_stream_index,
+                   AVCodecContext *video_codec_context, VideoSink *sink,
+                   const PipelineOptions &options)
+        : format_context_(format_context),
+          video_stream_index_(video_stream_index),
+          video_codec_context_(video_codec_context),
+          sink_(sink),
+          audio_(options.audio),
+          scheduling_(options.scheduling),
+          width_(video_codec_context->width),
+          height_(video_codec_context->height),
+          scale_to_surface_(options.scale_to_surface),
+          source_width_(video_codec_context->width),
+          source_height_(video_codec_context->height),
+          source_format_(AV_PIX_FMT_NONE),
+          converter_(options.simd_convert),
+          direct_present_(options.direct_present),
+          hold_at_end_(options.hold_at_end),
+          fast_start_(options.fast_start),
+          packet_index_(options.packet_index),
+          degrade_enabled_(options.degradation.enabled && options.clock != nullptr),
+          degradation_(options.degradation),
+          base_skip_loop_filter_(video_codec_context->skip_loop_filter),
+          base_skip_frame_(video_codec_context->skip_frame),
+          base_skip_idct_(video_codec_context->skip_idct),
+          decode_slowdown_(options.decode_slowdown),
+          max_frame_rate_(options.max_frame_rate),
+          rate_cap_(intra_only(video_codec_context->codec_id)),
+          packet_queue_(options.packet_limits, format_context->streams[video_stream_index]->time_base),
+          frame_queue_(options.frame_limits, format_context->streams[video_stream_index]->time_base),
+          rgba_queue_(count_limits(options.rgba_frame_count)),
+          rgba_free_queue_(count_limits(options.rgba_frame_count)),
+          keyframes_(format_context->streams[video_stream_index]),
+          error_(0) {
+    if (options.clock != nullptr) {
+        scheduler_.reset(new PresentScheduler(options.clock, format_context->streams[video_stream_index]->time_base,
+                                              options.scheduling));
+    }
+    if (scale_to_surface_) {
+        sink->surface_size(&surface_width_, &surface_height_);
+        sample_aspect_ratio_ = av_guess_sample_aspect_ratio(
+                format_context, format_context->streams[video_stream_index], nullptr);
+    }
+    refit_output();
+    if (direct_present_) {
+        return;
+    }
+    // the staging RGBA frames are allocated once and recycled between convert and present
+    for (int i = 0; i < options.rgba_frame_count; i++) {
+        AVFrame *rgba_frame = alloc_rgba_frame(width_, height_);
+        if (rgba_frame != nullptr) {
+            rgba_free_queue_.push(rgba_frame);
+        }
+    }
+}
+
+Pipeline::~Pipeline() {
+    if (demux_thread_.joinable()) {
+        abort();
+        wait();
+    }
+    AVPacket *packet;
+    while (packet_queue_.try_pop(packet)) {
+        media_packet_put(&packet);
+    }
+    AVFrame *frame;
+    while (frame_queue_.try_pop(frame)) {
+        media_frame_put(&frame);
+    }
+    while (rgba_queue_.try_pop(frame)) {
+        media_frame_put(&frame);
+    }
+    while (rgba_free_queue_.try_pop(frame)) {
+        av_frame_free(&frame);
+    }
+    av_frame_free(&staging_frame_);
+}
+
+int Pipeline::run() {
+    int result = start();
+    if (result < 0) {
+        return result;
+    }
+    return wait();
+}
+
+int Pipeline::start() {
+    int result = sink_->configure(width_, height_);
+    if (result < 0) {
+        return result;
+    }
+    sink_width_ = width_;
+    sink_height_ = height_;
+    LOGI("Player : converting with %s kernels", converter_.kernels_name());
+    int video_width = video_codec_context_->width;
+    int video_height = video_codec_context_->height;
+    if (width_ != video_width || height_ != video_height) {
+        LOGI("Player : scaling %dx%d to %dx%d with %s filtering, %lld KB RGBA per frame instead of %lld KB",
+             video_width, video_height, width_, height_,
+             scale_filter_name(scale_filter(video_width, video_height, width_, height_)),
+             (long long) width_ * height_ * 4 / 1024, (long long) video_width * video_height * 4 / 1024);
+    }
+    if (audio_ != nullptr && audio_->start() < 0) {
+        LOGE("Player Error : Can not start audio, playing video only");
+        if (scheduler_ && scheduler_->clock() == audio_->clock()) {
+            scheduler_.reset(new PresentScheduler(&fallback_clock_,
+                                                  format_context_->streams[video_stream_index_]->time_base,
+                                                  scheduling_));
+        }
+        audio_ = nullptr;
+    }
+    if (paused_.load()) {
+        // paused before it started: show the first frame and hold there
+        if (scheduler_) {
+            scheduler_->clock()->set_paused(true);
+        }
+        if (audio_ != nullptr) {
+            audio_->pause();
+        }
+    }
+    start_us_ = now_us();
+    demux_thread_ = std::thread(&Pipeline::demux_loop, this);
+    decode_thread_ = std::thread(&Pipeline::decode_loop, this);
+    if (direct_present_) {
+        present_thread_ = std::thread(&Pipeline::direct_present_loop, this);
+    } else {
+        convert_thread_ = std::thread(&Pipeline::convert_loop, this);
+        present_thread_ = std::thread(&Pipeline::present_loop, this);
+    }
+    return 0;
+}
+
+int Pipeline::wait() {
+    if (!demux_thread_.joinable()) {
+        return error_.load();
+    }
+    present_thread_.join();
+    if (convert_thread_.joinable()) {
+        convert_thread_.join();
+    }
+    decode_thread_.join();
+    demux_thread_.join();
+    if (audio_ != nullptr) {
+        audio_->join();
+    }
+    stats_.wall_us = now_us() - start_us_;
+    if (scheduler_) {
+        stats_.schedule = scheduler_->stats();
+    }
+    stats_.rate_cap = rate_cap_.stats();
+    stats_.rate_cap.dropped_frames = rate_dropped_frames_;
+    return error_.load();
+}
+
+void Pipeline::pause() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (paused_.exchange(true) || !demux_thread_.joinable()) {
+        return;
+    }
+    if (scheduler_) {
+        scheduler_->clock()->set_paused(true);
+    }
+    if (audio_ != nullptr) {
+        audio_->pause();
+    }
+}
+
+void Pipeline::resume() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    if (!paused_.exchange(false) || !demux_thread_.joinable()) {
+        return;
+    }
+    if (scheduler_) {
+        scheduler_->clock()->set_paused(false);
+    }
+    if (audio_ != nullptr) {
+        audio_->resume();
+    }
+    control_condition_.notify_all();
+}
+
+void Pipeline::seek(int64_t media_us, SeekMode mode) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    seek_issued_us_.store(now_us());
+    seek_target_us_.store(media_us);
+    seek_mode_.store(mode);
+    int serial = serial_.load() + 1;
+    serial_.store(serial);
+    position_us_.store(media_us);
+    if (audio_ != nullptr) {
+        audio_->flush(serial);
+    }
+    // a frame waiting for its deadline is stale now
+    if (scheduler_) {
+        scheduler_->interrupt();
+    }
+    control_condition_.notify_all();
+}
+
+SeekStats Pipeline::seek_stats() const {
+    std::lock_guard<std::mutex> lock(seek_stats_mutex_);
+    return seek_stats_;
+}
+
+MetricsSnapshot Pipeline::metrics() const {
+    MetricsSnapshot snapshot = metrics_.snapshot();
+    if (snapshot.enabled) {
+        snapshot.degradation_level = degradation_level_.load();
+    }
+    return snapshot;
+}
+
+void Pipeline::abort() {
+    {
+        std::lock_guard<std::mutex> lock(control_mutex_);
+        aborted_.store(true);
+        control_condition_.notify_all();
+    }
+    if (audio_ != nullptr) {
+        audio_->abort();
+    }
+    if (scheduler_) {
+        scheduler_->abort();
+    }
+    packet_queue_.abort();
+    frame_queue_.abort();
+    rgba_queue_.abort();
+    rgba_free_queue_.abort();
+}
+
+void Pipeline::fail(int error) {
+    int expected = 0;
+    error_.compare_exchange_strong(expected, error);
+    abort();
+}
+
+void Pipeline::demux_loop() {
+    allocation_set_stage(ALLOCATION_DEMUX);
+    trace_set_thread_name("demux");
+    StageStats &stats = stats_.demux;
+    int serial = 0;
+    // video packets before the first keyframe can not be decoded into anything showable
+    bool want_keyframe = fast_start_;
+    int64_t discard_before = AV_NOPTS_VALUE;
+    if (packet_index_ != nullptr) {
+        packet_index_->begin_run(true);
+    }
+    while (!aborted_.load()) {
+        int requested = serial_.load();
+        if (requested != serial) {
+            serial = requested;
+            SeekMode mode = (SeekMode) seek_mode_.load();
+            int64_t target = seek_target_us_.load();
+            seek_input(target, mode);
+            discard_before = mode == SEEK_ACCURATE ? target : AV_NOPTS_VALUE;
+            discard_before_us_.store(discard_before);
+            want_keyframe = fast_start_;
+            if (packet_index_ != nullptr) {
+                packet_index_->begin_run(false);
+            }
+        }
+        int64_t start = now_us();
+        AVPacket *packet = media_packet_get();
+        int result;
+        {
+            // the payload is the demuxer's to allocate
+            LibraryCall library;
+            ScopedLatency latency(metrics_, METRIC_DEMUX_READ);
+            TraceScope trace("av_read_frame");
+            result = av_read_frame(format_context_, packet);
+            trace.set_pts(result >= 0 ? packet->pts : TRACE_NO_PTS);
+        }
+        if (result < 0) {
+            media_packet_put(&packet);
+            if (result != AVERROR_EOF) {
+                LOGE("Player Error : read frame fail");
+                fail(result);
+                break;
+            }
+            if (packet_index_ != nullptr) {
+                packet_index_->end_of_stream();
+            }
+            if (!push_eos(serial) || !hold_at_end_) {
+                break;
+            }
+            // at the end only a seek or abort gives the demuxer something to do
+            std::unique_lock<std::mutex> lock(control_mutex_);
+            control_condition_.wait(lock, [this, serial] { return aborted_.load() || serial_.load() != serial; });
+            continue;
+        }
+        media_item_set_serial(packet, serial);
+        metrics_.add(METRIC_PACKETS);
+        metrics_.add(METRIC_DEMUXED_BYTES, packet->size);
+        if (audio_ != nullptr && packet->stream_index == audio_->stream_index()) {
+            // sound ahead of an accurate seek target would play over the frames being skipped
+            if (discard_before != AV_NOPTS_VALUE && before_seek_target(packet, discard_before)) {
+                media_packet_put(&packet);
+                continue;
+            }
+            if (!audio_->packet_queue().push(packet)) {
+                media_packet_put(&packet);
+            }
+            continue;
+        }
+        if (packet_index_ != nullptr && packet->stream_index == video_stream_index_) {
+            packet_index_->add(packet);
+        }
+        // match video stream
+        if (packet->stream_index != video_stream_index_ || (want_keyframe && !(packet->flags & AV_PKT_FLAG_KEY))) {
+            media_packet_put(&packet);
+            continue;
+        }
+        want_keyframe = false;
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            keyframes_.add(packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts, packet->pos);
+            if (serial == 0 && first_keyframe_position_.load() < 0) {
+                first_keyframe_position_.store(packet->pos);
+            }
+        }
+        stats.busy_us += now_us() - start;
+        stats.items++;
+        if (!packet_queue_.push(packet)) {
+            media_packet_put(&packet);
+            break;
+        }
+    }
+    packet_queue_.close();
+    if (audio_ != nullptr) {
+        audio_->packet_queue().close();
+    }
+    stats.cpu_us = thread_cpu_us();
+}
+
+void Pipeline::seek_input(int64_t media_us, SeekMode mode) {
+    AVStream *stream = format_context_->streams[video_stream_index_];
+    int64_t timestamp = av_rescale_q(media_us, AV_TIME_BASE_Q, stream->time_base);
+    if (packet_index_ != nullptr) {
+        // the indexed keyframe is one lookup away, the demuxer would bisect or scan for it
+        PacketIndexEntry indexed;
+        bool found = mode == SEEK_FAST ? packet_index_->keyframe_nearest(timestamp, &indexed)
+                                       : packet_index_->keyframe_before(timestamp, &indexed);
+        if (found && packet_index_seek(format_context_, *packet_index_, indexed) >= 0) {
+            return;
+        }
+    }
+    if (mode == SEEK_FAST) {
+        // straight onto the closest keyframe, which may lie past the target
+        KeyframeEntry keyframe;
+        if (keyframes_.nearest(timestamp, &keyframe)
+            && avformat_seek_file(format_context_, video_stream_index_, keyframe.timestamp, keyframe.timestamp,
+                                  keyframe.timestamp, 0) >= 0) {
+            return;
+        }
+    }
+    // the keyframe at or before the target, so decoding restarts cleanly
+    int result = avformat_seek_file(format_context_, -1, INT64_MIN, media_us, media_us, 0);
+    if (result < 0) {
+        LOGE("Player Error : seek to %lld us fail", (long long) media_us);
+    }
+}
+
+// the packet ends before target_us
+bool Pipeline::before_seek_target(const AVPacket *packet, int64_t target_us) const {
+    int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (timestamp == AV_NOPTS_VALUE) {
+        return false;
+    }
+    AVRational time_base = format_context_->streams[packet->stream_index]->time_base;
+    return av_rescale_q(timestamp + packet->duration, time_base, AV_TIME_BASE_Q) <= target_us;
+}
+
+int64_t Pipeline::stream_time_us(const AVFrame *frame) const {
+    int64_t timestamp = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    if (timestamp == AV_NOPTS_VALUE) {
+        return AV_NOPTS_VALUE;
+    }
+    return av_rescale_q(timestamp, format_context_->streams[video_stream_index_]->time_base, AV_TIME_BASE_Q);
+}
+
+// decode order time of a packet for the frame rate cap, AV_NOPTS_VALUE when it has none
+int64_t Pipeline::packet_time_us(const AVPacket *packet) const {
+    int64_t timestamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (timestamp == AV_NOPTS_VALUE) {
+        return AV_NOPTS_VALUE;
+    }
+    return av_rescale_q(timestamp, format_context_->streams[video_stream_index_]->time_base, AV_TIME_BASE_Q);
+}
+
+// the first frame of a serial was posted; serial 0 is the start, not a seek
+void Pipeline::seek_presented(int serial, int64_t media_us) {
+    if (serial == measured_serial_) {
+        return;
+    }
+    measured_serial_ = serial;
+    int64_t latency = now_us() - seek_issued_us_.load();
+    std::lock_guard<std::mutex> lock(seek_stats_mutex_);
+    seek_stats_.count++;
+    seek_stats_.total_us += latency;
+    seek_stats_.max_us = FFMAX(seek_stats_.max_us, latency);
+    seek_stats_.last_us = latency;
+    seek_stats_.last_error_us = media_us != AV_NOPTS_VALUE ? media_us - seek_target_us_.load() : 0;
+}
+
+// the end of the stream goes down both queues so decode and audio drain for this serial
+bool Pipeline::push_eos(int serial) {
+    AVPacket *packet = media_packet_get();
+    packet->stream_index = -1;
+    media_item_set_serial(packet, serial);
+    if (!packet_queue_.push(packet)) {
+        media_packet_put(&packet);
+        return false;
+    }
+    if (audio_ != nullptr) {
+        packet = media_packet_get();
+        packet->stream_index = -1;
+        media_item_set_serial(packet, serial);
+        if (!audio_->packet_queue().push(packet)) {
+            media_packet_put(&packet);
+        }
+    }
+    return true;
+}
+
+void Pipeline::decode_loop() {
+    allocation_set_stage(ALLOCATION_DECODE);
+    trace_set_thread_name("video decode");
+    StageStats &stats = stats_.decode;
+    AVPacket *packet = nullptr;
+    int serial = 0;
+    // frame threads only return a frame once every thread got a packet
+    bool prime = fast_start_ && (video_codec_context_->active_thread_type & FF_THREAD_FRAME)
+                 && video_codec_context_->thread_count > 1;
+    bool priming = prime;
+    // the primed keyframe comes out of the decoder a second time, that copy is dropped
+    int64_t primed_timestamp = AV_NOPTS_VALUE;
+    // after an accurate seek, frames that end before the target
+    int64_t discard_before = AV_NOPTS_VALUE;
+    // the latest of them, shown when the stream ends before the target
+    AVFrame *skipped = nullptr;
+    int decoder_level = DEGRADE_NONE;
+    bool decoder_nonref = false;
+    // what of the cap's stats went into the metrics already
+    int64_t skipped_reported = 0;
+    int64_t saved_reported = 0;
+    int64_t capped_reported = 0;
+    while (packet_queue_.pop(packet)) {
+        int packet_serial = media_item_serial(packet);
+        if (packet_serial != serial_.load()) {
+            // demuxed before a seek
+            media_packet_put(&packet);
+            continue;
+        }
+        if (packet_serial != serial) {
+            // first packet after a seek: drop the references the decoder holds, keep the decoder
+            {
+                LibraryCall library;
+                TraceScope trace("avcodec_flush_buffers");
+                avcodec_flush_buffers(video_codec_context_);
+            }
+            serial = packet_serial;
+            discard_before = discard_before_us_.load();
+            media_frame_put(&skipped);
+            rate_cap_.reset();
+            // the keyframe alone is of no use when it is decoded only to be skipped
+            priming = prime && discard_before == AV_NOPTS_VALUE;
+            primed_timestamp = AV_NOPTS_VALUE;
+        }
+        // a null packet at the end flushes the frames the decoder still holds
+        bool eos = media_item_is_eos(packet);
+        double max_rate = max_frame_rate_.load(std::memory_order_relaxed);
+        if (max_rate != rate_cap_.max_rate()) {
+            rate_cap_.set_max_rate(max_rate);
+            LOGI("Player : frame rate capped at %.1f fps", max_rate);
+        }
+        if (!eos) {
+            bool send = rate_cap_.packet(packet_time_us(packet), process_cpu_us());
+            capped_rate_.store(rate_cap_.active_rate(), std::memory_order_relaxed);
+            const FrameRateCapStats &cap = rate_cap_.stats();
+            if (cap.discarded_frames + cap.dropped_packets != skipped_reported) {
+                metrics_.add(METRIC_RATE_CAP_SKIPPED, cap.discarded_frames + cap.dropped_packets - skipped_reported);
+                skipped_reported = cap.discarded_frames + cap.dropped_packets;
+            }
+            if (cap.capped_us != capped_reported) {
+                metrics_.add(METRIC_RATE_CAP_SAVED_US, cap.saved_us - saved_reported);
+                metrics_.add(METRIC_RATE_CAP_MEDIA_US, cap.capped_us - capped_reported);
+                saved_reported = cap.saved_us;
+                capped_reported = cap.capped_us;
+            }
+            if (!send) {
+                // an intra-only stream above the cap, the packet is not needed for any other
+                media_packet_put(&packet);
+                continue;
+            }
+        }
+        int64_t start = now_us();
+        // the decoder's time for this packet, without the waits on the frame queue
+        int64_t decode_us = 0;
+        if (priming && !eos) {
+            priming = false;
+            primed_timestamp = decode_alone(packet, serial);
+            if (aborted_.load()) {
+                media_packet_put(&packet);
+                break;
+            }
+        }
+        int level = degradation_level_.load(std::memory_order_relaxed);
+        if (level != decoder_level || rate_cap_.nonref() != decoder_nonref) {
+            decoder_level = level;
+            decoder_nonref = rate_cap_.nonref();
+            apply_decoder_skips(level, decoder_nonref);
+        }
+        int result;
+        {
+            LibraryCall library;
+            TraceScope trace("avcodec_send_packet", eos ? TRACE_NO_PTS : packet->pts);
+            result = avcodec_send_packet(video_codec_context_, eos ? nullptr : packet);
+        }
+        media_packet_put(&packet);
+        if (result < 0 && result != AVERROR(EAGAIN) && result != AVERROR_EOF) {
+            LOGE("Player Error : codec step 1 fail");
+            fail(result);
+            break;
+        }
+        bool stopped = false;
+        for (;;) {
+            AVFrame *frame = media_frame_get();
+            {
+                LibraryCall library;
+                TraceScope trace("avcodec_receive_frame");
+                result = avcodec_receive_frame(video_codec_context_, frame);
+                trace.set_pts(result >= 0 ? frame->pts : TRACE_NO_PTS);
+            }
+            if (result < 0) {
+                media_frame_put(&frame);
+                if (result != AVERROR(EAGAIN) && result != AVERROR_EOF) {
+                    LOGE("Player Error : codec step 2 fail");
+                    fail(result);
+                    stopped = true;
+                }
+                break;
+            }
+            if (primed_timestamp != AV_NOPTS_VALUE && frame->best_effort_timestamp == primed_timestamp) {
+                primed_timestamp = AV_NOPTS_VALUE;
+                media_frame_put(&frame);
+                continue;
+            }
+            if (discard_before != AV_NOPTS_VALUE) {
+                int64_t media_us = stream_time_us(frame);
+                AVRational time_base = format_context_->streams[video_stream_index_]->time_base;
+                if (media_us != AV_NOPTS_VALUE
+                    && media_us + av_rescale_q(frame->duration, time_base, AV_TIME_BASE_Q) <= discard_before) {
+                    media_frame_put(&skipped);
+                    skipped = frame;
+                    std::lock_guard<std::mutex> lock(seek_stats_mutex_);
+                    seek_stats_.discarded_frames++;
+                    continue;
+                }
+                // reached the target, the rest of the serial plays as usual
+                discard_before = AV_NOPTS_VALUE;
+                media_frame_put(&skipped);
+            }
+            decode_us += now_us() - start;
+            stats.busy_us += now_us() - start;
+            if (!push_decoded(frame, serial)) {
+                stopped = true;
+                break;
+            }
+            start = now_us();
+        }
+        if (decode_slowdown_ > 1) {
+            // a slower device, see PipelineOptions::decode_slowdown
+            int64_t until = now_us() + (int64_t) ((decode_us + now_us() - start) * (decode_slowdown_ - 1));
+            while (now_us() < until) {
+            }
+        }
+        decode_us += now_us() - start;
+        stats.busy_us += now_us() - start;
+        decode_busy_us_.store(stats.busy_us, std::memory_order_relaxed);
+        metrics_.record(METRIC_DECODE, decode_us);
+        if (stopped) {
+            break;
+        }
+        if (eos) {
+            if (skipped != nullptr) {
+                // the target was past the last frame, settle on that one
+                media_item_set_serial(skipped, serial);
+                if (!frame_queue_.push(skipped)) {
+                    media_frame_put(&skipped);
+                    break;
+                }
+                skipped = nullptr;
+                discard_before = AV_NOPTS_VALUE;
+            }
+            AVFrame *frame = media_frame_get();
+            media_item_set_serial(frame, serial);
+            if (!frame_queue_.push(frame)) {
+                media_frame_put(&frame);
+                break;
+            }
+        }
+    }
+    media_frame_put(&skipped);
+    frame_queue_.close();
+    stats.cpu_us = thread_cpu_us();
+}
+
+// decodes the keyframe that starts a serial by itself: drain it out, then flush so the
+// regular decode starts over from the same packet. Costs one extra keyframe decode and saves
+// waiting for as many packets as the decoder has frame threads. Returns the timestamp of the
+// frame it pushed, AV_NOPTS_VALUE when there was none.
+int64_t Pipeline::decode_alone(const AVPacket *packet, int serial) {
+    int64_t timestamp = AV_NOPTS_VALUE;
+    {
+        LibraryCall library;
+        TraceScope trace("avcodec_send_packet", packet->pts);
+        if (avcodec_send_packet(video_codec_context_, packet) < 0
+            || avcodec_send_packet(video_codec_context_, nullptr) < 0) {
+            avcodec_flush_buffers(video_codec_context_);
+            return timestamp;
+        }
+    }
+    bool pushed = false;
+    for (;;) {
+        AVFrame *frame = media_frame_get();
+        int result;
+        {
+            LibraryCall library;
+            TraceScope trace("avcodec_receive_frame");
+            result = avcodec_receive_frame(video_codec_context_, frame);
+            trace.set_pts(result >= 0 ? frame->pts : TRACE_NO_PTS);
+        }
+        if (result < 0) {
+            media_frame_put(&frame);
+            break;
+        }
+        if (pushed) {
+            // only the keyframe itself is wanted
+            media_frame_put(&frame);
+            continue;
+        }
+        pushed = true;
+        timestamp = frame->best_effort_timestamp;
+        push_decoded(frame, serial);
+    }
+    // leaves draining mode, the decoder takes packets again
+    LibraryCall library;
+    TraceScope trace("avcodec_flush_buffers");
+    avcodec_flush_buffers(video_codec_context_);
+    return timestamp;
+}
+
+// on the decode thread: counts a frame that left the decoder and queues it for conversion;
+// false when the queue was closed and the frame freed
+bool Pipeline::push_decoded(AVFrame *frame, int serial) {
+    media_item_set_serial(frame, serial);
+    rate_cap_.frame();
+    stats_.decode.items++;
+    metrics_.add(METRIC_FRAMES_DECODED);
+    mark_first(&first_decode_us_);
+    if (!frame_queue_.push(frame)) {
+        media_frame_put(&frame);
+        return false;
+    }
+    return true;
+}
+
+void Pipeline::mark_first(std::atomic<int64_t> *first) {
+    if (first->load(std::memory_order_relaxed) < 0) {
+        int64_t expected = -1;
+        first->compare_exchange_strong(expected, now_us() - start_us_);
+    }
+}
+
+// parks the present thread while paused. The first frame of a serial still goes out, so
+// the picture follows a seek made while paused. False when a seek made the frame stale.
+bool Pipeline::hold_while_paused(int serial) {
+    if (paused_.load() && serial == shown_serial_) {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        control_condition_.wait(lock, [this, serial] {
+            return !paused_.load() || aborted_.load() || serial_.load() != serial;
+        });
+    }
+    if (serial != serial_.load() || aborted_.load()) {
+        return false;
+    }
+    shown_serial_ = serial;
+    return true;
+}
+
+// on the stage that converts: a frame of another size or pixel format than the last one refits
+// the output size to it. True when the format changed; the first frame only sets it.
+bool Pipeline::follow_frame_format(const AVFrame *frame) {
+    if (frame->width == source_width_ && frame->height == source_height_ && frame->format == source_format_) {
+        return false;
+    }
+    bool first = source_format_ == AV_PIX_FMT_NONE;
+    source_width_ = frame->width;
+    source_height_ = frame->height;
+    source_format_ = frame->format;
+    if (scale_to_surface_) {
+        sample_aspect_ratio_ = av_guess_sample_aspect_ratio(
+                format_context_, format_context_->streams[video_stream_index_], (AVFrame *) frame);
+    }
+    refit_output();
+    if (first) {
+        return false;
+    }
+    LOGI("Player : stream changed to %dx%d %s, converting to %dx%d", frame->width, frame->height,
+         av_get_pix_fmt_name((AVPixelFormat) frame->format), width_, height_);
+    stats_.format_changes++;
+    return true;
+}
+
+// the output size for the current source, surface and degradation level
+void Pipeline::refit_output() {
+    if (scale_to_surface_) {
+        fit_output_size(source_width_, source_height_, sample_aspect_ratio_, surface_width_, surface_height_,
+                        &width_, &height_);
+    } else {
+        width_ = source_width_;
+        height_ = source_height_;
+    }
+    if (downscaled_) {
+        width_ = FFMAX(2, width_ / 2);
+        height_ = FFMAX(2, height_ / 2);
+    }
+    converter_.set_output_size(width_, height_);
+}
+
+// on the stage that converts, for every frame before it is admitted: feeds the controller and
+// applies the converter's levers when the level changed; the decoder's follow on its own thread
+void Pipeline::degrade(int64_t media_us) {
+    if (!degrade_enabled_ || media_us == AV_NOPTS_VALUE) {
+        return;
+    }
+    int from = degradation_.level();
+    if (!degradation_.update(media_us, decode_busy_us_.load(std::memory_order_relaxed), stats_.convert.busy_us)) {
+        return;
+    }
+    int level = degradation_.level();
+    degradation_level_.store(level);
+    metrics_.add(level > from ? METRIC_DEGRADE_STEP_DOWNS : METRIC_DEGRADE_STEP_UPS);
+    converter_.set_fast_filter(level >= DEGRADE_FAST_SCALER);
+    bool downscaled = level >= DEGRADE_DOWNSCALE;
+    if (downscaled != downscaled_) {
+        downscaled_ = downscaled;
+        refit_output();
+    }
+    const DegradationStats &stats = degradation_.stats();
+    LOGI("Player : decode and convert at %d%% of real time, degradation %s -> %s",
+         stats.transitions[stats.transition_count - 1].load_percent, degradation_level_name(from),
+         degradation_level_name(level));
+}
+
+// on the decode thread, before the next packet; frame threads take the flags over with it.
+// The frame rate cap discards non-reference frames as the degradation ladder does.
+void Pipeline::apply_decoder_skips(int level, bool cap_nonref) {
+    video_codec_context_->skip_loop_filter = level >= DEGRADE_SKIP_LOOP_FILTER
+                                             ? (AVDiscard) FFMAX(base_skip_loop_filter_, AVDISCARD_ALL)
+                                             : base_skip_loop_filter_;
+    video_codec_context_->skip_frame = level >= DEGRADE_SKIP_NONREF || cap_nonref
+                                       ? (AVDiscard) FFMAX(base_skip_frame_, AVDISCARD_NONREF) : base_skip_frame_;
+    video_codec_context_->skip_idct = level >= DEGRADE_SKIP_IDCT
+                                      ? (AVDiscard) FFMAX(base_skip_idct_, AVDISCARD_NONKEY) : base_skip_idct_;
+}
+
+int Pipeline::convert(const AVFrame *frame, uint8_t *rgba, int linesize) {
+    ScopedLatency latency(metrics_, METRIC_CONVERT);
+    int result = converter_.convert(frame, rgba, linesize);
+    if (result < 0) {
+        return result;
+    }
+    stats_.converted_bytes += (int64_t) width_ * height_ * 4;
+    stats_.full_size_bytes += (int64_t) frame->width * frame->height * 4;
+    metrics_.add(METRIC_CONVERTED_BYTES, (int64_t) width_ * height_ * 4);
+    return 0;
+}
+
+// on device these are ANativeWindow_lock and ANativeWindow_unlockAndPost
+int Pipeline::lock_sink(VideoSinkBuffer *buffer, int64_t pts) {
+    ScopedLatency latency(metrics_, METRIC_WINDOW_LOCK);
+    TraceScope trace("sink lock", pts);
+    return sink_->lock(buffer);
+}
+
+// only a frame the sink took counts as presented
+int Pipeline::post_sink(int64_t pts) {
+    int result;
+    {
+        ScopedLatency latency(metrics_, METRIC_WINDOW_POST);
+        TraceScope trace("sink post", pts);
+        result = sink_->post();
+    }
+    if (result >= 0) {
+        metrics_.add(METRIC_FRAMES_PRESENTED);
+    }
+    return result;
+}
+
+// on the present stage, before the sink buffer is locked: sleeps until the frame is due less
+// twice what locking and filling a buffer took lately, so the window buffer is held from there
+// to the post rather than dequeued for the whole wait. False when a pause or seek cut it short.
+bool Pipeline::wait_to_fill(int64_t media_us) {
+    return scheduler_->wait(media_us, 2 * fill_lead_us_);
+}
+
+// a sink buffer was locked and filled in elapsed_us
+void Pipeline::record_fill(int64_t elapsed_us) {
+    fill_lead_us_ += (elapsed_us - fill_lead_us_) / 4;
+}
+
+void Pipeline::record_format_change(int64_t elapsed_us) {
+    stats_.format_change_total_us += elapsed_us;
+    stats_.format_change_max_us = FFMAX(stats_.format_change_max_us, elapsed_us);
+}
+
+// on the present stage: the output size changed, the sink follows before its next lock
+int Pipeline::resize_sink(int width, int height) {
+    if (width == sink_width_ && height == sink_height_) {
+        return 0;
+    }
+    int64_t start = now_us();
+    int result = sink_->configure(width, height);
+    if (result < 0) {
+        return result;
+    }
+    sink_width_ = width;
+    sink_height_ = height;
+    int64_t elapsed = now_us() - start;
+    stats_.sink_resizes++;
+    stats_.sink_resize_max_us = FFMAX(stats_.sink_resize_max_us, elapsed);
+    return 0;
+}
+
+void Pipeline::copy_to_sink(const AVFrame *rgba_frame, const VideoSinkBuffer &buffer) {
+    // render the image to the GUI
+    // Tip: the single line pixel size of rgba_frame might be different from the counterpart of window_buffer
+    // It needs to be transformed appropriately or it might become snow screen
+    int width = rgba_frame->width < buffer.width ? rgba_frame->width : buffer.width;
+    int height = rgba_frame->height < buffer.height ? rgba_frame->height : buffer.height;
+    for (int h = 0; h < height; h++) {
+        memcpy(buffer.bits + h * buffer.linesize,
+               rgba_frame->data[0] + h * rgba_frame->linesize[0],
+               width * 4);
+    }
+    stats_.copied_bytes += (int64_t) width * height * 4;
+}
+
+// staging path: a dedicated thread converts into recycled RGBA frames
+void Pipeline::convert_loop() {
+    allocation_set_stage(ALLOCATION_CONVERT);
+    trace_set_thread_name("convert");
+    StageStats &stats = stats_.convert;
+    AVFrame *frame;
+    AVFrame *rgba_frame;
+    int serial = 0;
+    while (frame_queue_.pop(frame)) {
+        int frame_serial = media_item_serial(frame);
+        if (frame_serial != serial_.load()) {
+            media_frame_put(&frame);
+            continue;
+        }
+        if (frame_serial != serial) {
+            serial = frame_serial;
+            if (scheduler_) {
+                scheduler_->reset();
+            }
+            degradation_.reset();
+            decimator_.reset();
+        }
+        if (media_item_is_eos(frame)) {
+            // passed on to present as is
+            if (!rgba_queue_.push(frame)) {
+                media_frame_put(&frame);
+                break;
+            }
+            continue;
+        }
+        int64_t media_us = stream_time_us(frame);
+        if (!decimator_.admit(media_us, capped_rate_.load(std::memory_order_relaxed))) {
+            // above the frame rate cap, dropped before it costs a conversion
+            rate_dropped_frames_++;
+            metrics_.add(METRIC_RATE_CAP_SKIPPED);
+            media_frame_put(&frame);
+            continue;
+        }
+        if (scheduler_) {
+            // late frames are dropped before they cost a conversion
+            media_us = scheduler_->frame_time_us(frame);
+            degrade(media_us);
+            if (!scheduler_->admit(media_us)) {
+                metrics_.add(METRIC_FRAMES_DROPPED);
+                media_frame_put(&frame);
+                continue;
+            }
+        }
+        if (!rgba_free_queue_.pop(rgba_frame)) {
+            media_frame_put(&frame);
+            break;
+        }
+        int64_t start = now_us();
+        bool changed = follow_frame_format(frame);
+        if (rgba_frame->width != width_ || rgba_frame->height != height_) {
+            // staging frames follow the output size one by one as they come back from present
+            av_frame_free(&rgba_frame);
+            rgba_frame = alloc_rgba_frame(width_, height_);
+            if (rgba_frame == nullptr) {
+                media_frame_put(&frame);
+                fail(AVERROR(ENOMEM));
+                break;
+            }
+        }
+        int result = convert(frame, rgba_frame->data[0], rgba_frame->linesize[0]);
+        rgba_frame->pts = media_us;
+        // the decoded frame's own timestamp, for the trace events of present
+        rgba_frame->best_effort_timestamp = frame->pts;
+        media_item_set_serial(rgba_frame, serial);
+        media_frame_put(&frame);
+        if (result < 0) {
+            av_frame_free(&rgba_frame);
+            fail(result);
+            break;
+        }
+        int64_t elapsed = now_us() - start;
+        if (changed) {
+            record_format_change(elapsed);
+        }
+        stats.busy_us += elapsed;
+        stats.items++;
+        if (!rgba_queue_.push(rgba_frame)) {
+            av_frame_free(&rgba_frame);
+            break;
+        }
+    }
+    rgba_queue_.close();
+    stats_.degradation = degradation_.stats();
+    stats.cpu_us = thread_cpu_us();
+}
+
+// staging path: copy the converted frame into the sink
+void Pipeline::present_loop() {
+    allocation_set_stage(ALLOCATION_PRESENT);
+    trace_set_thread_name("present");
+    StageStats &stats = stats_.present;
+    AVFrame *rgba_frame;
+    VideoSinkBuffer buffer;
+    while (rgba_queue_.pop(rgba_frame)) {
+        int serial = media_item_serial(rgba_frame);
+        if (media_item_is_eos(rgba_frame)) {
+            if (serial == serial_.load()) {
+                ended_serial_.store(serial);
+            }
+            media_frame_put(&rgba_frame);
+            continue;
+        }
+        if (hold_while_paused(serial)) {
+            // still paused: this is the frame showing where a seek landed, it goes out right away
+            bool preview = paused_.load();
+            int64_t start = now_us();
+            int result = resize_sink(rgba_frame->width, rgba_frame->height);
+            if (result < 0) {
+                av_frame_free(&rgba_frame);
+                fail(result);
+                break;
+            }
+            bool timed = scheduler_ && !preview;
+            bool due = true;
+            if (timed) {
+                int64_t waiting = now_us();
+                due = wait_to_fill(rgba_frame->pts);
+                start += now_us() - waiting;
+            }
+            // play
+            int64_t filling = now_us();
+            if (lock_sink(&buffer, rgba_frame->best_effort_timestamp) >= 0) {
+                copy_to_sink(rgba_frame, buffer);
+                if (timed) {
+                    record_fill(now_us() - filling);
+                }
+                if (timed && due) {
+                    int64_t waiting = now_us();
+                    scheduler_->wait(rgba_frame->pts);
+                    start += now_us() - waiting;
+                }
+                if (post_sink(rgba_frame->best_effort_timestamp) >= 0) {
+                    mark_first(&first_present_us_);
+                    seek_presented(serial, rgba_frame->pts);
+                    if (scheduler_) {
+                        scheduler_->presented(rgba_frame->pts);
+                    }
+                    if (rgba_frame->pts != AV_NOPTS_VALUE) {
+                        position_us_.store(rgba_frame->pts);
+                    }
+                    stats_.staged_frames++;
+                }
+            }
+            stats.busy_us += now_us() - start;
+            stats.items++;
+        }
+        if (!rgba_free_queue_.push(rgba_frame)) {
+            av_frame_free(&rgba_frame);
+            break;
+        }
+    }
+    stats.cpu_us = thread_cpu_us();
+}
+
+// direct path: lock the sink first and convert into its buffer
+void Pipeline::direct_present_loop() {
+    allocation_set_stage(ALLOCATION_PRESENT);
+    trace_set_thread_name("present");
+    AVFrame *frame;
+    VideoSinkBuffer buffer;
+    int serial = 0;
+    while (frame_queue_.pop(frame)) {
+        int frame_serial = media_item_serial(frame);
+        if (frame_serial != serial_.load()) {
+            media_frame_put(&frame);
+            continue;
+        }
+        if (frame_serial != serial) {
+            serial = frame_serial;
+            if (scheduler_) {
+                scheduler_->reset();
+            }
+            degradation_.reset();
+            decimator_.reset();
+        }
+        if (media_item_is_eos(frame)) {
+            ended_serial_.store(serial);
+            media_frame_put(&frame);
+            continue;
+        }
+        int64_t media_us = stream_time_us(frame);
+        if (!decimator_.admit(media_us, capped_rate_.load(std::memory_order_relaxed))) {
+            // above the frame rate cap, dropped before it costs a lock and a conversion
+            rate_dropped_frames_++;
+            metrics_.add(METRIC_RATE_CAP_SKIPPED);
+            media_frame_put(&frame);
+            continue;
+        }
+        if (scheduler_) {
+            // late frames are dropped before they cost a lock and a conversion
+            media_us = scheduler_->frame_time_us(frame);
+            degrade(media_us);
+            if (!scheduler_->admit(media_us)) {
+                metrics_.add(METRIC_FRAMES_DROPPED);
+                media_frame_put(&frame);
+                continue;
+            }
+        }
+        if (!hold_while_paused(serial)) {
+            media_frame_put(&frame);
+            continue;
+        }
+        // still paused: this is the frame showing where a seek landed, it goes out right away
+        bool preview = paused_.load();
+        int64_t start = now_us();
+        bool changed = follow_frame_format(frame);
+        int result = resize_sink(width_, height_);
+        if (result < 0) {
+            media_frame_put(&frame);
+            fail(result);
+            break;
+        }
+        bool timed = scheduler_ && !preview;
+        bool due = true;
+        int64_t waited_us = 0;
+        if (timed) {
+            int64_t waiting = now_us();
+            due = wait_to_fill(media_us);
+            waited_us = now_us() - waiting;
+        }
+        // play
+        // the frame is released before the post
+        int64_t pts = frame->pts;
+        int64_t filling = now_us();
+        if (lock_sink(&buffer, pts) < 0) {
+            media_frame_put(&frame);
+            continue;
+        }
+        int64_t locked = now_us();
+        bool aligned = ((uintptr_t) buffer.bits % DIRECT_ALIGNMENT) == 0
+                       && buffer.linesize % DIRECT_ALIGNMENT == 0
+                       && buffer.width >= width_ && buffer.height >= height_;
+        if (aligned) {
+            result = convert(frame, buffer.bits, buffer.linesize);
+            stats_.direct_frames++;
+        } else {
+            if (staging_frame_ != nullptr && (staging_frame_->width != width_ || staging_frame_->height != height_)) {
+                av_frame_free(&staging_frame_);
+            }
+            if (staging_frame_ == nullptr) {
+                staging_frame_ = alloc_rgba_frame(width_, height_);
+            }
+            result = staging_frame_ ? convert(frame, staging_frame_->data[0], staging_frame_->linesize[0]) : AVERROR(ENOMEM);
+            if (result >= 0) {
+                copy_to_sink(staging_frame_, buffer);
+            }
+            stats_.staged_frames++;
+        }
+        media_frame_put(&frame);
+        int64_t converted = now_us();
+        if (changed) {
+            record_format_change(converted - locked);
+        }
+        stats_.convert.busy_us += converted - locked;
+        stats_.convert.items++;
+        if (timed) {
+            record_fill(converted - filling);
+        }
+        if (timed && due && result >= 0) {
+            scheduler_->wait(media_us);
+        }
+        int64_t posting = now_us();
+        // a buffer that failed to convert is still posted so the window is not left locked
+        if (post_sink(pts) >= 0) {
+            mark_first(&first_present_us_);
+            seek_presented(serial, media_us);
+            if (scheduler_) {
+                scheduler_->presented(media_us);
+            }
+            if (media_us != AV_NOPTS_VALUE) {
+                position_us_.store(media_us);
+            }
+        }
+        stats_.present.busy_us += (locked - start - waited_us) + (now_us() - posting);
+        stats_.present.items++;
+        if (result < 0) {
+            fail(result);
+            break;
+        }
+    }
+    stats_.degradation = degradation_.stats();
+    // converting happens on this thread as well, its CPU time is all counted here
+    stats_.present.cpu_us = thread_cpu_us();
+}
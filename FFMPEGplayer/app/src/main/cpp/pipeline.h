@@ -0,0 +1,355 @@
+#ifndef FFMPEGPLAYER_PIPELINE_H
+#define FFMPEGPLAYER_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+
+#include "audio_pipeline.h"
+#include "degradation_controller.h"
+#include "frame_converter.h"
+#include "frame_rate_cap.h"
+#include "keyframe_index.h"
+#include "media_queue.h"
+#include "packet_index.h"
+#include "player_metrics.h"
+#include "present_scheduler.h"
+#include "video_sink.h"
+
+// counters of one stage, written by the stage thread and read after wait() returns
+struct StageStats {
+    int64_t items = 0;
+    // time spent working, waits on the queues are excluded
+    int64_t busy_us = 0;
+    // CPU time of the stage's thread, FFmpeg's work on it included but not that of the
+    // decoder's own threads; filled in when the thread ends
+    int64_t cpu_us = 0;
+};
+
+struct PipelineStats {
+    StageStats demux;
+    StageStats decode;
+    StageStats convert;
+    StageStats present;
+    int64_t wall_us = 0;
+    // frames converted straight into the sink buffer, and ones that went through staging
+    int64_t direct_frames = 0;
+    int64_t staged_frames = 0;
+    // RGBA bytes written by the converter, and bytes copied from staging into the sink
+    int64_t converted_bytes = 0;
+    int64_t copied_bytes = 0;
+    // what the converter would have written at the frames' own size; more than converted_bytes
+    // when frames are scaled down to the surface
+    int64_t full_size_bytes = 0;
+    // frames that came in at another size or pixel format than the one before, and what the
+    // first frame of each cost to convert: the context lookup, any new buffer and the conversion
+    int64_t format_changes = 0;
+    int64_t format_change_total_us = 0;
+    int64_t format_change_max_us = 0;
+    // the sink reconfigured to a new output size mid-stream, and the longest that took
+    int64_t sink_resizes = 0;
+    int64_t sink_resize_max_us = 0;
+    // steps along the degradation ladder, only taken when playing against a clock
+    DegradationStats degradation;
+    // presentation timing, only filled in when playing against a clock
+    SchedulerStats schedule;
+    // what the frame rate cap left out and the CPU time that saved
+    FrameRateCapStats rate_cap;
+};
+
+// values are shared with FFMpegPlayer.java
+enum SeekMode {
+    // show the keyframe nearest to the target, before or after it
+    SEEK_FAST = 0,
+    // decode from the keyframe before the target and show the frame at the target
+    SEEK_ACCURATE = 1,
+};
+
+// from seek() to the first frame of the new position being posted
+struct SeekStats {
+    int64_t count = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    int64_t last_us = 0;
+    // media time of the frame shown minus the target, for the last seek
+    int64_t last_error_us = 0;
+    // decoded by accurate seeks on the way to their target and never converted
+    int64_t discarded_frames = 0;
+
+    int64_t mean_us() const { return count > 0 ? total_us / count : 0; }
+};
+
+struct PipelineOptions {
+    PipelineOptions() {
+        packet_limits.max_items = 256;
+        packet_limits.max_bytes = 16 * 1024 * 1024;
+        packet_limits.max_duration_us = 2 * 1000000;
+        frame_limits.max_items = 8;
+        frame_limits.max_bytes = 128 * 1024 * 1024;
+        frame_limits.max_duration_us = 500 * 1000;
+    }
+
+    // compressed packets between demux and decode
+    MediaQueueLimits packet_limits;
+    // decoded frames between decode and convert
+    MediaQueueLimits frame_limits;
+    // convert straight into the locked sink buffer on the present thread;
+    // false runs a separate convert thread into staging frames that present copies
+    bool direct_present = true;
+    // SIMD YUV -> RGBA kernels for 4:2:0 sources, swscale otherwise
+    bool simd_convert = true;
+    // convert to the sample aspect ratio and, when the sink knows its surface size, no larger
+    // than fits the surface; false converts at the video's own size
+    bool scale_to_surface = true;
+    // RGBA staging frames cycling between convert and present when direct_present is off
+    int rgba_frame_count = 3;
+    // present frames at their timestamps against this clock; nullptr presents as fast as possible
+    MasterClock *clock = nullptr;
+    // audio packets are routed here; pass its clock() as clock to make audio the sync master
+    AudioPipeline *audio = nullptr;
+    // keep every stage alive at the end of the stream so a seek can resume playback;
+    // wait() then only returns after abort()
+    bool hold_at_end = false;
+    // after the start and each seek, demux from the first video keyframe on and decode that
+    // one alone, so frame threading does not hold the first picture back until all of its
+    // threads have a packet
+    bool fast_start = false;
+    // packet index of the video stream: the demuxer extends it and seeks go through it
+    // while the target is inside the indexed range; not owned
+    PacketIndex *packet_index = nullptr;
+    SchedulerOptions scheduling;
+    // when decode and convert fall behind real time, give up quality step by step and take it
+    // back once there is headroom again; needs a clock
+    DegradationOptions degradation;
+    // show no more than this many frames a second, to save power; 0 shows every frame.
+    // set_max_frame_rate() changes it while playing
+    double max_frame_rate = 0;
+    // testing: every decode step is stretched to this multiple of its time by spinning on the
+    // decode thread, a slower device on a fast machine. The degradation levers cut the real
+    // decode time and with it the extra
+    double decode_slowdown = 1;
+};
+
+/**
+ * Threaded demux -> decode -> convert -> present pipeline.
+ * By default convert and present share the present thread: the sink buffer is locked
+ * first and the frame is converted straight into it, with a staging copy only when the
+ * buffer's alignment does not allow writing into it directly.
+ * Every stage owns one thread; stages are joined by lock-free SPSC queues bounded by
+ * count, bytes and duration, so a slow stage holds back the ones in front of it instead
+ * of letting memory grow.
+ * seek() bumps a serial that every queued item is tagged with: the demuxer repositions,
+ * each stage throws away what it still holds from before and the decoder is flushed rather
+ * than reopened, so the contexts, the converter and the sink survive any number of seeks.
+ * An accurate seek decodes from the keyframe before the target and drops the frames ahead of
+ * it before they reach conversion.
+ * Playing against a clock, a DegradationController watches the decode and convert load and
+ * moves along the degradation ladder: the decode thread applies the decoder's skip flags,
+ * the converting stage the cheaper scaler and the smaller output.
+ * With a frame rate cap the decode thread measures the stream's rate from its packets and
+ * cuts it down to the cap before decoding where it can; the rest is dropped before conversion.
+ * A stream that changes size or pixel format mid-way (an ABR switch, a new SPS) carries on:
+ * the stage that converts refits the output size and resizes its RGBA buffers, and the present
+ * stage reconfigures the sink when the first frame of the new size reaches it.
+ * The pipeline does not own the format/codec contexts nor the sink.
+ */
+class Pipeline {
+public:
+    Pipeline(AVFormatContext *format_context, int video_stream_index,
+             AVCodecContext *video_codec_context, VideoSink *sink,
+             const PipelineOptions &options = PipelineOptions());
+    ~Pipeline();
+
+    // start() then wait()
+    int run();
+
+    // configure the sink and start audio and the stage threads; returns 0 or a negative AVERROR
+    int start();
+
+    // join the stage threads once the stream ended, failed or was aborted;
+    // returns 0 or a negative AVERROR
+    int wait();
+
+    // the control calls below are safe from any thread and return without waiting for the stages
+    void pause();
+    void resume();
+
+    // continue from media_us, see SeekMode; works while paused and after the end
+    void seek(int64_t media_us, SeekMode mode);
+
+    // stop all stages
+    void abort();
+
+    // every frame of the stream (since the last seek) has been presented
+    bool ended() const { return ended_serial_.load() == serial_.load(); }
+    // 0 or the negative AVERROR that stopped the pipeline
+    int error() const { return error_.load(); }
+    // media time of the last frame posted, or of the last seek target
+    int64_t position_us() const { return position_us_.load(); }
+    // since start(), when the first frame left the decoder and when it was posted; -1 until then
+    int64_t first_decode_us() const { return first_decode_us_.load(); }
+    int64_t first_present_us() const { return first_present_us_.load(); }
+    // byte offset of the first video keyframe demuxed, -1 until then or when the demuxer does not say
+    int64_t first_keyframe_position() const { return first_keyframe_position_.load(); }
+
+    // safe from any thread
+    SeekStats seek_stats() const;
+    // see PipelineOptions::max_frame_rate; safe from any thread, the decode thread picks it up
+    // with the next packet
+    void set_max_frame_rate(double rate) { max_frame_rate_.store(rate); }
+
+    // the DegradationLevel playback is at; safe from any thread
+    int degradation_level() const { return degradation_level_.load(); }
+    // latency histograms and counters so far; safe from any thread while the stages run
+    MetricsSnapshot metrics() const;
+
+    const PipelineStats &stats() const { return stats_; }
+    const FrameConverter &converter() const { return converter_; }
+    // the size frames are converted to and the sink is configured with, the latest one when
+    // the stream changed size
+    int output_width() const { return width_; }
+    int output_height() const { return height_; }
+
+private:
+    void demux_loop();
+    void decode_loop();
+    void convert_loop();
+    void present_loop();
+    void direct_present_loop();
+    void seek_input(int64_t media_us, SeekMode mode);
+    bool before_seek_target(const AVPacket *packet, int64_t target_us) const;
+    int64_t stream_time_us(const AVFrame *frame) const;
+    void seek_presented(int serial, int64_t media_us);
+    bool push_eos(int serial);
+    int64_t decode_alone(const AVPacket *packet, int serial);
+    bool push_decoded(AVFrame *frame, int serial);
+    void mark_first(std::atomic<int64_t> *first);
+    bool hold_while_paused(int serial);
+    bool follow_frame_format(const AVFrame *frame);
+    void refit_output();
+    void degrade(int64_t media_us);
+    void apply_decoder_skips(int level, bool cap_nonref);
+    int64_t packet_time_us(const AVPacket *packet) const;
+    int convert(const AVFrame *frame, uint8_t *rgba, int linesize);
+    bool wait_to_fill(int64_t media_us);
+    void record_fill(int64_t elapsed_us);
+    void record_format_change(int64_t elapsed_us);
+    int resize_sink(int width, int height);
+    int lock_sink(VideoSinkBuffer *buffer, int64_t pts);
+    int post_sink(int64_t pts);
+    void copy_to_sink(const AVFrame *rgba_frame, const VideoSinkBuffer &buffer);
+    void fail(int error);
+
+    AVFormatContext *format_context_;
+    int video_stream_index_;
+    AVCodecContext *video_codec_context_;
+    VideoSink *sink_;
+    AudioPipeline *audio_;
+    SchedulerOptions scheduling_;
+    // the converted frame size, see PipelineOptions::scale_to_surface; owned by the stage that
+    // converts once started
+    int width_;
+    int height_;
+    bool scale_to_surface_;
+    int surface_width_ = 0;
+    int surface_height_ = 0;
+    // size, pixel format and aspect ratio of the frames the output size was fitted to,
+    // converting stage only; the size starts as the codec context's, the format as
+    // AV_PIX_FMT_NONE until the first frame
+    int source_width_;
+    int source_height_;
+    int source_format_;
+    AVRational sample_aspect_ratio_ = {0, 1};
+    // converting at half the fitted size, DEGRADE_DOWNSCALE
+    bool downscaled_ = false;
+    // what the sink is configured with, present stage only
+    int sink_width_ = 0;
+    int sink_height_ = 0;
+    // smoothed time from locking a sink buffer to having it filled, present stage only
+    int64_t fill_lead_us_ = 0;
+    FrameConverter converter_;
+    std::unique_ptr<PresentScheduler> scheduler_;
+    // takes over from an audio master clock whose device failed to start
+    SystemClock fallback_clock_;
+    bool direct_present_;
+    bool hold_at_end_;
+    bool fast_start_;
+    PacketIndex *packet_index_;
+    bool degrade_enabled_;
+    // converting stage only
+    DegradationController degradation_;
+    // the level the converting stage settled on, for the decode thread to apply
+    std::atomic<int> degradation_level_{DEGRADE_NONE};
+    // what the decoder was opened with, the degradation levers only ever add to it
+    AVDiscard base_skip_loop_filter_;
+    AVDiscard base_skip_frame_;
+    AVDiscard base_skip_idct_;
+    double decode_slowdown_;
+    // the decode stage's busy time so far, published for the converting stage
+    std::atomic<int64_t> decode_busy_us_{0};
+    std::atomic<double> max_frame_rate_;
+    // decode thread only
+    FrameRateCap rate_cap_;
+    // the rate the converting stage thins frames out to, published by the decode thread
+    std::atomic<double> capped_rate_{0};
+    // converting stage only
+    FrameDecimator decimator_;
+    int64_t rate_dropped_frames_ = 0;
+    // used by the direct path when a sink buffer cannot be written in place
+    AVFrame *staging_frame_ = nullptr;
+
+    MediaQueue<AVPacket *> packet_queue_;
+    MediaQueue<AVFrame *> frame_queue_;
+    // converted frames waiting for the sink, and empty ones waiting to be converted into
+    MediaQueue<AVFrame *> rgba_queue_;
+    MediaQueue<AVFrame *> rgba_free_queue_;
+
+    std::thread demux_thread_;
+    std::thread decode_thread_;
+    std::thread convert_thread_;
+    std::thread present_thread_;
+    int64_t start_us_ = 0;
+
+    // pause, seek and abort change state under this and wake whoever waits for them
+    std::mutex control_mutex_;
+    std::condition_variable control_condition_;
+    std::atomic<bool> paused_{false};
+    std::atomic<bool> aborted_{false};
+    std::atomic<int> serial_{0};
+    std::atomic<int64_t> seek_target_us_{0};
+    std::atomic<int> seek_mode_{SEEK_FAST};
+    std::atomic<int64_t> seek_issued_us_{0};
+    // the accurate seek target of the serial the demuxer is on, AV_NOPTS_VALUE when not seeking
+    // accurately; published before the first packet of the serial is queued
+    std::atomic<int64_t> discard_before_us_{AV_NOPTS_VALUE};
+    // demux thread only
+    KeyframeIndex keyframes_;
+    // serial whose end of stream reached the present stage
+    std::atomic<int> ended_serial_{-1};
+    std::atomic<int64_t> position_us_{AV_NOPTS_VALUE};
+    // serial of the last frame the present thread showed
+    int shown_serial_ = -1;
+    // last serial whose first frame went into seek_stats_
+    int measured_serial_ = 0;
+    mutable std::mutex seek_stats_mutex_;
+    SeekStats seek_stats_;
+    std::atomic<int64_t> first_decode_us_{-1};
+    std::atomic<int64_t> first_present_us_{-1};
+    std::atomic<int64_t> first_keyframe_position_{-1};
+
+    std::atomic<int> error_;
+    PipelineStats stats_;
+    PlayerMetrics metrics_;
+};
+
+#endif // FFMPEGPLAYER_PIPELINE_H
@@ -1,19 +1,21 @@
 #include <jni.h>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
-#include <android/log.h>
 
-
-// FFMPEG headers
-extern "C" {
-#include "libavutil/frame.h"
-#include "libavformat/avformat.h"
-#include "libavcodec/avcodec.h"
-#include "libswscale/swscale.h"
-#include "libavutil/imgutils.h"
-#include "libavutil/avutil.h"
-}
+#include "http_cache.h"
+#include "packet_index.h"
+#include "probe_cache.h"
+#include "log.h"
+#include "master_clock.h"
+#include "media_player.h"
+#include "media_source.h"
+#include "opensl_sink.h"
+#include "pipeline.h"
+#include "trace.h"
+#include "window_sink.h"
 
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_charles_ffmpegplayer_FFMpegPlayer_stringFromJNI(
@@ -24,8 +26,57 @@ Java_com_charles_ffmpegplayer_FFMpegPlayer_stringFromJNI(
 }
 
 
-// Android 打印 Log
-#define LOGE(FORMAT,...) __android_log_print(ANDROID_LOG_ERROR, "player", FORMAT, ##__VA_ARGS__);
+// shared by every player in the process, set once from FFMpegPlayer.setCacheDirectory
+static std::mutex http_cache_mutex;
+static HttpCache *http_cache = nullptr;
+static ProbeCache *probe_cache = nullptr;
+static PacketIndexStore *packet_index_store = nullptr;
+// the first call settles all three, whether or not each of them opened
+static bool caches_initialised = false;
+
+static HttpCache *shared_http_cache() {
+    std::lock_guard<std::mutex> lock(http_cache_mutex);
+    return http_cache;
+}
+
+static ProbeCache *shared_probe_cache() {
+    std::lock_guard<std::mutex> lock(http_cache_mutex);
+    return probe_cache;
+}
+
+static PacketIndexStore *shared_packet_index_store() {
+    std::lock_guard<std::mutex> lock(http_cache_mutex);
+    return packet_index_store;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeSetCacheDirectory(JNIEnv *env, jclass clazz, jstring directory_) {
+    std::lock_guard<std::mutex> lock(http_cache_mutex);
+    if (caches_initialised) {
+        return;
+    }
+    caches_initialised = true;
+    const char *directory = env->GetStringUTFChars(directory_, 0);
+    HttpCacheOptions options;
+    options.directory = directory;
+    env->ReleaseStringUTFChars(directory_, directory);
+    std::unique_ptr<HttpCache> cache(new HttpCache(options));
+    if (cache->open() == 0) {
+        // lives as long as the process, players may still read through it at exit
+        http_cache = cache.release();
+    }
+    // probe results of local files too, next to the cached bytes
+    std::unique_ptr<ProbeCache> probes(new ProbeCache(options.directory + "/probe"));
+    if (probes->open() == 0) {
+        probe_cache = probes.release();
+    }
+    std::unique_ptr<PacketIndexStore> indexes(new PacketIndexStore(options.directory + "/index"));
+    if (indexes->open() == 0) {
+        packet_index_store = indexes.release();
+    }
+}
+
 /**
  * play video stream
  * R# rqquest release or close memory
@@ -33,155 +84,239 @@ Java_com_charles_ffmpegplayer_FFMpegPlayer_stringFromJNI(
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_charles_ffmpegplayer_FFMpegPlayer_playVideo(JNIEnv *env, jobject instance, jstring path_, jobject surface) {
-    // save the result
-    int result;
     // R1 Java String -> C String
     const char *path = env->GetStringUTFChars(path_, 0);
-
-
-    // regiister FFmpeg component
-    // av_register_all();  // not necessary after version 4.0
-    avformat_network_init();
-    // R2 initialize AVFormatContext
-    AVFormatContext *format_context = avformat_alloc_context();
-    // open video file
-    result = avformat_open_input(&format_context, path, nullptr, nullptr);
-    if (result < 0) {
-        LOGE("Player Error : Can not open video file");
+    // R2 open the input and its video decoder
+    MediaSource source;
+    MediaSourceOptions source_options;
+    source_options.enable_audio = true;
+    // network reads happen on a fetch thread, ahead of the demuxer
+    source_options.prefetch_bytes = 8 * 1024 * 1024;
+    source_options.http_cache = shared_http_cache();
+    source_options.probe_cache = shared_probe_cache();
+    source_options.packet_index_store = shared_packet_index_store();
+    source_options.fast_start = true;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        env->ReleaseStringUTFChars(path_, path);
         return;
     }
-    // look up video file information
-    result = avformat_find_stream_info(format_context, nullptr);
-    if (result < 0) {
-        LOGE("Player Error : Can not find video file stream info");
+    // R3   initialize Native Window for video playing
+    ANativeWindow *native_window = ANativeWindow_fromSurface(env, surface);
+    if (native_window == nullptr) {
+        LOGE("Player Error : Can not create native window");
+        media_source_close(&source);
+        env->ReleaseStringUTFChars(path_, path);
         return;
     }
-    // look up video codec
-    int video_stream_index = -1;
-    for (int i = 0; i < format_context->nb_streams; i++) {
-        // match video stream
-        if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index = i;
-        }
-    }
-    // video stream  is not found
-    if (video_stream_index == -1) {
-        LOGE("Player Error : Can not find video stream");
-        return;
+    // the sink releases the window when it goes away
+    WindowSink sink(native_window);
+    // frames are shown at their timestamps, late ones are dropped before conversion
+    SystemClock clock;
+    PipelineOptions options;
+    options.clock = &clock;
+    options.fast_start = true;
+    options.packet_index = source.packet_index;
+    // with an audio stream the audio device becomes the clock video follows
+    OpenSLSink audio_sink;
+    std::unique_ptr<AudioPipeline> audio;
+    if (source.audio_codec_context != nullptr) {
+        audio.reset(new AudioPipeline(source.audio_codec_context, source.audio_stream_index,
+                                      source.format_context->streams[source.audio_stream_index]->time_base,
+                                      &audio_sink));
+        options.audio = audio.get();
+        options.clock = audio->clock();
     }
-    // initialize video codec context
-    AVCodecContext *video_codec_context = avcodec_alloc_context3(nullptr);
-    avcodec_parameters_to_context(video_codec_context, format_context->streams[video_stream_index]->codecpar);
-    // initialize video codec
-    const AVCodec *video_codec = avcodec_find_decoder(video_codec_context->codec_id);
-    if (video_codec == nullptr) {
-        LOGE("Player Error : Can not find video codec");
-        return;
+    {
+        // every stage, presenting included, runs on the pipeline's own threads; this one only
+        // waits in run() until playback ends
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, &sink, options);
+        pipeline.run();
+        StartupTimings startup = source.startup;
+        startup.first_decode_us = pipeline.first_decode_us();
+        startup.first_present_us = pipeline.first_present_us();
+        char timings[160];
+        LOGI("Player : %s", startup_timings_describe(startup, timings, sizeof(timings)));
+        media_source_remember_keyframe(&source, pipeline.first_keyframe_position());
+        const SchedulerStats &schedule = pipeline.stats().schedule;
+        LOGI("Player : presented %lld dropped %lld jitter mean %lld us max %lld us, a/v drift mean %lld us",
+             (long long) schedule.presented, (long long) schedule.dropped,
+             (long long) schedule.jitter_mean_us(), (long long) schedule.jitter_max_us,
+             (long long) schedule.offset_mean_us());
     }
-    // R3 open video codec
-    result  = avcodec_open2(video_codec_context, video_codec, nullptr);
-    if (result < 0) {
-        LOGE("Player Error : Can not find video stream");
-        return;
+    if (source.frame_pool != nullptr) {
+        FramePoolStats pool = source.frame_pool->stats();
+        LOGI("Player : frame pool %lld hits %lld misses, peak %lld KB", (long long) pool.hits,
+             (long long) pool.misses, (long long) pool.peak_bytes / 1024);
     }
-    // acquire width and height of video
-    int videoWidth = video_codec_context->width;
-    int videoHeight = video_codec_context->height;
-    // R4   initialize Native Window for video playing
+    audio.reset();
+    // release R2
+    media_source_close(&source);
+    // release R1
+    env->ReleaseStringUTFChars(path_, path);
+}
+
+static MediaPlayerOptions native_player_options() {
+    MediaPlayerOptions options;
+    options.source.http_cache = shared_http_cache();
+    options.source.probe_cache = shared_probe_cache();
+    options.source.packet_index_store = shared_packet_index_store();
+    return options;
+}
+
+/**
+ * what the handle of a Java FFMpegPlayer points to: the player and the outputs it owns.
+ * The player is declared last so it is gone before the sinks it renders into.
+ */
+struct NativePlayer {
+    explicit NativePlayer(ANativeWindow *window)
+            : video_sink(window),
+              player(&video_sink, &audio_sink, native_player_options()) {}
+
+    WindowSink video_sink;
+    OpenSLSink audio_sink;
+    MediaPlayer player;
+};
+
+static MediaPlayer *player_from_handle(jlong handle) {
+    return handle != 0 ? &reinterpret_cast<NativePlayer *>(handle)->player : nullptr;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeCreate(JNIEnv *env, jobject instance, jobject surface) {
     ANativeWindow *native_window = ANativeWindow_fromSurface(env, surface);
     if (native_window == nullptr) {
         LOGE("Player Error : Can not create native window");
-        return;
+        return 0;
     }
-    // limit the number of buffer by setting width and height, instead of physical dimensions of screen
-    // if the sizes between buffer and physical screen are different, it might be stretch or shrink image
-    result = ANativeWindow_setBuffersGeometry(native_window, videoWidth, videoHeight,WINDOW_FORMAT_RGBA_8888);
-    if (result < 0){
-        LOGE("Player Error : Can not set native window buffer");
-        ANativeWindow_release(native_window);
+    return reinterpret_cast<jlong>(new NativePlayer(native_window));
+}
+
+// the controls below only queue a command for the player's control thread and return
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativePrepare(JNIEnv *env, jobject instance, jlong handle, jstring path_) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player == nullptr) {
         return;
     }
-    // define drawing buffer
-    ANativeWindow_Buffer window_buffer;
-    // declare 3 data container
-    // R5 before decoding, it is Packet encode data in the data container
-    AVPacket *packet = av_packet_alloc();
-    // R6 after decoding, it is Frame pixel data in the data container,  the data cannot be used directly, need to be transformed first
-    AVFrame *frame = av_frame_alloc();
-    // R7 After data transform, the data in the container can be used.
-    AVFrame *rgba_frame = av_frame_alloc();
-    // data format transform preparation
-    // output Buffer
-    int buffer_size = av_image_get_buffer_size(AV_PIX_FMT_RGBA, videoWidth, videoHeight, 1);
-    // R8 request Buffer memory
-    auto *out_buffer = (uint8_t *) av_malloc(buffer_size * sizeof(uint8_t));
-    av_image_fill_arrays(rgba_frame->data, rgba_frame->linesize, out_buffer, AV_PIX_FMT_RGBA, videoWidth, videoHeight, 1);
-    // R9 Data format context transform
-    struct SwsContext *data_convert_context = sws_getContext(
-            videoWidth, videoHeight, video_codec_context->pix_fmt,
-            videoWidth, videoHeight, AV_PIX_FMT_RGBA,
-            SWS_BICUBIC, nullptr, nullptr, nullptr);
-    // start to read frame
-    while (av_read_frame(format_context, packet) >= 0) {
-        // match video stream
-        if (packet->stream_index == video_stream_index) {
-            // decode
-            result = avcodec_send_packet(video_codec_context, packet);
-            if (result < 0 && result != AVERROR(EAGAIN) && result != AVERROR_EOF) {
-                LOGE("Player Error : codec step 1 fail");
-                return;
-            }
-            result = avcodec_receive_frame(video_codec_context, frame);
-            if (result < 0 && result != AVERROR_EOF) {
-                LOGE("Player Error : codec step 2 fail");
-                return;
-            }
-            // data format transform
-            result = sws_scale(
-                    data_convert_context,
-                    (const uint8_t* const*) frame->data, frame->linesize,
-                    0, videoHeight,
-                    rgba_frame->data, rgba_frame->linesize);
-            if (result <= 0) {
-                LOGE("Player Error : data convert fail");
-                return;
-            }
-            // play
-            result = ANativeWindow_lock(native_window, &window_buffer, nullptr);
-            if (result < 0) {
-                LOGE("Player Error : Can not lock native window");
-            } else {
-                // render the image to the GUI
-                // Tip: the single line pixel size of rgba_frame might be different from the counterpart of window_buffer
-                // It needs to be transformed appropriately or it might become snow screen
-                auto *bits = (uint8_t *) window_buffer.bits;
-                for (int h = 0; h < videoHeight; h++) {
-                    memcpy(bits + h * window_buffer.stride * 4,
-                           out_buffer + h * rgba_frame->linesize[0],
-                           rgba_frame->linesize[0]);
-                }
-                ANativeWindow_unlockAndPost(native_window);
-            }
-        }
-        // release packet reference
-        av_packet_unref(packet);
-    }
-    // release R9
-    sws_freeContext(data_convert_context);
-    // release R8
-    av_free(out_buffer);
-    // release R7
-    av_frame_free(&rgba_frame);
-    // release R6
-    av_frame_free(&frame);
-    // release R5
-    av_packet_free(&packet);
-    // release R4
-    ANativeWindow_release(native_window);
-    // release R3
-    avcodec_close(video_codec_context);
-    // release R2
-    avformat_close_input(&format_context);
-    // release R1
+    const char *path = env->GetStringUTFChars(path_, 0);
+    player->prepare(path);
+    env->ReleaseStringUTFChars(path_, path);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeStart(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player != nullptr) {
+        player->start();
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativePause(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player != nullptr) {
+        player->pause();
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeSeekTo(JNIEnv *env, jobject instance, jlong handle, jlong position_ms,
+                                                         jint mode) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player != nullptr) {
+        player->seek(position_ms, mode == SEEK_FAST ? SEEK_FAST : SEEK_ACCURATE);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeStop(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player != nullptr) {
+        player->stop();
+    }
+}
+
+// blocks until the stage threads are joined and everything is freed
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeRelease(JNIEnv *env, jobject instance, jlong handle) {
+    delete reinterpret_cast<NativePlayer *>(handle);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeSetMaxFrameRate(JNIEnv *env, jobject instance, jlong handle,
+                                                                 jdouble frames_per_second) {
+    MediaPlayer *player = player_from_handle(handle);
+    if (player != nullptr) {
+        player->set_max_frame_rate(frames_per_second);
+    }
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeGetState(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    return player != nullptr ? player->state() : PLAYER_RELEASED;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeGetCurrentPosition(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    return player != nullptr ? player->position_ms() : -1;
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeGetDuration(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    return player != nullptr ? player->duration_ms() : -1;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeStartTracing(JNIEnv *env, jclass clazz, jint events_per_thread) {
+    trace_start(events_per_thread);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeStopTracing(JNIEnv *env, jclass clazz) {
+    trace_stop();
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeDumpTrace(JNIEnv *env, jclass clazz, jstring path_) {
+    const char *path = env->GetStringUTFChars(path_, 0);
+    int result = trace_dump(path);
+    if (result < 0) {
+        LOGE("Player Error : Can not write trace %s", path);
+    }
     env->ReleaseStringUTFChars(path_, path);
-}
\ No newline at end of file
+    return result;
+}
+
+// the snapshot packed by metrics_snapshot_pack(), FFMpegPlayer.PlayerStats unpacks it
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_charles_ffmpegplayer_FFMpegPlayer_nativeGetStats(JNIEnv *env, jobject instance, jlong handle) {
+    MediaPlayer *player = player_from_handle(handle);
+    int64_t values[METRICS_PACKED_SIZE] = {0};
+    if (player != nullptr) {
+        metrics_snapshot_pack(player->metrics(), values);
+    }
+    jlongArray array = env->NewLongArray(METRICS_PACKED_SIZE);
+    if (array != nullptr) {
+        env->SetLongArrayRegion(array, 0, METRICS_PACKED_SIZE, (const jlong *) values);
+    }
+    return array;
+}
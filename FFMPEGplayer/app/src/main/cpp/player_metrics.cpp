@@ -0,0 +1,107 @@
+#include "player_metrics.h"
+
+int LatencyHistogram::bucket_of(int64_t value_us) {
+    if (value_us < SUB_BUCKETS) {
+        return value_us < 0 ? 0 : (int) value_us;
+    }
+    int top_bit = 63 - __builtin_clzll((unsigned long long) value_us);
+    // the bits right below the top one pick the sub-bucket
+    int sub_bucket = (int) ((value_us >> (top_bit - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    int bucket = SUB_BUCKETS + (top_bit - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+    return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+}
+
+int64_t LatencyHistogram::bucket_value(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int top_bit = (bucket - SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS;
+    int sub_bucket = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    int64_t width = (int64_t) 1 << (top_bit - SUB_BUCKET_BITS);
+    return ((int64_t) (SUB_BUCKETS + sub_bucket) << (top_bit - SUB_BUCKET_BITS)) + width / 2;
+}
+
+void LatencyHistogram::record(int64_t value_us) {
+    if (value_us < 0) {
+        value_us = 0;
+    }
+    buckets_[bucket_of(value_us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(value_us, std::memory_order_relaxed);
+    int64_t max = max_us_.load(std::memory_order_relaxed);
+    while (value_us > max && !max_us_.compare_exchange_weak(max, value_us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<int64_t> &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    LatencySummary summary;
+    int64_t counts[BUCKET_COUNT];
+    int64_t total = 0;
+    // the buckets are the truth, count_ may be a record or two ahead of them
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return summary;
+    }
+    summary.count = total;
+    summary.mean_us = sum_us_.load(std::memory_order_relaxed) / total;
+    summary.max_us = max_us_.load(std::memory_order_relaxed);
+    const double percentiles[] = {0.50, 0.90, 0.99};
+    int64_t *values[] = {&summary.p50_us, &summary.p90_us, &summary.p99_us};
+    int64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < BUCKET_COUNT && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3 && seen >= (int64_t) (percentiles[next] * total + 0.5)) {
+            // a bucket's middle may lie past the largest value recorded
+            int64_t value = bucket_value(i);
+            *values[next++] = value < summary.max_us ? value : summary.max_us;
+        }
+    }
+    return summary;
+}
+
+#ifndef PLAYER_NO_METRICS
+
+MetricsSnapshot PlayerMetrics::snapshot() const {
+    MetricsSnapshot snapshot;
+    snapshot.enabled = true;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        snapshot.counters[i] = counters_[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        snapshot.histograms[i] = histograms_[i].summary();
+    }
+    return snapshot;
+}
+
+#endif
+
+void metrics_snapshot_pack(const MetricsSnapshot &snapshot, int64_t *values) {
+    int n = 0;
+    values[n++] = snapshot.enabled ? 1 : 0;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        values[n++] = snapshot.counters[i];
+    }
+    values[n++] = snapshot.degradation_level;
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        const LatencySummary &histogram = snapshot.histograms[i];
+        values[n++] = histogram.count;
+        values[n++] = histogram.mean_us;
+        values[n++] = histogram.p50_us;
+        values[n++] = histogram.p90_us;
+        values[n++] = histogram.p99_us;
+        values[n++] = histogram.max_us;
+    }
+}
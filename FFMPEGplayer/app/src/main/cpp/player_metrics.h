@@ -0,0 +1,153 @@
+#ifndef FFMPEGPLAYER_PLAYER_METRICS_H
+#define FFMPEGPLAYER_PLAYER_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "time_util.h"
+
+// what a LatencyHistogram holds at one moment, in microseconds
+struct LatencySummary {
+    int64_t count = 0;
+    int64_t mean_us = 0;
+    int64_t p50_us = 0;
+    int64_t p90_us = 0;
+    int64_t p99_us = 0;
+    int64_t max_us = 0;
+};
+
+/**
+ * Lock-free latency histogram in the manner of HdrHistogram: values below 16 us get a bucket
+ * each, every power of two above that is split into 16 buckets, so a percentile is off by
+ * 6.25 % at most from 1 us to over two minutes with 400 fixed buckets. record() is a handful
+ * of relaxed atomic adds, safe from any thread; summary() may run concurrently and sees each
+ * bucket at some recent value.
+ */
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // up to 2^27 us, larger values land in the last bucket
+    static const int BUCKET_COUNT = SUB_BUCKETS + (27 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(int64_t value_us);
+    LatencySummary summary() const;
+    void reset();
+
+    static int bucket_of(int64_t value_us);
+    // the middle of the values a bucket stands for
+    static int64_t bucket_value(int bucket);
+
+private:
+    std::atomic<int64_t> buckets_[BUCKET_COUNT] = {};
+    std::atomic<int64_t> count_{0};
+    std::atomic<int64_t> sum_us_{0};
+    std::atomic<int64_t> max_us_{0};
+};
+
+// the stage steps timed by the pipeline
+enum MetricHistogram {
+    METRIC_DEMUX_READ = 0,
+    METRIC_DECODE,
+    METRIC_CONVERT,
+    METRIC_WINDOW_LOCK,
+    METRIC_WINDOW_POST,
+    METRIC_HISTOGRAM_COUNT
+};
+
+enum MetricCounter {
+    METRIC_PACKETS = 0,
+    METRIC_DEMUXED_BYTES,
+    METRIC_FRAMES_DECODED,
+    METRIC_FRAMES_PRESENTED,
+    // late frames the scheduler dropped before conversion
+    METRIC_FRAMES_DROPPED,
+    METRIC_CONVERTED_BYTES,
+    // rungs of the degradation ladder taken and given back; the current level is
+    // MetricsSnapshot::degradation_level
+    METRIC_DEGRADE_STEP_DOWNS,
+    METRIC_DEGRADE_STEP_UPS,
+    // frames the frame rate cap left out, before decoding or before conversion; the process
+    // CPU time that saved, and the media time it was saved over
+    METRIC_RATE_CAP_SKIPPED,
+    METRIC_RATE_CAP_SAVED_US,
+    METRIC_RATE_CAP_MEDIA_US,
+    METRIC_COUNTER_COUNT
+};
+
+struct MetricsSnapshot {
+    // false when the player was built without metrics, everything else is 0 then
+    bool enabled = false;
+    int64_t counters[METRIC_COUNTER_COUNT] = {};
+    // the DegradationLevel playback is at when the snapshot was taken, filled in by the pipeline
+    int64_t degradation_level = 0;
+    LatencySummary histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+// a snapshot flattened for JNI: enabled, the counters, the degradation level, then count, mean,
+// p50, p90, p99 and max of every histogram. FFMpegPlayer.PlayerStats reads the same layout.
+static const int METRICS_PACKED_SIZE = 1 + METRIC_COUNTER_COUNT + 1 + 6 * METRIC_HISTOGRAM_COUNT;
+
+void metrics_snapshot_pack(const MetricsSnapshot &snapshot, int64_t *values);
+
+// Built with PLAYER_NO_METRICS (CMake option PLAYER_METRICS=OFF) the pipeline's metrics and
+// the timing around them compile to nothing.
+#ifndef PLAYER_NO_METRICS
+
+/**
+ * Latency histograms and counters of one pipeline. The stage threads record, anyone may take
+ * a snapshot while they do.
+ */
+class PlayerMetrics {
+public:
+    void record(MetricHistogram histogram, int64_t value_us) {
+        histograms_[histogram].record(value_us);
+    }
+
+    void add(MetricCounter counter, int64_t value = 1) {
+        counters_[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    LatencyHistogram histograms_[METRIC_HISTOGRAM_COUNT];
+    std::atomic<int64_t> counters_[METRIC_COUNTER_COUNT] = {};
+};
+
+// times the enclosing scope into one histogram
+class ScopedLatency {
+public:
+    ScopedLatency(PlayerMetrics &metrics, MetricHistogram histogram)
+            : metrics_(metrics), histogram_(histogram), start_us_(now_us()) {}
+
+    ~ScopedLatency() { metrics_.record(histogram_, now_us() - start_us_); }
+
+    ScopedLatency(const ScopedLatency &) = delete;
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+    PlayerMetrics &metrics_;
+    MetricHistogram histogram_;
+    int64_t start_us_;
+};
+
+#else
+
+class PlayerMetrics {
+public:
+    void record(MetricHistogram, int64_t) {}
+
+    void add(MetricCounter, int64_t = 1) {}
+
+    MetricsSnapshot snapshot() const { return MetricsSnapshot(); }
+};
+
+class ScopedLatency {
+public:
+    ScopedLatency(PlayerMetrics &, MetricHistogram) {}
+};
+
+#endif
+
+#endif // FFMPEGPLAYER_PLAYER_METRICS_H
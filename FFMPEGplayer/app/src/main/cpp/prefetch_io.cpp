@@ -0,0 +1,209 @@
+#include "prefetch_io.h"
+
+#include <cstring>
+
+#include "http_cache.h"
+#include "time_util.h"
+
+extern "C" {
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+}
+
+// what the demuxer pulls per read_callback; the ring does the real buffering
+static const int IO_BUFFER_SIZE = 32 * 1024;
+
+PrefetchReader::PrefetchReader(const PrefetchOptions &options) : options_(options) {
+    if (options_.keep_behind_bytes < 0 || options_.keep_behind_bytes > options_.capacity_bytes / 2) {
+        options_.keep_behind_bytes = options_.capacity_bytes / 4;
+    }
+    stats_.capacity_bytes = options_.capacity_bytes;
+}
+
+PrefetchReader::~PrefetchReader() {
+    abort();
+    if (fetch_thread_.joinable()) {
+        fetch_thread_.join();
+    }
+    source_.reset();
+    if (io_context_ != nullptr) {
+        av_freep(&io_context_->buffer);
+        avio_context_free(&io_context_);
+    }
+}
+
+int PrefetchReader::open(const char *url, AVDictionary **protocol_options, HttpCache *http_cache) {
+    if (http_cache != nullptr) {
+        std::unique_ptr<CachedHttpSource> cached(new CachedHttpSource(http_cache, &aborted_));
+        int result = cached->open(url, protocol_options);
+        if (result != AVERROR(ENOSYS)) {
+            return result < 0 ? result : open(std::move(cached));
+        }
+    }
+    std::unique_ptr<ProtocolSource> source(new ProtocolSource(&aborted_));
+    int result = source->open(url, protocol_options);
+    if (result < 0) {
+        return result;
+    }
+    return open(std::move(source));
+}
+
+int PrefetchReader::open(std::unique_ptr<ByteSource> source) {
+    source_ = std::move(source);
+    size_ = source_->size();
+    ring_.resize((size_t) options_.capacity_bytes);
+    auto *buffer = (unsigned char *) av_malloc(IO_BUFFER_SIZE);
+    if (buffer == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    io_context_ = avio_alloc_context(buffer, IO_BUFFER_SIZE, 0, this,
+                                     &PrefetchReader::read_callback, nullptr, &PrefetchReader::seek_callback);
+    if (io_context_ == nullptr) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+    // a live stream stays unseekable for the demuxer too
+    io_context_->seekable = source_->seekable() ? AVIO_SEEKABLE_NORMAL : 0;
+    fetch_thread_ = std::thread(&PrefetchReader::fetch_loop, this);
+    return 0;
+}
+
+void PrefetchReader::abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_.store(true);
+    if (source_) {
+        source_->abort();
+    }
+    condition_.notify_all();
+}
+
+PrefetchStats PrefetchReader::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PrefetchStats stats = stats_;
+    stats.ahead_bytes = window_end_ - read_position_;
+    stats.behind_bytes = read_position_ - window_start_;
+    return stats;
+}
+
+int PrefetchReader::read_callback(void *opaque, uint8_t *buffer, int size) {
+    return static_cast<PrefetchReader *>(opaque)->read(buffer, size);
+}
+
+int64_t PrefetchReader::seek_callback(void *opaque, int64_t offset, int whence) {
+    return static_cast<PrefetchReader *>(opaque)->seek(offset, whence);
+}
+
+int PrefetchReader::read(uint8_t *buffer, int size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (read_position_ == window_end_ && fetch_result_ == 0 && !aborted_.load()) {
+        // the network fell behind the demuxer
+        int64_t start = now_us();
+        condition_.wait(lock, [this] {
+            return aborted_.load() || (!seek_pending_ && (read_position_ < window_end_ || fetch_result_ < 0));
+        });
+        stats_.stalls++;
+        stats_.stall_us += now_us() - start;
+    }
+    if (aborted_.load()) {
+        return AVERROR_EXIT;
+    }
+    if (read_position_ == window_end_) {
+        return fetch_result_;
+    }
+    int64_t capacity = options_.capacity_bytes;
+    int length = (int) FFMIN((int64_t) size, window_end_ - read_position_);
+    int64_t offset = read_position_ % capacity;
+    int first = (int) FFMIN((int64_t) length, capacity - offset);
+    memcpy(buffer, ring_.data() + offset, (size_t) first);
+    memcpy(buffer + first, ring_.data(), (size_t) (length - first));
+    read_position_ += length;
+    // room for the fetch thread
+    condition_.notify_all();
+    return length;
+}
+
+int64_t PrefetchReader::seek(int64_t offset, int whence) {
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE) {
+        return size_ >= 0 ? size_ : AVERROR(ENOSYS);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t target;
+    if (whence == SEEK_SET) {
+        target = offset;
+    } else if (whence == SEEK_CUR) {
+        target = read_position_ + offset;
+    } else if (whence == SEEK_END && size_ >= 0) {
+        target = size_ + offset;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+    if (target >= window_start_ && target <= window_end_) {
+        // already fetched or kept behind, no round trip
+        read_position_ = target;
+        stats_.buffered_seeks++;
+        condition_.notify_all();
+        return target;
+    }
+    // outside the window: the fetch thread repositions the protocol and starts a new one there
+    generation_++;
+    window_start_ = target;
+    window_end_ = target;
+    read_position_ = target;
+    seek_pending_ = true;
+    fetch_result_ = 0;
+    stats_.protocol_seeks++;
+    condition_.notify_all();
+    return target;
+}
+
+void PrefetchReader::fetch_loop() {
+    int64_t capacity = options_.capacity_bytes;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!aborted_.load()) {
+        int generation = generation_;
+        if (seek_pending_) {
+            seek_pending_ = false;
+            int64_t target = window_end_;
+            lock.unlock();
+            int64_t result = source_->seek(target);
+            lock.lock();
+            if (generation == generation_ && result < 0) {
+                fetch_result_ = (int) result;
+            }
+            condition_.notify_all();
+            continue;
+        }
+        // the demuxer's position and what it may still seek back to are off limits
+        int64_t floor = FFMAX(window_start_, read_position_ - options_.keep_behind_bytes);
+        int64_t space = capacity - (window_end_ - floor);
+        if (fetch_result_ < 0 || space <= 0) {
+            condition_.wait(lock);
+            continue;
+        }
+        int64_t offset = window_end_ % capacity;
+        int length = (int) FFMIN(FFMIN(space, (int64_t) options_.chunk_bytes), capacity - offset);
+        // the bytes about to be overwritten leave the window before the read starts
+        window_start_ = FFMAX(window_start_, window_end_ + length - capacity);
+        lock.unlock();
+        int64_t start = now_us();
+        int result = source_->read(ring_.data() + offset, length);
+        int64_t elapsed = now_us() - start;
+        lock.lock();
+        if (generation != generation_) {
+            // a seek moved the window while this was in flight
+            continue;
+        }
+        stats_.fetch_us += elapsed;
+        if (result > 0) {
+            window_end_ += result;
+            stats_.fetched_bytes += result;
+        } else {
+            fetch_result_ = result;
+        }
+        condition_.notify_all();
+    }
+}
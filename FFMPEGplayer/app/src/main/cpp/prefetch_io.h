@@ -0,0 +1,109 @@
+#ifndef FFMPEGPLAYER_PREFETCH_IO_H
+#define FFMPEGPLAYER_PREFETCH_IO_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "libavformat/avio.h"
+}
+
+#include "byte_source.h"
+
+class HttpCache;
+
+struct PrefetchOptions {
+    // size of the ring the background thread fills ahead of the demuxer
+    int64_t capacity_bytes = 8 * 1024 * 1024;
+    // already consumed bytes kept for backward seeks; < 0 picks a quarter of the capacity
+    int64_t keep_behind_bytes = -1;
+    // largest single read from the protocol
+    int chunk_bytes = 64 * 1024;
+};
+
+struct PrefetchStats {
+    int64_t capacity_bytes = 0;
+    // bytes ready ahead of the demuxer, and consumed ones still held for seeking back
+    int64_t ahead_bytes = 0;
+    int64_t behind_bytes = 0;
+    // bytes fetched from the protocol and the time spent in its reads
+    int64_t fetched_bytes = 0;
+    int64_t fetch_us = 0;
+    // seeks served from the ring, and ones that repositioned the protocol
+    int64_t buffered_seeks = 0;
+    int64_t protocol_seeks = 0;
+    // demuxer reads that found the ring empty and had to wait for the network
+    int64_t stalls = 0;
+    int64_t stall_us = 0;
+
+    // network throughput while the fetch thread was reading, bytes per second
+    int64_t throughput_bps() const { return fetch_us > 0 ? fetched_bytes * 1000000 / fetch_us : 0; }
+    // 0..100
+    int fill_percent() const { return capacity_bytes > 0 ? (int) (ahead_bytes * 100 / capacity_bytes) : 0; }
+};
+
+/**
+ * Custom AVIOContext that reads ahead of the demuxer. A background thread pulls from a
+ * ByteSource (FFmpeg's own protocols, or the HTTP cache) into a ring buffer, so a slow network
+ * read stalls the fetch thread instead of av_read_frame on the demux thread. The ring keeps the window of the file
+ * around the read position: seeks inside it only move the read position, seeks outside it
+ * reposition the protocol and restart the window there.
+ * Positions are guarded by one mutex; the network read itself runs outside of it, into ring
+ * space the demuxer cannot see yet.
+ */
+class PrefetchReader {
+public:
+    explicit PrefetchReader(const PrefetchOptions &options = PrefetchOptions());
+    ~PrefetchReader();
+
+    // open url with FFmpeg's protocols and start fetching; returns 0 or a negative AVERROR.
+    // With a cache, http(s) URLs it can hold are read through it.
+    int open(const char *url, AVDictionary **protocol_options = nullptr, HttpCache *http_cache = nullptr);
+
+    // start fetching from an opened source, which the reader takes over
+    int open(std::unique_ptr<ByteSource> source);
+
+    // goes into AVFormatContext.pb (with AVFMT_FLAG_CUSTOM_IO); owned by the reader
+    AVIOContext *io_context() const { return io_context_; }
+
+    // fail pending and further reads with AVERROR_EXIT and stop fetching; safe from any thread
+    void abort();
+
+    PrefetchStats stats() const;
+
+private:
+    static int read_callback(void *opaque, uint8_t *buffer, int size);
+    static int64_t seek_callback(void *opaque, int64_t offset, int whence);
+
+    int read(uint8_t *buffer, int size);
+    int64_t seek(int64_t offset, int whence);
+    void fetch_loop();
+
+    PrefetchOptions options_;
+    std::vector<uint8_t> ring_;
+    std::unique_ptr<ByteSource> source_;
+    AVIOContext *io_context_ = nullptr;
+    int64_t size_ = -1;
+    std::thread fetch_thread_;
+    std::atomic<bool> aborted_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    // the ring holds the file bytes [window_start_, window_end_), the demuxer is at read_position_
+    int64_t window_start_ = 0;
+    int64_t window_end_ = 0;
+    int64_t read_position_ = 0;
+    // bumped by every protocol seek, a fetch that started before it is thrown away
+    int generation_ = 0;
+    bool seek_pending_ = false;
+    // end of file or error reported by the protocol at window_end_
+    int fetch_result_ = 0;
+    PrefetchStats stats_;
+};
+
+#endif // FFMPEGPLAYER_PREFETCH_IO_H
@@ -0,0 +1,100 @@
+#include "present_scheduler.h"
+
+#include <cstdlib>
+
+extern "C" {
+#include "libavutil/mathematics.h"
+}
+
+// waits are cut into slices so abort() and clocks that move in steps (audio) are noticed
+static const int64_t WAIT_SLICE_US = 10000;
+
+PresentScheduler::PresentScheduler(MasterClock *clock, AVRational time_base, const SchedulerOptions &options)
+        : clock_(clock), time_base_(time_base), options_(options) {
+}
+
+int64_t PresentScheduler::frame_time_us(const AVFrame *frame) {
+    static const AVRational microseconds = {1, 1000000};
+    int64_t timestamp = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    int64_t media_us;
+    if (timestamp != AV_NOPTS_VALUE) {
+        media_us = av_rescale_q(timestamp, time_base_, microseconds);
+    } else if (last_media_us_ != AV_NOPTS_VALUE) {
+        media_us = last_media_us_ + last_duration_us_;
+    } else {
+        media_us = 0;
+    }
+    if (frame->duration > 0) {
+        last_duration_us_ = av_rescale_q(frame->duration, time_base_, microseconds);
+    } else if (last_media_us_ != AV_NOPTS_VALUE && media_us > last_media_us_) {
+        last_duration_us_ = media_us - last_media_us_;
+    }
+    last_media_us_ = media_us;
+    return media_us;
+}
+
+bool PresentScheduler::admit(int64_t media_us) {
+    int64_t now = clock_->time_us();
+    if (now == AV_NOPTS_VALUE) {
+        return true;
+    }
+    if (now - media_us > options_.drop_threshold_us && consecutive_drops_ < options_.max_consecutive_drops) {
+        consecutive_drops_++;
+        stats_.dropped++;
+        return false;
+    }
+    consecutive_drops_ = 0;
+    return true;
+}
+
+bool PresentScheduler::wait(int64_t media_us, int64_t lead_us) {
+    int interrupts = interrupts_.load();
+    while (!aborted_.load(std::memory_order_relaxed) && interrupts_.load(std::memory_order_relaxed) == interrupts) {
+        int64_t now = clock_->time_us();
+        if (now == AV_NOPTS_VALUE) {
+            // the first frame ready to post starts a free-running clock
+            if (lead_us <= 0) {
+                clock_->start_at(media_us);
+            }
+            return true;
+        }
+        int64_t remaining = media_us - lead_us - now;
+        if (remaining <= 0) {
+            return true;
+        }
+        clock_->sleep_us(remaining < WAIT_SLICE_US ? remaining : WAIT_SLICE_US);
+    }
+    return false;
+}
+
+void PresentScheduler::presented(int64_t media_us) {
+    stats_.presented++;
+    int64_t now = clock_->time_us();
+    if (now == AV_NOPTS_VALUE) {
+        return;
+    }
+    stats_.offset_total_us += now - media_us;
+    int64_t jitter = llabs(now - media_us);
+    stats_.jitter_total_us += jitter;
+    if (jitter > stats_.jitter_max_us) {
+        stats_.jitter_max_us = jitter;
+    }
+    if (now - media_us > 1000) {
+        stats_.late++;
+    }
+}
+
+void PresentScheduler::reset() {
+    last_media_us_ = AV_NOPTS_VALUE;
+    last_duration_us_ = 0;
+    consecutive_drops_ = 0;
+    clock_->reset();
+}
+
+void PresentScheduler::interrupt() {
+    interrupts_.fetch_add(1);
+}
+
+void PresentScheduler::abort() {
+    aborted_.store(true);
+}
@@ -0,0 +1,87 @@
+#ifndef FFMPEGPLAYER_PRESENT_SCHEDULER_H
+#define FFMPEGPLAYER_PRESENT_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/rational.h"
+}
+
+#include "master_clock.h"
+
+struct SchedulerOptions {
+    // a frame whose deadline passed by more than this is dropped before it is converted
+    int64_t drop_threshold_us = 15000;
+    // never drop more than this many frames in a row, so a slow device still shows motion
+    int max_consecutive_drops = 8;
+};
+
+struct SchedulerStats {
+    int64_t presented = 0;
+    int64_t dropped = 0;
+    // |actual - deadline| at post time, summed and worst case
+    int64_t jitter_total_us = 0;
+    int64_t jitter_max_us = 0;
+    // presented after the deadline, but not late enough to drop
+    int64_t late = 0;
+    // signed actual - deadline summed; with the audio clock as master this is the A/V drift
+    int64_t offset_total_us = 0;
+
+    int64_t jitter_mean_us() const { return presented > 0 ? jitter_total_us / presented : 0; }
+    int64_t offset_mean_us() const { return presented > 0 ? offset_total_us / presented : 0; }
+};
+
+/**
+ * Turns frame timestamps into deadlines on a master clock.
+ * The present stage asks admit() before spending conversion work on a frame, waits with
+ * wait() until shortly before the deadline before it takes a sink buffer, and again for the
+ * deadline itself once the buffer is filled; presented() reports the post.
+ * frame_time_us()/admit() belong to the thread that converts and wait()/presented() to the
+ * one that posts, which is the same thread unless the staging path is used; interrupt() and
+ * abort() are safe from anywhere.
+ */
+class PresentScheduler {
+public:
+    PresentScheduler(MasterClock *clock, AVRational time_base, const SchedulerOptions &options = SchedulerOptions());
+
+    // media time of a decoded frame, extrapolated from the previous one when it has no timestamp
+    int64_t frame_time_us(const AVFrame *frame);
+
+    // false when the frame is already too late and should be dropped unconverted
+    bool admit(int64_t media_us);
+
+    // sleep until media_us is due on the master clock, or lead_us before that; false when
+    // interrupted or aborted first. A wait with a lead leaves starting a free-running clock to
+    // the wait for the frame's own time.
+    bool wait(int64_t media_us, int64_t lead_us = 0);
+
+    // the frame for media_us was just posted
+    void presented(int64_t media_us);
+
+    // the timeline jumped (seek): forget the frame history and re-anchor the clock on the next frame
+    void reset();
+
+    // release a wait() in progress, later waits are not affected; safe from any thread
+    void interrupt();
+
+    // release a wait() in progress and make further waits return immediately
+    void abort();
+
+    const SchedulerStats &stats() const { return stats_; }
+    MasterClock *clock() const { return clock_; }
+
+private:
+    MasterClock *clock_;
+    AVRational time_base_;
+    SchedulerOptions options_;
+    int64_t last_media_us_ = AV_NOPTS_VALUE;
+    int64_t last_duration_us_ = 0;
+    int consecutive_drops_ = 0;
+    std::atomic<bool> aborted_{false};
+    std::atomic<int> interrupts_{0};
+    SchedulerStats stats_;
+};
+
+#endif // FFMPEGPLAYER_PRESENT_SCHEDULER_H
@@ -0,0 +1,356 @@
+#include "probe_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/mem.h"
+}
+
+#include "file_util.h"
+#include "log.h"
+
+static const uint32_t PROBE_MAGIC = 0x43505046; // "FPPC"
+// bump when the layout below changes, older entries then read as misses
+static const uint32_t PROBE_VERSION = 1;
+// no stream has parameters or extradata anywhere near this
+static const int64_t MAX_ENTRY_BYTES = 1024 * 1024;
+
+// appends fixed width native endian fields; the entries never leave the device
+class ProbeWriter {
+public:
+    template <typename T>
+    void value(const T &value) {
+        int64_t wide = (int64_t) value;
+        append(&wide, sizeof(wide));
+    }
+
+    void value(const AVRational &rational) {
+        value(rational.num);
+        value(rational.den);
+    }
+
+    void bytes(const void *data, int size) {
+        value(size);
+        append(data, size);
+    }
+
+    const std::vector<uint8_t> &data() const { return data_; }
+
+private:
+    void append(const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        data_.insert(data_.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t> data_;
+};
+
+// reads what ProbeWriter wrote; running past the end clears ok() and yields zeros
+class ProbeReader {
+public:
+    ProbeReader(const uint8_t *data, size_t size) : position_(data), end_(data + size) {}
+
+    template <typename T>
+    void value(T &value) {
+        int64_t wide = 0;
+        take(&wide, sizeof(wide));
+        value = (T) wide;
+    }
+
+    void value(AVRational &rational) {
+        value(rational.num);
+        value(rational.den);
+    }
+
+    // points into the entry, valid while it is
+    const uint8_t *bytes(int *size) {
+        value(*size);
+        if (*size < 0 || *size > end_ - position_) {
+            ok_ = false;
+            *size = 0;
+            return nullptr;
+        }
+        const uint8_t *data = position_;
+        position_ += *size;
+        return data;
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    void take(void *data, size_t size) {
+        if ((size_t) (end_ - position_) < size) {
+            ok_ = false;
+            return;
+        }
+        memcpy(data, position_, size);
+        position_ += size;
+    }
+
+    const uint8_t *position_;
+    const uint8_t *end_;
+    bool ok_ = true;
+};
+
+// one list of fields for both directions, so writing and reading can not drift apart
+template <typename Io, typename Parameters>
+static void transfer_parameters(Io &io, Parameters *parameters) {
+    io.value(parameters->codec_type);
+    io.value(parameters->codec_id);
+    io.value(parameters->codec_tag);
+    io.value(parameters->format);
+    io.value(parameters->bit_rate);
+    io.value(parameters->bits_per_coded_sample);
+    io.value(parameters->bits_per_raw_sample);
+    io.value(parameters->profile);
+    io.value(parameters->level);
+    io.value(parameters->width);
+    io.value(parameters->height);
+    io.value(parameters->sample_aspect_ratio);
+    io.value(parameters->framerate);
+    io.value(parameters->field_order);
+    io.value(parameters->color_range);
+    io.value(parameters->color_primaries);
+    io.value(parameters->color_trc);
+    io.value(parameters->color_space);
+    io.value(parameters->chroma_location);
+    io.value(parameters->video_delay);
+    io.value(parameters->ch_layout.order);
+    io.value(parameters->ch_layout.nb_channels);
+    io.value(parameters->ch_layout.u.mask);
+    io.value(parameters->sample_rate);
+    io.value(parameters->block_align);
+    io.value(parameters->frame_size);
+    io.value(parameters->initial_padding);
+    io.value(parameters->trailing_padding);
+    io.value(parameters->seek_preroll);
+}
+
+template <typename Io, typename Stream>
+static void transfer_stream(Io &io, Stream *stream) {
+    io.value(stream->time_base);
+    io.value(stream->avg_frame_rate);
+    io.value(stream->r_frame_rate);
+    io.value(stream->sample_aspect_ratio);
+    io.value(stream->start_time);
+    io.value(stream->duration);
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> *data) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint8_t chunk[16 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0 && (int64_t) data->size() <= MAX_ENTRY_BYTES) {
+        data->insert(data->end(), chunk, chunk + read);
+    }
+    fclose(file);
+    return (int64_t) data->size() <= MAX_ENTRY_BYTES;
+}
+
+int ProbeCache::open() {
+    int result = make_directories(directory_);
+    if (result < 0) {
+        LOGE("Player Error : Can not create probe cache directory %s", directory_.c_str());
+    }
+    return result;
+}
+
+std::string ProbeCache::path(const std::string &url) const {
+    return directory_ + "/" + url_file_key(url) + ".probe";
+}
+
+bool ProbeCache::apply(const std::string &url, AVFormatContext *format_context, int64_t *first_keyframe_position) {
+    std::vector<uint8_t> data;
+    int64_t size;
+    int64_t mtime;
+    if (!input_identity(url, format_context, &size, &mtime) || !read_file(path(url), &data)) {
+        misses_++;
+        return false;
+    }
+    ProbeReader reader(data.data(), data.size());
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    int64_t entry_size = 0;
+    int64_t entry_mtime = 0;
+    reader.value(magic);
+    reader.value(version);
+    reader.value(entry_size);
+    reader.value(entry_mtime);
+    int url_size = 0;
+    const uint8_t *entry_url = reader.bytes(&url_size);
+    if (!reader.ok() || magic != PROBE_MAGIC || version != PROBE_VERSION || entry_size != size || entry_mtime != mtime
+        || url_size != (int) url.size() || memcmp(entry_url, url.data(), url.size()) != 0) {
+        misses_++;
+        return false;
+    }
+    int64_t start_time = AV_NOPTS_VALUE;
+    int64_t duration = AV_NOPTS_VALUE;
+    int64_t bit_rate = 0;
+    unsigned int stream_count = 0;
+    reader.value(start_time);
+    reader.value(duration);
+    reader.value(bit_rate);
+    reader.value(*first_keyframe_position);
+    reader.value(stream_count);
+
+    // everything is checked before the first stream is touched
+    struct EntryStream {
+        AVRational time_base;
+        AVRational avg_frame_rate;
+        AVRational r_frame_rate;
+        AVRational sample_aspect_ratio;
+        int64_t start_time;
+        int64_t duration;
+    };
+    bool matches = reader.ok() && stream_count == format_context->nb_streams;
+    std::vector<EntryStream> streams(matches ? stream_count : 0);
+    std::vector<AVCodecParameters *> parameters(streams.size(), nullptr);
+    for (unsigned int i = 0; matches && i < stream_count; i++) {
+        transfer_stream(reader, &streams[i]);
+        parameters[i] = avcodec_parameters_alloc();
+        if (parameters[i] == nullptr) {
+            matches = false;
+            break;
+        }
+        transfer_parameters(reader, parameters[i]);
+        int extradata_size = 0;
+        const uint8_t *extradata = reader.bytes(&extradata_size);
+        if (extradata_size > 0) {
+            parameters[i]->extradata = (uint8_t *) av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (parameters[i]->extradata != nullptr) {
+                memcpy(parameters[i]->extradata, extradata, (size_t) extradata_size);
+                parameters[i]->extradata_size = extradata_size;
+            }
+        }
+        const AVStream *stream = format_context->streams[i];
+        // the header has to describe the same streams the entry was made from
+        matches = reader.ok() && parameters[i]->codec_type == stream->codecpar->codec_type
+                  && av_cmp_q(streams[i].time_base, stream->time_base) == 0
+                  && (stream->codecpar->codec_id == AV_CODEC_ID_NONE
+                      || stream->codecpar->codec_id == parameters[i]->codec_id);
+    }
+    for (unsigned int i = 0; matches && i < stream_count; i++) {
+        AVStream *stream = format_context->streams[i];
+        // side data the header attached (display matrix, ...) is not in the entry, carry it over
+        AVPacketSideData *side_data = stream->codecpar->coded_side_data;
+        int side_data_count = stream->codecpar->nb_coded_side_data;
+        stream->codecpar->coded_side_data = nullptr;
+        stream->codecpar->nb_coded_side_data = 0;
+        avcodec_parameters_copy(stream->codecpar, parameters[i]);
+        av_packet_side_data_free(&stream->codecpar->coded_side_data, &stream->codecpar->nb_coded_side_data);
+        stream->codecpar->coded_side_data = side_data;
+        stream->codecpar->nb_coded_side_data = side_data_count;
+        stream->avg_frame_rate = streams[i].avg_frame_rate;
+        stream->r_frame_rate = streams[i].r_frame_rate;
+        stream->sample_aspect_ratio = streams[i].sample_aspect_ratio;
+        if (stream->start_time == AV_NOPTS_VALUE) {
+            stream->start_time = streams[i].start_time;
+        }
+        if (stream->duration == AV_NOPTS_VALUE) {
+            stream->duration = streams[i].duration;
+        }
+    }
+    for (AVCodecParameters *entry : parameters) {
+        avcodec_parameters_free(&entry);
+    }
+    if (!matches) {
+        misses_++;
+        return false;
+    }
+    if (format_context->start_time == AV_NOPTS_VALUE) {
+        format_context->start_time = start_time;
+    }
+    if (format_context->duration == AV_NOPTS_VALUE) {
+        format_context->duration = duration;
+    }
+    if (format_context->bit_rate <= 0) {
+        format_context->bit_rate = bit_rate;
+    }
+    hits_++;
+    return true;
+}
+
+void ProbeCache::store(const std::string &url, const AVFormatContext *format_context, int64_t first_keyframe_position) {
+    int64_t size;
+    int64_t mtime;
+    if (!input_identity(url, format_context, &size, &mtime)) {
+        // live input, nothing to tell its versions apart with
+        return;
+    }
+    ProbeWriter writer;
+    writer.value(PROBE_MAGIC);
+    writer.value(PROBE_VERSION);
+    writer.value(size);
+    writer.value(mtime);
+    writer.bytes(url.data(), (int) url.size());
+    writer.value(format_context->start_time);
+    writer.value(format_context->duration);
+    writer.value(format_context->bit_rate);
+    writer.value(first_keyframe_position);
+    writer.value(format_context->nb_streams);
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        const AVStream *stream = format_context->streams[i];
+        const AVCodecParameters *parameters = stream->codecpar;
+        if (parameters->ch_layout.order != AV_CHANNEL_ORDER_NATIVE
+            && parameters->ch_layout.order != AV_CHANNEL_ORDER_UNSPEC) {
+            // a custom channel map has no compact form, probe such inputs every time
+            return;
+        }
+        transfer_stream(writer, stream);
+        transfer_parameters(writer, parameters);
+        writer.bytes(parameters->extradata, parameters->extradata_size);
+    }
+    // written aside and renamed over, a reader never sees half an entry
+    std::string final_path = path(url);
+    std::string temporary = final_path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    bool written = fwrite(writer.data().data(), 1, writer.data().size(), file) == writer.data().size();
+    if (fclose(file) == 0 && written && rename(temporary.c_str(), final_path.c_str()) == 0) {
+        stores_++;
+    } else {
+        remove(temporary.c_str());
+    }
+}
+
+void ProbeCache::store_keyframe(const std::string &url, int64_t first_keyframe_position) {
+    std::vector<uint8_t> data;
+    if (!read_file(path(url), &data)) {
+        return;
+    }
+    // the offset sits right behind the header and the container timings
+    size_t offset = 4 * sizeof(int64_t) + sizeof(int64_t) + url.size() + 3 * sizeof(int64_t);
+    ProbeReader reader(data.data(), data.size());
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    reader.value(magic);
+    reader.value(version);
+    if (!reader.ok() || magic != PROBE_MAGIC || version != PROBE_VERSION || data.size() < offset + sizeof(int64_t)) {
+        return;
+    }
+    FILE *file = fopen(path(url).c_str(), "r+b");
+    if (file == nullptr) {
+        return;
+    }
+    if (fseek(file, (long) offset, SEEK_SET) == 0) {
+        fwrite(&first_keyframe_position, sizeof(first_keyframe_position), 1, file);
+    }
+    fclose(file);
+}
+
+ProbeCacheStats ProbeCache::stats() const {
+    ProbeCacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.stores = stores_.load();
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef FFMPEGPLAYER_PROBE_CACHE_H
+#define FFMPEGPLAYER_PROBE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+struct ProbeCacheStats {
+    int64_t hits = 0;
+    // no entry, or one for another version of the input
+    int64_t misses = 0;
+    int64_t stores = 0;
+};
+
+/**
+ * What avformat_find_stream_info found out about an input, kept on disk so opening it again
+ * goes straight from the container header to decoding. An entry holds every stream's codec
+ * parameters with extradata, the stream layout and timings, and the byte offset of the first
+ * video keyframe. It is keyed by URL and only used while the input still has the size (and,
+ * for local files, the modification time) it had when the entry was written.
+ * One small file per input; safe to share between players.
+ */
+class ProbeCache {
+public:
+    explicit ProbeCache(const std::string &directory) : directory_(directory) {}
+
+    // create the directory; returns 0 or a negative AVERROR
+    int open();
+
+    // fill the streams of a format context fresh out of avformat_open_input from the entry for url.
+    // False, leaving the context alone, when there is none or it does not match the input.
+    bool apply(const std::string &url, AVFormatContext *format_context, int64_t *first_keyframe_position);
+
+    // remember the probed streams of url; first_keyframe_position is -1 while unknown
+    void store(const std::string &url, const AVFormatContext *format_context, int64_t first_keyframe_position);
+
+    // fill in the first keyframe offset of an entry store() wrote, once playback found it
+    void store_keyframe(const std::string &url, int64_t first_keyframe_position);
+
+    ProbeCacheStats stats() const;
+
+private:
+    std::string path(const std::string &url) const;
+
+    std::string directory_;
+    std::atomic<int64_t> hits_{0};
+    std::atomic<int64_t> misses_{0};
+    std::atomic<int64_t> stores_{0};
+};
+
+#endif // FFMPEGPLAYER_PROBE_CACHE_H
@@ -0,0 +1,60 @@
+#include "reduced_decode.h"
+
+#include <cstdio>
+#include <cstring>
+
+ReducedDecode reduced_decode_choose(const AVCodec *codec, const AVCodecParameters *codecpar,
+                                    const ReducedDecodeOptions &options) {
+    ReducedDecode reduced;
+    if (options.display_width <= 0 || options.display_height <= 0 || codecpar->width <= 0 || codecpar->height <= 0) {
+        return reduced;
+    }
+    while (reduced.lowres < codec->max_lowres
+           && (codecpar->width >> (reduced.lowres + 1)) >= options.display_width
+           && (codecpar->height >> (reduced.lowres + 1)) >= options.display_height) {
+        reduced.lowres++;
+    }
+    int width = codecpar->width >> reduced.lowres;
+    int height = codecpar->height >> reduced.lowres;
+    reduced.skip_loop_filter = width >= 2 * options.display_width && height >= 2 * options.display_height;
+    reduced.gray = options.allow_gray;
+    reduced.skip_nonref = options.skip_nonref;
+    return reduced;
+}
+
+void reduced_decode_apply(AVCodecContext *codec_context, const ReducedDecode &reduced) {
+    codec_context->lowres = reduced.lowres;
+    if (reduced.gray) {
+        codec_context->flags |= AV_CODEC_FLAG_GRAY;
+    }
+    if (reduced.skip_loop_filter) {
+        codec_context->skip_loop_filter = AVDISCARD_ALL;
+    }
+    if (reduced.skip_nonref) {
+        codec_context->skip_frame = AVDISCARD_NONREF;
+    }
+    if (reduced.reduced()) {
+        // shortcuts outside the spec that some decoders take, invisible at a fraction of the size
+        codec_context->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+}
+
+const char *reduced_decode_describe(const ReducedDecode &reduced, char *buffer, int size) {
+    if (!reduced.reduced()) {
+        snprintf(buffer, size, "full");
+        return buffer;
+    }
+    buffer[0] = '\0';
+    int length = 0;
+    if (reduced.lowres > 0) {
+        length += snprintf(buffer + length, size - length, "lowres %d", reduced.lowres);
+    }
+    const char *parts[] = {reduced.skip_loop_filter ? "no loop filter" : nullptr, reduced.gray ? "gray" : nullptr,
+                           reduced.skip_nonref ? "reference frames only" : nullptr};
+    for (const char *part : parts) {
+        if (part != nullptr && length < size) {
+            length += snprintf(buffer + length, size - length, "%s%s", length > 0 ? ", " : "", part);
+        }
+    }
+    return buffer;
+}
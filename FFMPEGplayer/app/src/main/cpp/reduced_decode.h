@@ -0,0 +1,48 @@
+#ifndef FFMPEGPLAYER_REDUCED_DECODE_H
+#define FFMPEGPLAYER_REDUCED_DECODE_H
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+// for video shown much smaller than it was coded: grid tiles, picture-in-picture
+struct ReducedDecodeOptions {
+    // the size the video is shown at; 0 decodes at full cost
+    int display_width = 0;
+    int display_height = 0;
+    // decoders that can leave chroma out (AV_CODEC_FLAG_GRAY) do, for tiles where a grey
+    // picture will do; only FFmpeg builds configured with --enable-gray honour it
+    bool allow_gray = false;
+    // decode reference frames only, which halves the frame rate of most streams
+    bool skip_nonref = false;
+};
+
+// what a decoder was set to cut
+struct ReducedDecode {
+    // the decoder outputs 1 / 2^lowres of the coded size each way
+    int lowres = 0;
+    bool gray = false;
+    // no deblocking, its effect is gone once the picture is scaled down by half or more
+    bool skip_loop_filter = false;
+    bool skip_nonref = false;
+
+    bool reduced() const { return lowres > 0 || gray || skip_loop_filter || skip_nonref; }
+};
+
+/**
+ * Choose how far a decoder that is about to be opened can cut its work for the display size.
+ * Decoders with lowres (MJPEG, MPEG-1/2/4, H.263 and a few more) output the largest
+ * power-of-two reduction that is still no smaller than the display, so the inverse transform
+ * and motion compensation run at that size. Whatever is still twice the display size or more
+ * after that decodes without the loop filter.
+ */
+ReducedDecode reduced_decode_choose(const AVCodec *codec, const AVCodecParameters *codecpar,
+                                    const ReducedDecodeOptions &options);
+
+// copy the choice into the context, must be called before avcodec_open2
+void reduced_decode_apply(AVCodecContext *codec_context, const ReducedDecode &reduced);
+
+// "lowres 2, no loop filter", "full"
+const char *reduced_decode_describe(const ReducedDecode &reduced, char *buffer, int size);
+
+#endif // FFMPEGPLAYER_REDUCED_DECODE_H
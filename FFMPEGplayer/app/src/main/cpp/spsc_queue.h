@@ -0,0 +1,80 @@
+#ifndef FFMPEGPLAYER_SPSC_QUEUE_H
+#define FFMPEGPLAYER_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+/**
+ * Wait-free single-producer/single-consumer ring.
+ * Only one thread may call try_push and only one thread may call try_pop.
+ * Capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // producer side, returns false when the ring is full
+    bool try_push(const T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, returns false when the ring is empty
+    bool try_pop(T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate when called while the other side is running
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    // consumer owned; padding instead of alignas so the queue can live in plain new'd objects
+    char consumer_padding_[CACHE_LINE_SIZE];
+    std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+    // producer owned
+    char producer_padding_[CACHE_LINE_SIZE];
+    std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+};
+
+#endif // FFMPEGPLAYER_SPSC_QUEUE_H
@@ -0,0 +1,48 @@
+#ifndef FFMPEGPLAYER_TIME_UTIL_H
+#define FFMPEGPLAYER_TIME_UTIL_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+// monotonic time in microseconds, only meaningful as a difference
+inline int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time the calling thread has used so far, in microseconds
+inline int64_t thread_cpu_us() {
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) < 0) {
+        return 0;
+    }
+    return (int64_t) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+// CPU time of the whole process so far, decoder threads included, in microseconds
+inline int64_t process_cpu_us() {
+    struct timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) < 0) {
+        return 0;
+    }
+    return (int64_t) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+// sleep_for alone overshoots by a scheduler tick; sleep most of the way and yield-spin the rest
+inline void precise_sleep_us(int64_t duration_us) {
+    if (duration_us <= 0) {
+        return;
+    }
+    int64_t deadline = now_us() + duration_us;
+    const int64_t spin_window_us = 1500;
+    if (duration_us > spin_window_us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(duration_us - spin_window_us));
+    }
+    while (now_us() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+#endif // FFMPEGPLAYER_TIME_UTIL_H
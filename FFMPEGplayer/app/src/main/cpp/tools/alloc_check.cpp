@@ -0,0 +1,159 @@
+// Plays a file through the pipeline with the counting malloc linked in and checks that the
+// stage threads stop allocating once playback has warmed up.
+//   alloc_check [--warmup <frames>] [--audio] [--staging] [--index <dir>] <file>
+// Only built with -DPLAYER_COUNT_ALLOCATIONS=ON; tools/run_alloc_check.sh generates a
+// ten minute clip and runs it.
+// --warmup is the number of presented frames left out of the check, 250 by default: queues
+// filling, the frame pool and the converter settling in.
+// --audio decodes the audio track into a null device as well; that device plays in real time,
+// so the run takes as long as the clip.
+// Allocations FFmpeg makes inside its own calls are reported but not held against the player:
+// every demuxed packet needs a payload and every reference handed out costs FFmpeg an
+// AVBufferRef. Exits 1 when the player's own code allocated on a stage thread after the warm-up,
+// or when the frame pool still grew then. Under frame threading the pool grows from FFmpeg's
+// worker threads, which carry no stage, so its misses are checked on their own.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "alloc_counter.h"
+#include "audio_pipeline.h"
+#include "audio_sink.h"
+#include "media_source.h"
+#include "packet_index.h"
+#include "pipeline.h"
+#include "video_sink.h"
+
+// takes the counts as the warm-up ends and again with every frame after it
+class CountingSink : public NullSink {
+public:
+    CountingSink(int64_t warmup_frames, const FramePool *frame_pool)
+            : warmup_frames_(warmup_frames), frame_pool_(frame_pool) {}
+
+    int post() override {
+        int result = NullSink::post();
+        int64_t frames = this->frames();
+        if (frames == warmup_frames_) {
+            warm_ = allocation_counts();
+            warm_misses_ = pool_misses();
+        } else if (frames > warmup_frames_) {
+            last_ = allocation_counts();
+            last_misses_ = pool_misses();
+        }
+        return result;
+    }
+
+    // read once the pipeline has stopped
+    const AllocationCounts &warm() const { return warm_; }
+    const AllocationCounts &last() const { return last_; }
+    int64_t pool_misses_after_warmup() const { return last_misses_ - warm_misses_; }
+
+private:
+    int64_t pool_misses() const { return frame_pool_ != nullptr ? frame_pool_->stats().misses : 0; }
+
+    int64_t warmup_frames_;
+    const FramePool *frame_pool_;
+    AllocationCounts warm_;
+    AllocationCounts last_;
+    int64_t warm_misses_ = 0;
+    int64_t last_misses_ = 0;
+};
+
+// stages whose threads have to stay clear of the allocator
+static bool checked(int stage) {
+    return stage != ALLOCATION_OTHER;
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    const char *index_directory = nullptr;
+    int64_t warmup_frames = 250;
+    bool play_audio = false;
+    MediaSourceOptions source_options;
+    PipelineOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup_frames = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--audio") == 0) {
+            play_audio = true;
+        } else if (strcmp(argv[i], "--staging") == 0) {
+            options.direct_present = false;
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_directory = argv[++i];
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr || warmup_frames < 1) {
+        fprintf(stderr, "usage: %s [--warmup <frames>] [--audio] [--staging] [--index <dir>] <file>\n", argv[0]);
+        return 2;
+    }
+    std::unique_ptr<PacketIndexStore> index_store;
+    if (index_directory != nullptr) {
+        index_store.reset(new PacketIndexStore(index_directory));
+        if (index_store->open() < 0) {
+            return 1;
+        }
+        source_options.packet_index_store = index_store.get();
+    }
+    MediaSource source;
+    source_options.enable_audio = play_audio;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        return 1;
+    }
+    options.packet_index = source.packet_index;
+    NullAudioSink audio_sink;
+    std::unique_ptr<AudioPipeline> audio;
+    if (source.audio_codec_context != nullptr) {
+        audio.reset(new AudioPipeline(source.audio_codec_context, source.audio_stream_index,
+                                      source.format_context->streams[source.audio_stream_index]->time_base,
+                                      &audio_sink));
+        options.audio = audio.get();
+    }
+    CountingSink sink(warmup_frames, source.frame_pool);
+    int result;
+    PipelineStats stats;
+    {
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, &sink, options);
+        result = pipeline.run();
+        stats = pipeline.stats();
+    }
+    audio.reset();
+    media_source_close(&source);
+    if (result < 0) {
+        fprintf(stderr, "playback failed\n");
+        return 1;
+    }
+
+    int64_t frames = sink.frames() - warmup_frames;
+    if (frames <= 0) {
+        fprintf(stderr, "only %lld frames, nothing left after the %lld frame warm-up\n",
+                (long long) sink.frames(), (long long) warmup_frames);
+        return 1;
+    }
+    printf("%lld frames after a %lld frame warm-up, %lld packets demuxed in all\n",
+           (long long) frames, (long long) warmup_frames, (long long) stats.demux.items);
+    printf("%-8s %12s %12s %14s\n", "stage", "player", "per frame", "ffmpeg/frame");
+    bool clean = true;
+    for (int stage = 0; stage < ALLOCATION_STAGE_COUNT; stage++) {
+        int64_t player = sink.last().player[stage] - sink.warm().player[stage];
+        int64_t library = sink.last().library[stage] - sink.warm().library[stage];
+        printf("%-8s %12lld %12.3f %14.2f%s\n", allocation_stage_name(stage), (long long) player,
+               player / (double) frames, library / (double) frames,
+               checked(stage) && player > 0 ? "  <- allocates in steady state" : "");
+        if (checked(stage) && player > 0) {
+            clean = false;
+        }
+    }
+    int64_t pool_misses = sink.pool_misses_after_warmup();
+    printf("frame pool %lld new buffers%s\n", (long long) pool_misses,
+           pool_misses > 0 ? "  <- grows in steady state" : "");
+    if (pool_misses > 0) {
+        clean = false;
+    }
+    printf("%s\n", clean ? "PASS" : "FAIL");
+    return clean ? 0 : 1;
+}
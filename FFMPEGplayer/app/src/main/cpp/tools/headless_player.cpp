@@ -0,0 +1,361 @@
+// Runs the player pipeline without a display so stage throughput can be measured on Linux.
+//   headless_player [--realtime] [--audio null|<file.wav>] [--sink null|memory|raw:<file>|y4m:<file>] [--staging] [--misalign]
+//                   [--surface <w>x<h>] [--full-size] [--tile <w>x<h>] [--gray] [--skip-nonref] [--max-fps <rate>] [--slow-decode <factor>] [--no-degrade] [--prefetch <MB>] [--cache <dir>] [--probe-cache <dir>] [--index <dir>] [--fast-start] [--no-pool]
+//                   [--trace <file.json>] <file or url>
+// Without --realtime it plays flat out, as fast as the stages go.
+// --realtime presents at the frame timestamps against the system clock instead of flat out.
+// --audio plays the audio track into a null device or a WAV file; with --realtime the audio
+// clock becomes the master and the A/V drift is reported.
+// --sink memory presents into a fake window with a padded stride, --misalign shifts its
+// buffers off alignment to exercise the staging fallback, --staging forces the copy path.
+// --sink raw:<file> writes the presented frames as bare RGBA, y4m:<file> as YUV4MPEG2.
+// --surface makes the null and memory sinks report a surface of that size, frames are then
+// scaled down to fit it the way they are for a small view on device; --full-size converts at
+// the video's own size whatever the surface.
+// --tile shows the video in a tile of that size: the surface is set to it and the decoder
+// produces no more than it needs for it, with lowres where the codec has it and without the
+// loop filter otherwise. --gray leaves out chroma on top where the decoder can, --skip-nonref
+// decodes the reference frames alone.
+// --max-fps caps the frame rate shown: non-reference frames are discarded in the decoder where
+// that does not go below the cap, the rest is dropped before conversion, and the CPU time it
+// saved is reported per minute of capped playback.
+// --slow-decode stretches every decode step to that multiple of its time, a slower device;
+// with --realtime the degradation ladder then has to step in, --no-degrade keeps it out.
+// --prefetch reads the input ahead of the demuxer into a ring of that many MB.
+// --cache keeps http(s) input in that directory and reads it back from there on later runs;
+// it works through the prefetcher and turns it on when --prefetch is not given.
+// --probe-cache remembers the stream info of every input there, a second run skips the probe.
+// --index keeps a packet index of every input there, built while playing and used for the
+// duration and for seeks on later runs.
+// --fast-start bounds stream probing and gets the first keyframe out of the decoder early.
+// --no-pool leaves frame buffers to FFmpeg's allocator instead of the frame pool.
+// --trace records a timeline of the run and writes it as Chrome trace JSON at the end, for
+// ui.perfetto.dev or chrome://tracing.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "audio_pipeline.h"
+#include "audio_sink.h"
+#include "file_sink.h"
+#include "http_cache.h"
+#include "packet_index.h"
+#include "probe_cache.h"
+#include "trace.h"
+#include "master_clock.h"
+#include "media_source.h"
+#include "memory_sink.h"
+#include "pipeline.h"
+#include "video_sink.h"
+
+static void print_stage(const char *name, const StageStats &stats) {
+    double fps = stats.busy_us > 0 ? stats.items * 1e6 / stats.busy_us : 0;
+    printf("%-8s %8lld items %10.1f ms busy %10.1f fps %10.1f ms cpu\n",
+           name, (long long) stats.items, stats.busy_us / 1000.0, fps, stats.cpu_us / 1000.0);
+}
+
+static void print_latency(const char *name, const LatencySummary &latency) {
+    printf("%-12s %8lld x mean %8lld p50 %8lld p90 %8lld p99 %8lld max %8lld us\n", name, (long long) latency.count,
+           (long long) latency.mean_us, (long long) latency.p50_us, (long long) latency.p90_us,
+           (long long) latency.p99_us, (long long) latency.max_us);
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    const char *sink_name = "null";
+    bool misalign = false;
+    const char *audio_output = nullptr;
+    const char *cache_directory = nullptr;
+    const char *probe_directory = nullptr;
+    const char *index_directory = nullptr;
+    const char *trace_path = nullptr;
+    int surface_width = 0;
+    int surface_height = 0;
+    MediaSourceOptions source_options;
+    PipelineOptions options;
+    SystemClock clock;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sink") == 0 && i + 1 < argc) {
+            sink_name = argv[++i];
+        } else if (strcmp(argv[i], "--staging") == 0) {
+            options.direct_present = false;
+        } else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            audio_output = argv[++i];
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            options.clock = &clock;
+        } else if (strcmp(argv[i], "--misalign") == 0) {
+            misalign = true;
+        } else if (strcmp(argv[i], "--surface") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &surface_width, &surface_height) != 2) {
+                surface_width = surface_height = 0;
+            }
+        } else if (strcmp(argv[i], "--full-size") == 0) {
+            options.scale_to_surface = false;
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &surface_width, &surface_height) != 2) {
+                surface_width = surface_height = 0;
+            }
+            source_options.reduced_decode.display_width = surface_width;
+            source_options.reduced_decode.display_height = surface_height;
+        } else if (strcmp(argv[i], "--gray") == 0) {
+            source_options.reduced_decode.allow_gray = true;
+        } else if (strcmp(argv[i], "--skip-nonref") == 0) {
+            source_options.reduced_decode.skip_nonref = true;
+        } else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc) {
+            options.max_frame_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--slow-decode") == 0 && i + 1 < argc) {
+            options.decode_slowdown = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-degrade") == 0) {
+            options.degradation.enabled = false;
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            source_options.prefetch_bytes = atoll(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_directory = argv[++i];
+        } else if (strcmp(argv[i], "--probe-cache") == 0 && i + 1 < argc) {
+            probe_directory = argv[++i];
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_directory = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-pool") == 0) {
+            source_options.pooled_frames = false;
+        } else if (strcmp(argv[i], "--fast-start") == 0) {
+            source_options.fast_start = true;
+            options.fast_start = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "usage: %s [--realtime] [--audio null|<file.wav>] [--sink null|memory|raw:<file>|y4m:<file>] [--staging] [--misalign] [--surface <w>x<h>] [--full-size] [--tile <w>x<h>] [--gray] [--skip-nonref] [--max-fps <rate>] [--slow-decode <factor>] [--no-degrade] [--prefetch <MB>] [--cache <dir>] [--probe-cache <dir>] [--index <dir>] [--fast-start] [--no-pool] [--trace <file.json>] <file or url>\n", argv[0]);
+        return 2;
+    }
+    if (trace_path != nullptr) {
+        // deep enough for a few minutes of every stage
+        trace_start(1 << 18);
+    }
+    std::unique_ptr<HttpCache> http_cache;
+    if (cache_directory != nullptr) {
+        HttpCacheOptions cache_options;
+        cache_options.directory = cache_directory;
+        http_cache.reset(new HttpCache(cache_options));
+        if (http_cache->open() < 0) {
+            return 1;
+        }
+        source_options.http_cache = http_cache.get();
+        if (source_options.prefetch_bytes <= 0) {
+            source_options.prefetch_bytes = 8 * 1024 * 1024;
+        }
+    }
+    std::unique_ptr<ProbeCache> probe_cache;
+    if (probe_directory != nullptr) {
+        probe_cache.reset(new ProbeCache(probe_directory));
+        if (probe_cache->open() < 0) {
+            return 1;
+        }
+        source_options.probe_cache = probe_cache.get();
+    }
+    std::unique_ptr<PacketIndexStore> index_store;
+    if (index_directory != nullptr) {
+        index_store.reset(new PacketIndexStore(index_directory));
+        if (index_store->open() < 0) {
+            return 1;
+        }
+        source_options.packet_index_store = index_store.get();
+    }
+    MediaSource source;
+    source_options.enable_audio = audio_output != nullptr;
+    if (media_source_open(&source, path, source_options) < 0) {
+        media_source_close(&source);
+        return 1;
+    }
+    options.packet_index = source.packet_index;
+    std::unique_ptr<AudioSink> audio_sink;
+    std::unique_ptr<AudioPipeline> audio;
+    if (source.audio_codec_context != nullptr) {
+        if (strcmp(audio_output, "null") == 0) {
+            audio_sink.reset(new NullAudioSink());
+        } else {
+            audio_sink.reset(new WavAudioSink(audio_output));
+        }
+        audio.reset(new AudioPipeline(source.audio_codec_context, source.audio_stream_index,
+                                      source.format_context->streams[source.audio_stream_index]->time_base,
+                                      audio_sink.get()));
+        options.audio = audio.get();
+        if (options.clock != nullptr) {
+            options.clock = audio->clock();
+        }
+    }
+    std::unique_ptr<VideoSink> sink;
+    if (strcmp(sink_name, "memory") == 0) {
+        MemorySink *memory_sink = new MemorySink(3, 64, misalign ? 4 : 0);
+        memory_sink->set_surface_size(surface_width, surface_height);
+        sink.reset(memory_sink);
+    } else if (strncmp(sink_name, "raw:", 4) == 0) {
+        sink.reset(new RawFileSink(sink_name + 4));
+    } else if (strncmp(sink_name, "y4m:", 4) == 0) {
+        AVStream *video = source.format_context->streams[source.video_stream_index];
+        sink.reset(new Y4mFileSink(sink_name + 4, av_guess_frame_rate(source.format_context, video, nullptr)));
+    } else {
+        sink.reset(new NullSink(surface_width, surface_height));
+    }
+    int result;
+    PipelineStats stats;
+    MetricsSnapshot metrics;
+    int output_width;
+    int output_height;
+    StartupTimings startup = source.startup;
+    int64_t cpu_start = process_cpu_us();
+    {
+        Pipeline pipeline(source.format_context, source.video_stream_index, source.video_codec_context, sink.get(), options);
+        result = pipeline.run();
+        stats = pipeline.stats();
+        metrics = pipeline.metrics();
+        output_width = pipeline.output_width();
+        output_height = pipeline.output_height();
+        startup.first_decode_us = pipeline.first_decode_us();
+        startup.first_present_us = pipeline.first_present_us();
+        media_source_remember_keyframe(&source, pipeline.first_keyframe_position());
+    }
+    int64_t cpu_us = process_cpu_us() - cpu_start;
+    if (trace_path != nullptr) {
+        trace_stop();
+        if (trace_dump(trace_path) < 0) {
+            fprintf(stderr, "can not write %s\n", trace_path);
+        }
+    }
+    AudioStats audio_stats;
+    if (audio) {
+        audio_stats = audio->stats();
+        audio.reset();
+    }
+    char threading[32];
+    decoder_threading_describe(source.video_threading, threading, sizeof(threading));
+    char reduced[64];
+    reduced_decode_describe(source.video_reduced, reduced, sizeof(reduced));
+    PrefetchStats prefetch;
+    if (source.prefetch != nullptr) {
+        prefetch = source.prefetch->stats();
+    }
+    FramePoolStats pool;
+    if (source.frame_pool != nullptr) {
+        pool = source.frame_pool->stats();
+    }
+    int video_width = source.video_codec_context->width;
+    int video_height = source.video_codec_context->height;
+    int64_t indexed_packets = source.packet_index != nullptr ? source.packet_index->size() : 0;
+    bool index_complete = source.packet_index != nullptr && source.packet_index->complete();
+    media_source_close(&source);
+
+    int64_t frames = stats.present.items;
+    char timings[160];
+    printf("decoder threading %s\n", threading);
+    if (source_options.reduced_decode.display_width > 0) {
+        printf("reduced  %s, decoded at %dx%d for a %dx%d tile\n", reduced, video_width, video_height,
+               source_options.reduced_decode.display_width, source_options.reduced_decode.display_height);
+    }
+    printf("startup  %s\n", startup_timings_describe(startup, timings, sizeof(timings)));
+    print_stage("demux", stats.demux);
+    print_stage("decode", stats.decode);
+    print_stage("convert", stats.convert);
+    print_stage("present", stats.present);
+    printf("overall  %8lld frames %10.1f ms wall %10.1f fps %10.1f ms cpu, %.2f cores\n",
+           (long long) frames, stats.wall_us / 1000.0,
+           stats.wall_us > 0 ? frames * 1e6 / stats.wall_us : 0,
+           cpu_us / 1000.0, stats.wall_us > 0 ? cpu_us / (double) stats.wall_us : 0);
+    if (frames > 0) {
+        // a staged frame is written once by the converter, then read and written again by the copy
+        int64_t traffic = stats.converted_bytes + 2 * stats.copied_bytes;
+        printf("present  %lld direct %lld staged, %.2f MB RGBA traffic per frame\n",
+               (long long) stats.direct_frames, (long long) stats.staged_frames,
+               traffic / (double) frames / (1024 * 1024));
+    }
+    if (frames > 0 && stats.full_size_bytes > stats.converted_bytes) {
+        // the convert time saved shows against a --full-size run, convert_bench times the sizes alone
+        printf("scaling  %dx%d -> %dx%d %s, %.2f MB instead of %.2f MB converted per frame, %.0f%% saved\n",
+               video_width, video_height, output_width, output_height,
+               scale_filter_name(scale_filter(video_width, video_height, output_width, output_height)),
+               stats.converted_bytes / (double) frames / (1024 * 1024),
+               stats.full_size_bytes / (double) frames / (1024 * 1024),
+               100.0 * (stats.full_size_bytes - stats.converted_bytes) / stats.full_size_bytes);
+    }
+    if (options.max_frame_rate > 0) {
+        const FrameRateCapStats &cap = stats.rate_cap;
+        printf("ratecap  %.1f fps cap on %.1f fps, %lld discarded in the decoder%s %lld packets %lld frames dropped, "
+               "%.1f ms cpu saved per minute over %.1f s\n",
+               cap.max_rate, cap.source_rate, (long long) cap.discarded_frames, cap.nonref ? " (nonref on)," : ",",
+               (long long) cap.dropped_packets, (long long) cap.dropped_frames, cap.saved_us_per_minute() / 1000.0,
+               cap.capped_us / 1e6);
+    }
+    if (stats.format_changes > 0) {
+        printf("formats  %lld changes, first frame converted in %.2f ms mean %.2f ms max, %lld sink resizes %.2f ms max\n",
+               (long long) stats.format_changes,
+               stats.format_change_total_us / 1000.0 / stats.format_changes, stats.format_change_max_us / 1000.0,
+               (long long) stats.sink_resizes, stats.sink_resize_max_us / 1000.0);
+    }
+    if (metrics.enabled) {
+        print_latency("demux read", metrics.histograms[METRIC_DEMUX_READ]);
+        print_latency("decode", metrics.histograms[METRIC_DECODE]);
+        print_latency("convert", metrics.histograms[METRIC_CONVERT]);
+        print_latency("window lock", metrics.histograms[METRIC_WINDOW_LOCK]);
+        print_latency("window post", metrics.histograms[METRIC_WINDOW_POST]);
+    }
+    if (options.clock != nullptr) {
+        printf("schedule %lld presented %lld dropped %lld late, jitter mean %lld us max %lld us\n",
+               (long long) stats.schedule.presented, (long long) stats.schedule.dropped,
+               (long long) stats.schedule.late, (long long) stats.schedule.jitter_mean_us(),
+               (long long) stats.schedule.jitter_max_us);
+    }
+    if (options.clock != nullptr && options.degradation.enabled) {
+        const DegradationStats &degradation = stats.degradation;
+        printf("degrade  %lld down %lld up, ended at %s;", (long long) degradation.step_downs,
+               (long long) degradation.step_ups, degradation_level_name(degradation.level));
+        for (int level = 0; level < DEGRADE_LEVEL_COUNT; level++) {
+            if (degradation.level_us[level] > 0) {
+                printf(" %s %.1f s", degradation_level_name(level), degradation.level_us[level] / 1e6);
+            }
+        }
+        printf("\n");
+        for (int i = 0; i < degradation.transition_count; i++) {
+            const DegradationTransition &transition = degradation.transitions[i];
+            printf("         at %8.2f s load %3d%% %s -> %s\n", transition.media_us / 1e6, transition.load_percent,
+                   degradation_level_name(transition.from), degradation_level_name(transition.to));
+        }
+    }
+    if (options.audio != nullptr) {
+        printf("audio    %lld packets %lld frames decoded %lld played %lld underruns",
+               (long long) audio_stats.packets, (long long) audio_stats.frames_decoded,
+               (long long) audio_stats.frames_played, (long long) audio_stats.underruns);
+        if (options.clock != nullptr) {
+            printf(", a/v drift mean %lld us", (long long) stats.schedule.offset_mean_us());
+        }
+        printf("\n");
+    }
+    if (source_options.pooled_frames) {
+        printf("frames   pool %lld hits %lld misses %lld fallbacks, peak %.1f MB\n", (long long) pool.hits,
+               (long long) pool.misses, (long long) pool.fallbacks, pool.peak_bytes / (1024.0 * 1024));
+    }
+    if (source_options.prefetch_bytes > 0) {
+        printf("prefetch %.1f MB fetched at %.2f MB/s, %lld buffered %lld protocol seeks, %lld stalls %.1f ms\n",
+               prefetch.fetched_bytes / (1024.0 * 1024), prefetch.throughput_bps() / (1024.0 * 1024),
+               (long long) prefetch.buffered_seeks, (long long) prefetch.protocol_seeks,
+               (long long) prefetch.stalls, prefetch.stall_us / 1000.0);
+    }
+    if (http_cache) {
+        HttpCacheStats cache = http_cache->stats();
+        printf("cache    %.1f MB from disk %.1f MB from the network in %lld requests, %.1f MB in %d entries\n",
+               cache.disk_bytes / (1024.0 * 1024), cache.network_bytes / (1024.0 * 1024),
+               (long long) cache.requests, cache.cached_bytes / (1024.0 * 1024), cache.entries);
+    }
+    if (index_store) {
+        printf("index    %lld packets%s\n", (long long) indexed_packets, index_complete ? ", complete" : "");
+    }
+    if (probe_cache) {
+        ProbeCacheStats probes = probe_cache->stats();
+        printf("probes   %lld hits %lld misses %lld stored\n", (long long) probes.hits, (long long) probes.misses,
+               (long long) probes.stores);
+    }
+    return result < 0 ? 1 : 0;
+}
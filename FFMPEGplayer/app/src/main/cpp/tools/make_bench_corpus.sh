@@ -0,0 +1,49 @@
+#!/bin/sh
+# Generates the clips playback_bench runs over, from FFmpeg's lavfi test sources so every
+# machine builds the same corpus.
+#   make_bench_corpus.sh [directory] [seconds]
+# Codecs are H.264, HEVC, VP9 and AV1, each only when this ffmpeg has an encoder for it.
+# Sizes run from 480p to 4K, rates from 24 to 120 fps, with short (half a second) and long
+# (ten second) GOPs. Names say what a clip is: <codec>_<height>p<fps>_g<gop>.mkv.
+set -e
+out=${1:-bench_corpus}
+seconds=${2:-10}
+mkdir -p "$out"
+encoders=$(ffmpeg -hide_banner -encoders 2>/dev/null)
+
+has() {
+    echo "$encoders" | grep -q " $1 "
+}
+
+# codec name, encoder and its speed options
+codecs=""
+has libx264 && codecs="$codecs h264:libx264:-preset:veryfast"
+has libx265 && codecs="$codecs hevc:libx265:-preset:veryfast:-x265-params:log-level=error"
+has libvpx-vp9 && codecs="$codecs vp9:libvpx-vp9:-deadline:realtime:-cpu-used:8:-row-mt:1"
+if has libsvtav1; then
+    codecs="$codecs av1:libsvtav1:-preset:10"
+elif has libaom-av1; then
+    codecs="$codecs av1:libaom-av1:-cpu-used:8:-usage:realtime:-row-mt:1"
+fi
+
+# size and rate, each played with both GOPs
+formats="854x480:24 1280x720:30 1920x1080:60 1920x1080:120 3840x2160:24"
+
+for codec in $codecs; do
+    name=${codec%%:*}
+    rest=${codec#*:}
+    encoder=${rest%%:*}
+    options=$(echo "${rest#*:}" | tr ':' ' ')
+    for format in $formats; do
+        size=${format%:*}
+        rate=${format#*:}
+        height=${size#*x}
+        for gop in $((rate / 2)) $((rate * 10)); do
+            clip="$out/${name}_${height}p${rate}_g${gop}.mkv"
+            [ -f "$clip" ] && continue
+            ffmpeg -loglevel error -y -f lavfi -i testsrc2=size=$size:rate=$rate:duration=$seconds \
+                -c:v $encoder $options -pix_fmt yuv420p -g $gop -keyint_min $gop "$clip"
+        done
+    done
+done
+ls -l "$out"
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Generates 60 s test clips that differ only in their keyframe interval, for seek_bench.
+#   make_gop_clips.sh [directory]
+# gop1 is all keyframes, gop250 has one every ten seconds at 25 fps. The MP4s carry an index,
+# the TS copies of the long GOP do not, so fast seeks there depend on what was demuxed before.
+set -e
+out=${1:-gop_clips}
+mkdir -p "$out"
+for gop in 1 12 60 250; do
+    ffmpeg -loglevel error -y -f lavfi -i testsrc2=size=1280x720:rate=25:duration=60 \
+        -c:v libx264 -preset veryfast -pix_fmt yuv420p -g $gop -keyint_min $gop -sc_threshold 0 \
+        "$out/gop$gop.mp4"
+done
+ffmpeg -loglevel error -y -i "$out/gop250.mp4" -c copy -f mpegts "$out/gop250.ts"
+ls -l "$out"
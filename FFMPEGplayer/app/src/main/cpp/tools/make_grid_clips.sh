@@ -0,0 +1,21 @@
+#!/bin/sh
+# Generates the clips reduced_decode_bench runs over: the kinds of material shown in thumbnail
+# grids, from FFmpeg's lavfi test sources so every machine builds the same ones.
+#   make_grid_clips.sh [directory] [seconds]
+# MJPEG, MPEG-2 and H.264 (when this ffmpeg has libx264), 1080p at 30 fps, with a GOP of a
+# second where the codec has one. Names say what a clip is: <codec>_1080p30.<ext>.
+set -e
+out=${1:-grid_clips}
+seconds=${2:-10}
+mkdir -p "$out"
+source="testsrc2=size=1920x1080:rate=30:duration=$seconds"
+
+[ -f "$out/mjpeg_1080p30.avi" ] || ffmpeg -loglevel error -y -f lavfi -i "$source" \
+    -c:v mjpeg -q:v 3 -pix_fmt yuvj420p "$out/mjpeg_1080p30.avi"
+[ -f "$out/mpeg2_1080p30.ts" ] || ffmpeg -loglevel error -y -f lavfi -i "$source" \
+    -c:v mpeg2video -b:v 15M -g 30 -bf 2 -pix_fmt yuv420p "$out/mpeg2_1080p30.ts"
+if ffmpeg -hide_banner -encoders 2>/dev/null | grep -q " libx264 "; then
+    [ -f "$out/h264_1080p30.mp4" ] || ffmpeg -loglevel error -y -f lavfi -i "$source" \
+        -c:v libx264 -preset veryfast -g 30 -bf 2 -pix_fmt yuv420p "$out/h264_1080p30.mp4"
+fi
+ls -l "$out"
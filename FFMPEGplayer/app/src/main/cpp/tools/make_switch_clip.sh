@@ -0,0 +1,24 @@
+#!/bin/sh
+# Generates a 32 s clip whose resolution changes every four seconds, for resolution_switch_bench.
+#   make_switch_clip.sh [directory]
+# H.264 segments of different sizes, one of them in 4:4:4, joined into one MPEG-TS stream the
+# way an ABR switch or a new SPS mid-broadcast reaches the player: new parameter sets in band,
+# the same stream throughout.
+set -e
+out=${1:-switch_clip}
+mkdir -p "$out"
+parts=""
+i=0
+for spec in 1280x720:yuv420p 640x360:yuv420p 1920x1080:yuv420p 854x480:yuv420p \
+            1280x720:yuv444p 320x180:yuv420p 1920x1080:yuv420p 1280x720:yuv420p; do
+    size=${spec%%:*}
+    format=${spec##*:}
+    ffmpeg -loglevel error -y -f lavfi -i testsrc2=size=$size:rate=30:duration=4 \
+        -c:v libx264 -preset veryfast -pix_fmt $format -g 30 -output_ts_offset $((i * 4)) \
+        -f mpegts "$out/part$i.ts"
+    parts="$parts${parts:+|}$out/part$i.ts"
+    i=$((i + 1))
+done
+ffmpeg -loglevel error -y -i "concat:$parts" -c copy -f mpegts "$out/switch.ts"
+rm -f "$out"/part*.ts
+ls -l "$out"
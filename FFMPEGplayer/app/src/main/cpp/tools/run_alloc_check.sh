@@ -0,0 +1,18 @@
+#!/bin/sh
+# Builds the allocation-counting variant of the Linux tools and checks a ten minute clip.
+#   run_alloc_check.sh [build directory] [alloc_check options]
+# The clip is generated once with lavfi: 720p H.264 at 25 fps with an AAC track, so the demuxer,
+# decoder, converter and the audio thread all run for 15000 frames past the warm-up.
+set -e
+here=$(cd "$(dirname "$0")/.." && pwd)
+build=${1:-build-alloc}
+[ $# -gt 0 ] && shift
+clip="$build/alloc_check_10min.mp4"
+cmake -S "$here" -B "$build" -DPLAYER_COUNT_ALLOCATIONS=ON -DCMAKE_BUILD_TYPE=RelWithDebInfo
+cmake --build "$build" --target alloc_check -j
+if [ ! -f "$clip" ]; then
+    ffmpeg -loglevel error -y -f lavfi -i testsrc2=size=1280x720:rate=25:duration=600 \
+        -f lavfi -i sine=frequency=440:sample_rate=48000:duration=600 \
+        -c:v libx264 -preset veryfast -pix_fmt yuv420p -g 50 -c:a aac -shortest "$clip"
+fi
+"$build/alloc_check" "$@" "$clip"
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Serves a directory over HTTP with Range support and limited bandwidth, so network
+playback can be tested on Linux against a slow, predictable link.
+
+    throttled_http_server.py [--port 8000] [--rate KB/s] [--latency ms] [directory]
+
+--rate caps every response at that many KB per second, --latency delays the first byte of
+each response. Every request is logged with its Range header so tests can count them.
+"""
+
+import argparse
+import email.utils
+import hashlib
+import os
+import re
+import sys
+import time
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+CHUNK = 16 * 1024
+
+
+class ThrottledHandler(SimpleHTTPRequestHandler):
+    rate = 0
+    latency = 0.0
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        self.send_file(head_only=False)
+
+    def do_HEAD(self):
+        self.send_file(head_only=True)
+
+    def send_file(self, head_only):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+        size = os.path.getsize(path)
+        mtime = os.path.getmtime(path)
+        etag = '"%s"' % hashlib.md5(("%s:%d:%f" % (path, size, mtime)).encode()).hexdigest()
+        start, end = 0, size - 1
+        status = 200
+        ranges = self.headers.get("Range")
+        if ranges:
+            match = re.match(r"bytes=(\d*)-(\d*)$", ranges.strip())
+            if not match or (not match.group(1) and not match.group(2)):
+                self.send_error(416)
+                return
+            if match.group(1):
+                start = int(match.group(1))
+                if match.group(2):
+                    end = min(int(match.group(2)), size - 1)
+            else:
+                # suffix range: the last n bytes
+                start = max(0, size - int(match.group(2)))
+            if start >= size or start > end:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            status = 206
+        if self.latency > 0:
+            time.sleep(self.latency)
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("Content-Length", str(end - start + 1))
+        self.send_header("ETag", etag)
+        self.send_header("Last-Modified", email.utils.formatdate(mtime, usegmt=True))
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, end, size))
+        self.end_headers()
+        if head_only:
+            return
+        with open(path, "rb") as file:
+            file.seek(start)
+            remaining = end - start + 1
+            began = time.monotonic()
+            sent = 0
+            try:
+                while remaining > 0:
+                    data = file.read(min(CHUNK, remaining))
+                    if not data:
+                        break
+                    self.wfile.write(data)
+                    sent += len(data)
+                    remaining -= len(data)
+                    if self.rate > 0:
+                        # hold the average at the configured rate
+                        ahead = sent / self.rate - (time.monotonic() - began)
+                        if ahead > 0:
+                            time.sleep(ahead)
+            except (BrokenPipeError, ConnectionResetError):
+                # the player closed the connection, usually to seek elsewhere
+                pass
+
+    def log_message(self, format, *args):
+        sys.stderr.write("%s %s range=%s\n" % (self.command, self.path, self.headers.get("Range", "-")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rate", type=int, default=0, help="KB/s per response, 0 for unlimited")
+    parser.add_argument("--latency", type=int, default=0, help="ms before each response")
+    parser.add_argument("directory", nargs="?", default=".")
+    args = parser.parse_args()
+
+    ThrottledHandler.rate = args.rate * 1024
+    ThrottledHandler.latency = args.latency / 1000.0
+    os.chdir(args.directory)
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), ThrottledHandler)
+    print("serving %s on http://127.0.0.1:%d rate %s latency %d ms"
+          % (os.getcwd(), args.port, "%d KB/s" % args.rate if args.rate else "unlimited", args.latency))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,203 @@
+#include "trace.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+// threads are created per prepare; beyond this many rings, those of exited threads are reused
+static const size_t MAX_TRACE_BUFFERS = 64;
+
+std::atomic<bool> trace_enabled_flag{false};
+
+struct TraceEvent {
+    const char *name;
+    int64_t start_us;
+    int64_t duration_us;
+    int64_t pts;
+};
+
+/**
+ * The events of one thread. Only the owning thread writes: it fills the slot, then publishes
+ * it by moving head_ on with a release store. A dump copies the slots and afterwards drops
+ * those the writer may have lapped while it read them.
+ */
+class TraceBuffer {
+public:
+    TraceBuffer(int capacity, long tid, const char *name) : events_((size_t) capacity), tid_(tid), name_(name) {}
+
+    void add(const TraceEvent &event) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        events_[head % events_.size()] = event;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // events in order, oldest first
+    void copy(std::vector<TraceEvent> *out) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t capacity = events_.size();
+        uint64_t first = head > capacity ? head - capacity : 0;
+        std::vector<TraceEvent> copied;
+        for (uint64_t i = first; i < head; i++) {
+            copied.push_back(events_[i % capacity]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = head_.load(std::memory_order_relaxed);
+        // slots the writer reused while they were copied
+        uint64_t safe = now > capacity ? now - capacity : 0;
+        for (uint64_t i = first; i < head; i++) {
+            if (i >= safe) {
+                out->push_back(copied[i - first]);
+            }
+        }
+    }
+
+    void reuse(long tid, const char *name) {
+        head_.store(0, std::memory_order_relaxed);
+        tid_ = tid;
+        name_.store(name);
+        exited_.store(false);
+    }
+
+    long tid() const { return tid_; }
+    const char *name() const { return name_.load(); }
+    // by the owning thread while a dump may read it
+    void set_name(const char *name) { name_.store(name); }
+    bool exited() const { return exited_.load(); }
+    void exit() { exited_.store(true); }
+    int capacity() const { return (int) events_.size(); }
+
+private:
+    std::vector<TraceEvent> events_;
+    std::atomic<uint64_t> head_{0};
+    long tid_;
+    std::atomic<const char *> name_;
+    std::atomic<bool> exited_{false};
+};
+
+static std::mutex buffers_mutex;
+static std::vector<TraceBuffer *> buffers;
+static int buffer_capacity = 16384;
+// events that started before this are from an earlier recording
+static std::atomic<int64_t> trace_epoch_us{0};
+
+// hands the thread's ring back when the thread ends
+struct ThreadTrace {
+    TraceBuffer *buffer = nullptr;
+    const char *name = nullptr;
+
+    ~ThreadTrace() {
+        if (buffer != nullptr) {
+            buffer->exit();
+        }
+    }
+};
+
+static thread_local ThreadTrace thread_trace;
+
+static long current_tid() {
+    return (long) syscall(SYS_gettid);
+}
+
+static TraceBuffer *thread_buffer() {
+    if (thread_trace.buffer != nullptr) {
+        return thread_trace.buffer;
+    }
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    TraceBuffer *buffer = nullptr;
+    if (buffers.size() >= MAX_TRACE_BUFFERS) {
+        for (TraceBuffer *candidate : buffers) {
+            if (candidate->exited() && candidate->capacity() == buffer_capacity) {
+                buffer = candidate;
+                buffer->reuse(current_tid(), thread_trace.name);
+                break;
+            }
+        }
+        if (buffer == nullptr) {
+            // every ring is in use; this thread goes untraced
+            return nullptr;
+        }
+    } else {
+        buffer = new TraceBuffer(buffer_capacity, current_tid(), thread_trace.name);
+        buffers.push_back(buffer);
+    }
+    thread_trace.buffer = buffer;
+    return buffer;
+}
+
+void trace_start(int events_per_thread) {
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffer_capacity = events_per_thread > 0 ? events_per_thread : 16384;
+    }
+    trace_epoch_us.store(now_us());
+    trace_enabled_flag.store(true);
+}
+
+void trace_stop() {
+    trace_enabled_flag.store(false);
+}
+
+void trace_set_thread_name(const char *name) {
+    thread_trace.name = name;
+    if (thread_trace.buffer != nullptr) {
+        thread_trace.buffer->set_name(name);
+    }
+}
+
+void trace_event(const char *name, int64_t start_us, int64_t duration_us, int64_t pts) {
+    TraceBuffer *buffer = thread_buffer();
+    if (buffer == nullptr) {
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.start_us = start_us;
+    event.duration_us = duration_us;
+    event.pts = pts;
+    buffer->add(event);
+}
+
+int trace_dump(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        return AVERROR(errno);
+    }
+    int pid = (int) getpid();
+    int64_t epoch = trace_epoch_us.load();
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    std::vector<TraceEvent> events;
+    for (TraceBuffer *buffer : buffers) {
+        if (buffer->name() != nullptr) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %ld, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", pid, buffer->tid(), buffer->name());
+            first = false;
+        }
+        events.clear();
+        buffer->copy(&events);
+        for (const TraceEvent &event : events) {
+            if (event.start_us < epoch) {
+                continue;
+            }
+            fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"player\", \"ph\": \"X\", \"ts\": %" PRId64 ", \"dur\": %" PRId64
+                          ", \"pid\": %d, \"tid\": %ld",
+                    first ? "" : ",\n", event.name, event.start_us - epoch, event.duration_us, pid, buffer->tid());
+            if (event.pts != TRACE_NO_PTS) {
+                fprintf(file, ", \"args\": {\"pts\": %" PRId64 "}", event.pts);
+            }
+            fprintf(file, "}");
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0 ? 0 : AVERROR(EIO);
+}
@@ -0,0 +1,61 @@
+#ifndef FFMPEGPLAYER_TRACE_H
+#define FFMPEGPLAYER_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "time_util.h"
+
+// Timeline tracing of the playback pipeline in the Chrome trace format, which
+// chrome://tracing and ui.perfetto.dev open. Off until trace_start(); while it is on every
+// thread records into a ring of its own with plain stores, so tracing never blocks the stages,
+// and the rings keep the latest events for trace_dump() to write out whenever asked.
+
+// no timestamp attached to an event
+static const int64_t TRACE_NO_PTS = INT64_MIN;
+
+// begin recording, each thread keeps its last events_per_thread events; events from before
+// the call are left out of later dumps
+void trace_start(int events_per_thread = 16384);
+
+void trace_stop();
+
+// writes what the rings hold as Chrome trace JSON; returns 0 or a negative AVERROR
+int trace_dump(const char *path);
+
+// labels the calling thread's track; name must outlive the process, a string literal
+void trace_set_thread_name(const char *name);
+
+extern std::atomic<bool> trace_enabled_flag;
+
+inline bool trace_enabled() {
+    return trace_enabled_flag.load(std::memory_order_relaxed);
+}
+
+// name must be a string literal, only the pointer is kept
+void trace_event(const char *name, int64_t start_us, int64_t duration_us, int64_t pts);
+
+// one event spanning the enclosing scope; the pts may be filled in once known
+class TraceScope {
+public:
+    explicit TraceScope(const char *name, int64_t pts = TRACE_NO_PTS)
+            : name_(name), pts_(pts), start_us_(trace_enabled() ? now_us() : -1) {}
+
+    ~TraceScope() {
+        if (start_us_ >= 0) {
+            trace_event(name_, start_us_, now_us() - start_us_, pts_);
+        }
+    }
+
+    void set_pts(int64_t pts) { pts_ = pts; }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    int64_t pts_;
+    int64_t start_us_;
+};
+
+#endif // FFMPEGPLAYER_TRACE_H
@@ -0,0 +1,87 @@
+#ifndef FFMPEGPLAYER_VIDEO_SINK_H
+#define FFMPEGPLAYER_VIDEO_SINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// a locked output buffer the converter may write RGBA pixels into
+struct VideoSinkBuffer {
+    uint8_t *bits = nullptr;
+    // bytes between rows, not pixels
+    int linesize = 0;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Where converted RGBA frames end up. On device this is the ANativeWindow.
+ * The pipeline locks a buffer, converts straight into it when it can, and posts it.
+ */
+class VideoSink {
+public:
+    virtual ~VideoSink() {}
+
+    // the size frames end up on screen at, so the converter does not produce more pixels than
+    // are shown; false when the sink does not know and frames keep the video's size
+    virtual bool surface_size(int * /*width*/, int * /*height*/) const { return false; }
+
+    // called once before the first frame with the size frames are converted to, returns < 0 on failure
+    virtual int configure(int width, int height) = 0;
+
+    // hand out the next buffer to draw into, returns < 0 on failure
+    virtual int lock(VideoSinkBuffer *buffer) = 0;
+
+    // show the buffer returned by the last lock()
+    virtual int post() = 0;
+};
+
+// draws into one scratch buffer and drops it, used to measure the pipeline without a display
+class NullSink : public VideoSink {
+public:
+    // stand in for a surface of that size, 0 for none
+    explicit NullSink(int surface_width = 0, int surface_height = 0)
+            : surface_width_(surface_width), surface_height_(surface_height) {}
+
+    bool surface_size(int *width, int *height) const override {
+        *width = surface_width_;
+        *height = surface_height_;
+        return surface_width_ > 0 && surface_height_ > 0;
+    }
+
+    int configure(int width, int height) override {
+        width_ = width;
+        height_ = height;
+        pixels_.assign((size_t) width * height * 4 + 64, 0);
+        return 0;
+    }
+
+    int lock(VideoSinkBuffer *buffer) override {
+        // std::vector only guarantees malloc alignment, line the rows up like a window buffer would
+        uintptr_t address = (uintptr_t) pixels_.data();
+        buffer->bits = (uint8_t *) ((address + 63) & ~(uintptr_t) 63);
+        buffer->linesize = width_ * 4;
+        buffer->width = width_;
+        buffer->height = height_;
+        return 0;
+    }
+
+    int post() override {
+        frames_++;
+        return 0;
+    }
+
+    // safe to poll from another thread
+    int64_t frames() const { return frames_.load(); }
+
+private:
+    int surface_width_;
+    int surface_height_;
+    std::vector<uint8_t> pixels_;
+    int width_ = 0;
+    int height_ = 0;
+    std::atomic<int64_t> frames_{0};
+};
+
+#endif // FFMPEGPLAYER_VIDEO_SINK_H
@@ -0,0 +1,55 @@
+#include "window_sink.h"
+
+#include "log.h"
+
+WindowSink::WindowSink(ANativeWindow *native_window)
+        : native_window_(native_window),
+          // once the buffer geometry is set these report it instead of the surface
+          surface_width_(ANativeWindow_getWidth(native_window)),
+          surface_height_(ANativeWindow_getHeight(native_window)) {
+}
+
+WindowSink::~WindowSink() {
+    ANativeWindow_release(native_window_);
+}
+
+bool WindowSink::surface_size(int *width, int *height) const {
+    *width = surface_width_;
+    *height = surface_height_;
+    return surface_width_ > 0 && surface_height_ > 0;
+}
+
+int WindowSink::configure(int width, int height) {
+    // limit the number of buffer by setting width and height, instead of physical dimensions of screen
+    // the size already fits the surface; the compositor stretches what is left to the view
+    int result = ANativeWindow_setBuffersGeometry(native_window_, width, height, WINDOW_FORMAT_RGBA_8888);
+    if (result < 0) {
+        LOGE("Player Error : Can not set native window buffer");
+    }
+    return result;
+}
+
+int WindowSink::lock(VideoSinkBuffer *buffer) {
+    // define drawing buffer
+    ANativeWindow_Buffer window_buffer;
+    int result = ANativeWindow_lock(native_window_, &window_buffer, nullptr);
+    if (result < 0) {
+        LOGE("Player Error : Can not lock native window");
+        return result;
+    }
+    // Tip: the single line pixel size of the window might be wider than the video
+    // window_buffer.stride is in pixels, the converter wants bytes
+    buffer->bits = (uint8_t *) window_buffer.bits;
+    buffer->linesize = window_buffer.stride * 4;
+    buffer->width = window_buffer.width;
+    buffer->height = window_buffer.height;
+    return 0;
+}
+
+int WindowSink::post() {
+    int result = ANativeWindow_unlockAndPost(native_window_);
+    if (result < 0) {
+        LOGE("Player Error : Can not post native window");
+    }
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef FFMPEGPLAYER_WINDOW_SINK_H
+#define FFMPEGPLAYER_WINDOW_SINK_H
+
+#include <android/native_window.h>
+
+#include "video_sink.h"
+
+// presents RGBA frames on an ANativeWindow, takes over the caller's window reference
+class WindowSink : public VideoSink {
+public:
+    explicit WindowSink(ANativeWindow *native_window);
+    ~WindowSink() override;
+
+    bool surface_size(int *width, int *height) const override;
+    int configure(int width, int height) override;
+    int lock(VideoSinkBuffer *buffer) override;
+    int post() override;
+
+private:
+    ANativeWindow *native_window_;
+    // the surface's own size, taken before configure() sets the buffer geometry
+    int surface_width_;
+    int surface_height_;
+};
+
+#endif // FFMPEGPLAYER_WINDOW_SINK_H
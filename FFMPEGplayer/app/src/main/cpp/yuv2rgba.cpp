@@ -0,0 +1,145 @@
+#include "yuv2rgba.h"
+
+#include <cmath>
+
+extern "C" {
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+}
+
+void yuv2rgba_coefficients(YuvToRgbaCoefficients *coefficients, YuvMatrix matrix, bool full_range) {
+    double kr = matrix == YUV_MATRIX_BT709 ? 0.2126 : 0.299;
+    double kb = matrix == YUV_MATRIX_BT709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    // limited range spans 16..235 for luma and 16..240 for chroma
+    double y_scale = full_range ? 1.0 : 255.0 / 219.0;
+    double c_scale = full_range ? 1.0 : 255.0 / 224.0;
+    coefficients->y_offset = full_range ? 0 : 16;
+    coefficients->y_mul = (int16_t) lrint(y_scale * 64);
+    coefficients->v_r = (int16_t) lrint(2 * (1 - kr) * c_scale * 64);
+    coefficients->u_g = (int16_t) lrint(2 * kb * (1 - kb) / kg * c_scale * 64);
+    coefficients->v_g = (int16_t) lrint(2 * kr * (1 - kr) / kg * c_scale * 64);
+    coefficients->u_b = (int16_t) lrint(2 * (1 - kb) * c_scale * 64);
+}
+
+static inline uint8_t clamp_u8(int value) {
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t) value;
+}
+
+static inline void yuv_pixel(int y, int u, int v, uint8_t *rgba, const YuvToRgbaCoefficients *c) {
+    int y1 = (y - c->y_offset) * c->y_mul + 32;
+    u -= 128;
+    v -= 128;
+    rgba[0] = clamp_u8((y1 + v * c->v_r) >> 6);
+    rgba[1] = clamp_u8((y1 - u * c->u_g - v * c->v_g) >> 6);
+    rgba[2] = clamp_u8((y1 + u * c->u_b) >> 6);
+    rgba[3] = 255;
+}
+
+static void planar_row_c(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                         uint8_t *rgba, int width, const YuvToRgbaCoefficients *c) {
+    for (int x = 0; x < width; x++) {
+        yuv_pixel(y[x], u[x >> 1], v[x >> 1], rgba + x * 4, c);
+    }
+}
+
+static void semi_planar_row_c(const uint8_t *y, const uint8_t *uv, uint8_t *rgba, int width,
+                              const YuvToRgbaCoefficients *c, bool swap_uv) {
+    int u_index = swap_uv ? 1 : 0;
+    for (int x = 0; x < width; x++) {
+        const uint8_t *pair = uv + (x >> 1) * 2;
+        yuv_pixel(y[x], pair[u_index], pair[1 - u_index], rgba + x * 4, c);
+    }
+}
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_c() {
+    static const Yuv2RgbaKernels kernels = {"c", planar_row_c, semi_planar_row_c};
+    return &kernels;
+}
+
+// the SIMD files only define their kernels for their own architecture
+#if !defined(__x86_64__) && !defined(__i386__)
+const Yuv2RgbaKernels *yuv2rgba_kernels_sse4() {
+    return nullptr;
+}
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_avx2() {
+    return nullptr;
+}
+#endif
+
+#if !defined(__aarch64__)
+const Yuv2RgbaKernels *yuv2rgba_kernels_neon() {
+    return nullptr;
+}
+#endif
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_best() {
+    int flags = av_get_cpu_flags();
+    if ((flags & AV_CPU_FLAG_NEON) && yuv2rgba_kernels_neon()) {
+        return yuv2rgba_kernels_neon();
+    }
+    if ((flags & AV_CPU_FLAG_AVX2) && yuv2rgba_kernels_avx2()) {
+        return yuv2rgba_kernels_avx2();
+    }
+    if ((flags & AV_CPU_FLAG_SSE4) && yuv2rgba_kernels_sse4()) {
+        return yuv2rgba_kernels_sse4();
+    }
+    return yuv2rgba_kernels_c();
+}
+
+bool yuv2rgba_supported(AVPixelFormat format) {
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P
+           || format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_NV21;
+}
+
+YuvMatrix yuv2rgba_frame_matrix(const AVFrame *frame) {
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT709:
+            return YUV_MATRIX_BT709;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+        case AVCOL_SPC_FCC:
+            return YUV_MATRIX_BT601;
+        default:
+            // untagged streams: HD sizes are almost always BT.709
+            return frame->height >= 720 ? YUV_MATRIX_BT709 : YUV_MATRIX_BT601;
+    }
+}
+
+bool yuv2rgba_full_range(const AVFrame *frame) {
+    switch (frame->format) {
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_YUVJ440P:
+        case AV_PIX_FMT_YUVJ411P:
+            return true;
+        default:
+            return frame->color_range == AVCOL_RANGE_JPEG;
+    }
+}
+
+int yuv2rgba_convert(const Yuv2RgbaKernels *kernels, const AVFrame *frame, uint8_t *rgba, int linesize) {
+    AVPixelFormat format = (AVPixelFormat) frame->format;
+    if (!yuv2rgba_supported(format)) {
+        return AVERROR(ENOSYS);
+    }
+    YuvToRgbaCoefficients coefficients;
+    yuv2rgba_coefficients(&coefficients, yuv2rgba_frame_matrix(frame), yuv2rgba_full_range(frame));
+    bool planar = format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P;
+    for (int row = 0; row < frame->height; row++) {
+        const uint8_t *y = frame->data[0] + row * frame->linesize[0];
+        uint8_t *out = rgba + row * linesize;
+        if (planar) {
+            kernels->planar(y,
+                            frame->data[1] + (row >> 1) * frame->linesize[1],
+                            frame->data[2] + (row >> 1) * frame->linesize[2],
+                            out, frame->width, &coefficients);
+        } else {
+            kernels->semi_planar(y, frame->data[1] + (row >> 1) * frame->linesize[1],
+                                 out, frame->width, &coefficients, format == AV_PIX_FMT_NV21);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef FFMPEGPLAYER_YUV2RGBA_H
+#define FFMPEGPLAYER_YUV2RGBA_H
+
+#include <cstdint>
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+}
+
+/**
+ * Same-size YUV 4:2:0 -> RGBA conversion, the only thing the player asks swscale for
+ * when the window matches the video.
+ *
+ * All kernels use the same 6-bit fixed point math so the SIMD versions are bit-exact
+ * with the C reference:
+ *   y1 = (Y - y_offset) * y_mul + 32
+ *   R = clamp((y1 + (V - 128) * v_r) >> 6)
+ *   G = clamp((y1 - (U - 128) * u_g - (V - 128) * v_g) >> 6)
+ *   B = clamp((y1 + (U - 128) * u_b) >> 6)
+ * SIMD kernels work on 16 bit lanes with saturating adds; only B of a limited range
+ * source can saturate, and only at values that clamp to 255 anyway.
+ */
+struct YuvToRgbaCoefficients {
+    int16_t y_offset;
+    int16_t y_mul;
+    int16_t v_r;
+    int16_t u_g;
+    int16_t v_g;
+    int16_t u_b;
+};
+
+enum YuvMatrix {
+    YUV_MATRIX_BT601,
+    YUV_MATRIX_BT709,
+};
+
+void yuv2rgba_coefficients(YuvToRgbaCoefficients *coefficients, YuvMatrix matrix, bool full_range);
+
+// the matrix and range a frame is converted with, by the SIMD kernels and by swscale alike, so
+// a stream looks the same whichever path it takes. Untagged frames 720 lines or taller are
+// taken as BT.709, smaller ones as BT.601.
+YuvMatrix yuv2rgba_frame_matrix(const AVFrame *frame);
+bool yuv2rgba_full_range(const AVFrame *frame);
+
+// u/v are planes at half horizontal resolution
+typedef void (*Yuv2RgbaPlanarRow)(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                                  uint8_t *rgba, int width, const YuvToRgbaCoefficients *coefficients);
+
+// uv holds interleaved pairs, U first (NV12) or V first (NV21) when swap_uv is set
+typedef void (*Yuv2RgbaSemiPlanarRow)(const uint8_t *y, const uint8_t *uv, uint8_t *rgba, int width,
+                                      const YuvToRgbaCoefficients *coefficients, bool swap_uv);
+
+struct Yuv2RgbaKernels {
+    const char *name;
+    Yuv2RgbaPlanarRow planar;
+    Yuv2RgbaSemiPlanarRow semi_planar;
+};
+
+// portable reference, also used for the tail of every SIMD row
+const Yuv2RgbaKernels *yuv2rgba_kernels_c();
+// nullptr when the build target has no such instruction set
+const Yuv2RgbaKernels *yuv2rgba_kernels_sse4();
+const Yuv2RgbaKernels *yuv2rgba_kernels_avx2();
+const Yuv2RgbaKernels *yuv2rgba_kernels_neon();
+
+// fastest kernels the CPU supports, from av_get_cpu_flags()
+const Yuv2RgbaKernels *yuv2rgba_kernels_best();
+
+// YUV420P, YUVJ420P, NV12 and NV21
+bool yuv2rgba_supported(AVPixelFormat format);
+
+// convert a whole frame into an RGBA buffer of the same size, returns < 0 if the format is not supported
+int yuv2rgba_convert(const Yuv2RgbaKernels *kernels, const AVFrame *frame, uint8_t *rgba, int linesize);
+
+#endif // FFMPEGPLAYER_YUV2RGBA_H
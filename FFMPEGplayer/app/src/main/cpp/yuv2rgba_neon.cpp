@@ -0,0 +1,89 @@
+// NEON YUV -> RGBA kernels for arm64-v8a, where NEON is always present.
+
+#include "yuv2rgba.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+namespace {
+
+struct NeonConstants {
+    int16x8_t y_mul, round, v_r, u_g, v_g, u_b;
+    uint8x8_t y_offset, bias;
+    uint8x16_t alpha;
+
+    explicit NeonConstants(const YuvToRgbaCoefficients *c) {
+        y_mul = vdupq_n_s16(c->y_mul);
+        round = vdupq_n_s16(32);
+        v_r = vdupq_n_s16(c->v_r);
+        u_g = vdupq_n_s16(c->u_g);
+        v_g = vdupq_n_s16(c->v_g);
+        u_b = vdupq_n_s16(c->u_b);
+        y_offset = vdup_n_u8((uint8_t) c->y_offset);
+        bias = vdup_n_u8(128);
+        alpha = vdupq_n_u8(255);
+    }
+};
+
+// widening subtract wraps in unsigned, reinterpreted it is the signed difference
+inline int16x8_t centered(uint8x8_t value, uint8x8_t offset) {
+    return vreinterpretq_s16_u16(vsubl_u8(value, offset));
+}
+
+// 16 pixels from 16 luma bytes and 8 U/V samples
+inline void store16_neon(uint8x16_t y8, uint8x8_t u8, uint8x8_t v8, uint8_t *rgba, const NeonConstants &k) {
+    int16x8_t u = centered(u8, k.bias);
+    int16x8_t v = centered(v8, k.bias);
+    int16x8_t r_c = vmulq_s16(v, k.v_r);
+    int16x8_t g_c = vmlaq_s16(vmulq_s16(u, k.u_g), v, k.v_g);
+    int16x8_t b_c = vmulq_s16(u, k.u_b);
+
+    int16x8_t y_lo = vmlaq_s16(k.round, centered(vget_low_u8(y8), k.y_offset), k.y_mul);
+    int16x8_t y_hi = vmlaq_s16(k.round, centered(vget_high_u8(y8), k.y_offset), k.y_mul);
+
+    // every chroma sample covers two luma pixels; vqshrun shifts and clamps to 0..255 in one go
+    uint8x16x4_t out;
+    out.val[0] = vcombine_u8(vqshrun_n_s16(vqaddq_s16(y_lo, vzip1q_s16(r_c, r_c)), 6),
+                             vqshrun_n_s16(vqaddq_s16(y_hi, vzip2q_s16(r_c, r_c)), 6));
+    out.val[1] = vcombine_u8(vqshrun_n_s16(vqsubq_s16(y_lo, vzip1q_s16(g_c, g_c)), 6),
+                             vqshrun_n_s16(vqsubq_s16(y_hi, vzip2q_s16(g_c, g_c)), 6));
+    out.val[2] = vcombine_u8(vqshrun_n_s16(vqaddq_s16(y_lo, vzip1q_s16(b_c, b_c)), 6),
+                             vqshrun_n_s16(vqaddq_s16(y_hi, vzip2q_s16(b_c, b_c)), 6));
+    out.val[3] = k.alpha;
+    vst4q_u8(rgba, out);
+}
+
+void planar_row_neon(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     uint8_t *rgba, int width, const YuvToRgbaCoefficients *c) {
+    NeonConstants k(c);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        store16_neon(vld1q_u8(y + x), vld1_u8(u + x / 2), vld1_u8(v + x / 2), rgba + x * 4, k);
+    }
+    if (x < width) {
+        yuv2rgba_kernels_c()->planar(y + x, u + x / 2, v + x / 2, rgba + x * 4, width - x, c);
+    }
+}
+
+void semi_planar_row_neon(const uint8_t *y, const uint8_t *uv, uint8_t *rgba, int width,
+                          const YuvToRgbaCoefficients *c, bool swap_uv) {
+    NeonConstants k(c);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8x2_t pairs = vld2_u8(uv + x);
+        store16_neon(vld1q_u8(y + x), pairs.val[swap_uv ? 1 : 0], pairs.val[swap_uv ? 0 : 1], rgba + x * 4, k);
+    }
+    if (x < width) {
+        yuv2rgba_kernels_c()->semi_planar(y + x, uv + x, rgba + x * 4, width - x, c, swap_uv);
+    }
+}
+
+} // namespace
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_neon() {
+    static const Yuv2RgbaKernels kernels = {"neon", planar_row_neon, semi_planar_row_neon};
+    return &kernels;
+}
+
+#endif
@@ -0,0 +1,192 @@
+// SSE4.1 and AVX2 YUV -> RGBA kernels. The functions carry their own target attributes so the
+// file builds with the default x86_64 flags and the kernels are only entered after av_get_cpu_flags().
+
+#include "yuv2rgba.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define SSE4 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+namespace {
+
+struct Sse4Constants {
+    __m128i y_offset, y_mul, round, v_r, u_g, v_g, u_b, bias, alpha;
+
+    SSE4 explicit Sse4Constants(const YuvToRgbaCoefficients *c) {
+        y_offset = _mm_set1_epi16(c->y_offset);
+        y_mul = _mm_set1_epi16(c->y_mul);
+        round = _mm_set1_epi16(32);
+        v_r = _mm_set1_epi16(c->v_r);
+        u_g = _mm_set1_epi16(c->u_g);
+        v_g = _mm_set1_epi16(c->v_g);
+        u_b = _mm_set1_epi16(c->u_b);
+        bias = _mm_set1_epi16(128);
+        alpha = _mm_set1_epi8((char) 0xff);
+    }
+};
+
+// 16 pixels from 16 luma bytes and 8 chroma samples already widened to signed 16 bit
+SSE4 inline void store16_sse4(__m128i y8, __m128i u, __m128i v, uint8_t *rgba, const Sse4Constants &k) {
+    __m128i r_c = _mm_mullo_epi16(v, k.v_r);
+    __m128i g_c = _mm_add_epi16(_mm_mullo_epi16(u, k.u_g), _mm_mullo_epi16(v, k.v_g));
+    __m128i b_c = _mm_mullo_epi16(u, k.u_b);
+
+    __m128i y_lo = _mm_cvtepu8_epi16(y8);
+    __m128i y_hi = _mm_cvtepu8_epi16(_mm_srli_si128(y8, 8));
+    y_lo = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y_lo, k.y_offset), k.y_mul), k.round);
+    y_hi = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y_hi, k.y_offset), k.y_mul), k.round);
+
+    // every chroma sample covers two luma pixels
+    __m128i r = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(y_lo, _mm_unpacklo_epi16(r_c, r_c)), 6),
+                                 _mm_srai_epi16(_mm_adds_epi16(y_hi, _mm_unpackhi_epi16(r_c, r_c)), 6));
+    __m128i g = _mm_packus_epi16(_mm_srai_epi16(_mm_subs_epi16(y_lo, _mm_unpacklo_epi16(g_c, g_c)), 6),
+                                 _mm_srai_epi16(_mm_subs_epi16(y_hi, _mm_unpackhi_epi16(g_c, g_c)), 6));
+    __m128i b = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(y_lo, _mm_unpacklo_epi16(b_c, b_c)), 6),
+                                 _mm_srai_epi16(_mm_adds_epi16(y_hi, _mm_unpackhi_epi16(b_c, b_c)), 6));
+
+    __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+    __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+    __m128i ba_lo = _mm_unpacklo_epi8(b, k.alpha);
+    __m128i ba_hi = _mm_unpackhi_epi8(b, k.alpha);
+    _mm_storeu_si128((__m128i *) rgba, _mm_unpacklo_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128((__m128i *) (rgba + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+    _mm_storeu_si128((__m128i *) (rgba + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+    _mm_storeu_si128((__m128i *) (rgba + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+}
+
+SSE4 void planar_row_sse4(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                          uint8_t *rgba, int width, const YuvToRgbaCoefficients *c) {
+    Sse4Constants k(c);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u16 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (u + x / 2))), k.bias);
+        __m128i v16 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (v + x / 2))), k.bias);
+        store16_sse4(_mm_loadu_si128((const __m128i *) (y + x)), u16, v16, rgba + x * 4, k);
+    }
+    if (x < width) {
+        yuv2rgba_kernels_c()->planar(y + x, u + x / 2, v + x / 2, rgba + x * 4, width - x, c);
+    }
+}
+
+SSE4 void semi_planar_row_sse4(const uint8_t *y, const uint8_t *uv, uint8_t *rgba, int width,
+                               const YuvToRgbaCoefficients *c, bool swap_uv) {
+    Sse4Constants k(c);
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i pairs = _mm_loadu_si128((const __m128i *) (uv + x));
+        __m128i first = _mm_sub_epi16(_mm_and_si128(pairs, low_bytes), k.bias);
+        __m128i second = _mm_sub_epi16(_mm_srli_epi16(pairs, 8), k.bias);
+        store16_sse4(_mm_loadu_si128((const __m128i *) (y + x)),
+                     swap_uv ? second : first, swap_uv ? first : second, rgba + x * 4, k);
+    }
+    if (x < width) {
+        yuv2rgba_kernels_c()->semi_planar(y + x, uv + x, rgba + x * 4, width - x, c, swap_uv);
+    }
+}
+
+struct Avx2Constants {
+    __m256i y_offset, y_mul, round, v_r, u_g, v_g, u_b, bias, alpha;
+
+    AVX2 explicit Avx2Constants(const YuvToRgbaCoefficients *c) {
+        y_offset = _mm256_set1_epi16(c->y_offset);
+        y_mul = _mm256_set1_epi16(c->y_mul);
+        round = _mm256_set1_epi16(32);
+        v_r = _mm256_set1_epi16(c->v_r);
+        u_g = _mm256_set1_epi16(c->u_g);
+        v_g = _mm256_set1_epi16(c->v_g);
+        u_b = _mm256_set1_epi16(c->u_b);
+        bias = _mm256_set1_epi16(128);
+        alpha = _mm256_set1_epi8((char) 0xff);
+    }
+};
+
+AVX2 inline __m256i luma_avx2(const uint8_t *y, const Avx2Constants &k) {
+    __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) y));
+    return _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y16, k.y_offset), k.y_mul), k.round);
+}
+
+// clamp one channel of 32 pixels, back in pixel order
+AVX2 inline __m256i channel_avx2(__m256i a, __m256i b) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srai_epi16(a, 6), _mm256_srai_epi16(b, 6)), 0xd8);
+}
+
+// 32 pixels from 32 luma bytes and 16 chroma samples already widened to signed 16 bit
+AVX2 inline void store32_avx2(const uint8_t *y, __m256i u, __m256i v, uint8_t *rgba, const Avx2Constants &k) {
+    // lanes 0-3 and 8-11 of a term end up next to each other so the in-lane unpacks duplicate in order
+    __m256i r_c = _mm256_permute4x64_epi64(_mm256_mullo_epi16(v, k.v_r), 0xd8);
+    __m256i g_c = _mm256_permute4x64_epi64(
+            _mm256_add_epi16(_mm256_mullo_epi16(u, k.u_g), _mm256_mullo_epi16(v, k.v_g)), 0xd8);
+    __m256i b_c = _mm256_permute4x64_epi64(_mm256_mullo_epi16(u, k.u_b), 0xd8);
+
+    __m256i y_a = luma_avx2(y, k);
+    __m256i y_b = luma_avx2(y + 16, k);
+
+    __m256i r = channel_avx2(_mm256_adds_epi16(y_a, _mm256_unpacklo_epi16(r_c, r_c)),
+                             _mm256_adds_epi16(y_b, _mm256_unpackhi_epi16(r_c, r_c)));
+    __m256i g = channel_avx2(_mm256_subs_epi16(y_a, _mm256_unpacklo_epi16(g_c, g_c)),
+                             _mm256_subs_epi16(y_b, _mm256_unpackhi_epi16(g_c, g_c)));
+    __m256i b = channel_avx2(_mm256_adds_epi16(y_a, _mm256_unpacklo_epi16(b_c, b_c)),
+                             _mm256_adds_epi16(y_b, _mm256_unpackhi_epi16(b_c, b_c)));
+
+    // in-lane interleave gives pixels 0-7/16-23 and 8-15/24-31, the final permutes restore the order
+    __m256i rg_lo = _mm256_unpacklo_epi8(r, g);
+    __m256i rg_hi = _mm256_unpackhi_epi8(r, g);
+    __m256i ba_lo = _mm256_unpacklo_epi8(b, k.alpha);
+    __m256i ba_hi = _mm256_unpackhi_epi8(b, k.alpha);
+    __m256i p0 = _mm256_unpacklo_epi16(rg_lo, ba_lo);
+    __m256i p1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);
+    __m256i p2 = _mm256_unpacklo_epi16(rg_hi, ba_hi);
+    __m256i p3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);
+    _mm256_storeu_si256((__m256i *) rgba, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256((__m256i *) (rgba + 32), _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256((__m256i *) (rgba + 64), _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256((__m256i *) (rgba + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+AVX2 void planar_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                          uint8_t *rgba, int width, const YuvToRgbaCoefficients *c) {
+    Avx2Constants k(c);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i u16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (u + x / 2))), k.bias);
+        __m256i v16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (v + x / 2))), k.bias);
+        store32_avx2(y + x, u16, v16, rgba + x * 4, k);
+    }
+    if (x < width) {
+        planar_row_sse4(y + x, u + x / 2, v + x / 2, rgba + x * 4, width - x, c);
+    }
+}
+
+AVX2 void semi_planar_row_avx2(const uint8_t *y, const uint8_t *uv, uint8_t *rgba, int width,
+                               const YuvToRgbaCoefficients *c, bool swap_uv) {
+    Avx2Constants k(c);
+    const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i pairs = _mm256_loadu_si256((const __m256i *) (uv + x));
+        __m256i first = _mm256_sub_epi16(_mm256_and_si256(pairs, low_bytes), k.bias);
+        __m256i second = _mm256_sub_epi16(_mm256_srli_epi16(pairs, 8), k.bias);
+        store32_avx2(y + x, swap_uv ? second : first, swap_uv ? first : second, rgba + x * 4, k);
+    }
+    if (x < width) {
+        semi_planar_row_sse4(y + x, uv + x, rgba + x * 4, width - x, c, swap_uv);
+    }
+}
+
+} // namespace
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_sse4() {
+    static const Yuv2RgbaKernels kernels = {"sse4", planar_row_sse4, semi_planar_row_sse4};
+    return &kernels;
+}
+
+const Yuv2RgbaKernels *yuv2rgba_kernels_avx2() {
+    static const Yuv2RgbaKernels kernels = {"avx2", planar_row_avx2, semi_planar_row_avx2};
+    return &kernels;
+}
+
+#endif
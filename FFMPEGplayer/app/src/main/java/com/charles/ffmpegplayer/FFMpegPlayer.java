@@ -8,6 +8,132 @@ public class FFMpegPlayer {
         System.loadLibrary("ffmpegplayer");
     }
 
+    // player states, the values of PlayerState in media_player.h
+    public static final int STATE_IDLE = 0;
+    public static final int STATE_PREPARED = 1;
+    public static final int STATE_STARTED = 2;
+    public static final int STATE_PAUSED = 3;
+    public static final int STATE_STOPPED = 4;
+    public static final int STATE_COMPLETED = 5;
+    public static final int STATE_ERROR = 6;
+    public static final int STATE_RELEASED = 7;
+
+    // seekTo modes, the values of SeekMode in pipeline.h
+    // the keyframe nearest to the position: quickest, may land a little before or after it
+    public static final int SEEK_FAST = 0;
+    // the frame at the position, decoded up to from the keyframe before it
+    public static final int SEEK_ACCURATE = 1;
+
+    // native player behind this object, 0 once released
+    private long nativeHandle;
+
+    public FFMpegPlayer() {
+    }
+
+    /**
+     * A player that renders into the surface and lives until release().
+     * prepare/start/pause/seekTo/stop return immediately, the native player applies them
+     * in order on its own thread, so they are safe to call from the UI thread.
+     */
+    public FFMpegPlayer(Surface surface) {
+        nativeHandle = nativeCreate(surface);
+    }
+
+    /**
+     * Keeps what http(s) players download in this directory, so it is read from disk the next
+     * time. Takes effect for players created afterwards; only the first call counts.
+     */
+    public static void setCacheDirectory(String directory) {
+        nativeSetCacheDirectory(directory);
+    }
+
+    /**
+     * Records a timeline of the native pipeline of every player: demuxing, decoding, conversion
+     * and the window, per thread and tagged with frame timestamps. Each thread keeps its latest
+     * eventsPerThread events, so a trace dumped right after a stutter shows what led up to it.
+     */
+    public static void startTracing(int eventsPerThread) {
+        nativeStartTracing(eventsPerThread);
+    }
+
+    public static void stopTracing() {
+        nativeStopTracing();
+    }
+
+    /**
+     * Writes the recorded events as Chrome trace JSON, for ui.perfetto.dev or chrome://tracing.
+     * Works while tracing is on as well as after stopTracing(); returns false when the file can not be written.
+     */
+    public static boolean dumpTrace(String path) {
+        return nativeDumpTrace(path) == 0;
+    }
+
+    public synchronized void prepare(String path) {
+        nativePrepare(nativeHandle, path);
+    }
+
+    public synchronized void start() {
+        nativeStart(nativeHandle);
+    }
+
+    public synchronized void pause() {
+        nativePause(nativeHandle);
+    }
+
+    public synchronized void seekTo(long positionMs) {
+        seekTo(positionMs, SEEK_ACCURATE);
+    }
+
+    public synchronized void seekTo(long positionMs, int mode) {
+        nativeSeekTo(nativeHandle, positionMs, mode);
+    }
+
+    public synchronized void stop() {
+        nativeStop(nativeHandle);
+    }
+
+    /**
+     * Stops playback and frees the native player; waits for its threads to finish.
+     */
+    public synchronized void release() {
+        if (nativeHandle != 0) {
+            nativeRelease(nativeHandle);
+            nativeHandle = 0;
+        }
+    }
+
+    /**
+     * Shows no more than this many frames a second, 0 for every frame; 60 fps content at 30 on
+     * battery. Frames above the cap are left out before decoding where the stream allows it and
+     * before conversion otherwise. Takes effect right away and for later prepare() calls.
+     */
+    public synchronized void setMaxFrameRate(double framesPerSecond) {
+        nativeSetMaxFrameRate(nativeHandle, framesPerSecond);
+    }
+
+    public synchronized int getState() {
+        return nativeGetState(nativeHandle);
+    }
+
+    public synchronized long getCurrentPosition() {
+        return nativeGetCurrentPosition(nativeHandle);
+    }
+
+    public synchronized long getDuration() {
+        return nativeGetDuration(nativeHandle);
+    }
+
+    /**
+     * Where frame time went since prepare(): latency histograms of the pipeline steps and frame
+     * and byte counters. Cheap enough to poll every second.
+     */
+    public synchronized PlayerStats getStats() {
+        return new PlayerStats(nativeGetStats(nativeHandle));
+    }
+
+    /**
+     * Plays the whole file on the calling thread and returns at its end.
+     */
     public native void playVideo(String path, Surface surface);
 
     /**
@@ -15,4 +141,36 @@ public class FFMpegPlayer {
      * which is packaged with this application.
      */
     public native String stringFromJNI();
+
+    private static native void nativeSetCacheDirectory(String directory);
+
+    private static native void nativeStartTracing(int eventsPerThread);
+
+    private static native void nativeStopTracing();
+
+    private static native int nativeDumpTrace(String path);
+
+    private native long nativeCreate(Surface surface);
+
+    private native void nativePrepare(long handle, String path);
+
+    private native void nativeStart(long handle);
+
+    private native void nativePause(long handle);
+
+    private native void nativeSeekTo(long handle, long positionMs, int mode);
+
+    private native void nativeStop(long handle);
+
+    private native void nativeRelease(long handle);
+
+    private native void nativeSetMaxFrameRate(long handle, double framesPerSecond);
+
+    private native int nativeGetState(long handle);
+
+    private native long nativeGetCurrentPosition(long handle);
+
+    private native long nativeGetDuration(long handle);
+
+    private native long[] nativeGetStats(long handle);
 }
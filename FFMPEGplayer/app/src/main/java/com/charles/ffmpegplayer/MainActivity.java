@@ -3,8 +3,6 @@ package com.charles.ffmpegplayer;
 import androidx.appcompat.app.AppCompatActivity;
 
 import android.os.Bundle;
-import android.os.Handler;
-import android.os.Looper;
 import android.view.SurfaceHolder;
 import android.view.SurfaceView;
 import android.view.View;
@@ -12,17 +10,16 @@ import android.widget.Button;
 
 import com.charles.ffmpegplayer.databinding.ActivityMainBinding;
 
-import java.util.concurrent.ExecutorService;
-import java.util.concurrent.Executors;
-
-public class MainActivity extends AppCompatActivity {
-
+public class MainActivity extends AppCompatActivity implements SurfaceHolder.Callback {
 
+    private static final String VIDEO_PATH = "http://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4";
 
     private ActivityMainBinding binding;
     private SurfaceView surfaceView;
     private SurfaceHolder surfaceHolder;
     private Button PlayBtn;
+    // one player for as long as the surface exists, its controls do not block
+    private FFMpegPlayer player;
 
     @Override
     protected void onCreate(Bundle savedInstanceState) {
@@ -31,28 +28,49 @@ public class MainActivity extends AppCompatActivity {
         binding = ActivityMainBinding.inflate(getLayoutInflater());
         setContentView(binding.getRoot());
 
+        FFMpegPlayer.setCacheDirectory(getCacheDir() + "/media");
+
         surfaceView = findViewById(R.id.surface_view);
         surfaceHolder = surfaceView.getHolder();
+        surfaceHolder.addCallback(this);
 
         PlayBtn = findViewById(R.id.btn_play);
+        PlayBtn.setEnabled(false);
+    }
 
+    @Override
+    public void surfaceCreated(SurfaceHolder holder) {
+        player = new FFMpegPlayer(holder.getSurface());
+        player.prepare(VIDEO_PATH);
+        PlayBtn.setEnabled(true);
     }
 
-    public void play(View view) {
+    @Override
+    public void surfaceChanged(SurfaceHolder holder, int format, int width, int height) {
+    }
 
+    @Override
+    public void surfaceDestroyed(SurfaceHolder holder) {
         PlayBtn.setEnabled(false);
-        ExecutorService executor = Executors.newSingleThreadExecutor();
-        Handler handler = new Handler(Looper.getMainLooper());
-        executor.execute(() -> {
-            //Background work here
-            String videoPath = "http://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4";
-            FFMpegPlayer player = new FFMpegPlayer();
-            player.playVideo(videoPath, surfaceHolder.getSurface());
-            handler.post(() -> {
-                //UI Thread work here
-                PlayBtn.setEnabled(true);
-            });
-        });
+        PlayBtn.setText("Play");
+        if (player != null) {
+            player.release();
+            player = null;
+        }
+    }
+
+    public void play(View view) {
+        if (player == null) {
+            return;
+        }
+        if (player.getState() == FFMpegPlayer.STATE_STARTED) {
+            player.pause();
+            PlayBtn.setText("Play");
+        } else {
+            // also plays again from the start once the video completed
+            player.start();
+            PlayBtn.setText("Pause");
+        }
     }
 
-}
\ No newline at end of file
+}
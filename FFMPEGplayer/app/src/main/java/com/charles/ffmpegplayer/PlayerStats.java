@@ -0,0 +1,102 @@
+package com.charles.ffmpegplayer;
+
+/**
+ * Stage latencies and counters of a player since its last prepare(), from FFMpegPlayer.getStats().
+ * Unpacks the array written by metrics_snapshot_pack() in player_metrics.cpp.
+ */
+public class PlayerStats {
+    /**
+     * Count and percentiles of one timed step, in microseconds.
+     */
+    public static class Latency {
+        public final long count;
+        public final long meanUs;
+        public final long p50Us;
+        public final long p90Us;
+        public final long p99Us;
+        public final long maxUs;
+
+        Latency(long[] values, int offset) {
+            count = values[offset];
+            meanUs = values[offset + 1];
+            p50Us = values[offset + 2];
+            p90Us = values[offset + 3];
+            p99Us = values[offset + 4];
+            maxUs = values[offset + 5];
+        }
+
+        @Override
+        public String toString() {
+            return count + " x mean " + meanUs + " p50 " + p50Us + " p90 " + p90Us + " p99 " + p99Us
+                    + " max " + maxUs + " us";
+        }
+    }
+
+    // false when the native library was built without metrics, or nothing is prepared
+    public final boolean enabled;
+
+    public final long packets;
+    public final long demuxedBytes;
+    public final long framesDecoded;
+    public final long framesPresented;
+    // late frames dropped before they were converted
+    public final long framesDropped;
+    public final long convertedBytes;
+    // rungs of the degradation ladder taken and given back since prepare()
+    public final long degradeStepDowns;
+    public final long degradeStepUps;
+    // how far down the ladder playback is now, 0 at full quality; see DegradationLevel in
+    // degradation_controller.h for the rungs
+    public final long degradeLevel;
+    // frames the frame rate cap left out, and the CPU time that saved over the media time it
+    // was capped for; see FFMpegPlayer.setMaxFrameRate()
+    public final long rateCapSkipped;
+    public final long rateCapSavedUs;
+    public final long rateCapMediaUs;
+    public final long rateCapSavedMsPerMinute;
+
+    public final Latency demuxRead;
+    public final Latency decode;
+    public final Latency convert;
+    public final Latency windowLock;
+    public final Latency windowPost;
+
+    PlayerStats(long[] values) {
+        enabled = values[0] != 0;
+        packets = values[1];
+        demuxedBytes = values[2];
+        framesDecoded = values[3];
+        framesPresented = values[4];
+        framesDropped = values[5];
+        convertedBytes = values[6];
+        degradeStepDowns = values[7];
+        degradeStepUps = values[8];
+        rateCapSkipped = values[9];
+        rateCapSavedUs = values[10];
+        rateCapMediaUs = values[11];
+        rateCapSavedMsPerMinute = rateCapMediaUs > 0 ? rateCapSavedUs * 60000 / rateCapMediaUs : 0;
+        degradeLevel = values[12];
+        demuxRead = new Latency(values, 13);
+        decode = new Latency(values, 19);
+        convert = new Latency(values, 25);
+        windowLock = new Latency(values, 31);
+        windowPost = new Latency(values, 37);
+    }
+
+    @Override
+    public String toString() {
+        if (!enabled) {
+            return "stats disabled";
+        }
+        return "packets " + packets + " (" + demuxedBytes + " bytes), frames " + framesDecoded + " decoded "
+                + framesPresented + " presented " + framesDropped + " dropped\n"
+                + "degradation level " + degradeLevel + " (" + degradeStepDowns + " down " + degradeStepUps + " up)\n"
+                + "frame rate cap " + rateCapSkipped + " frames skipped, " + rateCapSavedMsPerMinute
+                + " ms CPU saved per minute\n"
+                + "demux read " + demuxRead + "\n"
+                + "decode " + decode + "\n"
+                + "convert " + convert + "\n"
+                + "window lock " + windowLock + "\n"
+                + "window post " + windowPost;
+    }
+}